@@ -0,0 +1,270 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Include/Kernel/Architecture/hosted/HAL/AtomicImpl.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/07
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	Implements the Atomic functions for the hosted (userspace)
+///			configuration.
+///
+/// This file is included by Kernel/HAL/Atomic.h, and should not be included
+/// directly. The functions are built on GCC's __atomic builtins, so the host
+/// compiler picks the instructions, and tools like ThreadSanitizer understand
+/// them.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_ARCH_HOSTED_HAL_ATOMICIMPL_H_
+#define _KERNEL_ARCH_HOSTED_HAL_ATOMICIMPL_H_
+
+
+/// \brief	Converts an AtomicOrder to the equivalent __ATOMIC_xxx constant.
+static inline int Atomic_hosted_toGccOrder( AtomicOrder order )
+{
+	switch (order)
+	{
+	case ATOMIC_RELAXED:	return __ATOMIC_RELAXED;
+	case ATOMIC_ACQUIRE:	return __ATOMIC_ACQUIRE;
+	case ATOMIC_RELEASE:	return __ATOMIC_RELEASE;
+	case ATOMIC_ACQ_REL:	return __ATOMIC_ACQ_REL;
+	default:				return __ATOMIC_SEQ_CST;
+	}
+}
+
+
+/// \brief	Converts an AtomicOrder to the __ATOMIC_xxx constant for a failed compare-and-swap.
+///
+/// A failed compare-and-swap doesn't write anything, so its order can't include a release.
+static inline int Atomic_hosted_toGccFailureOrder( AtomicOrder order )
+{
+	switch (order)
+	{
+	case ATOMIC_RELEASE:	return __ATOMIC_RELAXED;
+	case ATOMIC_ACQ_REL:	return __ATOMIC_ACQUIRE;
+	default:				return Atomic_hosted_toGccOrder( order );
+	}
+}
+
+
+static inline bool Atomic_compareAndSwapExplicit(
+	volatile uintptr_t*	targetAddress,
+	uintptr_t			compareValue,
+	uintptr_t			updateValue,
+	AtomicOrder			order
+)
+{
+	return __atomic_compare_exchange_n(
+		targetAddress,
+		&compareValue,
+		updateValue,
+		false,
+		Atomic_hosted_toGccOrder( order ),
+		Atomic_hosted_toGccFailureOrder( order )
+	);
+}
+
+
+static inline bool Atomic_compareAndSwap(
+	volatile uintptr_t*	targetAddress,
+	uintptr_t			compareValue,
+	uintptr_t			updateValue
+)
+{
+	return Atomic_compareAndSwapExplicit(
+		targetAddress,
+		compareValue,
+		updateValue,
+		ATOMIC_SEQ_CST
+	);
+}
+
+
+static inline uintptr_t Atomic_swapExplicit(
+	volatile uintptr_t*	targetAddress,
+	uintptr_t			updateValue,
+	AtomicOrder			order
+)
+{
+	return __atomic_exchange_n( targetAddress, updateValue, Atomic_hosted_toGccOrder( order ) );
+}
+
+
+static inline uintptr_t Atomic_swap( volatile uintptr_t* targetAddress, uintptr_t updateValue )
+{
+	return Atomic_swapExplicit( targetAddress, updateValue, ATOMIC_SEQ_CST );
+}
+
+
+static inline uintptr_t Atomic_readExplicit(
+	const volatile uintptr_t*	targetAddress,
+	AtomicOrder					order
+)
+{
+	if ((order == ATOMIC_RELEASE) || (order == ATOMIC_ACQ_REL))
+	{
+		order = ATOMIC_SEQ_CST;
+	}
+	return __atomic_load_n( targetAddress, Atomic_hosted_toGccOrder( order ) );
+}
+
+
+static inline uintptr_t Atomic_read( const volatile uintptr_t* targetAddress )
+{
+	return Atomic_readExplicit( targetAddress, ATOMIC_ACQUIRE );
+}
+
+
+static inline void Atomic_writeExplicit(
+	volatile uintptr_t*	targetAddress,
+	uintptr_t			updateValue,
+	AtomicOrder			order
+)
+{
+	if ((order == ATOMIC_ACQUIRE) || (order == ATOMIC_ACQ_REL))
+	{
+		order = ATOMIC_SEQ_CST;
+	}
+	__atomic_store_n( targetAddress, updateValue, Atomic_hosted_toGccOrder( order ) );
+}
+
+
+static inline void Atomic_write( volatile uintptr_t* targetAddress, uintptr_t updateValue )
+{
+	Atomic_writeExplicit( targetAddress, updateValue, ATOMIC_RELEASE );
+}
+
+
+static inline uintptr_t Atomic_fetchAddExplicit(
+	volatile uintptr_t*	targetAddress,
+	uintptr_t			addend,
+	AtomicOrder			order
+)
+{
+	return __atomic_fetch_add( targetAddress, addend, Atomic_hosted_toGccOrder( order ) );
+}
+
+
+static inline uintptr_t Atomic_fetchAdd( volatile uintptr_t* targetAddress, uintptr_t addend )
+{
+	return Atomic_fetchAddExplicit( targetAddress, addend, ATOMIC_SEQ_CST );
+}
+
+
+static inline uintptr_t Atomic_fetchOrExplicit(
+	volatile uintptr_t*	targetAddress,
+	uintptr_t			bits,
+	AtomicOrder			order
+)
+{
+	return __atomic_fetch_or( targetAddress, bits, Atomic_hosted_toGccOrder( order ) );
+}
+
+
+static inline uintptr_t Atomic_fetchOr( volatile uintptr_t* targetAddress, uintptr_t bits )
+{
+	return Atomic_fetchOrExplicit( targetAddress, bits, ATOMIC_SEQ_CST );
+}
+
+
+static inline uintptr_t Atomic_fetchAndExplicit(
+	volatile uintptr_t*	targetAddress,
+	uintptr_t			mask,
+	AtomicOrder			order
+)
+{
+	return __atomic_fetch_and( targetAddress, mask, Atomic_hosted_toGccOrder( order ) );
+}
+
+
+static inline uintptr_t Atomic_fetchAnd( volatile uintptr_t* targetAddress, uintptr_t mask )
+{
+	return Atomic_fetchAndExplicit( targetAddress, mask, ATOMIC_SEQ_CST );
+}
+
+
+static inline bool Atomic_bitTestAndSetExplicit(
+	volatile uintptr_t*	targetAddress,
+	uint8_t				bit,
+	AtomicOrder			order
+)
+{
+	// GCC turns this into LOCK BTS when only the one bit of the result is used.
+	uintptr_t mask = ((uintptr_t) 1) << bit;
+	return (Atomic_fetchOrExplicit( targetAddress, mask, order ) & mask) != 0;
+}
+
+
+static inline bool Atomic_bitTestAndSet( volatile uintptr_t* targetAddress, uint8_t bit )
+{
+	return Atomic_bitTestAndSetExplicit( targetAddress, bit, ATOMIC_SEQ_CST );
+}
+
+
+static inline bool Atomic_bitTestAndResetExplicit(
+	volatile uintptr_t*	targetAddress,
+	uint8_t				bit,
+	AtomicOrder			order
+)
+{
+	uintptr_t mask = ((uintptr_t) 1) << bit;
+	return (Atomic_fetchAndExplicit( targetAddress, ~mask, order ) & mask) != 0;
+}
+
+
+static inline bool Atomic_bitTestAndReset( volatile uintptr_t* targetAddress, uint8_t bit )
+{
+	return Atomic_bitTestAndResetExplicit( targetAddress, bit, ATOMIC_SEQ_CST );
+}
+
+
+static inline bool Atomic_compareAndSwap64Explicit(
+	volatile uint64_t*	targetAddress,
+	uint64_t			compareValue,
+	uint64_t			updateValue,
+	AtomicOrder			order
+)
+{
+	return __atomic_compare_exchange_n(
+		targetAddress,
+		&compareValue,
+		updateValue,
+		false,
+		Atomic_hosted_toGccOrder( order ),
+		Atomic_hosted_toGccFailureOrder( order )
+	);
+}
+
+
+static inline bool Atomic_compareAndSwap64(
+	volatile uint64_t*	targetAddress,
+	uint64_t			compareValue,
+	uint64_t			updateValue
+)
+{
+	return Atomic_compareAndSwap64Explicit(
+		targetAddress,
+		compareValue,
+		updateValue,
+		ATOMIC_SEQ_CST
+	);
+}
+
+
+static inline void Atomic_fence( AtomicOrder order )
+{
+	__atomic_thread_fence( Atomic_hosted_toGccOrder( order ) );
+}
+
+
+#endif
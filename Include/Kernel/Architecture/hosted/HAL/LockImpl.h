@@ -0,0 +1,60 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Include/Kernel/Architecture/hosted/HAL/LockImpl.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/Apr/30
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	Defines the Lock structure for the hosted (userspace) configuration.
+///
+/// The hosted configuration runs kernel code in an ordinary process for
+/// testing and benchmarking. Every thread in the process plays the part of
+/// a processor, so a Lock is a simple spinlock rather than an interrupt
+/// mask.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_HAL_LOCKIMPL_H_
+#define _KERNEL_HAL_LOCKIMPL_H_
+
+
+#include "Kernel/HAL/LockStats.h"
+
+
+/// \brief	Defines the fields of the Lock structure.
+typedef struct LockStruct
+{
+#ifdef _KERNEL_HAL_LOCK_C_
+
+	/// \brief	Non-zero while some thread holds the lock.
+	volatile int m_isHeld;
+
+#ifdef LOCK_STATS
+	/// \brief	Who holds the lock and since when, for the instrumented Lock.
+	LockStatsHold m_stats;
+#endif
+
+#else
+
+	#ifndef DOXYGEN_SHOULD_SKIP_THIS
+	volatile int	m_reserved0;
+	#ifdef LOCK_STATS
+	LockStatsHold	m_reserved1;
+	#endif
+	#endif
+
+#endif
+} Lock;
+
+
+#endif
@@ -0,0 +1,38 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Include/Kernel/Architecture/hosted/HAL/ProcessorImpl.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/Apr/30
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	Defines architecture-specific constants for the Processor class in
+///			the hosted (userspace) configuration.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_HAL_PROCESSORIMPL_H_
+#define _KERNEL_HAL_PROCESSORIMPL_H_
+
+
+/// \brief	Defines constants for the implementation of the Processor class.
+enum ProcessorImpl_consts
+{
+	/// \brief	The largest number of processors supported by this configuration.
+	///
+	/// Each thread of the host process is assigned to one of these "processors" the first time it
+	/// asks for its current processor. Threads beyond this many share processors round-robin.
+	PROCESSOR_MAX_COUNT = 64
+};
+
+
+#endif
@@ -0,0 +1,81 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Include/Kernel/Architecture/hosted/HAL/QueueLockImpl.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/08
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	Defines the QueueLock structures for the hosted (userspace)
+///			configuration.
+///
+/// This is an MCS lock, like the x86_smp version, but without the interrupt
+/// masking.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_HAL_QUEUELOCKIMPL_H_
+#define _KERNEL_HAL_QUEUELOCKIMPL_H_
+
+
+#include "Kernel/HAL/LockStats.h"
+
+
+/// \brief	Defines the fields of a waiter's place in a QueueLock.
+typedef struct QueueLockNodeStruct
+{
+#ifdef _KERNEL_HAL_QUEUELOCK_C_
+
+	/// \brief	The node of the thread queued behind this one, or NULL if there isn't one yet.
+	struct QueueLockNodeStruct* volatile m_next;
+
+	/// \brief	Non-zero until the thread ahead of this one hands over the lock.
+	volatile int m_isWaiting;
+
+#else
+
+	#ifndef DOXYGEN_SHOULD_SKIP_THIS
+	void* volatile	m_reserved0;
+	volatile int	m_reserved1;
+	#endif
+
+#endif
+} QueueLockNode;
+
+
+/// \brief	Defines the fields of the QueueLock structure.
+typedef struct QueueLockStruct
+{
+#ifdef _KERNEL_HAL_QUEUELOCK_C_
+
+	/// \brief	The node of the last thread in the queue, or NULL if the lock is free.
+	QueueLockNode* volatile m_tail;
+
+#ifdef LOCK_STATS
+	/// \brief	Who holds the lock and since when, for the instrumented QueueLock.
+	LockStatsHold m_stats;
+#endif
+
+#else
+
+	#ifndef DOXYGEN_SHOULD_SKIP_THIS
+	QueueLockNode* volatile	m_reserved0;
+	#ifdef LOCK_STATS
+	LockStatsHold			m_reserved1;
+	#endif
+	#endif
+
+#endif
+} QueueLock;
+
+
+#endif
@@ -0,0 +1,76 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Include/Kernel/Architecture/hosted/HAL/RWLockImpl.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/09
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	Defines the RWLock structures for the hosted (userspace)
+///			configuration.
+///
+/// This works the same way as the x86_smp version, but without the interrupt
+/// masking, so a reader has nothing to remember.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_HAL_RWLOCKIMPL_H_
+#define _KERNEL_HAL_RWLOCKIMPL_H_
+
+
+#include <stdint.h>
+#include "Kernel/HAL/Lock.h"
+#include "Kernel/HAL/LockStats.h"
+
+
+/// \brief	Defines the fields of a reader's hold on an RWLock.
+typedef struct RWLockReaderStruct
+{
+	#ifndef DOXYGEN_SHOULD_SKIP_THIS
+	int m_reserved;
+	#endif
+
+} RWLockReader;
+
+
+/// \brief	Defines the fields of the RWLock structure.
+typedef struct RWLockStruct
+{
+#ifdef _KERNEL_HAL_RWLOCK_C_
+
+	/// \brief	The number of readers in the low bits, and the top bit set while there is a
+	///			writer.
+	volatile uintptr_t m_state;
+
+	/// \brief	Serializes writers.
+	Lock m_writerLock;
+
+#ifdef LOCK_STATS
+	/// \brief	Who holds the lock for writing and since when, for the instrumented RWLock.
+	LockStatsHold m_stats;
+#endif
+
+#else
+
+	#ifndef DOXYGEN_SHOULD_SKIP_THIS
+	volatile uintptr_t	m_reserved0;
+	Lock				m_reserved1;
+	#ifdef LOCK_STATS
+	LockStatsHold		m_reserved2;
+	#endif
+	#endif
+
+#endif
+} RWLock;
+
+
+#endif
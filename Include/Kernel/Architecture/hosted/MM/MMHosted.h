@@ -0,0 +1,45 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Include/Kernel/Architecture/hosted/MM/MMHosted.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/21
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	Declares the Memory Manager utilities that only exist in the hosted
+///			(userspace) configuration.
+///
+/// There is no real cache to measure in the hosted configuration, so tests
+/// pick the number of cache colours themselves.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_MM_MMHOSTED_H_
+#define _KERNEL_MM_MMHOSTED_H_
+
+
+#include <stddef.h>
+
+
+/// \brief	Sets the value that MM_getNumCacheColours() returns from now on.
+///
+/// \param numColours	the number of colours; Must be a power of two between 1 and
+///						MAX_CACHE_COLOURS inclusive.
+///
+/// Allocators read the number of colours when they are created, so call this first. The default
+/// is one colour.
+///
+/// This method is not thread-safe.
+void MM_hosted_setNumCacheColours( size_t numColours );
+
+
+#endif
@@ -0,0 +1,419 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Include/Kernel/Architecture/x86/HAL/AtomicImpl.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/07
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	Implements the Atomic functions for the x86 architecture.
+///
+/// This file is included by Kernel/HAL/Atomic.h, and should not be included
+/// directly.
+///
+/// x86 is strongly ordered: reads are never moved before earlier reads,
+/// writes are never moved before earlier accesses, and locked instructions
+/// are full barriers. The only reordering the processor does is to let a
+/// read pass an earlier write to a different address. As a result:
+///
+/// - Relaxed, acquire, and release reads and writes are all plain MOVs. The
+///	  orders only differ in what the compiler is allowed to move around them,
+///	  which is controlled with "memory" clobbers.
+/// - Sequentially consistent writes use XCHG, which is locked, so that a
+///	  later read can't pass them.
+/// - Compare-and-swap and swap are locked, so they are sequentially
+///	  consistent no matter what order is asked for. Weaker orders only drop
+///	  the "memory" clobber.
+/// - Fetch-and-add and the bit operations are single locked instructions
+///	  (XADD, BTS, and BTR). Fetch-and-OR and fetch-and-AND have no single
+///	  instruction that returns the old value, so they are compare-and-swap
+///	  loops.
+///
+/// These all require a 486 or later, which is what the kernel requires
+/// anyway, except for Atomic_compareAndSwap64(), which uses CMPXCHG8B and so
+/// needs a Pentium.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_ARCH_X86_HAL_ATOMICIMPL_H_
+#define _KERNEL_ARCH_X86_HAL_ATOMICIMPL_H_
+
+
+#include "Kernel/KCommon/KDebug.h"
+#include "Kernel/KCommon/KMem.h"
+
+
+/// \brief	Stops the compiler from moving memory accesses across this point. Emits no code.
+static inline void Atomic_x86_compilerBarrier( void )
+{
+	__asm__ __volatile__ ( "" : : : "memory" );
+}
+
+
+static inline bool Atomic_compareAndSwapExplicit(
+	volatile uintptr_t*	targetAddress,
+	uintptr_t			compareValue,
+	uintptr_t			updateValue,
+	AtomicOrder			order
+)
+{
+	uint8_t succeeded;
+	if (order == ATOMIC_RELAXED)
+	{
+		__asm__ __volatile__ (
+			"lock cmpxchgl %3, %1\n\t"
+			"setz %0"
+			: "=q" (succeeded), "+m" (*targetAddress), "+a" (compareValue)
+			: "r" (updateValue)
+			: "cc"
+		);
+	}
+	else
+	{
+		__asm__ __volatile__ (
+			"lock cmpxchgl %3, %1\n\t"
+			"setz %0"
+			: "=q" (succeeded), "+m" (*targetAddress), "+a" (compareValue)
+			: "r" (updateValue)
+			: "cc", "memory"
+		);
+	}
+	return succeeded != 0;
+}
+
+
+static inline bool Atomic_compareAndSwap(
+	volatile uintptr_t*	targetAddress,
+	uintptr_t			compareValue,
+	uintptr_t			updateValue
+)
+{
+	return Atomic_compareAndSwapExplicit(
+		targetAddress,
+		compareValue,
+		updateValue,
+		ATOMIC_SEQ_CST
+	);
+}
+
+
+static inline uintptr_t Atomic_swapExplicit(
+	volatile uintptr_t*	targetAddress,
+	uintptr_t			updateValue,
+	AtomicOrder			order
+)
+{
+	// XCHG with a memory operand is always locked, so there's no need for the LOCK prefix.
+	if (order == ATOMIC_RELAXED)
+	{
+		__asm__ __volatile__ (
+			"xchgl %0, %1"
+			: "+r" (updateValue), "+m" (*targetAddress)
+		);
+	}
+	else
+	{
+		__asm__ __volatile__ (
+			"xchgl %0, %1"
+			: "+r" (updateValue), "+m" (*targetAddress)
+			:
+			: "memory"
+		);
+	}
+	return updateValue;
+}
+
+
+static inline uintptr_t Atomic_swap( volatile uintptr_t* targetAddress, uintptr_t updateValue )
+{
+	return Atomic_swapExplicit( targetAddress, updateValue, ATOMIC_SEQ_CST );
+}
+
+
+static inline uintptr_t Atomic_readExplicit(
+	const volatile uintptr_t*	targetAddress,
+	AtomicOrder					order
+)
+{
+	// Reads and writes of 32-bit values to 32-bit-aligned addresses are atomic on every processor
+	// since the 486. The volatile keeps the compiler from caching the value in a register.
+	KDebug_assert( KMem_isAligned32( (uintptr_t) targetAddress ) );
+
+	uintptr_t value = *targetAddress;
+	if (order != ATOMIC_RELAXED)
+	{
+		Atomic_x86_compilerBarrier();
+	}
+	return value;
+}
+
+
+static inline uintptr_t Atomic_read( const volatile uintptr_t* targetAddress )
+{
+	return Atomic_readExplicit( targetAddress, ATOMIC_ACQUIRE );
+}
+
+
+static inline void Atomic_writeExplicit(
+	volatile uintptr_t*	targetAddress,
+	uintptr_t			updateValue,
+	AtomicOrder			order
+)
+{
+	KDebug_assert( KMem_isAligned32( (uintptr_t) targetAddress ) );
+
+	switch (order)
+	{
+	case ATOMIC_RELAXED:
+		*targetAddress = updateValue;
+		break;
+
+	case ATOMIC_RELEASE:
+		Atomic_x86_compilerBarrier();
+		*targetAddress = updateValue;
+		break;
+
+	default:
+		(void) Atomic_swapExplicit( targetAddress, updateValue, ATOMIC_SEQ_CST );
+		break;
+	}
+}
+
+
+static inline void Atomic_write( volatile uintptr_t* targetAddress, uintptr_t updateValue )
+{
+	Atomic_writeExplicit( targetAddress, updateValue, ATOMIC_RELEASE );
+}
+
+
+static inline uintptr_t Atomic_fetchAddExplicit(
+	volatile uintptr_t*	targetAddress,
+	uintptr_t			addend,
+	AtomicOrder			order
+)
+{
+	if (order == ATOMIC_RELAXED)
+	{
+		__asm__ __volatile__ (
+			"lock xaddl %0, %1"
+			: "+r" (addend), "+m" (*targetAddress)
+			:
+			: "cc"
+		);
+	}
+	else
+	{
+		__asm__ __volatile__ (
+			"lock xaddl %0, %1"
+			: "+r" (addend), "+m" (*targetAddress)
+			:
+			: "cc", "memory"
+		);
+	}
+	return addend;
+}
+
+
+static inline uintptr_t Atomic_fetchAdd( volatile uintptr_t* targetAddress, uintptr_t addend )
+{
+	return Atomic_fetchAddExplicit( targetAddress, addend, ATOMIC_SEQ_CST );
+}
+
+
+static inline uintptr_t Atomic_fetchOrExplicit(
+	volatile uintptr_t*	targetAddress,
+	uintptr_t			bits,
+	AtomicOrder			order
+)
+{
+	uintptr_t oldValue;
+	do
+	{
+		oldValue = Atomic_readExplicit( targetAddress, ATOMIC_RELAXED );
+	} while (!Atomic_compareAndSwapExplicit( targetAddress, oldValue, oldValue | bits, order ));
+	return oldValue;
+}
+
+
+static inline uintptr_t Atomic_fetchOr( volatile uintptr_t* targetAddress, uintptr_t bits )
+{
+	return Atomic_fetchOrExplicit( targetAddress, bits, ATOMIC_SEQ_CST );
+}
+
+
+static inline uintptr_t Atomic_fetchAndExplicit(
+	volatile uintptr_t*	targetAddress,
+	uintptr_t			mask,
+	AtomicOrder			order
+)
+{
+	uintptr_t oldValue;
+	do
+	{
+		oldValue = Atomic_readExplicit( targetAddress, ATOMIC_RELAXED );
+	} while (!Atomic_compareAndSwapExplicit( targetAddress, oldValue, oldValue & mask, order ));
+	return oldValue;
+}
+
+
+static inline uintptr_t Atomic_fetchAnd( volatile uintptr_t* targetAddress, uintptr_t mask )
+{
+	return Atomic_fetchAndExplicit( targetAddress, mask, ATOMIC_SEQ_CST );
+}
+
+
+static inline bool Atomic_bitTestAndSetExplicit(
+	volatile uintptr_t*	targetAddress,
+	uint8_t				bit,
+	AtomicOrder			order
+)
+{
+	// With a register operand, BTS treats memory as a bit string and can reach past the word, so
+	// the bit number has to be checked.
+	KDebug_assert( bit < (sizeof( uintptr_t ) * 8) );
+
+	uint8_t wasSet;
+	if (order == ATOMIC_RELAXED)
+	{
+		__asm__ __volatile__ (
+			"lock btsl %2, %1\n\t"
+			"setc %0"
+			: "=q" (wasSet), "+m" (*targetAddress)
+			: "Ir" ((uintptr_t) bit)
+			: "cc"
+		);
+	}
+	else
+	{
+		__asm__ __volatile__ (
+			"lock btsl %2, %1\n\t"
+			"setc %0"
+			: "=q" (wasSet), "+m" (*targetAddress)
+			: "Ir" ((uintptr_t) bit)
+			: "cc", "memory"
+		);
+	}
+	return wasSet != 0;
+}
+
+
+static inline bool Atomic_bitTestAndSet( volatile uintptr_t* targetAddress, uint8_t bit )
+{
+	return Atomic_bitTestAndSetExplicit( targetAddress, bit, ATOMIC_SEQ_CST );
+}
+
+
+static inline bool Atomic_bitTestAndResetExplicit(
+	volatile uintptr_t*	targetAddress,
+	uint8_t				bit,
+	AtomicOrder			order
+)
+{
+	KDebug_assert( bit < (sizeof( uintptr_t ) * 8) );
+
+	uint8_t wasSet;
+	if (order == ATOMIC_RELAXED)
+	{
+		__asm__ __volatile__ (
+			"lock btrl %2, %1\n\t"
+			"setc %0"
+			: "=q" (wasSet), "+m" (*targetAddress)
+			: "Ir" ((uintptr_t) bit)
+			: "cc"
+		);
+	}
+	else
+	{
+		__asm__ __volatile__ (
+			"lock btrl %2, %1\n\t"
+			"setc %0"
+			: "=q" (wasSet), "+m" (*targetAddress)
+			: "Ir" ((uintptr_t) bit)
+			: "cc", "memory"
+		);
+	}
+	return wasSet != 0;
+}
+
+
+static inline bool Atomic_bitTestAndReset( volatile uintptr_t* targetAddress, uint8_t bit )
+{
+	return Atomic_bitTestAndResetExplicit( targetAddress, bit, ATOMIC_SEQ_CST );
+}
+
+
+static inline bool Atomic_compareAndSwap64Explicit(
+	volatile uint64_t*	targetAddress,
+	uint64_t			compareValue,
+	uint64_t			updateValue,
+	AtomicOrder			order
+)
+{
+	// CMPXCHG8B compares EDX:EAX with the target, and if they match, stores ECX:EBX.
+	KDebug_assert( ((uintptr_t) targetAddress & 7) == 0 );
+
+	uint8_t succeeded;
+	if (order == ATOMIC_RELAXED)
+	{
+		__asm__ __volatile__ (
+			"lock cmpxchg8b %1\n\t"
+			"setz %0"
+			: "=q" (succeeded), "+m" (*targetAddress), "+A" (compareValue)
+			: "b" ((uint32_t) updateValue), "c" ((uint32_t) (updateValue >> 32))
+			: "cc"
+		);
+	}
+	else
+	{
+		__asm__ __volatile__ (
+			"lock cmpxchg8b %1\n\t"
+			"setz %0"
+			: "=q" (succeeded), "+m" (*targetAddress), "+A" (compareValue)
+			: "b" ((uint32_t) updateValue), "c" ((uint32_t) (updateValue >> 32))
+			: "cc", "memory"
+		);
+	}
+	return succeeded != 0;
+}
+
+
+static inline bool Atomic_compareAndSwap64(
+	volatile uint64_t*	targetAddress,
+	uint64_t			compareValue,
+	uint64_t			updateValue
+)
+{
+	return Atomic_compareAndSwap64Explicit(
+		targetAddress,
+		compareValue,
+		updateValue,
+		ATOMIC_SEQ_CST
+	);
+}
+
+
+static inline void Atomic_fence( AtomicOrder order )
+{
+	if (order == ATOMIC_SEQ_CST)
+	{
+		// MFENCE needs SSE2. A locked no-op on the top of the stack is just as good a barrier,
+		// works on every processor, and is usually faster anyway.
+		__asm__ __volatile__ ( "lock orl $0, (%%esp)" : : : "cc", "memory" );
+	}
+	else if (order != ATOMIC_RELAXED)
+	{
+		Atomic_x86_compilerBarrier();
+	}
+}
+
+
+#endif
@@ -0,0 +1,82 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Include/Kernel/Architecture/x86/HAL/CpuFeatures.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/06
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	This file defines the x86 processor feature detection module.
+///
+/// The features of the bootstrap processor are detected once, by
+/// Processor_initPrimary(), and cached. Modules that have faster versions of
+/// their primitives for some processors (KMem, for example) pick the
+/// version to use when they are initialized, based on these features, so
+/// the hot paths never have to check for themselves.
+///
+/// Only features that the kernel is ready to use are reported. For
+/// example, CPUFEATURE_SSE2 is only reported once the SSE state has been
+/// enabled in CR4.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_ARCH_X86_HAL_CPUFEATURES_H_
+#define _KERNEL_ARCH_X86_HAL_CPUFEATURES_H_
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/// \brief	Identifies a processor feature.
+///
+/// Each feature is a single bit, so that sets of features can be tested with one mask. Keep these
+/// in synch with the definitions in KMem_x86.s.
+typedef enum
+{
+	CPUFEATURE_CPUID			= 0x00000001,	///< CPUID instruction.
+	CPUFEATURE_TSC				= 0x00000002,	///< RDTSC instruction (leaf 1 EDX bit 4).
+	CPUFEATURE_INVARIANT_TSC	= 0x00000004,	///< TSC rate is constant (0x80000007 EDX bit 8).
+	CPUFEATURE_SSE2				= 0x00000008,	///< SSE2 instructions, enabled by the kernel.
+	CPUFEATURE_POPCNT			= 0x00000010,	///< POPCNT instruction (leaf 1 ECX bit 23).
+	CPUFEATURE_LZCNT			= 0x00000020,	///< LZCNT instruction (0x80000001 ECX bit 5).
+	CPUFEATURE_TZCNT			= 0x00000040,	///< TZCNT instruction (leaf 7 EBX bit 3, BMI1).
+	CPUFEATURE_ERMSB			= 0x00000080,	///< Fast REP MOVSB/STOSB (leaf 7 EBX bit 9).
+	CPUFEATURE_APIC				= 0x00000100	///< On-chip local APIC (leaf 1 EDX bit 9).
+
+} CpuFeature;
+
+
+/// \brief	Detects the features of the bootstrap processor, and enables the ones that need it.
+///
+/// This is called by Processor_initPrimary() before anything else, while a zero-size IDT is
+/// loaded, so any fault in here reboots the machine instead of bugchecking. It must not be
+/// called again.
+void CpuFeatures_init( void );
+
+
+/// \brief	Gets the set of features supported by the bootstrap processor.
+///
+/// \return a bitwise OR of CpuFeature values, or zero if CpuFeatures_init() hasn't been called yet.
+uint32_t CpuFeatures_getAll( void );
+
+
+/// \brief	Indicates whether the bootstrap processor supports the given feature.
+///
+/// \param feature	the feature to check for.
+///
+/// \retval true	the feature is supported, and the kernel has enabled it if necessary.
+/// \retval false	the feature is not supported, or CpuFeatures_init() hasn't been called yet.
+bool CpuFeatures_has( CpuFeature feature );
+
+
+#endif
@@ -0,0 +1,71 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Include/Kernel/Architecture/x86/HAL/Cpuid.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/Apr/23
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	This file defines a utility for querying the x86 CPUID
+///			instruction.
+///
+/// CPUID is not available on every processor that Precursor supports (e.g.
+/// the 386 and early 486s), so callers must check Cpuid_isSupported() before
+/// calling Cpuid_query().
+///
+// ===========================================================================
+
+#ifndef _KERNEL_ARCH_X86_HAL_CPUID_H_
+#define _KERNEL_ARCH_X86_HAL_CPUID_H_
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/// \brief	Holds the values returned by the CPUID instruction.
+typedef struct
+{
+	uint32_t eax;	///< Value of EAX after CPUID.
+	uint32_t ebx;	///< Value of EBX after CPUID.
+	uint32_t ecx;	///< Value of ECX after CPUID.
+	uint32_t edx;	///< Value of EDX after CPUID.
+
+} CpuidRegisters;
+
+
+/// \brief	Indicates whether the current processor supports the CPUID instruction.
+///
+/// This is determined by checking whether the ID flag in EFLAGS can be toggled.
+///
+/// \retval true	CPUID is supported.
+/// \retval false	CPUID is not supported.
+bool Cpuid_isSupported( void );
+
+
+/// \brief	Executes the CPUID instruction on the current processor.
+///
+/// \param leaf		the value to load into EAX (the "leaf" to query).
+/// \param subLeaf	the value to load into ECX; Only meaningful for leaves that have sub-leaves.
+/// \param regs		receives the values of EAX, EBX, ECX, and EDX after CPUID executes.
+///
+/// The caller must make sure that CPUID is supported by calling Cpuid_isSupported() first, and
+/// that \a leaf is no greater than the maximum leaf reported by leaf 0 (or leaf 0x80000000 for
+/// extended leaves).
+///
+/// \note
+/// CPUID is a serializing instruction, and is therefore quite slow. Callers should cache the
+/// results rather than calling it on hot paths.
+void Cpuid_query( uint32_t leaf, uint32_t subLeaf, CpuidRegisters* regs );
+
+
+#endif
@@ -30,7 +30,11 @@ enum Mem_consts
 {
 	// MAINTENANCE NOTE: This is defined here so that it's accessible to other parts of the HAL; it is a special case.
 	// In general, MM constants should be private to MM.
-	KERNEL_VIRTUAL_BASE = 0xE0000000	///< Virtual base address of kernel space. 3.5 GB on x86.
+	KERNEL_VIRTUAL_BASE = 0xE0000000,	///< Virtual base address of kernel space. 3.5 GB on x86.
+
+	/// \brief	Virtual base of the two 4MB windows that the HAL uses to reach device registers and
+	///			firmware tables until there is a VMM; K+4MB. MM's windows start at K+12MB.
+	HAL_DEVICE_WINDOW_BASE = KERNEL_VIRTUAL_BASE + 0x00400000
 };
 
 #endif
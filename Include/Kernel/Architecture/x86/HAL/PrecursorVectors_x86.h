@@ -44,7 +44,13 @@ typedef enum
 	INT_HW_IRQ13	= 45,	///< Hardware IRQ 13.
 	INT_HW_IRQ14	= 46,	///< Hardware IRQ 14.
 	INT_HW_IRQ15	= 47,	///< Hardware IRQ 15.
-	INT_SYS_CALL	= 48	///< System call vector.
+	INT_SYS_CALL	= 48,	///< System call vector.
+
+	// The local APIC's own interrupts come after the system call vector. They only arrive when the
+	// InterruptController is using the APIC. Their IRQ numbers are still the vector number minus
+	// INT_HW_IRQ0, so they don't overlap the ISA IRQs.
+	INT_APIC_TIMER		= 49,	///< Local APIC timer.
+	INT_APIC_SPURIOUS	= 63	///< Local APIC spurious interrupt. Older APICs need 0xF low.
 
 } KernelInterruptVector;
 
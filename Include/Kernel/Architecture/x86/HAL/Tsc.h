@@ -0,0 +1,45 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Include/Kernel/Architecture/x86/HAL/Tsc.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/10
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	This file defines a utility for reading the x86 timestamp counter.
+///
+/// The timestamp counter (TSC) counts processor cycles since reset. It is
+/// not available on every processor that Precursor supports (e.g. the 486),
+/// so callers must check for CPUFEATURE_TSC before calling Tsc_read(). Unless
+/// the TSC is also CPUFEATURE_INVARIANT_TSC, its rate can change with the
+/// processor's power state, so it is good for measuring short stretches of
+/// code, but not for keeping time.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_ARCH_X86_HAL_TSC_H_
+#define _KERNEL_ARCH_X86_HAL_TSC_H_
+
+
+#include <stdint.h>
+
+
+/// \brief	Reads the timestamp counter of the current processor with the RDTSC instruction.
+///
+/// RDTSC doesn't wait for earlier instructions to finish, so the result can be off by the depth
+/// of the pipeline. That doesn't matter for anything longer than a few dozen cycles.
+///
+/// \return the number of cycles since the processor was reset.
+uint64_t Tsc_read( void );
+
+
+#endif
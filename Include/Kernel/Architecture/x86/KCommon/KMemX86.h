@@ -0,0 +1,45 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Include/Kernel/Architecture/x86/KCommon/KMemX86.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/28
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	Declares the KMem utilities that only exist in the x86
+///			configurations.
+///
+/// KMem_init() picks the fastest version of each routine that the processor
+/// supports, so only those versions would ever be exercised. Tests use this
+/// to run the slower versions on the same processor.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_KCOMMON_KMEMX86_H_
+#define _KERNEL_KCOMMON_KMEMX86_H_
+
+
+#include <stdint.h>
+
+
+/// \brief	Selects the KMem implementations as KMem_init() would for a processor with only the
+///			given features.
+///
+/// \param features	a bitwise OR of CpuFeature values; Must be a subset of CpuFeatures_getAll().
+///
+/// Call KMem_init() afterwards to go back to the fastest versions.
+///
+/// This method is not thread-safe. Nothing else may be using KMem while it runs.
+void KMem_x86_initForFeatures( uint32_t features );
+
+
+#endif
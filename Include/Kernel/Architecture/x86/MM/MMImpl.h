@@ -60,7 +60,9 @@ enum MM_consts
 	PDE_INDEX_MASK = 0xFFC00000,				///< Masks out the PDE index from a virtual address.
 	PHYS_NULL = 0x00000000,						///< NULL constant for physical addresses.
 	MM_KERNEL_LOAD_PHYS_ADDR = 0x00100000,		///< Physical load address of kernel image.
+	MAX_CACHE_COLOURS = 64,						///< Upper bound on MM_getNumCacheColours().
 	MM_KERNEL_VIRTUAL_BASE = KERNEL_VIRTUAL_BASE,					///< Virtual base of kernel space; K=3.5GB
+	MM_SCRATCH_WINDOW_BASE = KERNEL_VIRTUAL_BASE + 0x00C00000,		///< Virtual base of 4MB scratch window; K+12MB
 	MM_CURRENT_PAGE_TABLES_BASE = KERNEL_VIRTUAL_BASE + 0x01000000,	///< Virtual base of current page tables; K+16MB
 
 	/// \brief	Virtual base address of the current page directory.
@@ -0,0 +1,80 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Include/Kernel/Architecture/x86_smp/HAL/LockImpl.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/08
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	Implements the Lock class for the x86 multiprocessor architecture.
+///
+/// This is the x86 multiprocessor implementation of the Lock class. It is a
+/// ticket lock: acquire() disables interrupts like the uniprocessor version,
+/// then takes the next ticket with a single LOCK XADD and spins until that
+/// ticket is being served. release() serves the next ticket with a plain
+/// increment, which only the holder ever does, then restores the old
+/// EFLAGS.
+///
+/// Processors get the lock in the order they asked for it, so none of them
+/// can be starved. While waiting, they only read the lock, so the cache line
+/// holding it is shared rather than bounced between them.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_HAL_LOCKIMPL_H_
+#define _KERNEL_HAL_LOCKIMPL_H_
+
+
+#include <stdint.h>
+#include "Kernel/HAL/LockStats.h"
+#include "HAL/ProtectedMode.h"
+
+
+/// \brief	Defines the architecture-specific fields of the Lock class.
+///
+/// MAINTENANCE NOTE: LockImpl_x86_smp_asm.s depends on the layout of this structure. In
+/// particular, m_nowServing must be the low word and m_nextTicket the high word of the first
+/// dword, so that taking a ticket also reads the ticket being served.
+typedef struct LockStruct
+{
+#ifdef _KERNEL_HAL_LOCK_C_
+
+	/// \brief	The ticket of the processor that holds the lock.
+	uint16_t m_nowServing;
+
+	/// \brief	The ticket that the next processor to ask for the lock will get.
+	uint16_t m_nextTicket;
+
+	/// \brief	Contains the value of the EFLAGS register prior to when the lock was acquired.
+	EFlagsRegister m_oldEFlags;
+
+#ifdef LOCK_STATS
+	/// \brief	Who holds the lock and since when, for the instrumented Lock.
+	LockStatsHold m_stats;
+#endif
+
+#else
+
+	#ifndef DOXYGEN_SHOULD_SKIP_THIS
+	uint16_t		m_reserved0;
+	uint16_t		m_reserved1;
+	EFlagsRegister	m_reserved2;
+	#ifdef LOCK_STATS
+	LockStatsHold	m_reserved3;
+	#endif
+	#endif
+
+#endif
+} PACKED Lock;
+
+
+#endif
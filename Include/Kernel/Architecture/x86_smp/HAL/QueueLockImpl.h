@@ -0,0 +1,94 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Include/Kernel/Architecture/x86_smp/HAL/QueueLockImpl.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/08
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	Implements the QueueLock class for the x86 multiprocessor
+///			architecture.
+///
+/// This is an MCS lock. The lock itself is just a pointer to the node of the
+/// last processor in the queue, or NULL if the lock is free. acquire()
+/// disables interrupts, swaps its own node in as the new tail with XCHG, and
+/// if there was a previous tail, links itself behind it and spins on its own
+/// m_isWaiting flag. release() hands the lock to the next node by clearing
+/// its flag, or if there is none, swings the tail back to NULL with LOCK
+/// CMPXCHG.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_HAL_QUEUELOCKIMPL_H_
+#define _KERNEL_HAL_QUEUELOCKIMPL_H_
+
+
+#include <stdint.h>
+#include "Kernel/HAL/LockStats.h"
+#include "HAL/ProtectedMode.h"
+
+
+/// \brief	Defines the architecture-specific fields of a waiter's place in a QueueLock.
+///
+/// MAINTENANCE NOTE: LockImpl_x86_smp_asm.s depends on the layout of this structure.
+typedef struct QueueLockNodeStruct
+{
+#ifdef _KERNEL_HAL_QUEUELOCK_C_
+
+	/// \brief	The node of the processor queued behind this one, or NULL if there isn't one yet.
+	struct QueueLockNodeStruct* m_next;
+
+	/// \brief	Non-zero until the processor ahead of this one hands over the lock.
+	uint32_t m_isWaiting;
+
+	/// \brief	Contains the value of the EFLAGS register prior to when the lock was acquired.
+	EFlagsRegister m_oldEFlags;
+
+#else
+
+	#ifndef DOXYGEN_SHOULD_SKIP_THIS
+	void*			m_reserved0;
+	uint32_t		m_reserved1;
+	EFlagsRegister	m_reserved2;
+	#endif
+
+#endif
+} PACKED QueueLockNode;
+
+
+/// \brief	Defines the architecture-specific fields of the QueueLock class.
+typedef struct QueueLockStruct
+{
+#ifdef _KERNEL_HAL_QUEUELOCK_C_
+
+	/// \brief	The node of the last processor in the queue, or NULL if the lock is free.
+	QueueLockNode* m_tail;
+
+#ifdef LOCK_STATS
+	/// \brief	Who holds the lock and since when, for the instrumented QueueLock.
+	LockStatsHold m_stats;
+#endif
+
+#else
+
+	#ifndef DOXYGEN_SHOULD_SKIP_THIS
+	void*			m_reserved0;
+	#ifdef LOCK_STATS
+	LockStatsHold	m_reserved1;
+	#endif
+	#endif
+
+#endif
+} PACKED QueueLock;
+
+
+#endif
@@ -0,0 +1,93 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Include/Kernel/Architecture/x86_smp/HAL/RWLockImpl.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/09
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	Implements the RWLock class for the x86 multiprocessor
+///			architecture.
+///
+/// The state of the lock is one dword: the top bit is set while a writer
+/// holds or is waiting for the lock, and the rest count the readers.
+/// Readers take the lock with a LOCK XADD of one, and back out if the writer
+/// bit turns out to be set. Writers first line up on an ordinary Lock, which
+/// also takes care of the interrupts, then set the writer bit and wait for
+/// the readers to drain.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_HAL_RWLOCKIMPL_H_
+#define _KERNEL_HAL_RWLOCKIMPL_H_
+
+
+#include <stdint.h>
+#include "Kernel/HAL/Lock.h"
+#include "Kernel/HAL/LockStats.h"
+#include "HAL/ProtectedMode.h"
+
+
+/// \brief	Defines the architecture-specific fields of a reader's hold on an RWLock.
+///
+/// MAINTENANCE NOTE: LockImpl_x86_smp_asm.s depends on the layout of this structure.
+typedef struct RWLockReaderStruct
+{
+#ifdef _KERNEL_HAL_RWLOCK_C_
+
+	/// \brief	Contains the value of the EFLAGS register prior to when the lock was acquired.
+	EFlagsRegister m_oldEFlags;
+
+#else
+
+	#ifndef DOXYGEN_SHOULD_SKIP_THIS
+	EFlagsRegister m_reserved;
+	#endif
+
+#endif
+} PACKED RWLockReader;
+
+
+/// \brief	Defines the architecture-specific fields of the RWLock class.
+///
+/// MAINTENANCE NOTE: LockImpl_x86_smp_asm.s depends on the layout of this structure.
+typedef struct RWLockStruct
+{
+#ifdef _KERNEL_HAL_RWLOCK_C_
+
+	/// \brief	The number of readers in the low 31 bits, and the top bit set while there is a
+	///			writer.
+	uint32_t m_state;
+
+	/// \brief	Serializes writers, and holds the old EFLAGS of the current writer.
+	Lock m_writerLock;
+
+#ifdef LOCK_STATS
+	/// \brief	Who holds the lock for writing and since when, for the instrumented RWLock.
+	LockStatsHold m_stats;
+#endif
+
+#else
+
+	#ifndef DOXYGEN_SHOULD_SKIP_THIS
+	uint32_t		m_reserved0;
+	Lock			m_reserved1;
+	#ifdef LOCK_STATS
+	LockStatsHold	m_reserved2;
+	#endif
+	#endif
+
+#endif
+} PACKED RWLock;
+
+
+#endif
@@ -28,6 +28,7 @@
 #define _KERNEL_HAL_LOCKIMPL_H_
 
 
+#include "Kernel/HAL/LockStats.h"
 #include "HAL/ProtectedMode.h"
 
 
@@ -39,10 +40,18 @@ typedef struct LockStruct
 	/// \brief	Contains the value of the EFLAGS register prior to when the lock was acquired.
 	EFlagsRegister m_oldEFlags;
 
+#ifdef LOCK_STATS
+	/// \brief	Who holds the lock and since when, for the instrumented Lock.
+	LockStatsHold m_stats;
+#endif
+
 #else
 
 	#ifndef DOXYGEN_SHOULD_SKIP_THIS
 	EFlagsRegister m_reserved;
+	#ifdef LOCK_STATS
+	LockStatsHold m_reserved1;
+	#endif
 	#endif
 
 #endif
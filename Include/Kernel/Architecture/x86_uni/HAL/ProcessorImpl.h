@@ -0,0 +1,38 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Include/Kernel/Architecture/x86_uni/HAL/ProcessorImpl.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/Apr/16
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	Defines configuration-specific constants for the Processor class
+///			for the x86 uniprocessor architecture.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_HAL_PROCESSORIMPL_H_
+#define _KERNEL_HAL_PROCESSORIMPL_H_
+
+
+/// \brief	Defines configuration-specific constants for the Processor class.
+enum ProcessorImpl_consts
+{
+	/// \brief	The largest number of processors supported by this configuration.
+	///
+	/// Processor IDs range from 0 to PROCESSOR_MAX_COUNT - 1, so they can be used to index
+	/// per-processor arrays.
+	PROCESSOR_MAX_COUNT = 1
+};
+
+
+#endif
@@ -0,0 +1,72 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Include/Kernel/Architecture/x86_uni/HAL/QueueLockImpl.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/08
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	Implements the QueueLock class for the x86 uniprocessor
+///			architecture.
+///
+/// There is never anyone to queue behind on a uniprocessor, so a QueueLock
+/// has the same layout as a Lock, and acquire() and release() are the same
+/// code as the Lock versions. The QueueLockNode is unused.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_HAL_QUEUELOCKIMPL_H_
+#define _KERNEL_HAL_QUEUELOCKIMPL_H_
+
+
+#include <stdint.h>
+#include "Kernel/HAL/LockStats.h"
+#include "HAL/ProtectedMode.h"
+
+
+/// \brief	Defines the architecture-specific fields of a waiter's place in a QueueLock.
+typedef struct QueueLockNodeStruct
+{
+	#ifndef DOXYGEN_SHOULD_SKIP_THIS
+	uint8_t m_reserved;
+	#endif
+
+} QueueLockNode;
+
+
+/// \brief	Defines the architecture-specific fields of the QueueLock class.
+typedef struct QueueLockStruct
+{
+#ifdef _KERNEL_HAL_QUEUELOCK_C_
+
+	/// \brief	Contains the value of the EFLAGS register prior to when the lock was acquired.
+	EFlagsRegister m_oldEFlags;
+
+#ifdef LOCK_STATS
+	/// \brief	Who holds the lock and since when, for the instrumented QueueLock.
+	LockStatsHold m_stats;
+#endif
+
+#else
+
+	#ifndef DOXYGEN_SHOULD_SKIP_THIS
+	EFlagsRegister	m_reserved0;
+	#ifdef LOCK_STATS
+	LockStatsHold	m_reserved1;
+	#endif
+	#endif
+
+#endif
+} PACKED QueueLock;
+
+
+#endif
@@ -0,0 +1,81 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Include/Kernel/Architecture/x86_uni/HAL/RWLockImpl.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/09
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	Implements the RWLock class for the x86 uniprocessor
+///			architecture.
+///
+/// With only one processor, disabling interrupts already keeps everyone
+/// else out, so readers and writers both just save EFLAGS and clear IF. A
+/// writer keeps the old EFLAGS in the RWLock, exactly like a Lock, and a
+/// reader keeps them in its RWLockReader.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_HAL_RWLOCKIMPL_H_
+#define _KERNEL_HAL_RWLOCKIMPL_H_
+
+
+#include "Kernel/HAL/LockStats.h"
+#include "HAL/ProtectedMode.h"
+
+
+/// \brief	Defines the architecture-specific fields of a reader's hold on an RWLock.
+typedef struct RWLockReaderStruct
+{
+#ifdef _KERNEL_HAL_RWLOCK_C_
+
+	/// \brief	Contains the value of the EFLAGS register prior to when the lock was acquired.
+	EFlagsRegister m_oldEFlags;
+
+#else
+
+	#ifndef DOXYGEN_SHOULD_SKIP_THIS
+	EFlagsRegister m_reserved;
+	#endif
+
+#endif
+} PACKED RWLockReader;
+
+
+/// \brief	Defines the architecture-specific fields of the RWLock class.
+typedef struct RWLockStruct
+{
+#ifdef _KERNEL_HAL_RWLOCK_C_
+
+	/// \brief	Contains the value of the EFLAGS register prior to when the lock was acquired for
+	///			writing.
+	EFlagsRegister m_oldEFlags;
+
+#ifdef LOCK_STATS
+	/// \brief	Who holds the lock for writing and since when, for the instrumented RWLock.
+	LockStatsHold m_stats;
+#endif
+
+#else
+
+	#ifndef DOXYGEN_SHOULD_SKIP_THIS
+	EFlagsRegister	m_reserved0;
+	#ifdef LOCK_STATS
+	LockStatsHold	m_reserved1;
+	#endif
+	#endif
+
+#endif
+} PACKED RWLock;
+
+
+#endif
@@ -18,6 +18,18 @@
 /// \brief	Defines functions for atomically comparing and updating values in
 ///			memory.
 ///
+/// All of these functions are inline. They are implemented by the
+/// architecture-specific HAL/AtomicImpl.h, and each one compiles down to one
+/// or two instructions, so they are cheap enough for the hottest loops.
+///
+/// Each operation comes in two forms. The plain form (e.g. --
+/// Atomic_compareAndSwap()) has the ordering that most callers want. The
+/// "Explicit" form (e.g. -- Atomic_compareAndSwapExplicit()) takes an
+/// AtomicOrder that says how the operation is ordered with respect to other
+/// memory accesses by the same processor. Weaker orders are never slower, and
+/// are often faster, since they leave the compiler free to keep values in
+/// registers and to move other accesses across the atomic one.
+///
 // ===========================================================================
 
 #ifndef _KERNEL_HAL_ATOMIC_H_
@@ -28,6 +40,37 @@
 #include <stdint.h>
 
 
+/// \brief	Specifies how an atomic operation is ordered with respect to other memory accesses made
+///			by the same processor.
+///
+/// These have the same meanings as the memory orders of C11 and C++11.
+typedef enum
+{
+	/// \brief	The operation is atomic, but imposes no ordering on other accesses. Good enough for
+	///			statistics and hints, and for reads that will be validated by a later
+	///			compare-and-swap.
+	ATOMIC_RELAXED,
+
+	/// \brief	No later access may be moved before the operation. Use this when reading a flag or
+	///			pointer that guards other data (e.g. -- acquiring a lock).
+	ATOMIC_ACQUIRE,
+
+	/// \brief	No earlier access may be moved after the operation. Use this when writing a flag or
+	///			pointer that guards other data (e.g. -- releasing a lock).
+	ATOMIC_RELEASE,
+
+	/// \brief	Both ATOMIC_ACQUIRE and ATOMIC_RELEASE. Only meaningful for read-modify-write
+	///			operations.
+	ATOMIC_ACQ_REL,
+
+	/// \brief	Both ATOMIC_ACQUIRE and ATOMIC_RELEASE, and all ATOMIC_SEQ_CST operations appear to
+	///			happen in a single order that every processor agrees on. This is a full memory
+	///			barrier.
+	ATOMIC_SEQ_CST
+
+} AtomicOrder;
+
+
 /// \brief	Atomically compares the given value to the value at the target address for equality
 ///			and updates the target value if the comparison succeeds.
 ///
@@ -37,7 +80,8 @@
 ///							\a *targetAddress is equal to \a compareValue.
 ///
 /// This function is guaranteed to execute atomically with respect to all other processors in
-/// the system, and is uninterruptible on the current processor. It also acts as a memory barrier.
+/// the system, and is uninterruptible on the current processor. It also acts as a memory barrier
+/// (i.e. -- it is ATOMIC_SEQ_CST).
 ///
 /// \warning
 /// Do not specify the value \a *targetAddress as the \a compareValue or \a updateValue, or you may
@@ -48,20 +92,42 @@
 ///					value is equal to \a updateValue.
 /// \retval false	the value of \a *targetAddress is unchanged, and not equal to
 ///					\a compareValue.
-bool Atomic_compareAndSwap(
+static inline bool Atomic_compareAndSwap(
 	volatile uintptr_t*	targetAddress,
 	uintptr_t			compareValue,
 	uintptr_t			updateValue
 );
 
 
+/// \brief	Like Atomic_compareAndSwap(), but with the given memory order.
+///
+/// \param targetAddress	the address of the target value to compare with and possibly update.
+/// \param compareValue		the value to compare to \a *targetAddress.
+/// \param updateValue		the value to assign to \a *targetAddress if the old value of
+///							\a *targetAddress is equal to \a compareValue.
+/// \param order			the ordering of the operation. It applies whether or not the
+///							comparison succeeds.
+///
+/// \retval true	the old value at \a *targetAddress was equal to \a compareValue, and its new
+///					value is equal to \a updateValue.
+/// \retval false	the value of \a *targetAddress is unchanged, and not equal to
+///					\a compareValue.
+static inline bool Atomic_compareAndSwapExplicit(
+	volatile uintptr_t*	targetAddress,
+	uintptr_t			compareValue,
+	uintptr_t			updateValue,
+	AtomicOrder			order
+);
+
+
 /// \brief	Atomically swaps the given value with the value at the target address.
 ///
 /// \param targetAddress	the address of the target value to update.
 /// \param updateValue		the value to assign to \a *targetAddress.
 ///
 /// This function is guaranteed to execute atomically with respect to all other processors in
-/// the system, and is uninterruptible on the current processor. It also acts as a memory barrier.
+/// the system, and is uninterruptible on the current processor. It also acts as a memory barrier
+/// (i.e. -- it is ATOMIC_SEQ_CST).
 ///
 /// \warning
 /// Do not specify the value \a *targetAddress as the \a updateValue, or you may get unexpected
@@ -69,34 +135,275 @@ bool Atomic_compareAndSwap(
 /// a non-atomic manner.
 ///
 /// \returns	the old value at \a *targetAddress before it was replaced with \a updateValue.
-uintptr_t Atomic_swap( volatile uintptr_t* targetAddress, uintptr_t updateValue );
+static inline uintptr_t Atomic_swap( volatile uintptr_t* targetAddress, uintptr_t updateValue );
+
+
+/// \brief	Like Atomic_swap(), but with the given memory order.
+///
+/// \param targetAddress	the address of the target value to update.
+/// \param updateValue		the value to assign to \a *targetAddress.
+/// \param order			the ordering of the operation.
+///
+/// \returns	the old value at \a *targetAddress before it was replaced with \a updateValue.
+static inline uintptr_t Atomic_swapExplicit(
+	volatile uintptr_t*	targetAddress,
+	uintptr_t			updateValue,
+	AtomicOrder			order
+);
 
 
 /// \brief	Atomically reads the value at the given target address.
 ///
-/// \param targetAddress	the address of the target value to read.
+/// \param targetAddress	the address of the target value to read. Must be aligned.
 ///
 /// This function is guaranteed to execute atomically with respect to all other processors in
-/// the system, and is uninterruptible on the current processor.
+/// the system, and is uninterruptible on the current processor. It is ATOMIC_ACQUIRE.
 ///
 /// \returns	the value at \a *targetAddress.
-uintptr_t Atomic_read( const volatile uintptr_t* targetAddress );
+static inline uintptr_t Atomic_read( const volatile uintptr_t* targetAddress );
+
+
+/// \brief	Like Atomic_read(), but with the given memory order.
+///
+/// \param targetAddress	the address of the target value to read. Must be aligned.
+/// \param order			the ordering of the read. ATOMIC_RELEASE and ATOMIC_ACQ_REL don't make
+///							sense for a read, and are treated as ATOMIC_SEQ_CST.
+///
+/// \returns	the value at \a *targetAddress.
+static inline uintptr_t Atomic_readExplicit(
+	const volatile uintptr_t*	targetAddress,
+	AtomicOrder					order
+);
 
 
 /// \brief	Atomically writes the given value to the target address.
 ///
-/// \param targetAddress	the address of the target value to update.
+/// \param targetAddress	the address of the target value to update. Must be aligned.
 /// \param updateValue		the value to assign to \a *targetAddress.
 ///
 /// This function is guaranteed to execute atomically with respect to all other processors in
-/// the system, and is uninterruptible on the current processor.
+/// the system, and is uninterruptible on the current processor. It is ATOMIC_RELEASE.
 ///
 /// \warning
 /// Do not specify the value \a *targetAddress as the \a updateValue, or you may get unexpected
 /// results. The reason for this is that the value parameter is typically read into a register in
 /// a non-atomic manner.
-void Atomic_write( volatile uintptr_t* targetAddress, uintptr_t updateValue );
+static inline void Atomic_write( volatile uintptr_t* targetAddress, uintptr_t updateValue );
 
 
-#endif
+/// \brief	Like Atomic_write(), but with the given memory order.
+///
+/// \param targetAddress	the address of the target value to update. Must be aligned.
+/// \param updateValue		the value to assign to \a *targetAddress.
+/// \param order			the ordering of the write. ATOMIC_ACQUIRE and ATOMIC_ACQ_REL don't make
+///							sense for a write, and are treated as ATOMIC_SEQ_CST.
+static inline void Atomic_writeExplicit(
+	volatile uintptr_t*	targetAddress,
+	uintptr_t			updateValue,
+	AtomicOrder			order
+);
+
+
+/// \brief	Atomically adds the given value to the value at the target address.
+///
+/// \param targetAddress	the address of the target value to update.
+/// \param addend			the value to add to \a *targetAddress. Wraps around on overflow, so
+///							subtracting is done by adding the two's complement.
+///
+/// This function is guaranteed to execute atomically with respect to all other processors in
+/// the system, and is uninterruptible on the current processor. It is ATOMIC_SEQ_CST.
+///
+/// \returns	the old value at \a *targetAddress before \a addend was added to it.
+static inline uintptr_t Atomic_fetchAdd( volatile uintptr_t* targetAddress, uintptr_t addend );
+
+
+/// \brief	Like Atomic_fetchAdd(), but with the given memory order.
+///
+/// \param targetAddress	the address of the target value to update.
+/// \param addend			the value to add to \a *targetAddress.
+/// \param order			the ordering of the operation.
+///
+/// \returns	the old value at \a *targetAddress before \a addend was added to it.
+static inline uintptr_t Atomic_fetchAddExplicit(
+	volatile uintptr_t*	targetAddress,
+	uintptr_t			addend,
+	AtomicOrder			order
+);
+
+
+/// \brief	Atomically ORs the given bits into the value at the target address.
+///
+/// \param targetAddress	the address of the target value to update.
+/// \param bits				the bits to set in \a *targetAddress.
+///
+/// This function is guaranteed to execute atomically with respect to all other processors in
+/// the system. It is ATOMIC_SEQ_CST. It may be implemented with a compare-and-swap loop, so if
+/// only one bit is being set and the old value of the rest doesn't matter,
+/// Atomic_bitTestAndSet() is faster.
+///
+/// \returns	the old value at \a *targetAddress before \a bits were set.
+static inline uintptr_t Atomic_fetchOr( volatile uintptr_t* targetAddress, uintptr_t bits );
+
+
+/// \brief	Like Atomic_fetchOr(), but with the given memory order.
+///
+/// \param targetAddress	the address of the target value to update.
+/// \param bits				the bits to set in \a *targetAddress.
+/// \param order			the ordering of the operation.
+///
+/// \returns	the old value at \a *targetAddress before \a bits were set.
+static inline uintptr_t Atomic_fetchOrExplicit(
+	volatile uintptr_t*	targetAddress,
+	uintptr_t			bits,
+	AtomicOrder			order
+);
+
 
+/// \brief	Atomically ANDs the given mask into the value at the target address.
+///
+/// \param targetAddress	the address of the target value to update.
+/// \param mask				the bits to keep in \a *targetAddress. All the others are cleared.
+///
+/// This function is guaranteed to execute atomically with respect to all other processors in
+/// the system. It is ATOMIC_SEQ_CST. It may be implemented with a compare-and-swap loop, so if
+/// only one bit is being cleared and the old value of the rest doesn't matter,
+/// Atomic_bitTestAndReset() is faster.
+///
+/// \returns	the old value at \a *targetAddress before it was masked.
+static inline uintptr_t Atomic_fetchAnd( volatile uintptr_t* targetAddress, uintptr_t mask );
+
+
+/// \brief	Like Atomic_fetchAnd(), but with the given memory order.
+///
+/// \param targetAddress	the address of the target value to update.
+/// \param mask				the bits to keep in \a *targetAddress.
+/// \param order			the ordering of the operation.
+///
+/// \returns	the old value at \a *targetAddress before it was masked.
+static inline uintptr_t Atomic_fetchAndExplicit(
+	volatile uintptr_t*	targetAddress,
+	uintptr_t			mask,
+	AtomicOrder			order
+);
+
+
+/// \brief	Atomically sets one bit of the value at the target address.
+///
+/// \param targetAddress	the address of the target value to update.
+/// \param bit				the 0-based number of the bit to set. Bit 0 is the lowest.
+///
+/// This function is guaranteed to execute atomically with respect to all other processors in
+/// the system, and is uninterruptible on the current processor. It is ATOMIC_SEQ_CST.
+///
+/// In checked builds, a bugcheck will occur if \a bit is out of range.
+///
+/// \retval true	the bit was already set.
+/// \retval false	the bit was clear, and this call set it.
+static inline bool Atomic_bitTestAndSet( volatile uintptr_t* targetAddress, uint8_t bit );
+
+
+/// \brief	Like Atomic_bitTestAndSet(), but with the given memory order.
+///
+/// \param targetAddress	the address of the target value to update.
+/// \param bit				the 0-based number of the bit to set.
+/// \param order			the ordering of the operation.
+///
+/// \retval true	the bit was already set.
+/// \retval false	the bit was clear, and this call set it.
+static inline bool Atomic_bitTestAndSetExplicit(
+	volatile uintptr_t*	targetAddress,
+	uint8_t				bit,
+	AtomicOrder			order
+);
+
+
+/// \brief	Atomically clears one bit of the value at the target address.
+///
+/// \param targetAddress	the address of the target value to update.
+/// \param bit				the 0-based number of the bit to clear. Bit 0 is the lowest.
+///
+/// This function is guaranteed to execute atomically with respect to all other processors in
+/// the system, and is uninterruptible on the current processor. It is ATOMIC_SEQ_CST.
+///
+/// In checked builds, a bugcheck will occur if \a bit is out of range.
+///
+/// \retval true	the bit was set, and this call cleared it.
+/// \retval false	the bit was already clear.
+static inline bool Atomic_bitTestAndReset( volatile uintptr_t* targetAddress, uint8_t bit );
+
+
+/// \brief	Like Atomic_bitTestAndReset(), but with the given memory order.
+///
+/// \param targetAddress	the address of the target value to update.
+/// \param bit				the 0-based number of the bit to clear.
+/// \param order			the ordering of the operation.
+///
+/// \retval true	the bit was set, and this call cleared it.
+/// \retval false	the bit was already clear.
+static inline bool Atomic_bitTestAndResetExplicit(
+	volatile uintptr_t*	targetAddress,
+	uint8_t				bit,
+	AtomicOrder			order
+);
+
+
+/// \brief	Atomically compares and swaps a 64-bit value.
+///
+/// \param targetAddress	the address of the target value to compare with and possibly update.
+///							Must be 8-byte aligned.
+/// \param compareValue		the value to compare to \a *targetAddress.
+/// \param updateValue		the value to assign to \a *targetAddress if the old value of
+///							\a *targetAddress is equal to \a compareValue.
+///
+/// This works like Atomic_compareAndSwap(), and is ATOMIC_SEQ_CST. On 32-bit architectures it
+/// updates two words at once, which is what lock-free structures need to pair a pointer with a
+/// generation count and so avoid the ABA problem.
+///
+/// Note that on 32-bit architectures, a 64-bit value can't be read atomically with a plain load.
+/// A torn read is harmless when it is only used as the \a compareValue, since the swap will just
+/// fail and can be retried.
+///
+/// In checked builds, a bugcheck will occur if \a targetAddress is not 8-byte aligned.
+///
+/// \retval true	the old value at \a *targetAddress was equal to \a compareValue, and its new
+///					value is equal to \a updateValue.
+/// \retval false	the value of \a *targetAddress is unchanged, and not equal to
+///					\a compareValue.
+static inline bool Atomic_compareAndSwap64(
+	volatile uint64_t*	targetAddress,
+	uint64_t			compareValue,
+	uint64_t			updateValue
+);
+
+
+/// \brief	Like Atomic_compareAndSwap64(), but with the given memory order.
+///
+/// \param targetAddress	the address of the target value. Must be 8-byte aligned.
+/// \param compareValue		the value to compare to \a *targetAddress.
+/// \param updateValue		the value to assign to \a *targetAddress if the comparison succeeds.
+/// \param order			the ordering of the operation.
+///
+/// \retval true	the swap happened.
+/// \retval false	the value of \a *targetAddress is unchanged, and not equal to
+///					\a compareValue.
+static inline bool Atomic_compareAndSwap64Explicit(
+	volatile uint64_t*	targetAddress,
+	uint64_t			compareValue,
+	uint64_t			updateValue,
+	AtomicOrder			order
+);
+
+
+/// \brief	Prevents memory accesses from being moved across this point.
+///
+/// \param order	which accesses may not be moved. ATOMIC_ACQUIRE keeps reads before the fence
+///				from moving after later accesses; ATOMIC_RELEASE keeps accesses before the fence
+///				from moving after later writes; ATOMIC_SEQ_CST is a full barrier. ATOMIC_RELAXED
+///				does nothing.
+static inline void Atomic_fence( AtomicOrder order );
+
+
+#include "HAL/AtomicImpl.h"	// Architecture-specific header that implements the functions above.
+
+
+#endif
@@ -24,6 +24,7 @@
 #define _KERNEL_HAL_INTERRUPTCONTROLLER_H_
 
 
+#include <stdbool.h>
 #include <stdint.h>
 
 
@@ -92,5 +93,31 @@ void InterruptController_unmask( InterruptController* controller, uint32_t irqNu
 void InterruptController_endOfInterrupt( InterruptController* controller, uint32_t irqNumber );
 
 
+/// \brief	Sends the given IRQ to the given processor from now on.
+///
+/// \param controller	the InterruptController through which the IRQ is routed.
+/// \param irqNumber	a non-negative integer indicating which IRQ to route. The interpretation
+///						of this value is architecture-specific.
+/// \param processorId	the ID of the processor that should handle the IRQ, as returned by
+///						Processor_getID(). The processor must be running, and must have called
+///						InterruptController_initForCurrentProcessor().
+///
+/// Until this function is called, every IRQ goes to the processor that initialized the interrupt
+/// controller hardware first. Spreading the IRQs of busy devices across processors keeps any one
+/// of them from spending all its time handling interrupts. Not all hardware can do this, in which
+/// case the IRQ stays where it is.
+///
+/// This function must be called with interrupts disabled on the current processor.
+///
+/// \retval true	the IRQ now goes to \a processorId.
+/// \retval false	the hardware can't send the IRQ to \a processorId, or there is no such
+///					processor.
+bool InterruptController_setAffinity(
+	InterruptController*	controller,
+	uint32_t				irqNumber,
+	int						processorId
+);
+
+
 #endif
 
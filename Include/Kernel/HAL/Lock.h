@@ -18,13 +18,18 @@
 /// \brief	Defines the methods of the Lock class.
 ///
 /// Locks enforce mutual exclusion by disabling interrupts on the acquiring
-/// processor, and in the case of MP systems, by an atomic test-and-set to a
-/// shared memory location.
+/// processor, and in the case of MP systems, by spinning on a shared memory
+/// location. The MP implementations grant the lock in the order in which
+/// processors asked for it, so no processor can be starved. For structures
+/// that many processors fight over, see QueueLock.
 ///
 /// Note that it is not safe to acquire locks recursively. In the case of a UP
 /// implementation, the result is that interrupts will never be re-enabled. In
 /// the case of an MP implementation, the result is deadlock. It is safe for a
 /// thread or interrupt handler to hold more than one lock, however.
+///
+/// In builds with LOCK_STATS defined, Lock_acquire() and Lock_release() are
+/// macros that time each critical section. See LockStats.h.
 // ===========================================================================
 
 #ifndef _KERNEL_HAL_LOCK_H_
@@ -59,5 +64,44 @@ void Lock_acquire( volatile Lock* lock );
 void Lock_release( volatile Lock* lock );
 
 
+#if defined( LOCK_STATS ) && !defined( _KERNEL_HAL_LOCK_C_ ) ////////////////////////////////
+
+
+/// \brief	Acquires the Lock, and records the wait against the given site.
+///
+/// \param lock	the Lock to acquire.
+/// \param site	the statistics of the place in the source that is acquiring \a lock.
+///
+/// This is what Lock_acquire() calls in instrumented builds. There's no need to call it directly.
+void LockStats_acquire( volatile Lock* lock, LockSite* site );
+
+
+/// \brief	Releases the Lock, and records how long it was held against the site that acquired it.
+///
+/// \param lock	the Lock to release.
+///
+/// This is what Lock_release() calls in instrumented builds. There's no need to call it directly.
+void LockStats_release( volatile Lock* lock );
+
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+	// Each expansion gets its own LockSite, so every call in the source is counted separately.
+	// The implementation files define _KERNEL_HAL_LOCK_C_, so they still see the real functions.
+	#define Lock_acquire( lock ) \
+		do \
+		{ \
+			static LockSite s_lockSite = { .m_file = __FILE__, .m_line = __LINE__ }; \
+			LockStats_acquire( (lock), &s_lockSite ); \
+		} while (0)
+
+	#define Lock_release( lock ) LockStats_release( (lock) )
+
+#endif
+
+
+#endif //////////////////////////////////////////////////////////////////////////////////////
+
+
 #endif
 
@@ -0,0 +1,140 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Include/Kernel/HAL/LockStats.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/10
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	Defines the statistics kept by the instrumented locks.
+///
+/// When the kernel is built with LOCK_STATS defined (e.g. -- "make
+/// LOCK_STATS=1"), every call to Lock_acquire(), QueueLock_acquire() and
+/// RWLock_acquireWrite() is counted and timed against the place in the
+/// source where it was made, which is called its site. For each site, the
+/// instrumented locks keep:
+///
+/// \li the number of times the lock was acquired there;
+/// \li the total and longest time spent waiting to get the lock; and
+/// \li the total and longest time the lock was held afterwards.
+///
+/// Since the locks disable interrupts while they are held, the hold times
+/// are also how long interrupts were kept off, which makes this the place to
+/// look for the critical sections that hurt interrupt latency.
+/// KLockStats_dump() writes the statistics of every site to the kernel
+/// display.
+///
+/// Times are in processor cycles, and are only measured on processors that
+/// have a timestamp counter; on others, only the counts are kept. The hosted
+/// build measures them in nanoseconds instead. A site's statistics are
+/// updated with atomic operations after the lock is released, so they add
+/// little to the hold times they measure, but a dump that runs while locks
+/// are in use may see a slightly stale mix of values.
+///
+/// Readers of an RWLock aren't instrumented, since they are meant to be
+/// cheap and don't exclude each other, and neither is SeqLock beyond the Lock
+/// that serializes its writers. In builds without LOCK_STATS, nothing is
+/// recorded and LockStats_getFirstSite() returns NULL.
+// ===========================================================================
+
+#ifndef _KERNEL_HAL_LOCKSTATS_H_
+#define _KERNEL_HAL_LOCKSTATS_H_
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+#ifdef __GNUC__ //////////////////////////////////////////////////////////////
+
+	#define ALIGNED_8 __attribute__((aligned( 8 )))
+
+#else ////////////////////////////////////////////////////////////////////////
+
+	#error Currently only GCC is supported for building the kernel!
+
+#endif ///////////////////////////////////////////////////////////////////////
+
+
+/// \brief	Defines the statistics kept for one place in the source that acquires a lock.
+///
+/// The fields are only meant to be written by the instrumented locks. There is one of these per
+/// call to Lock_acquire(), QueueLock_acquire() or RWLock_acquireWrite() in the source, created by
+/// the macro of the same name. The cycle counts come first, and the structure is 8-byte aligned,
+/// so that they can be updated with 64-bit atomic operations.
+typedef struct LockSiteStruct
+{
+	/// \brief	Total cycles spent waiting to acquire the lock here.
+	uint64_t m_totalSpinCycles;
+
+	/// \brief	Longest single wait to acquire the lock here, in cycles.
+	uint64_t m_maxSpinCycles;
+
+	/// \brief	Total cycles the lock was held after being acquired here.
+	uint64_t m_totalHoldCycles;
+
+	/// \brief	Longest the lock was held after being acquired here, in cycles.
+	uint64_t m_maxHoldCycles;
+
+	/// \brief	Name of the source file that acquires the lock.
+	const char* m_file;
+
+	/// \brief	Line number in \a m_file of the call that acquires the lock.
+	int m_line;
+
+	/// \brief	The next site in the list of all sites, or NULL if this is the last one.
+	struct LockSiteStruct* m_next;
+
+	/// \brief	Non-zero once the site has been added to the list of all sites.
+	uintptr_t m_isRegistered;
+
+	/// \brief	The number of times the lock has been acquired here.
+	uintptr_t m_acquireCount;
+
+} ALIGNED_8 LockSite;
+
+
+/// \brief	Defines what the instrumented locks remember about their current holder.
+///
+/// This is added to the end of the Lock, QueueLock and RWLock structures in builds with
+/// LOCK_STATS defined.
+typedef struct LockStatsHoldStruct
+{
+	/// \brief	The site that acquired the lock, or NULL if it was acquired without the macro.
+	LockSite* m_site;
+
+	/// \brief	The timestamp counter right after the lock was acquired, or zero without a TSC.
+	uint64_t m_acquireTime;
+
+} LockStatsHold;
+
+
+/// \brief	Gets the first site in the list of every site that has acquired a lock so far.
+///
+/// Sites are added to the front of the list the first time they acquire a lock, and are never
+/// removed.
+///
+/// \return the most recently added site, or NULL if there are none or this build isn't
+///			instrumented.
+LockSite* LockStats_getFirstSite( void );
+
+
+/// \brief	Gets the site after the given one in the list of every site.
+///
+/// \param site	a site returned by LockStats_getFirstSite() or LockStats_getNextSite().
+///
+/// \return the next site, or NULL if \a site is the last one.
+LockSite* LockStats_getNextSite( const LockSite* site );
+
+
+#endif
+
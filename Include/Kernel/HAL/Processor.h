@@ -42,19 +42,34 @@
 #include <stdint.h>
 #include "Kernel/HAL/TrapFrame.h"
 #include "Kernel/HAL/IInterruptHandler.h"
+#include "HAL/ProcessorImpl.h"	// Architecture-specific header that defines PROCESSOR_MAX_COUNT.
 
 
 /// \brief	Forward declaration of the Processor object type.
 typedef struct ProcessorStruct Processor;
 
 
+/// \brief	Defines the signature of the function at which a new kernel thread starts running.
+///
+/// \param arg	the argument given to Processor_createKernelThreadFrame().
+typedef void (*Processor_threadStartFunc)( void* arg );
+
+
+/// \brief	Defines the signature of the function to which a kernel thread returns when its start
+///			function returns.
+///
+/// This function must never return.
+typedef void (*Processor_threadExitFunc)( void );
+
+
 /// \brief	Called by the kernel's entry-point code to intialize the bootstrap processor.
 ///
 /// This function is the first function to be called in the kernel. It is called even before main().
 /// It is responsible for initializing the bootstrap processor for normal operation. This includes
 /// initialization of the MMU and any hardware structures pertaining to memory management and
 /// interrupt/exception dispatching. It also includes any processor state required to support the
-/// kernel's C language run-time environment.
+/// kernel's C language run-time environment, and detecting the processor's optional features so
+/// that KMem_init() can pick the fastest routines the processor supports.
 ///
 /// \note
 /// This function is guaranteed to be called with interrupts disabled. In MP systems, all other
@@ -104,6 +119,9 @@ void Processor_waitForInterrupt( void );
 ///
 /// ***FIXME: Describe MP ID scheme here.
 ///
+/// IDs are always less than PROCESSOR_MAX_COUNT, so they can be used to index per-processor
+/// arrays.
+///
 /// \note
 /// On UP systems, the ID of the one-and-only processor is always 0.
 ///
@@ -129,5 +147,30 @@ void Processor_registerHandler(
 );
 
 
+/// \brief	Builds the TrapFrame from which a new kernel-mode thread starts running.
+///
+/// \param stackBase	the lowest address of the new thread's kernel stack.
+/// \param stackSize	the size of the new thread's kernel stack, in bytes.
+/// \param start		the function at which the new thread starts running.
+/// \param arg			the argument to pass to \a start.
+/// \param exitFunc		the function to which \a start returns.
+///
+/// The TrapFrame is built at the top of the given stack, as if the new thread had been interrupted
+/// just before calling \a start. Returning the TrapFrame from an IInterruptHandler switches to the
+/// new thread, which starts running with interrupts enabled.
+///
+/// In checked builds, a bugcheck will occur if the stack is too small to hold the TrapFrame, or if
+/// any of the pointers are NULL.
+///
+/// \return the new thread's TrapFrame.
+TrapFrame* Processor_createKernelThreadFrame(
+	void*						stackBase,
+	size_t						stackSize,
+	Processor_threadStartFunc	start,
+	void*						arg,
+	Processor_threadExitFunc	exitFunc
+);
+
+
 #endif
 
@@ -0,0 +1,123 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Include/Kernel/HAL/QueueLock.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/08
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	Defines the methods of the QueueLock class.
+///
+/// A QueueLock enforces mutual exclusion just like a Lock, but is meant for
+/// structures that many processors fight over. In MP implementations it is
+/// an MCS lock: each processor that wants the lock brings its own
+/// QueueLockNode, joins the end of a queue of waiters with a single atomic
+/// swap, and then spins on a flag in its own node until the processor ahead
+/// of it hands the lock over. Waiters never touch the same cache line, so
+/// the cost of a hand-off doesn't grow with the number of waiters, and the
+/// lock is granted in the order it was asked for.
+///
+/// The node is usually a local variable of the function that acquires the
+/// lock. The same node must be passed to QueueLock_release(), and it must not
+/// be reused until then.
+///
+/// In UP implementations, a QueueLock is no different from a Lock, and the
+/// node is unused. The same rules about recursion apply as for Lock.
+///
+/// In builds with LOCK_STATS defined, QueueLock_acquire() and
+/// QueueLock_release() are macros that time each critical section, just like
+/// Lock's. See LockStats.h.
+// ===========================================================================
+
+#ifndef _KERNEL_HAL_QUEUELOCK_H_
+#define _KERNEL_HAL_QUEUELOCK_H_
+
+
+#include "HAL/QueueLockImpl.h"	// Architecture-specific header that defines the structures.
+
+
+/// \brief	Creates a new QueueLock that is ready to be acquired.
+///
+/// \return a new QueueLock instance.
+QueueLock QueueLock_create( void );
+
+
+/// \brief	Acquires the QueueLock.
+///
+/// \param lock	the QueueLock to acquire.
+/// \param node	the caller's place in the queue of waiters. Its contents are overwritten.
+///
+/// While the lock is acquired, interrupts are disabled on the acquiring processor, and no other
+/// processor can execute code that is guarded by the same QueueLock.
+void QueueLock_acquire( volatile QueueLock* lock, volatile QueueLockNode* node );
+
+
+/// \brief	Releases the QueueLock.
+///
+/// \param lock	the QueueLock to release.
+/// \param node	the same node that was passed to QueueLock_acquire().
+///
+/// When the lock is released, interrupts may or may not be enabled on the releasing processor,
+/// depending on whether they were enabled before the QueueLock was acquired. If another processor
+/// is waiting, the lock is handed directly to it.
+void QueueLock_release( volatile QueueLock* lock, volatile QueueLockNode* node );
+
+
+#if defined( LOCK_STATS ) && !defined( _KERNEL_HAL_QUEUELOCK_C_ ) ///////////////////////////
+
+
+/// \brief	Acquires the QueueLock, and records the wait against the given site.
+///
+/// \param lock	the QueueLock to acquire.
+/// \param node	the caller's place in the queue of waiters.
+/// \param site	the statistics of the place in the source that is acquiring \a lock.
+///
+/// This is what QueueLock_acquire() calls in instrumented builds. There's no need to call it
+/// directly.
+void LockStats_acquireQueue(
+	volatile QueueLock*		lock,
+	volatile QueueLockNode*	node,
+	LockSite*				site
+);
+
+
+/// \brief	Releases the QueueLock, and records how long it was held against the site that
+///			acquired it.
+///
+/// \param lock	the QueueLock to release.
+/// \param node	the same node that was passed to QueueLock_acquire().
+///
+/// This is what QueueLock_release() calls in instrumented builds. There's no need to call it
+/// directly.
+void LockStats_releaseQueue( volatile QueueLock* lock, volatile QueueLockNode* node );
+
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+	// Each expansion gets its own LockSite, as for Lock_acquire().
+	#define QueueLock_acquire( lock, node ) \
+		do \
+		{ \
+			static LockSite s_lockSite = { .m_file = __FILE__, .m_line = __LINE__ }; \
+			LockStats_acquireQueue( (lock), (node), &s_lockSite ); \
+		} while (0)
+
+	#define QueueLock_release( lock, node ) LockStats_releaseQueue( (lock), (node) )
+
+#endif
+
+
+#endif //////////////////////////////////////////////////////////////////////////////////////
+
+
+#endif
+
@@ -0,0 +1,140 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Include/Kernel/HAL/RWLock.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/09
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	Defines the methods of the RWLock class.
+///
+/// An RWLock protects data that is read far more often than it is written.
+/// Any number of readers can hold the lock at once, but a writer excludes
+/// readers and other writers, just like a Lock. In MP implementations, an
+/// uncontended read acquire is a single locked increment, so readers never
+/// wait for each other. A writer that is waiting for the readers to leave
+/// keeps new readers out, so writers can't be starved.
+///
+/// Readers and writers both disable interrupts on the acquiring processor
+/// while they hold the lock, so it is safe to use the same RWLock from
+/// interrupt handlers. A reader that has to wait for a writer does so with
+/// interrupts restored to what they were before the call.
+///
+/// Each reader keeps its own RWLockReader, which is usually a local variable
+/// of the function that acquires the lock. The same reader must be passed to
+/// RWLock_releaseRead().
+///
+/// The same rules about recursion apply as for Lock. In particular, a
+/// processor that already holds an RWLock for reading must not try to read
+/// it again, since a writer may have started waiting in between.
+///
+/// For data that is small enough to copy, SeqLock lets readers in without
+/// writing to shared memory at all.
+///
+/// In builds with LOCK_STATS defined, RWLock_acquireWrite() and
+/// RWLock_releaseWrite() are macros that time each write, just like Lock's.
+/// The read side is left alone. See LockStats.h.
+// ===========================================================================
+
+#ifndef _KERNEL_HAL_RWLOCK_H_
+#define _KERNEL_HAL_RWLOCK_H_
+
+
+#include "HAL/RWLockImpl.h"	// Architecture-specific header that defines the structures.
+
+
+/// \brief	Creates a new RWLock that is ready to be acquired.
+///
+/// \return a new RWLock instance.
+RWLock RWLock_create( void );
+
+
+/// \brief	Acquires the RWLock for reading.
+///
+/// \param lock		the RWLock to acquire.
+/// \param reader	the caller's read-side state. Its contents are overwritten.
+///
+/// While the lock is held for reading, interrupts are disabled on the acquiring processor, and no
+/// other processor can hold the same RWLock for writing. Other processors can read at the same
+/// time.
+void RWLock_acquireRead( volatile RWLock* lock, RWLockReader* reader );
+
+
+/// \brief	Releases the RWLock after reading.
+///
+/// \param lock		the RWLock to release.
+/// \param reader	the same reader that was passed to RWLock_acquireRead().
+///
+/// Interrupts are restored to what they were before the RWLock was acquired.
+void RWLock_releaseRead( volatile RWLock* lock, RWLockReader* reader );
+
+
+/// \brief	Acquires the RWLock for writing.
+///
+/// \param lock	the RWLock to acquire.
+///
+/// While the lock is held for writing, interrupts are disabled on the acquiring processor, and no
+/// other processor can hold the same RWLock at all.
+void RWLock_acquireWrite( volatile RWLock* lock );
+
+
+/// \brief	Releases the RWLock after writing.
+///
+/// \param lock	the RWLock to release.
+///
+/// Interrupts are restored to what they were before the RWLock was acquired.
+void RWLock_releaseWrite( volatile RWLock* lock );
+
+
+#if defined( LOCK_STATS ) && !defined( _KERNEL_HAL_RWLOCK_C_ ) //////////////////////////////
+
+
+/// \brief	Acquires the RWLock for writing, and records the wait against the given site.
+///
+/// \param lock	the RWLock to acquire.
+/// \param site	the statistics of the place in the source that is acquiring \a lock.
+///
+/// This is what RWLock_acquireWrite() calls in instrumented builds. There's no need to call it
+/// directly.
+void LockStats_acquireWrite( volatile RWLock* lock, LockSite* site );
+
+
+/// \brief	Releases the RWLock after writing, and records how long it was held against the site
+///			that acquired it.
+///
+/// \param lock	the RWLock to release.
+///
+/// This is what RWLock_releaseWrite() calls in instrumented builds. There's no need to call it
+/// directly.
+void LockStats_releaseWrite( volatile RWLock* lock );
+
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+	// Each expansion gets its own LockSite, as for Lock_acquire().
+	#define RWLock_acquireWrite( lock ) \
+		do \
+		{ \
+			static LockSite s_lockSite = { .m_file = __FILE__, .m_line = __LINE__ }; \
+			LockStats_acquireWrite( (lock), &s_lockSite ); \
+		} while (0)
+
+	#define RWLock_releaseWrite( lock ) LockStats_releaseWrite( (lock) )
+
+#endif
+
+
+#endif //////////////////////////////////////////////////////////////////////////////////////
+
+
+#endif
+
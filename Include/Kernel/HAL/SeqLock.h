@@ -0,0 +1,154 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Include/Kernel/HAL/SeqLock.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/09
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	Defines the SeqLock class.
+///
+/// A SeqLock protects small, read-mostly data without making readers write
+/// to shared memory or disable interrupts. Writers serialize on a Lock and
+/// bump a sequence number before and after each update, so the sequence is
+/// odd while an update is in progress. A reader notes the sequence, copies
+/// the data, and then checks that the sequence hasn't changed. If it has,
+/// the copy may be torn, and the reader tries again:
+///
+/// \code
+/// uintptr_t sequence;
+/// do
+/// {
+///		sequence = SeqLock_beginRead( &s_lock );
+///		copy = s_data;
+/// } while (SeqLock_retryRead( &s_lock, sequence ));
+/// \endcode
+///
+/// Because a reader may see a half-written update before it finds out it has
+/// to retry, the read side must only copy the data, and must not follow
+/// pointers in it or act on it until SeqLock_retryRead() returns \c false.
+///
+/// Readers never block writers, so writers can't be starved, but a steady
+/// stream of writers can make readers retry many times.
+///
+/// It is safe for interrupt handlers to read or write a SeqLock, but the
+/// same rules about recursion apply to writers as for Lock. Writers disable
+/// interrupts, so an interrupt handler can never observe a write in progress
+/// on its own processor. A reader on another processor just retries until
+/// the writer is done.
+///
+/// Everything here is inline and built from Lock and Atomic, so it is the
+/// same for every architecture.
+// ===========================================================================
+
+#ifndef _KERNEL_HAL_SEQLOCK_H_
+#define _KERNEL_HAL_SEQLOCK_H_
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "Kernel/HAL/Atomic.h"
+#include "Kernel/HAL/Lock.h"
+#include "Kernel/KCommon/KDebug.h"
+
+
+/// \brief	Defines the fields of the SeqLock class.
+///
+/// The fields are only meant to be used by the functions in this file.
+typedef struct SeqLockStruct
+{
+	/// \brief	Incremented at the start and end of every update, so it is odd during one.
+	uintptr_t m_sequence;
+
+	/// \brief	Serializes writers.
+	Lock m_writerLock;
+
+} SeqLock;
+
+
+/// \brief	Creates a new SeqLock with no update in progress.
+///
+/// \return a new SeqLock instance.
+static inline SeqLock SeqLock_create( void )
+{
+	SeqLock newLock;
+	newLock.m_sequence		= 0;
+	newLock.m_writerLock	= Lock_create();
+	return newLock;
+}
+
+
+/// \brief	Starts reading the data protected by the SeqLock.
+///
+/// \param lock	the SeqLock to read.
+///
+/// This doesn't wait for an update in progress to finish. If there is one, the SeqLock_retryRead()
+/// at the end of the read will fail.
+///
+/// \return the sequence number to pass to SeqLock_retryRead().
+static inline uintptr_t SeqLock_beginRead( const volatile SeqLock* lock )
+{
+	return Atomic_readExplicit( &(lock->m_sequence), ATOMIC_ACQUIRE );
+}
+
+
+/// \brief	Finishes reading the data protected by the SeqLock.
+///
+/// \param lock		the SeqLock that was read.
+/// \param sequence	the value returned by the matching SeqLock_beginRead().
+///
+/// \retval true	the data may have changed while it was being read. Read it again.
+/// \retval false	the data that was read is consistent.
+static inline bool SeqLock_retryRead( const volatile SeqLock* lock, uintptr_t sequence )
+{
+	// The fence keeps the reads of the data from moving after the second read of the sequence.
+	Atomic_fence( ATOMIC_ACQUIRE );
+	uintptr_t current = Atomic_readExplicit( &(lock->m_sequence), ATOMIC_RELAXED );
+	return ((sequence & 1) != 0) || (current != sequence);
+}
+
+
+/// \brief	Starts an update of the data protected by the SeqLock.
+///
+/// \param lock	the SeqLock to write.
+///
+/// While the update is in progress, interrupts are disabled on the writing processor, and no other
+/// processor can write the same SeqLock.
+static inline void SeqLock_acquireWrite( volatile SeqLock* lock )
+{
+	Lock_acquire( &(lock->m_writerLock) );
+
+	// Only the writer changes the sequence, so there's no need for a locked increment. The fence
+	// keeps the writes of the data from moving ahead of the now-odd sequence.
+	uintptr_t sequence = Atomic_readExplicit( &(lock->m_sequence), ATOMIC_RELAXED );
+	Atomic_writeExplicit( &(lock->m_sequence), sequence + 1, ATOMIC_RELAXED );
+	Atomic_fence( ATOMIC_RELEASE );
+}
+
+
+/// \brief	Finishes an update of the data protected by the SeqLock.
+///
+/// \param lock	the SeqLock that was written.
+///
+/// Interrupts are restored to what they were before SeqLock_acquireWrite() was called.
+static inline void SeqLock_releaseWrite( volatile SeqLock* lock )
+{
+	uintptr_t sequence = Atomic_readExplicit( &(lock->m_sequence), ATOMIC_RELAXED );
+	KDebug_assert( (sequence & 1) != 0 );
+	Atomic_writeExplicit( &(lock->m_sequence), sequence + 1, ATOMIC_RELEASE );
+
+	Lock_release( &(lock->m_writerLock) );
+}
+
+
+#endif
+
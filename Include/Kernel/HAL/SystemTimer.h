@@ -0,0 +1,77 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Include/Kernel/HAL/SystemTimer.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/12
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	This file defines the SystemTimer class, which encapsulates the
+///			hardware that keeps time and interrupts a Processor when asked.
+///
+/// The timer runs in one-shot mode: Rather than interrupting at a fixed
+/// rate, it interrupts once, at the next deadline that the Timer class
+/// asks for. The interrupts are delivered through the InterruptController
+/// like any other device interrupt. Which vector they arrive on is
+/// architecture-specific; It is up to the InterruptDispatcher to know where
+/// to look.
+///
+/// Times are in microseconds since SystemTimer_initForCurrentProcessor() was
+/// called. The hardware may not be able to wait as long as it is asked to,
+/// in which case it interrupts early, and the deadline is simply asked for
+/// again. Some hardware also keeps time by counting the intervals it is
+/// programmed with, so interrupts must never stay disabled for longer than the
+/// longest one.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_HAL_SYSTEMTIMER_H_
+#define _KERNEL_HAL_SYSTEMTIMER_H_
+
+
+#include <stdint.h>
+
+
+/// \brief	Starts the current processor's clock at zero, along with the timer hardware that
+///			interrupts it.
+///
+/// Until SystemTimer_setNextInterrupt() is called, the timer interrupts as late as it can.
+///
+/// This method must be called once on each processor in the system during kernel initialization.
+/// It must be called with interrupts disabled for the current processor.
+void SystemTimer_initForCurrentProcessor( void );
+
+
+/// \brief	Gets the current time on the current processor's clock.
+///
+/// This method must be called with interrupts disabled for the current processor.
+///
+/// \return the number of microseconds since SystemTimer_initForCurrentProcessor() was called.
+uint64_t SystemTimer_getTime( void );
+
+
+/// \brief	Programs the timer to interrupt the current processor once, at the given time.
+///
+/// \param deadline	the time at which to interrupt, in microseconds since the clock started. If
+///					it has already passed, the interrupt comes as soon as the hardware allows. Pass
+///					UINT64_MAX if there is nothing to wait for.
+///
+/// This replaces any interrupt that was programmed before. The interrupt may come early if the
+/// deadline is further off than the hardware can count, but it never comes late unless interrupts
+/// are disabled. Either way, the timer has to be programmed again after every interrupt, or the
+/// clock may lose time.
+///
+/// This method must be called with interrupts disabled for the current processor.
+void SystemTimer_setNextInterrupt( uint64_t deadline );
+
+#endif
+
@@ -0,0 +1,227 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Include/Kernel/HAL/WorkDeque.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/14
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	Defines the WorkDeque class, a lock-free work-stealing deque of
+///			pointers.
+///
+/// A WorkDeque has one owner, which is the only one allowed to push and pop
+/// items at the bottom end. Anyone, including the owner, can steal the item at
+/// the top end. Thieves and the owner only contend when they go for the same
+/// item, so a processor can hand out work to its peers without any of them
+/// taking a lock. This is the array-based deque of Chase and Lev, with a fixed
+/// capacity since the kernel has no heap to grow it from.
+///
+/// The owner is usually a processor. If the owner's thread and its interrupt
+/// handlers both use the bottom end, they must keep each other out (e.g. --
+/// by disabling interrupts), since they count as the same owner.
+///
+/// Pushing and stealing alone make a FIFO queue with many consumers, which
+/// suits round-robin scheduling. Pushing and popping make a LIFO stack, which
+/// suits work whose data is still in the owner's cache.
+///
+/// Everything here is inline and built from Atomic, so it is the same for
+/// every architecture.
+// ===========================================================================
+
+#ifndef _KERNEL_HAL_WORKDEQUE_H_
+#define _KERNEL_HAL_WORKDEQUE_H_
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "Kernel/HAL/Atomic.h"
+#include "Kernel/KCommon/KDebug.h"
+
+
+// Public constants
+
+/// \brief	Defines constants for the WorkDeque class.
+enum WorkDeque_consts
+{
+	/// \brief	The most items a WorkDeque can hold. Must be a power of two.
+	WORK_DEQUE_CAPACITY = 64
+};
+
+
+
+/// \brief	Defines the fields of the WorkDeque class.
+///
+/// The fields are only meant to be used by the functions in this file. The indices only ever
+/// increase, and wrap around harmlessly, since they are only ever compared by subtracting them.
+/// An all-zero WorkDeque is empty, so a static one is ready to use without calling
+/// WorkDeque_init().
+typedef struct WorkDequeStruct
+{
+	/// \brief	Index of the item at the top, which is the next one to be stolen.
+	uintptr_t m_top;
+
+	/// \brief	Index one past the item at the bottom. Only the owner changes it.
+	uintptr_t m_bottom;
+
+	/// \brief	The items, each at its index modulo WORK_DEQUE_CAPACITY.
+	uintptr_t m_items[WORK_DEQUE_CAPACITY];
+
+} WorkDeque;
+
+
+
+/// \brief	Initializes the given WorkDeque so that it is empty.
+///
+/// \param deque	the WorkDeque to initialize.
+///
+/// Unlike most classes, WorkDeque is initialized in place rather than returned by value, since it
+/// is fairly large.
+static inline void WorkDeque_init( volatile WorkDeque* deque )
+{
+	Atomic_writeExplicit( &(deque->m_top), 0, ATOMIC_RELAXED );
+	Atomic_writeExplicit( &(deque->m_bottom), 0, ATOMIC_RELAXED );
+}
+
+
+/// \brief	Gets the number of items in the WorkDeque.
+///
+/// \param deque	the WorkDeque.
+///
+/// When called by anyone but the owner, the result is only a hint, since the count can change
+/// at any time.
+///
+/// \return the number of items in \a deque.
+static inline size_t WorkDeque_getCount( const volatile WorkDeque* deque )
+{
+	uintptr_t top		= Atomic_readExplicit( &(deque->m_top), ATOMIC_ACQUIRE );
+	uintptr_t bottom	= Atomic_readExplicit( &(deque->m_bottom), ATOMIC_ACQUIRE );
+	intptr_t count		= (intptr_t) (bottom - top);
+
+	// While the owner is popping, bottom can be one less than top for a moment.
+	return (count < 0) ? 0 : (size_t) count;
+}
+
+
+/// \brief	Adds an item at the bottom of the WorkDeque. Only the owner may call this.
+///
+/// \param deque	the WorkDeque.
+/// \param item		the item to add. Must not be NULL.
+///
+/// \retval true	the item was added.
+/// \retval false	the WorkDeque is full.
+static inline bool WorkDeque_push( volatile WorkDeque* deque, void* item )
+{
+	KDebug_assertArg( item != NULL );
+
+	uintptr_t bottom	= Atomic_readExplicit( &(deque->m_bottom), ATOMIC_RELAXED );
+	uintptr_t top		= Atomic_readExplicit( &(deque->m_top), ATOMIC_ACQUIRE );
+	if (bottom - top >= WORK_DEQUE_CAPACITY)
+	{
+		return false;
+	}
+
+	// The release makes sure that a thief who sees the new bottom also sees the item.
+	Atomic_writeExplicit(
+		&(deque->m_items[bottom & (WORK_DEQUE_CAPACITY - 1)]),
+		(uintptr_t) item,
+		ATOMIC_RELAXED
+	);
+	Atomic_writeExplicit( &(deque->m_bottom), bottom + 1, ATOMIC_RELEASE );
+	return true;
+}
+
+
+/// \brief	Removes the item at the bottom of the WorkDeque, which is the one pushed most recently.
+///			Only the owner may call this.
+///
+/// \param deque	the WorkDeque.
+///
+/// \retval void*	the item that was removed.
+/// \retval NULL	the WorkDeque is empty, or a thief got the last item first.
+static inline void* WorkDeque_pop( volatile WorkDeque* deque )
+{
+	// Claim the bottom item before looking at the top, so that a thief who comes along now won't
+	// take it too. The store has to be visible before the top is read, hence the full fence.
+	uintptr_t bottom = Atomic_readExplicit( &(deque->m_bottom), ATOMIC_RELAXED ) - 1;
+	Atomic_writeExplicit( &(deque->m_bottom), bottom, ATOMIC_RELAXED );
+	Atomic_fence( ATOMIC_SEQ_CST );
+	uintptr_t top = Atomic_readExplicit( &(deque->m_top), ATOMIC_RELAXED );
+
+	if ((intptr_t) (bottom - top) < 0)
+	{
+		// It was already empty.
+		Atomic_writeExplicit( &(deque->m_bottom), bottom + 1, ATOMIC_RELAXED );
+		return NULL;
+	}
+
+	void* item = (void*) Atomic_readExplicit(
+		&(deque->m_items[bottom & (WORK_DEQUE_CAPACITY - 1)]),
+		ATOMIC_RELAXED
+	);
+	if (bottom != top)
+	{
+		// There was more than one item, so no thief can be after this one.
+		return item;
+	}
+
+	// This is the last item, so race the thieves for it by stealing it ourselves.
+	if (!Atomic_compareAndSwapExplicit( &(deque->m_top), top, top + 1, ATOMIC_SEQ_CST ))
+	{
+		item = NULL;
+	}
+	Atomic_writeExplicit( &(deque->m_bottom), bottom + 1, ATOMIC_RELAXED );
+	return item;
+}
+
+
+/// \brief	Removes the item at the top of the WorkDeque, which is the one that has been there
+///			longest. Anyone may call this.
+///
+/// \param deque	the WorkDeque.
+///
+/// If another thief gets to the top item first, this tries again with the next one, so it only
+/// gives up if the WorkDeque is empty.
+///
+/// \retval void*	the item that was removed.
+/// \retval NULL	the WorkDeque is empty.
+static inline void* WorkDeque_steal( volatile WorkDeque* deque )
+{
+	while (true)
+	{
+		// The top has to be read before the bottom, or a pop and a push in between could make an
+		// empty deque look like it has an item.
+		uintptr_t top = Atomic_readExplicit( &(deque->m_top), ATOMIC_ACQUIRE );
+		Atomic_fence( ATOMIC_SEQ_CST );
+		uintptr_t bottom = Atomic_readExplicit( &(deque->m_bottom), ATOMIC_ACQUIRE );
+
+		if ((intptr_t) (bottom - top) <= 0)
+		{
+			return NULL;
+		}
+
+		// The item has to be read before the top moves past it, since the owner may then push
+		// over it.
+		void* item = (void*) Atomic_readExplicit(
+			&(deque->m_items[top & (WORK_DEQUE_CAPACITY - 1)]),
+			ATOMIC_RELAXED
+		);
+		if (Atomic_compareAndSwapExplicit( &(deque->m_top), top, top + 1, ATOMIC_SEQ_CST ))
+		{
+			return item;
+		}
+	}
+}
+
+
+#endif
+
@@ -31,6 +31,20 @@
 #include "Kernel/KCommon/KDebug.h"
 
 
+/// \brief	Selects the fastest implementations of the KMem functions that the current processor
+///			supports.
+///
+/// Until this is called, implementations that work on any processor are used, so it is safe to
+/// call the other KMem functions first. On x86, the choice is based on the features detected by
+/// the HAL: processors with SSE2 get copies and fills that move 16 bytes at a time and page
+/// operations that bypass the caches, processors with fast strings get plain REP MOVSB and
+/// STOSB, and processors with TZCNT, LZCNT, and POPCNT get bit scans and counts that use them.
+///
+/// This must be called exactly once, early in boot, while only one processor is running. It is
+/// called by Processor_initPrimary(), after the processor's features have been detected.
+void KMem_init( void );
+
+
 /// \brief	Copies memory from a source to a destination address.
 ///
 /// \param dest		the address of the destination region.
@@ -61,6 +75,28 @@ void KMem_move( volatile void* dest, const volatile void* source, size_t numByte
 void KMem_set( volatile void* dest, char val, size_t numBytes );
 
 
+/// \brief	Fills a page with zeroes without pulling it into the caches.
+///
+/// \param page	the page-aligned address of the page to clear.
+///
+/// This is meant for zero-filling whole frames that won't be touched again soon (e.g. -- frames
+/// being scrubbed before they go back on the free list). Where possible, it uses non-temporal
+/// stores, so it doesn't evict the working set of the thread that calls it. All the stores are
+/// complete and visible to other processors by the time it returns.
+void KMem_clearPage( volatile void* page );
+
+
+/// \brief	Copies a page without pulling either page into the caches.
+///
+/// \param dest		the page-aligned address of the destination page.
+/// \param source	the page-aligned address of the source page.
+///
+/// This is meant for copying whole frames (e.g. -- on copy-on-write faults). Like
+/// KMem_clearPage(), it uses non-temporal stores where possible, and all the stores are complete
+/// and visible to other processors by the time it returns. The pages must not overlap.
+void KMem_copyPage( volatile void* dest, const volatile void* source );
+
+
 /// \brief	Extracts the least-significant 8-bits from the given 16-bit value.
 ///
 /// \param val	a 16-bit value.
@@ -114,6 +150,23 @@ uint16_t KMem_high16( uint32_t val );
 int KMem_findLowestSetBit( uintptr_t val );
 
 
+/// \brief	Finds the most significant set (1) bit in the given value.
+///
+/// \param val	the value to scan for set bits.
+///
+/// \retval <0	\a val is zero.
+/// \retval >=0	the offset of the most significant one bit in \a val.
+int KMem_findHighestSetBit( uintptr_t val );
+
+
+/// \brief	Counts the set (1) bits in the given value.
+///
+/// \param val	the value in which to count set bits.
+///
+/// \return the number of one bits in \a val.
+int KMem_countSetBits( uintptr_t val );
+
+
 /// \brief	Sets the given bit in the given 8-bit value.
 ///
 /// \param val	the value in which to set the bit.
@@ -158,7 +211,7 @@ static inline uint16_t KMem_bitSet16( uint16_t val, uint8_t bit )
 static inline uint32_t KMem_bitSet32( uint32_t val, uint8_t bit )
 {
 	KDebug_assertArg( bit < 32 );
-	return (val | (1 << bit));
+	return (val | (((uint32_t) 1) << bit));
 }
 
 
@@ -174,7 +227,7 @@ static inline uint32_t KMem_bitSet32( uint32_t val, uint8_t bit )
 static inline uintptr_t KMem_bitSet( uintptr_t val, uint8_t bit )
 {
 	KDebug_assertArg( bit < sizeof( uintptr_t ) * 8 );
-	return (val | (1 << bit));
+	return (val | (((uintptr_t) 1) << bit));
 }
 
 
@@ -222,7 +275,7 @@ static inline uint16_t KMem_bitClear16( uint16_t val, uint8_t bit )
 static inline uint32_t KMem_bitClear32( uint32_t val, uint8_t bit )
 {
 	KDebug_assertArg( bit < 32 );
-	return (val & ~(1 << bit));
+	return (val & ~(((uint32_t) 1) << bit));
 }
 
 
@@ -238,7 +291,7 @@ static inline uint32_t KMem_bitClear32( uint32_t val, uint8_t bit )
 static inline uintptr_t KMem_bitClear( uintptr_t val, uint8_t bit )
 {
 	KDebug_assertArg( bit < sizeof( uintptr_t ) * 8 );
-	return (val & ~(1 << bit));
+	return (val & ~(((uintptr_t) 1) << bit));
 }
 
 
@@ -286,7 +339,7 @@ static inline bool KMem_isBitSet16( uint16_t val, uint8_t bit )
 static inline bool KMem_isBitSet32( uint32_t val, uint8_t bit )
 {
 	KDebug_assertArg( bit < 32 );
-	return ((val & (1 << bit)) != 0);
+	return ((val & (((uint32_t) 1) << bit)) != 0);
 }
 
 
@@ -302,7 +355,7 @@ static inline bool KMem_isBitSet32( uint32_t val, uint8_t bit )
 static inline bool KMem_isBitSet( uintptr_t val, uint8_t bit )
 {
 	KDebug_assertArg( bit < sizeof( uintptr_t ) * 8 );
-	return ((val & (1 << bit)) != 0);
+	return ((val & (((uintptr_t) 1) << bit)) != 0);
 }
 
 
@@ -0,0 +1,41 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Include/Kernel/KRunTime/KLockStats.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/10
+//
+// ===========================================================================
+///
+///	\file
+///
+/// \brief	Defines a utility for reporting the statistics kept by the
+///			instrumented locks.
+///
+/// See Kernel/HAL/LockStats.h for what is measured and how to build the
+/// instrumented locks.
+// ===========================================================================
+
+#ifndef _KERNEL_KRUNTIME_KLOCKSTATS_H_
+#define _KERNEL_KRUNTIME_KLOCKSTATS_H_
+
+
+/// \brief	Writes the statistics of every lock site to the kernel display.
+///
+/// There is one line per site, giving the source file and line of the call to Lock_acquire(), the
+/// number of times it acquired its lock, and the average and longest times it held the lock and
+/// waited for it, in cycles. In builds without LOCK_STATS defined, this just says so.
+///
+/// This takes the kernel display's own Lock, so it must not be called while holding a Lock that
+/// the display might need.
+void KLockStats_dump( void );
+
+
+#endif
+
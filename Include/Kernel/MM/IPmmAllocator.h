@@ -89,6 +89,49 @@ typedef phys_addr_t (*IPmmAllocator_allocateFunc)( volatile void* this, void* co
 typedef void (*IPmmAllocator_freeFunc)( volatile void* this, phys_addr_t frameAddr );
 
 
+/// \brief	Defines the method signature for IPmmAllocator_allocateMany().
+///
+/// \param this			the object that implements IPmmAllocator.
+/// \param frameAddrs	receives the physical addresses of the frames allocated.
+/// \param numFrames	the number of frames to allocate (i.e. -- the size of \a frameAddrs).
+/// \param colourHint	a hint to the allocator that the frames will be mapped to consecutive
+///						virtual pages starting at the given virtual address.
+///
+/// This method has the same effect as calling IPmmAllocator_allocate() \a numFrames times, except
+/// that the implementation can amortize the cost of dispatch, locking, and searching over all the
+/// frames. It is meant for bulk operations like mapping process images and building page tables.
+///
+/// If \a colourHint is not NULL, the implementation is encouraged to allocate frame i with the
+/// same colour as the virtual page at \a colourHint + (i * PAGE_SIZE). The frames returned are
+/// not necessarily contiguous, and may be returned in any order.
+///
+/// \return the number of frames actually allocated. Only that many elements at the start of
+///			\a frameAddrs are valid. This is less than \a numFrames if and only if there are no
+///			more frames available.
+typedef size_t (*IPmmAllocator_allocateManyFunc)(
+	volatile void*	this,
+	phys_addr_t*	frameAddrs,
+	size_t			numFrames,
+	void*			colourHint
+);
+
+
+/// \brief	Defines the method signature for IPmmAllocator_freeMany().
+///
+/// \param this			the object that implements IPmmAllocator.
+/// \param frameAddrs	the physical addresses of the frames to free.
+/// \param numFrames	the number of frames to free (i.e. -- the size of \a frameAddrs).
+///
+/// This method has the same effect as calling IPmmAllocator_free() for each element of
+/// \a frameAddrs, and the same rules apply to each element. Implementations may be able to free
+/// frames more cheaply when runs of nearby frames appear next to each other in \a frameAddrs.
+typedef void (*IPmmAllocator_freeManyFunc)(
+	volatile void*		this,
+	const phys_addr_t*	frameAddrs,
+	size_t				numFrames
+);
+
+
 
 /// \brief	Defines the interface dispatch table for IPmmAllocator.
 typedef struct
@@ -99,6 +142,12 @@ typedef struct
 	/// \brief	Pointer to a particular implementation of IPmmAllocator_free().
 	IPmmAllocator_freeFunc free;
 
+	/// \brief	Pointer to a particular implementation of IPmmAllocator_allocateMany().
+	IPmmAllocator_allocateManyFunc allocateMany;
+
+	/// \brief	Pointer to a particular implementation of IPmmAllocator_freeMany().
+	IPmmAllocator_freeManyFunc freeMany;
+
 } IPmmAllocator_itable;
 
 
@@ -24,6 +24,7 @@
 #define _KERNEL_MM_MM_H_
 
 // Just delegate to the architecture-specific include.
+#include <stddef.h>
 #include <stdint.h>
 #include "MM/MMImpl.h"
 #include "Kernel/KCommon/KDebug.h"
@@ -85,6 +86,61 @@ static inline uintptr_t MM_GB( size_t gigaBytes )
 // Here are some portable utilities that depend on the constants defined in MMImpl.h.
 
 
+/// \brief	Gets the number of page colours for the current machine.
+///
+/// The "colour" of a frame or page determines which sets of the processor's largest cache it can
+/// occupy. Two frames of the same colour compete for the same cache sets, while frames of
+/// different colours never do. The number of colours is the size of one way of the cache
+/// divided by the page size.
+///
+/// How the cache geometry is discovered is architecture-specific. The result is always a power
+/// of two between 1 and MAX_CACHE_COLOURS inclusive. It is calculated on the first call and
+/// cached after that.
+///
+/// \return the number of page colours.
+size_t MM_getNumCacheColours( void );
+
+
+/// \brief	Fills the given frame with zeroes.
+///
+/// \param frameAddr	the physical address of the frame to clear.
+///
+/// The frame does not have to be mapped into the kernel's address space. How the frame is reached
+/// is architecture-specific.
+///
+/// In checked builds, a bugcheck will occur if \a frameAddr is not page-aligned.
+///
+/// This method is thread-safe.
+void MM_zeroFrame( phys_addr_t frameAddr );
+
+
+/// \brief	Gets the colour of the frame with the given frame number.
+///
+/// \param frameNumber	the number of the frame.
+/// \param numColours	the number of colours, as returned by MM_getNumCacheColours().
+///
+/// \return the colour of the frame; Guaranteed to be less than \a numColours.
+static inline size_t MM_getFrameColour( size_t frameNumber, size_t numColours )
+{
+	KDebug_assertArg( (numColours > 0) && ((numColours & (numColours - 1)) == 0) );
+	return (frameNumber & (numColours - 1));
+}
+
+
+/// \brief	Gets the colour of the virtual page containing the given address.
+///
+/// \param vaddr		a virtual address within the page.
+/// \param numColours	the number of colours, as returned by MM_getNumCacheColours().
+///
+/// This is how the colour hint passed to IPmmAllocator_allocate() is interpreted.
+///
+/// \return the colour of the page; Guaranteed to be less than \a numColours.
+static inline size_t MM_getPageColour( const void* vaddr, size_t numColours )
+{
+	return MM_getFrameColour( ((uintptr_t) vaddr) >> PAGE_BITS, numColours );
+}
+
+
 /// \brief	Returns the nearest physical address at or below the given address that is on a frame
 ///			boundary.
 ///
@@ -0,0 +1,448 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Include/Kernel/MM/PageFrameDatabase.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/Apr/02
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	Defines the PageFrameDatabase class, which tracks the state of
+///			every frame of physical memory and implements the IPmmAllocator
+///			that the kernel uses once the PhysicalMemoryManager is fully
+///			initialized.
+///
+/// The PageFrameDatabase (PFDB) keeps one small record per frame, from
+/// frame zero up to the highest frame of RAM reported by the boot loader.
+/// Each record holds the state of the frame (free, allocated to the kernel,
+/// occupied by the kernel image or a module, or reserved), and free frames
+/// are additionally chained together into free lists, one per cache colour
+/// (see MM_getNumCacheColours()). This makes both allocate() and free() O(1)
+/// operations when a frame of the requested colour is available.
+///
+/// Free frames that are known to be filled with zeroes are kept on a second
+/// set of per-colour lists. Frames only get there by being scrubbed (see
+/// PageFrameDatabase_allocateDirty() and PageFrameDatabase_freeZeroed()),
+/// which the PhysicalMemoryManager does during idle time.
+/// PageFrameDatabase_allocateZeroed() takes from these lists first, while
+/// ordinary allocations leave them alone for as long as there are other free
+/// frames.
+///
+/// The PFDB is built in two steps by the PhysicalMemoryManager. First it is
+/// created over a caller-supplied working space, with every frame considered
+/// to be reserved. Then the initializer describes the physical address space
+/// by setting the state of regions and individual frames, and finally calls
+/// PageFrameDatabase_buildFreeList() to put the database into service.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_MM_PAGEFRAMEDATABASE_H_
+#define _KERNEL_MM_PAGEFRAMEDATABASE_H_
+
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "Kernel/MM/IPmmAllocator.h"
+#include "Kernel/MM/PmmRegion.h"
+#include "Kernel/MM/MM.h"
+#include "Kernel/HAL/QueueLock.h"
+
+
+/// \brief	Describes what a frame of physical memory is currently being used for.
+typedef enum
+{
+	// MAINTENANCE NOTE: Keep these enum values 0-based and contiguous.
+	PFSTATE_FREE = 0,	///< The frame is RAM and is available for allocation.
+	PFSTATE_KERNEL,		///< The frame has been allocated by the kernel.
+	PFSTATE_MODULE,		///< The frame holds the kernel image, a module, or boot loader data.
+	PFSTATE_RESERVED	///< The frame is not usable RAM (a hole, memory-mapped I/O, ROM, etc.).
+} PageFrameState;
+
+
+/// \brief	Forward declaration of the per-frame record kept by the PageFrameDatabase.
+struct PageFrameStruct;
+
+
+
+/// \brief	Defines the fields of PageFrameDatabase.
+typedef struct PageFrameDatabaseStruct
+{
+#ifdef _KERNEL_MM_PAGEFRAMEDATABASE_C_
+
+	/// \brief	Base address of the array of per-frame records. Indexed by frame number.
+	struct PageFrameStruct* m_frames;
+
+	/// \brief	The number of frames tracked by the database (i.e. -- the size of \a m_frames).
+	size_t m_numFrames;
+
+	/// \brief	Frame number of the first frame in the free list for each colour, or zero if the
+	///			list is empty.
+	size_t m_freeListHeads[MAX_CACHE_COLOURS];
+
+	/// \brief	The number of cache colours, as reported by MM_getNumCacheColours().
+	size_t m_numColours;
+
+	/// \brief	The colour to try first for the next allocation without a colour hint.
+	///
+	/// Rotating through the colours spreads such allocations evenly across the cache.
+	size_t m_nextColour;
+
+	/// \brief	The number of frames currently in the free lists, including the zeroed lists.
+	size_t m_numFreeFrames;
+
+	/// \brief	Frame number of the first frame in the zeroed list for each colour, or zero if the
+	///			list is empty.
+	size_t m_zeroedListHeads[MAX_CACHE_COLOURS];
+
+	/// \brief	The number of frames currently in the zeroed lists.
+	size_t m_numZeroedFrames;
+
+	/// \brief	Protects the free list and the state of every frame.
+	///
+	/// Every allocation and free goes through this one lock, so it is a QueueLock rather than a
+	/// Lock: on MP systems, waiters queue up instead of all spinning on the same cache line.
+	QueueLock m_lock;
+
+#else
+
+	#ifndef DOXYGEN_SHOULD_SKIP_THIS
+	struct PageFrameStruct*	m_reserved0;
+	size_t					m_reserved1;
+	size_t					m_reserved2[MAX_CACHE_COLOURS];
+	size_t					m_reserved3;
+	size_t					m_reserved4;
+	size_t					m_reserved5;
+	size_t					m_reserved6[MAX_CACHE_COLOURS];
+	size_t					m_reserved7;
+	QueueLock				m_reserved8;
+	#endif
+
+#endif
+} PageFrameDatabase;
+
+
+
+/// \brief	Calculates the size of the working space needed by a PageFrameDatabase that tracks
+///			the given number of frames.
+///
+/// \param numFrames	the number of frames to track, starting with frame zero.
+///
+/// \return the number of bytes of working space to pass to PageFrameDatabase_create().
+size_t PageFrameDatabase_calculateSizeInBytes( size_t numFrames );
+
+
+/// \brief	Creates a new PageFrameDatabase instance.
+///
+/// \param workingSpace	points to the buffer that will hold the per-frame records.
+/// \param sizeInBytes	the size of the \a workingSpace buffer in bytes.
+/// \param numFrames	the number of frames to track, starting with frame zero.
+///
+/// In checked builds, a bugcheck will occur if \a workingSpace is NULL or not aligned on a 32-bit
+/// boundary, if \a numFrames is zero, or if \a sizeInBytes is less than the value returned by
+/// PageFrameDatabase_calculateSizeInBytes() for \a numFrames.
+///
+/// The initial state of the database is that every frame is reserved and the free lists are
+/// empty.
+///
+/// \return a new PageFrameDatabase instance.
+PageFrameDatabase PageFrameDatabase_create(
+	void*	workingSpace,	// in, own
+	size_t	sizeInBytes,	// in
+	size_t	numFrames		// in
+);
+
+
+/// \brief	Gets the number of frames tracked by the given PageFrameDatabase.
+///
+/// \param pfdb	the PageFrameDatabase.
+///
+/// This method is thread-safe.
+///
+/// \return the number of frames tracked by \a pfdb.
+size_t PageFrameDatabase_getNumFrames( const volatile PageFrameDatabase* pfdb );
+
+
+/// \brief	Gets the number of frames that are currently available for allocation.
+///
+/// \param pfdb	the PageFrameDatabase.
+///
+/// This method is thread-safe, but the returned value may be stale by the time the caller looks
+/// at it.
+///
+/// \return the number of free frames in \a pfdb, including those known to be zeroed.
+size_t PageFrameDatabase_getNumFreeFrames( const volatile PageFrameDatabase* pfdb );
+
+
+/// \brief	Gets the number of free frames that are known to be filled with zeroes.
+///
+/// \param pfdb	the PageFrameDatabase.
+///
+/// This method is thread-safe, but the returned value may be stale by the time the caller looks
+/// at it.
+///
+/// \return the number of zeroed free frames in \a pfdb.
+size_t PageFrameDatabase_getNumZeroedFrames( const volatile PageFrameDatabase* pfdb );
+
+
+/// \brief	Gets the state of the given frame.
+///
+/// \param pfdb			the PageFrameDatabase.
+/// \param frameAddr	the physical address of the frame.
+///
+/// In checked builds, a bugcheck will occur if \a frameAddr is not page-aligned or is beyond the
+/// last frame tracked by \a pfdb.
+///
+/// This method is thread-safe, but the returned value may be stale by the time the caller looks
+/// at it.
+///
+/// \return the state of the frame at \a frameAddr.
+PageFrameState PageFrameDatabase_getFrameState(
+	const volatile PageFrameDatabase*	pfdb,
+	phys_addr_t							frameAddr
+);
+
+
+/// \brief	Sets the state of the given frame during initialization.
+///
+/// \param pfdb			the PageFrameDatabase.
+/// \param frameAddr	the physical address of the frame.
+/// \param state		the new state of the frame.
+///
+/// This method can only be called before PageFrameDatabase_buildFreeList(). It is not
+/// thread-safe. Frames beyond the last frame tracked by \a pfdb are silently ignored.
+void PageFrameDatabase_setFrameState(
+	PageFrameDatabase*	pfdb,
+	phys_addr_t			frameAddr,
+	PageFrameState		state
+);
+
+
+/// \brief	Sets the state of every frame overlapping the given region during initialization.
+///
+/// \param pfdb		the PageFrameDatabase.
+/// \param region	the region of physical address space to update.
+/// \param state	the new state of the frames.
+///
+/// If \a state is PFSTATE_FREE, only those frames that lie entirely within \a region are
+/// updated, since a partial frame of RAM cannot be handed out. For all other states, every
+/// frame that overlaps \a region at all is updated. Frames beyond the last frame tracked by
+/// \a pfdb are silently ignored.
+///
+/// This method can only be called before PageFrameDatabase_buildFreeList(). It is not
+/// thread-safe.
+void PageFrameDatabase_setRegionState(
+	PageFrameDatabase*	pfdb,
+	PmmRegion			region,
+	PageFrameState		state
+);
+
+
+/// \brief	Completes initialization of the PageFrameDatabase by gathering every free frame into
+///			the free lists.
+///
+/// \param pfdb	the PageFrameDatabase.
+///
+/// Frame zero is always treated as reserved, regardless of its state, since its address is
+/// PHYS_NULL. The free lists are built so that frames are initially handed out in roughly
+/// ascending order of physical address when no colour hint is given.
+///
+/// This method must be called exactly once, after all calls to PageFrameDatabase_setFrameState()
+/// and PageFrameDatabase_setRegionState(). It is not thread-safe.
+void PageFrameDatabase_buildFreeList( PageFrameDatabase* pfdb );
+
+
+/// \brief	Implementation of IPmmAllocator_allocate().
+///
+/// \param this			the PageFrameDatabase from which to allocate.
+/// \param colourHint	the colour hint; NULL means no preference.
+///
+/// If a colour hint is given, a frame of the same colour as the page containing \a colourHint is
+/// returned if there is one. Otherwise the next colour up that has a free frame is used. Without
+/// a hint, successive allocations rotate through the colours. Zeroed frames are only handed out
+/// once there are no other free frames left.
+///
+/// The allocated frame is recorded as being in the PFSTATE_KERNEL state.
+///
+/// This method is thread-safe. It runs in constant time unless the desired colour has run out,
+/// in which case it takes at most MAX_CACHE_COLOURS steps.
+///
+/// \retval phys_addr_t	the physical address of the frame just allocated; Guaranteed to be
+///						page-aligned.
+/// \retval PHYS_NULL	there are no more free frames.
+phys_addr_t PageFrameDatabase_allocate( volatile PageFrameDatabase* this, void* colourHint );
+
+
+/// \brief	Allocates a frame, preferring one that is known to be filled with zeroes.
+///
+/// \param this			the PageFrameDatabase from which to allocate.
+/// \param colourHint	the colour hint; NULL means no preference.
+/// \param isZeroed		receives \c true if the frame came from the zeroed lists, or \c false if
+///						the caller has to clear it.
+///
+/// This is just like PageFrameDatabase_allocate(), except that the zeroed lists are tried first.
+/// If they are empty, any free frame is returned instead.
+///
+/// In checked builds, a bugcheck will occur if \a isZeroed is NULL.
+///
+/// This method is thread-safe.
+///
+/// \retval phys_addr_t	the physical address of the frame just allocated; Guaranteed to be
+///						page-aligned.
+/// \retval PHYS_NULL	there are no more free frames.
+phys_addr_t PageFrameDatabase_allocateZeroed(
+	volatile PageFrameDatabase*	this,
+	void*						colourHint,
+	bool*						isZeroed
+);
+
+
+/// \brief	Allocates a free frame that is not known to be zeroed, so that it can be scrubbed.
+///
+/// \param this	the PageFrameDatabase from which to allocate.
+///
+/// Successive calls rotate through the colours, so that scrubbing keeps the zeroed lists of every
+/// colour stocked evenly. Once the frame has been cleared, it should be returned with
+/// PageFrameDatabase_freeZeroed().
+///
+/// This method is thread-safe.
+///
+/// \retval phys_addr_t	the physical address of a frame that needs scrubbing.
+/// \retval PHYS_NULL	every free frame is already zeroed.
+phys_addr_t PageFrameDatabase_allocateDirty( volatile PageFrameDatabase* this );
+
+
+/// \brief	Frees a frame that the caller has filled with zeroes.
+///
+/// \param this			the PageFrameDatabase to which to free.
+/// \param frameAddr	the physical address of the frame to free.
+///
+/// This is just like PageFrameDatabase_free(), except that the frame goes on the zeroed list for
+/// its colour. The same checks apply.
+///
+/// This method is thread-safe and runs in constant time.
+void PageFrameDatabase_freeZeroed( volatile PageFrameDatabase* this, phys_addr_t frameAddr );
+
+
+/// \brief	Implementation of IPmmAllocator_free().
+///
+/// \param this			the PageFrameDatabase to which to free.
+/// \param frameAddr	the physical address of the frame to free.
+///
+/// Frames in either the PFSTATE_KERNEL or PFSTATE_MODULE state may be freed. The latter allows
+/// the kernel to reclaim the memory occupied by modules once it is done with them. In checked
+/// builds, a bugcheck will occur if \a frameAddr is PHYS_NULL, not page-aligned, beyond the last
+/// frame tracked by this database, or in any other state. In free builds, \a frameAddr will be
+/// truncated down to the nearest page boundary if it is not page-aligned, and attempts to free
+/// free, reserved, or out-of-range frames will be ignored.
+///
+/// This method is thread-safe and runs in constant time.
+void PageFrameDatabase_free( volatile PageFrameDatabase* this, phys_addr_t frameAddr );
+
+
+/// \brief	Implementation of IPmmAllocator_allocateMany().
+///
+/// \param this			the PageFrameDatabase from which to allocate.
+/// \param frameAddrs	receives the physical addresses of the frames allocated.
+/// \param numFrames	the number of frames to allocate.
+/// \param colourHint	the colour hint for the first frame; NULL means no preference.
+///
+/// Frames are chosen exactly as if PageFrameDatabase_allocate() had been called for each one,
+/// but the lock is only acquired once.
+///
+/// This method is thread-safe.
+///
+/// \return the number of frames actually allocated.
+size_t PageFrameDatabase_allocateMany(
+	volatile PageFrameDatabase*	this,
+	phys_addr_t*				frameAddrs,
+	size_t						numFrames,
+	void*						colourHint
+);
+
+
+/// \brief	Implementation of IPmmAllocator_freeMany().
+///
+/// \param this			the PageFrameDatabase to which to free.
+/// \param frameAddrs	the physical addresses of the frames to free.
+/// \param numFrames	the number of frames to free.
+///
+/// The same checks as PageFrameDatabase_free() apply to each element of \a frameAddrs. The lock
+/// is only acquired once.
+///
+/// This method is thread-safe.
+void PageFrameDatabase_freeMany(
+	volatile PageFrameDatabase*	this,
+	const phys_addr_t*			frameAddrs,
+	size_t						numFrames
+);
+
+
+/// \brief	Allocates a run of physically contiguous frames with the given alignment, entirely
+///			at or below the given address.
+///
+/// \param this			the PageFrameDatabase from which to allocate.
+/// \param numFrames	the number of frames to allocate.
+/// \param alignment	the alignment of the first frame in bytes; Must be a power of two. Values
+///						less than PAGE_SIZE (including zero) mean page alignment.
+/// \param maxAddr		the highest physical address that the run may include. For example,
+///						0x00FFFFFF for ISA DMA, or MAX_PHYS_ADDR for no limit.
+///
+/// The frame states are searched from the bottom up for the first run of free frames that fits,
+/// skipping past the highest frame in use of each candidate that doesn't. The frames of the run
+/// are then unlinked from the free and zeroed lists of their colours, which means walking those
+/// lists. This is much slower than PageFrameDatabase_allocate(), so it is meant for the rare
+/// callers that really need contiguous memory, such as drivers setting up DMA buffers.
+///
+/// Every frame of the run is recorded as being in the PFSTATE_KERNEL state. Free the run with
+/// PageFrameDatabase_freeRange().
+///
+/// In checked builds, a bugcheck will occur if \a numFrames is zero or if \a alignment is not a
+/// power of two.
+///
+/// This method is thread-safe. The lock is held for the whole search.
+///
+/// \retval phys_addr_t	the physical address of the first frame of the run; Guaranteed to be
+///						aligned on \a alignment.
+/// \retval PHYS_NULL	there is no run of free frames that satisfies the constraints.
+phys_addr_t PageFrameDatabase_allocateRange(
+	volatile PageFrameDatabase*	this,
+	size_t						numFrames,
+	phys_size_t					alignment,
+	phys_addr_t					maxAddr
+);
+
+
+/// \brief	Frees a run of physically contiguous frames.
+///
+/// \param this				the PageFrameDatabase to which to free.
+/// \param firstFrameAddr	the physical address of the first frame of the run.
+/// \param numFrames		the number of frames in the run.
+///
+/// The same checks as PageFrameDatabase_free() apply to each frame of the run. The lock is only
+/// acquired once.
+///
+/// This method is thread-safe.
+void PageFrameDatabase_freeRange(
+	volatile PageFrameDatabase*	this,
+	phys_addr_t					firstFrameAddr,
+	size_t						numFrames
+);
+
+
+/// \brief	Gets a reference to the IPmmAllocator implementation of the given PageFrameDatabase.
+///
+/// \param pfdb the PageFrameDatabase instance.
+///
+/// \return the IPmmAllocator interface that \a pfdb implements.
+IPmmAllocator PageFrameDatabase_getAsPmmAllocator( volatile PageFrameDatabase* pfdb );
+
+
+#endif
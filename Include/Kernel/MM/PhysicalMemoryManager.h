@@ -28,6 +28,8 @@
 #include <stddef.h>
 #include "Kernel/MM/IPmmRegionList.h"
 #include "Kernel/MM/IPmmAllocator.h"
+#include "Kernel/MM/PageFrameDatabase.h"
+#include "Kernel/MM/PmmRegionTable.h"
 
 
 /// \brief	Forward declaration of the PhysicalMemoryManager object type.
@@ -86,7 +88,11 @@ size_t PhysicalMemoryManager_initStageOne(
 /// This method will switch the PhysicalMemoryManager out of "initialization mode" by replacing its
 /// initial watermark allocator with the fully-initialized PageFrameDatabase. At this point, the
 /// PhysicalMemoryManager is fully operational and can handle requests from the kernel or from
-/// user processes.
+/// user processes. The kernel allocator keeps a small cache of free frames per processor in front
+/// of the PageFrameDatabase, so most requests never touch the PageFrameDatabase's lock.
+///
+/// Every frame that the initial allocator can still hand out is moved to the PageFrameDatabase in
+/// batches. Everything else in RAM is assumed to belong to the kernel.
 ///
 /// \note
 /// It is an error to call this method before calling initStageOne(). It is also an error to call
@@ -115,12 +121,30 @@ volatile PhysicalMemoryManager* PhysicalMemoryManager_getInstance();
 ///
 /// This method can only be called after initStageTwo() has been called.
 ///
-/// \return a pointer to the PageFrameDatabase. ***FIXME: declare PageFrameDatabase.
-volatile char* PhysicalMemoryManager_getPageFrameDatabase(
+/// \return a pointer to the PageFrameDatabase.
+volatile PageFrameDatabase* PhysicalMemoryManager_getPageFrameDatabase(
 	volatile PhysicalMemoryManager* pmm
 );
 
 
+/// \brief	Provides access to the table of physical memory regions built from the memory maps
+///			passed to initStageOne().
+///
+/// \param pmm	the PhysicalMemoryManager.
+///
+/// The table is sorted by address and its entries never overlap, so it can be used to quickly find
+/// out what kind of memory lives at a given physical address.
+///
+/// This method is thread-safe, since the table never changes after initStageOne().
+///
+/// This method can only be called after initStageOne() has been called.
+///
+/// \return a pointer to the PmmRegionTable.
+const PmmRegionTable* PhysicalMemoryManager_getRegionTable(
+	const volatile PhysicalMemoryManager* pmm
+);
+
+
 /// \brief	Provides access to the PhysicalMemoryManager's kernel allocator.
 ///
 /// \param pmm	the PhysicalMemoryManager.
@@ -134,4 +158,106 @@ volatile char* PhysicalMemoryManager_getPageFrameDatabase(
 IPmmAllocator PhysicalMemoryManager_getAllocator( const volatile PhysicalMemoryManager* pmm );
 
 
+/// \brief	Returns every frame cached by the kernel allocator to the PageFrameDatabase.
+///
+/// \param pmm	the PhysicalMemoryManager.
+///
+/// Frames in a processor's cache are free as far as the kernel allocator is concerned, but still
+/// allocated as far as the PageFrameDatabase is concerned. Call this method before asking the
+/// PageFrameDatabase anything that depends on exactly which frames are free.
+///
+/// This method is thread-safe. It does nothing until initStageTwo() has been called.
+void PhysicalMemoryManager_drainFrameCaches( volatile PhysicalMemoryManager* pmm );
+
+
+/// \brief	Allocates a run of physically contiguous frames for the kernel with the given
+///			alignment, entirely at or below the given address.
+///
+/// \param pmm			the PhysicalMemoryManager.
+/// \param numFrames	the number of frames to allocate.
+/// \param alignment	the alignment of the first frame in bytes; Must be a power of two. Values
+///						less than PAGE_SIZE (including zero) mean page alignment.
+/// \param maxAddr		the highest physical address that the run may include. For example,
+///						0x00FFFFFF for ISA DMA, or MAX_PHYS_ADDR for no limit.
+///
+/// This is for the rare callers that need physically contiguous memory, such as drivers setting up
+/// DMA buffers. It is backed by PageFrameDatabase_allocateRange(), and is much slower than the
+/// kernel allocator. If no run fits, the processors' frame caches are drained and the search is
+/// tried again. Free the run with PhysicalMemoryManager_freeRange().
+///
+/// In checked builds, a bugcheck will occur if \a numFrames is zero or if \a alignment is not a
+/// power of two.
+///
+/// This method is thread-safe. It always fails until initStageTwo() has been called.
+///
+/// \retval phys_addr_t	the physical address of the first frame of the run; Guaranteed to be
+///						aligned on \a alignment.
+/// \retval PHYS_NULL	there is no run of free frames that satisfies the constraints.
+phys_addr_t PhysicalMemoryManager_allocateRange(
+	volatile PhysicalMemoryManager*	pmm,
+	size_t							numFrames,
+	phys_size_t						alignment,
+	phys_addr_t						maxAddr
+);
+
+
+/// \brief	Frees a run of frames allocated by PhysicalMemoryManager_allocateRange().
+///
+/// \param pmm				the PhysicalMemoryManager.
+/// \param firstFrameAddr	the physical address of the first frame of the run.
+/// \param numFrames		the number of frames in the run.
+///
+/// The frames go straight back to the PageFrameDatabase rather than to the frame caches, so the
+/// run is available to the next caller of allocateRange() in one piece.
+///
+/// This method is thread-safe. It can only be called after initStageTwo() has been called.
+void PhysicalMemoryManager_freeRange(
+	volatile PhysicalMemoryManager*	pmm,
+	phys_addr_t						firstFrameAddr,
+	size_t							numFrames
+);
+
+
+/// \brief	Allocates a frame for the kernel that is filled with zeroes.
+///
+/// \param pmm			the PhysicalMemoryManager.
+/// \param colourHint	the colour hint; NULL means no preference. See IPmmAllocator_allocate().
+///
+/// Once the PhysicalMemoryManager is fully initialized, frames that were scrubbed during idle time
+/// are handed out first, so the caller usually doesn't pay for clearing the frame. If there are no
+/// scrubbed frames left, or during "initialization mode", the frame is cleared before this method
+/// returns.
+///
+/// This method is thread-safe.
+///
+/// This method can only be called after initStageOne() has been called.
+///
+/// \retval phys_addr_t	the physical address of the zero-filled frame.
+/// \retval PHYS_NULL	there are no more free frames.
+phys_addr_t PhysicalMemoryManager_allocateZeroed(
+	volatile PhysicalMemoryManager*	pmm,
+	void*							colourHint
+);
+
+
+/// \brief	Fills up to the given number of free frames with zeroes, so that they are ready for
+///			PhysicalMemoryManager_allocateZeroed().
+///
+/// \param pmm			the PhysicalMemoryManager.
+/// \param maxFrames	the most frames to scrub before returning.
+///
+/// This is meant to be called from the idle loop. Each frame is taken out of the PageFrameDatabase
+/// while it is being cleared, so other processors and interrupt handlers can keep allocating and
+/// freeing in the meantime. Keep \a maxFrames small so that the caller gets a chance to notice
+/// pending work between batches.
+///
+/// This method is thread-safe. It does nothing until initStageTwo() has been called.
+///
+/// \return the number of frames scrubbed; Zero means there was nothing left to scrub.
+size_t PhysicalMemoryManager_scrubFreeFrames(
+	volatile PhysicalMemoryManager*	pmm,
+	size_t							maxFrames
+);
+
+
 #endif
@@ -0,0 +1,269 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Include/Kernel/MM/PmmBuddyAllocator.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/Apr/09
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	Defines the PmmBuddyAllocator class, which implements a frame
+///			allocator that can hand out physically contiguous runs of frames.
+///
+/// The buddy allocator manages free memory as blocks of 2^order frames,
+/// where order ranges from zero (a single frame) up to MAX_BUDDY_ORDER. Every
+/// block is naturally aligned -- that is, the frame number of its first frame
+/// is a multiple of its size. This means that every block has exactly one
+/// "buddy" of the same size that it can be merged with to form a block of the
+/// next order up.
+///
+/// Each order has its own doubly-linked free list. Allocating a block of a
+/// given order takes the smallest free block that is big enough and splits it
+/// in half repeatedly, putting the unused halves back on the free lists.
+/// Freeing a block merges it with its buddy for as long as the buddy is also
+/// free, which keeps large blocks from being permanently broken up by churn.
+/// Both operations take O(log n) time, where n is the size of the largest
+/// block.
+///
+/// Since the frames themselves may not be mapped into the kernel's address
+/// space, the free lists are threaded through a separate array of per-frame
+/// records in a caller-supplied working space instead of through the free
+/// frames.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_MM_PMMBUDDYALLOCATOR_H_
+#define _KERNEL_MM_PMMBUDDYALLOCATOR_H_
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Kernel/MM/IPmmAllocator.h"
+#include "Kernel/MM/MM.h"
+#include "Kernel/HAL/Lock.h"
+
+
+// Public constants
+
+/// \brief	Defines constants for the implementation of PmmBuddyAllocator.
+enum PmmBuddyAllocator_consts
+{
+	/// \brief	The order of the largest block that the buddy allocator will manage.
+	///
+	/// On x86, an order 10 block is 4 MB, which is the size of a large page.
+	MAX_BUDDY_ORDER = 10,
+
+	NUM_BUDDY_ORDERS = MAX_BUDDY_ORDER + 1	///< Number of free lists kept by the allocator.
+};
+
+
+/// \brief	Forward declaration of the per-frame record kept by the PmmBuddyAllocator.
+struct PmmBuddyFrameStruct;
+
+
+
+/// \brief	Defines the fields of PmmBuddyAllocator.
+typedef struct PmmBuddyAllocator
+{
+#ifdef _KERNEL_MM_PMMBUDDYALLOCATOR_C_
+
+	/// \brief	Base address of the array of per-frame records. Indexed by frame number relative to
+	///			\a m_baseFrameNumber.
+	struct PmmBuddyFrameStruct* m_frames;
+
+	/// \brief	The number of frames tracked by this allocator.
+	size_t m_numFrames;
+
+	/// \brief	The frame number of the first frame of the region being tracked by this allocator.
+	size_t m_baseFrameNumber;
+
+	/// \brief	Index of the first block in the free list for each order.
+	size_t m_freeListHeads[NUM_BUDDY_ORDERS];
+
+	/// \brief	The total number of free frames, across all orders.
+	size_t m_numFreeFrames;
+
+	/// \brief	A lock to synchronize access to the allocator.
+	Lock m_lock;
+
+#else
+
+	#ifndef DOXYGEN_SHOULD_SKIP_THIS
+	struct PmmBuddyFrameStruct*	m_reserved0;
+	size_t						m_reserved1;
+	size_t						m_reserved2;
+	size_t						m_reserved3[NUM_BUDDY_ORDERS];
+	size_t						m_reserved4;
+	Lock						m_reserved5;
+	#endif
+
+#endif
+} PmmBuddyAllocator;
+
+
+
+/// \brief	Calculates the size of the working space needed by a PmmBuddyAllocator that tracks
+///			the given number of frames.
+///
+/// \param numFrames	the number of frames to track.
+///
+/// \return the number of bytes of working space to pass to PmmBuddyAllocator_create().
+size_t PmmBuddyAllocator_calculateSizeInBytes( size_t numFrames );
+
+
+/// \brief	Creates a new PmmBuddyAllocator instance.
+///
+/// \param workingSpace	points to the buffer that will hold the per-frame records.
+/// \param sizeInBytes	the size of the \a workingSpace buffer in bytes.
+/// \param baseAddress	base physical address of the region to be managed by the allocator.
+/// \param numFrames	the number of frames to manage, starting at \a baseAddress.
+///
+/// In checked builds, a bugcheck will occur if \a workingSpace is NULL or not aligned on a 32-bit
+/// boundary, if \a baseAddress is not page-aligned, if \a numFrames is zero, or if \a sizeInBytes
+/// is less than the value returned by PmmBuddyAllocator_calculateSizeInBytes() for \a numFrames.
+///
+/// Blocks are aligned on physical frame numbers, not relative to \a baseAddress, so a region that
+/// doesn't start on a MAX_BUDDY_ORDER boundary simply has a few smaller blocks at either end.
+///
+/// The initial state of the allocator is that all frames are allocated. Free individual frames
+/// to make them available; buddies are merged as they are freed.
+///
+/// \return a new PmmBuddyAllocator instance.
+PmmBuddyAllocator PmmBuddyAllocator_create(
+	void*		workingSpace,	// in, own
+	size_t		sizeInBytes,	// in
+	phys_addr_t	baseAddress,	// in
+	size_t		numFrames		// in
+);
+
+
+/// \brief	Gets the number of frames that are currently available for allocation.
+///
+/// \param this	the allocator.
+///
+/// This method is thread-safe, but the returned value may be stale by the time the caller looks
+/// at it.
+///
+/// \return the number of free frames in \a this allocator, across all orders.
+size_t PmmBuddyAllocator_getNumFreeFrames( const volatile PmmBuddyAllocator* this );
+
+
+/// \brief	Allocates a physically contiguous block of 2^\a order frames.
+///
+/// \param this		the allocator from which to allocate.
+/// \param order	the base-2 logarithm of the number of frames to allocate.
+///
+/// In checked builds, a bugcheck will occur if \a order is greater than MAX_BUDDY_ORDER.
+///
+/// This method is thread-safe and runs in O(MAX_BUDDY_ORDER) time.
+///
+/// \retval phys_addr_t	the physical address of the first frame of the block; Guaranteed to be
+///						aligned on a boundary of 2^\a order frames.
+/// \retval PHYS_NULL	there is no free block large enough.
+phys_addr_t PmmBuddyAllocator_allocateOrder( volatile PmmBuddyAllocator* this, uint8_t order );
+
+
+/// \brief	Frees a block of 2^\a order frames previously returned by
+///			PmmBuddyAllocator_allocateOrder().
+///
+/// \param this			the allocator to which to free.
+/// \param blockAddr	the physical address of the first frame of the block.
+/// \param order		the order that was passed to PmmBuddyAllocator_allocateOrder().
+///
+/// The block is merged with its buddy, and the result with its buddy, and so on, for as long as
+/// the buddies are free.
+///
+/// In checked builds, a bugcheck will occur if \a blockAddr is PHYS_NULL, not aligned on a
+/// boundary of 2^\a order frames, not in the region tracked by this allocator, already free, or
+/// was allocated with a different order.
+///
+/// This method is thread-safe and runs in O(MAX_BUDDY_ORDER) time.
+void PmmBuddyAllocator_freeOrder(
+	volatile PmmBuddyAllocator*	this,
+	phys_addr_t					blockAddr,
+	uint8_t						order
+);
+
+
+/// \brief	Implementation of IPmmAllocator_allocate().
+///
+/// \param this			the allocator from which to allocate.
+/// \param colourHint	the colour hint; Currently ignored by this implementation.
+///
+/// This is equivalent to PmmBuddyAllocator_allocateOrder() with an order of zero.
+///
+/// This method is thread-safe.
+///
+/// \retval phys_addr_t	the physical address of the frame just allocated; Guaranteed to be
+///						page-aligned.
+/// \retval PHYS_NULL	there are no more free frames.
+phys_addr_t PmmBuddyAllocator_allocate( volatile PmmBuddyAllocator* this, void* colourHint );
+
+
+/// \brief	Implementation of IPmmAllocator_free().
+///
+/// \param this			the allocator to which to free.
+/// \param frameAddr	the physical address of the frame to free.
+///
+/// This is equivalent to PmmBuddyAllocator_freeOrder() with an order of zero.
+///
+/// This method is thread-safe.
+void PmmBuddyAllocator_free( volatile PmmBuddyAllocator* this, phys_addr_t frameAddr );
+
+
+/// \brief	Implementation of IPmmAllocator_allocateMany().
+///
+/// \param this			the allocator from which to allocate.
+/// \param frameAddrs	receives the physical addresses of the frames allocated.
+/// \param numFrames	the number of frames to allocate.
+/// \param colourHint	the colour hint; Currently ignored by this implementation.
+///
+/// This is equivalent to calling PmmBuddyAllocator_allocateOrder() with an order of zero for each
+/// frame, but the lock is only acquired once. Callers that need the frames to be contiguous
+/// should use PmmBuddyAllocator_allocateOrder() instead.
+///
+/// This method is thread-safe.
+///
+/// \return the number of frames actually allocated.
+size_t PmmBuddyAllocator_allocateMany(
+	volatile PmmBuddyAllocator*	this,
+	phys_addr_t*				frameAddrs,
+	size_t						numFrames,
+	void*						colourHint
+);
+
+
+/// \brief	Implementation of IPmmAllocator_freeMany().
+///
+/// \param this			the allocator to which to free.
+/// \param frameAddrs	the physical addresses of the frames to free.
+/// \param numFrames	the number of frames to free.
+///
+/// This is equivalent to calling PmmBuddyAllocator_free() for each frame, but the lock is only
+/// acquired once.
+///
+/// This method is thread-safe.
+void PmmBuddyAllocator_freeMany(
+	volatile PmmBuddyAllocator*	this,
+	const phys_addr_t*			frameAddrs,
+	size_t						numFrames
+);
+
+
+/// \brief	Gets a reference to the IPmmAllocator implementation of the given PmmBuddyAllocator.
+///
+/// \param allocator the PmmBuddyAllocator instance.
+///
+/// \return the IPmmAllocator interface that \a allocator implements.
+IPmmAllocator PmmBuddyAllocator_getAsPmmAllocator( volatile PmmBuddyAllocator* allocator );
+
+
+#endif
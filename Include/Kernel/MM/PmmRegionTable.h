@@ -0,0 +1,274 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Include/Kernel/MM/PmmRegionTable.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/Apr/23
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	Defines the PmmRegionTable class, which keeps a compact, sorted
+///			table of the physical memory map, and the PmmRegionTableList class,
+///			which enumerates the table as an IPmmRegionList.
+///
+/// The memory maps reported by the bootloader come in three separate lists
+/// (RAM, reserved, and kernel & modules), they are not sorted, and they may
+/// overlap. Enumerating them means going through the IPmmRegionList callbacks
+/// of whatever parses the bootloader's data structures, and every consumer
+/// has to resolve the overlaps itself.
+///
+/// The region table is built once from the three lists. Each entry is tagged
+/// with the type of memory it describes. Where the lists overlap, reserved
+/// regions trump RAM, and kernel & module regions trump everything, so that
+/// no two entries in the table ever overlap. Adjacent entries of the same
+/// type are merged. Since the table is sorted, the entry containing a given
+/// address can be found with a binary search.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_MM_PMMREGIONTABLE_H_
+#define _KERNEL_MM_PMMREGIONTABLE_H_
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "Kernel/MM/IPmmRegionList.h"
+#include "Kernel/MM/PmmRegion.h"
+
+
+// Public constants
+
+/// \brief	Defines constants for the implementation of PmmRegionTable.
+enum PmmRegionTable_consts
+{
+	/// \brief	The maximum number of entries in the table.
+	///
+	/// Real memory maps have a few dozen entries at most, even after splitting.
+	MAX_REGION_TABLE_ENTRIES = 128,
+
+	/// \brief	Returned by PmmRegionTable_find() when there is no entry at or above the given
+	///			address.
+	REGION_TABLE_NOT_FOUND = MAX_REGION_TABLE_ENTRIES
+};
+
+
+/// \brief	Identifies the type of memory described by an entry in a PmmRegionTable.
+///
+/// The values are bit flags so that they can be combined into a mask for PmmRegionTableList.
+/// Higher values take precedence over lower values when regions overlap.
+typedef enum
+{
+	PMMREGION_NONE		= 0x00,	///< Not described by any region (a hole in the memory map).
+	PMMREGION_RAM		= 0x01,	///< RAM that is available for use.
+	PMMREGION_RESERVED	= 0x02,	///< Reserved by the firmware, memory-mapped I/O, etc.
+	PMMREGION_MODULE	= 0x04,	///< Occupied by the kernel or one of its modules.
+
+	PMMREGION_USED		= PMMREGION_RESERVED | PMMREGION_MODULE,	///< Everything but RAM.
+	PMMREGION_ALL		= PMMREGION_RAM | PMMREGION_USED			///< Every entry.
+} PmmRegionType;
+
+
+
+/// \brief	Defines the fields of a single entry in a PmmRegionTable.
+typedef struct PmmRegionTableEntry
+{
+#ifdef _KERNEL_MM_PMMREGIONTABLE_C_
+
+	phys_addr_t	m_base;	///< Points to the lowest byte in the region.
+	phys_addr_t	m_last;	///< Points to the highest byte in the region.
+	uint8_t		m_type;	///< The PmmRegionType of the region.
+
+#else
+
+	#ifndef DOXYGEN_SHOULD_SKIP_THIS
+	phys_addr_t	m_reserved0;
+	phys_addr_t	m_reserved1;
+	uint8_t		m_reserved2;
+	#endif
+
+#endif
+} PmmRegionTableEntry;
+
+
+
+/// \brief	Defines the fields of PmmRegionTable.
+typedef struct PmmRegionTable
+{
+#ifdef _KERNEL_MM_PMMREGIONTABLE_C_
+
+	/// \brief	The entries of the table, sorted by base address.
+	PmmRegionTableEntry m_entries[MAX_REGION_TABLE_ENTRIES];
+
+	/// \brief	The number of entries in use.
+	size_t m_numEntries;
+
+#else
+
+	#ifndef DOXYGEN_SHOULD_SKIP_THIS
+	PmmRegionTableEntry	m_reserved0[MAX_REGION_TABLE_ENTRIES];
+	size_t				m_reserved1;
+	#endif
+
+#endif
+} PmmRegionTable;
+
+
+
+/// \brief	Defines the fields of PmmRegionTableList.
+typedef struct PmmRegionTableList
+{
+#ifdef _KERNEL_MM_PMMREGIONTABLE_C_
+
+	/// \brief	The table being enumerated.
+	const PmmRegionTable* m_table;
+
+	/// \brief	The PmmRegionType flags of the entries to include in the enumeration.
+	uint8_t m_typeMask;
+
+	/// \brief	Index of the next entry to examine.
+	size_t m_next;
+
+	/// \brief	Index of the current entry, or REGION_TABLE_NOT_FOUND if the iterator is not on a
+	///			valid position.
+	size_t m_current;
+
+#else
+
+	#ifndef DOXYGEN_SHOULD_SKIP_THIS
+	const PmmRegionTable*	m_reserved0;
+	uint8_t					m_reserved1;
+	size_t					m_reserved2;
+	size_t					m_reserved3;
+	#endif
+
+#endif
+} PmmRegionTableList;
+
+
+
+/// \brief	Builds the region table from the given memory maps.
+///
+/// \param table		the PmmRegionTable to initialize.
+/// \param ramList		a list of all known RAM regions in the physical address space.
+/// \param reservedList	a list of reserved regions in the physical address space.
+/// \param moduleList	a list of all physical memory regions occupied by the kernel and its
+///						modules.
+///
+/// Unlike most classes, PmmRegionTable is initialized in place rather than returned by value,
+/// since it is fairly large.
+///
+/// In checked builds, a bugcheck will occur if \a table is NULL.
+///
+/// \retval true	the table was built successfully.
+/// \retval false	the memory maps have too many regions to fit in the table. The table is left
+///					in a valid state, but some of the regions will be missing from it.
+bool PmmRegionTable_init(
+	PmmRegionTable*	table,
+	IPmmRegionList	ramList,
+	IPmmRegionList	reservedList,
+	IPmmRegionList	moduleList
+);
+
+
+/// \brief	Adds a region of the given type to the table.
+///
+/// \param table	the PmmRegionTable.
+/// \param region	the region to add.
+/// \param type		the type of \a region.
+///
+/// Wherever \a region overlaps an existing entry of equal or higher precedence, the existing
+/// entry wins. Elsewhere, \a region replaces whatever was there. The result is merged with any
+/// adjacent entries of the same type.
+///
+/// In checked builds, a bugcheck will occur if \a table is NULL or if \a type is not exactly one
+/// of PMMREGION_RAM, PMMREGION_RESERVED, or PMMREGION_MODULE.
+///
+/// \retval true	the region was added.
+/// \retval false	there was no room in the table. The table is left in a valid state, but only
+///					part of \a region may have been added.
+bool PmmRegionTable_add( PmmRegionTable* table, PmmRegion region, PmmRegionType type );
+
+
+/// \brief	Gets the number of entries in the table.
+///
+/// \param table	the PmmRegionTable.
+///
+/// \return the number of entries in \a table.
+size_t PmmRegionTable_getNumEntries( const PmmRegionTable* table );
+
+
+/// \brief	Gets the entry at the given index.
+///
+/// \param table	the PmmRegionTable.
+/// \param index	the index of the entry. Entries are sorted by ascending base address.
+/// \param region	receives the region described by the entry. May be NULL.
+///
+/// In checked builds, a bugcheck will occur if \a table is NULL or \a index is out of range.
+///
+/// \return the type of the entry.
+PmmRegionType PmmRegionTable_getEntry(
+	const PmmRegionTable*	table,
+	size_t					index,
+	PmmRegion*				region
+);
+
+
+/// \brief	Finds the first entry that is not below the given address.
+///
+/// \param table	the PmmRegionTable.
+/// \param addr		the physical address to look for.
+///
+/// This is a binary search, so it runs in O(log n) time. The entry found either contains
+/// \a addr, or is the first entry above it. This makes it the starting point for range queries:
+/// the entries overlapping [\a addr, x] are the ones from the returned index up to, but not
+/// including, the first one whose base is above x.
+///
+/// In checked builds, a bugcheck will occur if \a table is NULL.
+///
+/// \retval size_t					the index of the entry.
+/// \retval REGION_TABLE_NOT_FOUND	every entry is below \a addr.
+size_t PmmRegionTable_find( const PmmRegionTable* table, phys_addr_t addr );
+
+
+/// \brief	Looks up the type of memory at the given address.
+///
+/// \param table	the PmmRegionTable.
+/// \param addr		the physical address to look up.
+///
+/// This runs in O(log n) time.
+///
+/// \return the type of the entry containing \a addr, or PMMREGION_NONE if \a addr falls in a hole
+///			in the memory map.
+PmmRegionType PmmRegionTable_lookup( const PmmRegionTable* table, phys_addr_t addr );
+
+
+/// \brief	Creates a new PmmRegionTableList that enumerates the entries of the given types.
+///
+/// \param table	the PmmRegionTable to enumerate. It must outlive the list.
+/// \param typeMask	a combination of PmmRegionType flags selecting the entries to enumerate.
+///
+/// The regions are enumerated in ascending order of address, and never overlap each other.
+///
+/// \return a new PmmRegionTableList instance.
+PmmRegionTableList PmmRegionTableList_create( const PmmRegionTable* table, uint8_t typeMask );
+
+
+/// \brief	Gets a reference to the IPmmRegionList implementation of the given
+///			PmmRegionTableList.
+///
+/// \param list the PmmRegionTableList instance.
+///
+/// \return the IPmmRegionList interface that \a list implements.
+IPmmRegionList PmmRegionTableList_getAsPmmRegionList( PmmRegionTableList* list );
+
+
+#endif
@@ -0,0 +1,196 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/Architecture/hosted/HAL/LockImpl_hosted.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/Apr/30
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	This file implements the Lock, QueueLock, and RWLock classes for the
+///			hosted (userspace) configuration.
+///
+/// There are no interrupts to disable in a userspace process, so a Lock is a
+/// test-and-test-and-set spinlock, a QueueLock is a plain MCS lock, and an
+/// RWLock is a reader count with a writer bit, like the x86_smp version. A
+/// spinning thread yields the host CPU so that benchmarks with more threads
+/// than host CPUs still make progress.
+///
+// ===========================================================================
+
+
+#include <sched.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define _KERNEL_HAL_LOCK_C_
+#include "Kernel/HAL/Lock.h"
+#undef _KERNEL_HAL_LOCK_C_
+
+#define _KERNEL_HAL_QUEUELOCK_C_
+#include "Kernel/HAL/QueueLock.h"
+#undef _KERNEL_HAL_QUEUELOCK_C_
+
+#define _KERNEL_HAL_RWLOCK_C_
+#include "Kernel/HAL/RWLock.h"
+#undef _KERNEL_HAL_RWLOCK_C_
+
+
+// Private constants
+
+/// \brief	Set in the RWLock state while a writer holds the lock or waits for readers to leave.
+///
+/// This is the top bit of a uintptr_t, which is too big for an enum on 64-bit hosts.
+static const uintptr_t RWLOCK_WRITER = ((uintptr_t) 1) << ((sizeof( uintptr_t ) * 8) - 1);
+
+
+
+// Public functions.
+
+Lock Lock_create( void )
+{
+	Lock newLock;
+	newLock.m_isHeld = 0;
+	return newLock;
+}
+
+
+void Lock_acquire( volatile Lock* lock )
+{
+	while (__atomic_exchange_n( &(lock->m_isHeld), 1, __ATOMIC_ACQUIRE ) != 0)
+	{
+		while (__atomic_load_n( &(lock->m_isHeld), __ATOMIC_RELAXED ) != 0)
+		{
+			sched_yield();
+		}
+	}
+}
+
+
+void Lock_release( volatile Lock* lock )
+{
+	__atomic_store_n( &(lock->m_isHeld), 0, __ATOMIC_RELEASE );
+}
+
+
+QueueLock QueueLock_create( void )
+{
+	QueueLock newLock;
+	newLock.m_tail = NULL;
+	return newLock;
+}
+
+
+void QueueLock_acquire( volatile QueueLock* lock, volatile QueueLockNode* node )
+{
+	node->m_next		= NULL;
+	node->m_isWaiting	= 1;
+
+	// The release half makes our node's fields visible to whoever links in behind us; the
+	// acquire half pairs with the previous holder's release of the lock.
+	QueueLockNode* prev = __atomic_exchange_n(
+		&(lock->m_tail),
+		(QueueLockNode*) node,
+		__ATOMIC_ACQ_REL
+	);
+
+	if (prev != NULL)
+	{
+		__atomic_store_n( &(prev->m_next), (QueueLockNode*) node, __ATOMIC_RELEASE );
+		while (__atomic_load_n( &(node->m_isWaiting), __ATOMIC_ACQUIRE ) != 0)
+		{
+			sched_yield();
+		}
+	}
+}
+
+
+void QueueLock_release( volatile QueueLock* lock, volatile QueueLockNode* node )
+{
+	QueueLockNode* next = __atomic_load_n( &(node->m_next), __ATOMIC_ACQUIRE );
+	if (next == NULL)
+	{
+		// If we're still the tail, nobody is waiting.
+		QueueLockNode* expected = (QueueLockNode*) node;
+		if (__atomic_compare_exchange_n(
+				&(lock->m_tail),
+				&expected,
+				NULL,
+				false,
+				__ATOMIC_RELEASE,
+				__ATOMIC_RELAXED
+			))
+		{
+			return;
+		}
+
+		// Someone has become the tail, but hasn't linked in behind us yet.
+		while ((next = __atomic_load_n( &(node->m_next), __ATOMIC_ACQUIRE )) == NULL)
+		{
+			sched_yield();
+		}
+	}
+	__atomic_store_n( &(next->m_isWaiting), 0, __ATOMIC_RELEASE );
+}
+
+
+RWLock RWLock_create( void )
+{
+	RWLock newLock;
+	newLock.m_state			= 0;
+	newLock.m_writerLock	= Lock_create();
+	return newLock;
+}
+
+
+void RWLock_acquireRead( volatile RWLock* lock, RWLockReader* reader )
+{
+	(void) reader;
+
+	while ((__atomic_fetch_add( &(lock->m_state), 1, __ATOMIC_ACQUIRE ) & RWLOCK_WRITER) != 0)
+	{
+		// There's a writer, so back out and wait for it to finish.
+		__atomic_fetch_sub( &(lock->m_state), 1, __ATOMIC_RELAXED );
+		while ((__atomic_load_n( &(lock->m_state), __ATOMIC_RELAXED ) & RWLOCK_WRITER) != 0)
+		{
+			sched_yield();
+		}
+	}
+}
+
+
+void RWLock_releaseRead( volatile RWLock* lock, RWLockReader* reader )
+{
+	(void) reader;
+	__atomic_fetch_sub( &(lock->m_state), 1, __ATOMIC_RELEASE );
+}
+
+
+void RWLock_acquireWrite( volatile RWLock* lock )
+{
+	Lock_acquire( &(lock->m_writerLock) );
+
+	// Keep new readers out, then wait for the ones already in to leave.
+	__atomic_fetch_or( &(lock->m_state), RWLOCK_WRITER, __ATOMIC_RELAXED );
+	while ((__atomic_load_n( &(lock->m_state), __ATOMIC_ACQUIRE ) & ~RWLOCK_WRITER) != 0)
+	{
+		sched_yield();
+	}
+}
+
+
+void RWLock_releaseWrite( volatile RWLock* lock )
+{
+	__atomic_fetch_and( &(lock->m_state), ~RWLOCK_WRITER, __ATOMIC_RELEASE );
+	Lock_release( &(lock->m_writerLock) );
+}
+
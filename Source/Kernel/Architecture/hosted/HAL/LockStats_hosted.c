@@ -0,0 +1,268 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/Architecture/hosted/HAL/LockStats_hosted.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/10
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	This file implements the instrumented locks for the hosted
+///			(userspace) configuration.
+///
+/// This is the same as the x86 version, except that times come from the
+/// host's monotonic clock, in nanoseconds, rather than from the TSC. It lets
+/// the hosted lock stress test check that the statistics actually move.
+///
+// ===========================================================================
+
+
+#include <time.h>
+
+#define _KERNEL_HAL_LOCK_C_
+#define _KERNEL_HAL_QUEUELOCK_C_
+#define _KERNEL_HAL_RWLOCK_C_
+#include "Kernel/HAL/Lock.h"
+#include "Kernel/HAL/QueueLock.h"
+#include "Kernel/HAL/RWLock.h"
+#undef _KERNEL_HAL_RWLOCK_C_
+#undef _KERNEL_HAL_QUEUELOCK_C_
+#undef _KERNEL_HAL_LOCK_C_
+
+#include "Kernel/HAL/Atomic.h"
+#include "Kernel/HAL/LockStats.h"
+#include "Kernel/KCommon/KDebug.h"
+
+
+// Private variables
+
+/// \brief	The most recently registered LockSite, or zero if there are none.
+static volatile uintptr_t s_firstSite = 0;
+
+
+
+#ifdef LOCK_STATS ////////////////////////////////////////////////////////////
+
+// Private functions
+
+/// \brief	Reads the host's monotonic clock.
+///
+/// \return the time in nanoseconds, or zero if the clock can't be read.
+static uint64_t LockStats_readTimestamp( void )
+{
+	struct timespec now;
+	if (clock_gettime( CLOCK_MONOTONIC, &now ) != 0)
+	{
+		return 0;
+	}
+	return (((uint64_t) now.tv_sec) * 1000000000) + (uint64_t) now.tv_nsec;
+}
+
+
+/// \brief	Adds the given site to the list of all sites, if it isn't already there.
+///
+/// \param site	the site to add.
+static void LockStats_register( LockSite* site )
+{
+	if (Atomic_bitTestAndSetExplicit( &(site->m_isRegistered), 0, ATOMIC_RELAXED ))
+	{
+		return;
+	}
+
+	// Sites are never removed, so a simple compare-and-swap push can't suffer from ABA.
+	uintptr_t first;
+	do
+	{
+		first = Atomic_readExplicit( &s_firstSite, ATOMIC_RELAXED );
+		site->m_next = (LockSite*) first;
+	} while (!Atomic_compareAndSwapExplicit(
+		&s_firstSite,
+		first,
+		(uintptr_t) site,
+		ATOMIC_RELEASE
+	));
+}
+
+
+/// \brief	Adds a measurement to a total, and raises a maximum to it if necessary.
+///
+/// \param total	the running total to add \a cycles to.
+/// \param max		the largest measurement so far.
+/// \param cycles	the new measurement.
+///
+/// The same site can acquire different locks on different threads at once, so both updates
+/// are atomic.
+static void LockStats_addCycles( uint64_t* total, uint64_t* max, uint64_t cycles )
+{
+	uint64_t oldValue;
+	uint64_t newValue;
+	do
+	{
+		oldValue = *total;
+		newValue = oldValue + cycles;
+	} while (!Atomic_compareAndSwap64Explicit( total, oldValue, newValue, ATOMIC_RELAXED ));
+
+	do
+	{
+		oldValue = *max;
+		if (cycles <= oldValue)
+		{
+			break;
+		}
+	} while (!Atomic_compareAndSwap64Explicit( max, oldValue, cycles, ATOMIC_RELAXED ));
+}
+
+
+/// \brief	Records that a lock has just been acquired at the given site.
+///
+/// \param site		the site that acquired the lock.
+/// \param start	the timestamp from just before the lock was requested.
+///
+/// \return the timestamp of the acquire, for the lock to remember until it is released.
+static uint64_t LockStats_recordAcquire( LockSite* site, uint64_t start )
+{
+	uint64_t acquired = LockStats_readTimestamp();
+
+	Atomic_fetchAddExplicit( &(site->m_acquireCount), 1, ATOMIC_RELAXED );
+	if (acquired != 0)
+	{
+		LockStats_addCycles(
+			&(site->m_totalSpinCycles),
+			&(site->m_maxSpinCycles),
+			acquired - start
+		);
+	}
+	return acquired;
+}
+
+
+/// \brief	Records how long a lock was held, after it has been released.
+///
+/// \param site		the site that acquired the lock, or NULL if it was acquired without the macro.
+/// \param acquired	the timestamp of the acquire.
+/// \param released	the timestamp of the release.
+///
+/// This is done outside the critical section, so it isn't counted in the hold time.
+static void LockStats_recordRelease( LockSite* site, uint64_t acquired, uint64_t released )
+{
+	if ((site != NULL) && (acquired != 0))
+	{
+		LockStats_addCycles(
+			&(site->m_totalHoldCycles),
+			&(site->m_maxHoldCycles),
+			released - acquired
+		);
+	}
+}
+
+
+
+// Public functions (instrumented builds only)
+
+void LockStats_acquire( volatile Lock* lock, LockSite* site )
+{
+	LockStats_register( site );
+
+	uint64_t start = LockStats_readTimestamp();
+	Lock_acquire( lock );
+
+	// Now that we hold the lock, nobody else will touch these until we release it.
+	lock->m_stats.m_site		= site;
+	lock->m_stats.m_acquireTime	= LockStats_recordAcquire( site, start );
+}
+
+
+void LockStats_release( volatile Lock* lock )
+{
+	// Grab what we need before releasing, since the next holder will overwrite it.
+	LockSite* site		= lock->m_stats.m_site;
+	uint64_t acquired	= lock->m_stats.m_acquireTime;
+	uint64_t released	= LockStats_readTimestamp();
+
+	lock->m_stats.m_site = NULL;
+	Lock_release( lock );
+	LockStats_recordRelease( site, acquired, released );
+}
+
+
+void LockStats_acquireQueue(
+	volatile QueueLock*		lock,
+	volatile QueueLockNode*	node,
+	LockSite*				site
+)
+{
+	LockStats_register( site );
+
+	uint64_t start = LockStats_readTimestamp();
+	QueueLock_acquire( lock, node );
+
+	// Now that we hold the lock, nobody else will touch these until we release it.
+	lock->m_stats.m_site		= site;
+	lock->m_stats.m_acquireTime	= LockStats_recordAcquire( site, start );
+}
+
+
+void LockStats_releaseQueue( volatile QueueLock* lock, volatile QueueLockNode* node )
+{
+	// Grab what we need before releasing, since the next holder will overwrite it.
+	LockSite* site		= lock->m_stats.m_site;
+	uint64_t acquired	= lock->m_stats.m_acquireTime;
+	uint64_t released	= LockStats_readTimestamp();
+
+	lock->m_stats.m_site = NULL;
+	QueueLock_release( lock, node );
+	LockStats_recordRelease( site, acquired, released );
+}
+
+
+void LockStats_acquireWrite( volatile RWLock* lock, LockSite* site )
+{
+	LockStats_register( site );
+
+	uint64_t start = LockStats_readTimestamp();
+	RWLock_acquireWrite( lock );
+
+	// Now that we hold the lock, nobody else will touch these until we release it.
+	lock->m_stats.m_site		= site;
+	lock->m_stats.m_acquireTime	= LockStats_recordAcquire( site, start );
+}
+
+
+void LockStats_releaseWrite( volatile RWLock* lock )
+{
+	// Grab what we need before releasing, since the next holder will overwrite it.
+	LockSite* site		= lock->m_stats.m_site;
+	uint64_t acquired	= lock->m_stats.m_acquireTime;
+	uint64_t released	= LockStats_readTimestamp();
+
+	lock->m_stats.m_site = NULL;
+	RWLock_releaseWrite( lock );
+	LockStats_recordRelease( site, acquired, released );
+}
+
+
+#endif ///////////////////////////////////////////////////////////////////////
+
+
+
+// Public functions
+
+LockSite* LockStats_getFirstSite( void )
+{
+	return (LockSite*) Atomic_read( &s_firstSite );
+}
+
+
+LockSite* LockStats_getNextSite( const LockSite* site )
+{
+	KDebug_assertArg( site != NULL );
+	return site->m_next;
+}
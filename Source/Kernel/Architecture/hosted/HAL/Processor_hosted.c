@@ -0,0 +1,73 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/Architecture/hosted/HAL/Processor_hosted.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/Apr/30
+//
+// ===========================================================================
+///
+///	\file
+///
+/// \brief	Contains the parts of the Processor class needed by kernel code
+///			running in the hosted (userspace) configuration.
+///
+/// Each thread of the host process is treated as a processor. Only the
+/// methods that identify the current processor are implemented; there are no
+/// interrupts or privileged instructions to wrap.
+///
+// ===========================================================================
+
+
+#include <stddef.h>
+#include "Kernel/HAL/Processor.h"
+#include "Kernel/HAL/Atomic.h"
+
+
+/// \brief	Implementation of the Processor class.
+struct ProcessorStruct
+{
+	int m_id;	///< The ID of the processor; Equal to its index in s_processors.
+};
+
+
+
+/// \brief	One Processor per possible processor ID.
+static Processor s_processors[PROCESSOR_MAX_COUNT];
+
+/// \brief	The number of threads that have asked for their processor so far.
+static volatile uintptr_t s_numThreads = 0;
+
+/// \brief	The processor assigned to the current thread, or NULL if there isn't one yet.
+static __thread Processor* s_currentProcessor = NULL;
+
+
+
+// Public functions
+
+volatile Processor* Processor_getCurrent( void )
+{
+	if (s_currentProcessor == NULL)
+	{
+		// Hand out the processors round-robin. It's ok to have more threads than processors; the
+		// extra threads just share.
+		uintptr_t threadIndex = Atomic_fetchAdd( &s_numThreads, 1 );
+
+		int id = (int) (threadIndex % PROCESSOR_MAX_COUNT);
+		s_processors[id].m_id = id;
+		s_currentProcessor = &(s_processors[id]);
+	}
+	return s_currentProcessor;
+}
+
+
+int Processor_getID( const volatile Processor* processor )
+{
+	return processor->m_id;
+}
@@ -0,0 +1,38 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/Architecture/hosted/KCommon/KDebug_hosted.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/Apr/30
+//
+// ===========================================================================
+///
+///	\file
+///
+/// \brief	Contains the implementation of the KDebug class for the hosted
+///			(userspace) configuration.
+///
+/// Instead of trapping to the kernel debugger, a failed assertion reports
+/// where it happened and aborts the process, so that test harnesses and CI
+/// see a non-zero exit status (and a core dump, if enabled).
+///
+// ===========================================================================
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "Kernel/KCommon/KDebug.h"
+
+
+void KDebug_triggerDebugTrap( const char* msg, const char* file, int line )
+{
+	fprintf( stderr, "%s:%d: %s\n", file, line, msg );
+	fflush( stderr );
+	abort();
+}
@@ -0,0 +1,109 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/Architecture/hosted/KCommon/KMem_hosted.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/Apr/30
+//
+// ===========================================================================
+///
+///	\file
+///
+/// \brief	Contains the implementation of the KMem functions for the hosted
+///			(userspace) configuration.
+///
+/// The memory functions defer to the host's C library, and the bit scans to
+/// GCC's builtins.
+///
+// ===========================================================================
+
+
+#include <string.h>
+#include "Kernel/KCommon/KMem.h"
+#include "Kernel/MM/MM.h"
+
+
+void KMem_init( void )
+{
+	// The C library already picks the best implementations for the host.
+}
+
+
+// Casting away volatile is ok here, since the C library doesn't cache anything across calls.
+
+void KMem_copy( volatile void* dest, const volatile void* source, size_t numBytes )
+{
+	memcpy( (void*) dest, (const void*) source, numBytes );
+}
+
+
+void KMem_move( volatile void* dest, const volatile void* source, size_t numBytes )
+{
+	memmove( (void*) dest, (const void*) source, numBytes );
+}
+
+
+void KMem_set( volatile void* dest, char val, size_t numBytes )
+{
+	memset( (void*) dest, val, numBytes );
+}
+
+
+void KMem_clearPage( volatile void* page )
+{
+	memset( (void*) page, 0, PAGE_SIZE );
+}
+
+
+void KMem_copyPage( volatile void* dest, const volatile void* source )
+{
+	memcpy( (void*) dest, (const void*) source, PAGE_SIZE );
+}
+
+
+uint8_t KMem_low8( uint16_t val )
+{
+	return (uint8_t) (val & 0xFF);
+}
+
+
+uint8_t KMem_high8( uint16_t val )
+{
+	return (uint8_t) (val >> 8);
+}
+
+
+uint16_t KMem_low16( uint32_t val )
+{
+	return (uint16_t) (val & 0xFFFF);
+}
+
+
+uint16_t KMem_high16( uint32_t val )
+{
+	return (uint16_t) (val >> 16);
+}
+
+
+int KMem_findLowestSetBit( uintptr_t val )
+{
+	return (val == 0) ? -1 : __builtin_ctzl( val );
+}
+
+
+int KMem_findHighestSetBit( uintptr_t val )
+{
+	return (val == 0) ? -1 : (int) ((sizeof( unsigned long ) * 8) - 1) - __builtin_clzl( val );
+}
+
+
+int KMem_countSetBits( uintptr_t val )
+{
+	return __builtin_popcountl( val );
+}
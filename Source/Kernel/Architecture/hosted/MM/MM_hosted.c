@@ -0,0 +1,58 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/Architecture/hosted/MM/MM_hosted.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/Apr/30
+//
+// ===========================================================================
+///
+///	\file
+///
+/// \brief	Contains the hosted (userspace) implementation of the Memory
+///			Manager utilities declared in MM.h.
+///
+/// In the hosted configuration, physical frames are just numbers. There is
+/// no memory behind them, so there is nothing to clear. There is no real
+/// cache either, so the number of colours is whatever the tests ask for.
+///
+// ===========================================================================
+
+
+#include "Kernel/MM/MM.h"
+#include "Kernel/KCommon/KDebug.h"
+#include "MM/MMHosted.h"
+
+
+/// \brief	The number of cache colours that MM_getNumCacheColours() returns.
+static size_t s_numCacheColours = 1;
+
+
+
+// Public functions
+
+size_t MM_getNumCacheColours( void )
+{
+	return s_numCacheColours;
+}
+
+
+void MM_hosted_setNumCacheColours( size_t numColours )
+{
+	KDebug_assertArg( (numColours > 0) && (numColours <= MAX_CACHE_COLOURS) );
+	KDebug_assertArg( (numColours & (numColours - 1)) == 0 );
+	s_numCacheColours = numColours;
+}
+
+
+void MM_zeroFrame( phys_addr_t frameAddr )
+{
+	KDebug_assertArg( MM_isFrameAligned( frameAddr ) );
+	(void) frameAddr;	// Only used in checked builds.
+}
@@ -24,6 +24,7 @@
 ; ===========================================================================
 
 global StartPrecursor						; Make entry point visible to linker.
+global BootPageDirectory					; MM uses a spare entry as a scratch window.
 extern kmain								; Make the linker look for kmain() in C-land.
 extern Processor_initPrimary				; Need this to initialize the Processor.
 extern BootLoaderInfoTranslator_translate	; Need this to make the Multiboot info palatable
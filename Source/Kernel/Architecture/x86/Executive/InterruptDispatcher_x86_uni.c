@@ -27,6 +27,8 @@
 #include "Kernel/HAL/Processor.h"
 #include "Kernel/Architecture/x86/HAL/PrecursorVectors_x86.h"
 #include "Kernel/KCommon/KDebug.h"
+#include "Scheduler.h"
+#include "Timer.h"
 
 //***FIXME: For temporary debugging only.
 #include "Kernel/KRunTime/KOut.h"
@@ -66,7 +68,32 @@ static TrapFrame* InterruptDispatcher_handleTimerInterrupt(
 	// disabled.
 	InterruptController* pic = (InterruptController*) InterruptController_getForCurrentProcessor();
 	InterruptController_endOfInterrupt( pic, irq );
-	return NULL;	//***FIXME: Implement timers and scheduler.
+
+	// The EOI has to go out first, since the Scheduler may not come back to this thread for a
+	// while. The expired timers go before the Scheduler, since one of them may end the running
+	// thread's time slice.
+	Timer_handleInterrupt();
+	return Scheduler_handleTimerInterrupt( trapFrame );
+}
+
+
+/// \brief	Interrupt handler that handles spurious interrupts from the local APIC.
+///
+/// \param this			the InterruptDispatcher that is handling the interrupt.
+/// \param trapFrame	the machine state captured when the interrupt occurred.
+///
+/// The local APIC raises these when an interrupt goes away before it can be delivered. They must
+/// not be acknowledged, since nothing is in service.
+///
+/// \retval NULL	the current thread always continues to run.
+static TrapFrame* InterruptDispatcher_handleSpuriousInterrupt(
+	volatile InterruptDispatcher*	this,
+	TrapFrame*						trapFrame
+)
+{
+	(void) this;
+	(void) trapFrame;
+	return NULL;
 }
 
 
@@ -120,6 +147,14 @@ static IInterruptHandler_itable s_deliverableHandlerTable =
 
 
 
+/// \brief	The IInterruptHandler interface dispatch table for handling spurious interrupts.
+static IInterruptHandler_itable s_spuriousHandlerTable =
+{
+	(IInterruptHandler_handleInterruptFunc) InterruptDispatcher_handleSpuriousInterrupt
+};
+
+
+
 /// \brief	The one-and-only instance of InterruptDispatcher. Only one is needed for UP systems.
 static volatile InterruptDispatcher s_instance;
 
@@ -135,6 +170,10 @@ void InterruptDispatcher_initForCurrentProcessor( void )
 	timerHandler.iptr	= &s_timerHandlerTable;
 	timerHandler.obj	= &s_instance;
 
+	IInterruptHandler spuriousHandler;
+	spuriousHandler.iptr	= &s_spuriousHandlerTable;
+	spuriousHandler.obj		= &s_instance;
+
 	static const uint32_t deliverableVectors[] =
 	{
 		INT_HW_IRQ1,
@@ -165,11 +204,18 @@ void InterruptDispatcher_initForCurrentProcessor( void )
 		Processor_registerHandler( processor, deliverableHandler, deliverableVectors[i] );
 	}
 
-	// REVISIT: In x86 UP systems, use the PIT for scheduling and timing.
+	// The SystemTimer interrupts on one of these, depending on whether it uses the PIT or the
+	// local APIC timer. The local APIC ignores the IRQ number that the EOI is sent with, so the
+	// handler doesn't need to tell them apart.
 	Processor_registerHandler( processor, timerHandler, INT_HW_IRQ0 );
+	Processor_registerHandler( processor, timerHandler, INT_APIC_TIMER );
+	Processor_registerHandler( processor, spuriousHandler, INT_APIC_SPURIOUS );
 
 	// Make sure the interrupts are sent our way.
 	InterruptController_initForCurrentProcessor();
+
+	// Start the clock and the one-shot timer interrupts that drive the Timers and the Scheduler.
+	Timer_initForCurrentProcessor();
 }
 
 
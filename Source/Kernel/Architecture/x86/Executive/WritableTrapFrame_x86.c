@@ -160,6 +160,14 @@ static void WritableTrapFrame_writeInterruptVectorNumberTo(
 		KOut_writeTo( writer, "System Call Vector" );
 		break;
 
+	case INT_APIC_TIMER:
+		KOut_writeTo( writer, "Local APIC Timer" );
+		break;
+
+	case INT_APIC_SPURIOUS:
+		KOut_writeTo( writer, "Local APIC Spurious Interrupt" );
+		break;
+
 	default:
 		KOut_writeTo( writer, "Unrecognized Interrupt Vector" );
 	}
@@ -0,0 +1,89 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/Architecture/x86/HAL/ApicConfig.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/16
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	This file defines the ApicConfig class, which describes the APICs
+///			of an x86 system as reported by its firmware.
+///
+/// The ACPI MADT is tried first, since newer systems may not have MP tables
+/// at all, and then the Intel MultiProcessor Specification tables. Only what
+/// the HAL uses is kept: The address of the local APICs, the local APIC IDs
+/// of the processors, and how the 16 ISA IRQs are wired to the I/O APIC that
+/// serves them. Any other I/O APICs, and the PCI interrupts they carry, are
+/// ignored for now.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_ARCHITECTURE_X86_HAL_APICCONFIG_H_
+#define _KERNEL_ARCHITECTURE_X86_HAL_APICCONFIG_H_
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "Kernel/HAL/Processor.h"
+
+
+/// \brief	Defines public constants for the ApicConfig class.
+enum ApicConfig_consts
+{
+	APIC_NUM_ISA_IRQS		= 16,	///< Number of ISA IRQs.
+	APIC_NO_PIN				= 0xFF,	///< I/O APIC pin of an ISA IRQ that isn't wired to it.
+	APIC_IRQ_ACTIVE_LOW		= 0x01,	///< The IRQ is active when its line is low.
+	APIC_IRQ_LEVEL			= 0x02	///< The IRQ is level-triggered rather than edge-triggered.
+};
+
+
+/// \brief	Describes the APICs of the system.
+typedef struct
+{
+	/// \brief	Physical address of the registers of every processor's local APIC.
+	uint32_t	m_localApicPhysAddr;
+
+	/// \brief	Physical address of the registers of the I/O APIC that the ISA IRQs go to.
+	uint32_t	m_ioApicPhysAddr;
+
+	/// \brief	The I/O APIC pin that each ISA IRQ is wired to, or APIC_NO_PIN.
+	uint8_t		m_isaIrqPins[APIC_NUM_ISA_IRQS];
+
+	/// \brief	The APIC_IRQ_* flags of each ISA IRQ.
+	uint8_t		m_isaIrqFlags[APIC_NUM_ISA_IRQS];
+
+	/// \brief	The local APIC ID of each usable processor, in the order the firmware lists them.
+	uint8_t		m_localApicIds[PROCESSOR_MAX_COUNT];
+
+	/// \brief	The number of entries in m_localApicIds.
+	int			m_numProcessors;
+
+	/// \brief	Whether the system boots in PIC mode, with an IMCR that has to be switched over
+	///			before interrupts reach the APICs.
+	bool		m_hasImcr;
+
+} ApicConfig;
+
+
+/// \brief	Reads the firmware tables that describe the system's APICs.
+///
+/// \param config	receives the description of the APICs.
+///
+/// This method maps the tables through DeviceWindow, so it must only be called during
+/// initialization of the bootstrap processor, with interrupts disabled.
+///
+/// \retval true	\a config describes the system's APICs.
+/// \retval false	neither ACPI nor the MP tables describe an I/O APIC that the ISA IRQs go to.
+bool ApicConfig_discover( ApicConfig* config );
+
+
+#endif
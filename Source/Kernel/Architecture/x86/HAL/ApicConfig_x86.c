@@ -0,0 +1,747 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/Architecture/x86/HAL/ApicConfig_x86.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/16
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	This file implements the ApicConfig class, which reads the ACPI MADT
+///			or the MP tables to find the APICs of an x86 system.
+///
+/// Both sets of tables start with a structure that the firmware leaves in the
+/// first megabyte of physical memory, which the kernel's own 4MB page already
+/// maps. Everything else can be anywhere, so it is read through DeviceWindow.
+///
+// ===========================================================================
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ApicConfig.h"
+#include "DeviceWindow.h"
+#include "Kernel/HAL/Mem.h"
+#include "Kernel/KCommon/KDebug.h"
+#include "Kernel/KCommon/KMem.h"
+
+
+#ifdef __GNUC__ //////////////////////////////////////////////////////////////
+
+	#define PACKED __attribute__((packed))
+
+#else ////////////////////////////////////////////////////////////////////////
+
+	#error Currently only GCC is supported for building the kernel!
+
+#endif ///////////////////////////////////////////////////////////////////////
+
+
+// Private constants
+
+/// \brief	Defines private constants for the ApicConfig class.
+enum ApicConfig_privateConsts
+{
+	BDA_EBDA_SEGMENT		= 0x040E,	///< Where the BIOS keeps the real-mode segment of the EBDA.
+	EBDA_SCAN_LENGTH		= 1024,		///< Bytes of the EBDA to search.
+	BASE_MEMORY_LAST_KB		= 0x9FC00,	///< Last KB of base memory, if there is no EBDA.
+	BIOS_ROM_BASE			= 0xE0000,	///< Start of the BIOS ROM area to search.
+	BIOS_ROM_LENGTH			= 0x20000,	///< Length of the BIOS ROM area to search.
+	SCAN_ALIGNMENT			= 16,		///< Both structures are on 16-byte boundaries.
+
+	ACPI_RSDP_CHECKSUM_LENGTH	= 20,			///< Bytes covered by the ACPI 1.0 RSDP checksum.
+	MADT_LOCAL_APIC				= 0,			///< MADT entry type: Processor local APIC.
+	MADT_IO_APIC				= 1,			///< MADT entry type: I/O APIC.
+	MADT_INTERRUPT_OVERRIDE		= 2,			///< MADT entry type: Interrupt source override.
+	MADT_LOCAL_APIC_ADDRESS		= 5,			///< MADT entry type: Local APIC address override.
+	MADT_LOCAL_APIC_ENABLED		= 0x00000001,	///< The processor can be used.
+	MADT_BUS_ISA				= 0,			///< The only bus an override can apply to.
+
+	MP_DEFAULT_LOCAL_APIC	= 0xFEE00000,	///< Local APIC address in the default configurations.
+	MP_DEFAULT_IO_APIC		= 0xFEC00000,	///< I/O APIC address in the default configurations.
+	MP_DEFAULT_NUM_CPUS		= 2,			///< Processors in the default configurations.
+	MP_FEATURE2_IMCRP		= 0x80,			///< The system has an IMCR, and boots in PIC mode.
+	MP_ENTRY_PROCESSOR		= 0,			///< MP entry type: Processor. 20 bytes long.
+	MP_ENTRY_BUS			= 1,			///< MP entry type: Bus. 8 bytes long.
+	MP_ENTRY_IO_APIC		= 2,			///< MP entry type: I/O APIC. 8 bytes long.
+	MP_ENTRY_IO_INTERRUPT	= 3,			///< MP entry type: I/O interrupt. 8 bytes long.
+	MP_PROCESSOR_LENGTH		= 20,			///< Length of a processor entry.
+	MP_OTHER_LENGTH			= 8,			///< Length of every other kind of entry.
+	MP_PROCESSOR_ENABLED	= 0x01,			///< The processor can be used.
+	MP_IO_APIC_ENABLED		= 0x01,			///< The I/O APIC can be used.
+	MP_INTERRUPT_INT		= 0,			///< An ordinary interrupt, not NMI, SMI or ExtINT.
+	MP_ALL_IO_APICS			= 0xFF,			///< Destination ID meaning every I/O APIC.
+	MP_MAX_BUSES			= 256,			///< Bus IDs are 8 bits.
+
+	// Both sets of tables encode polarity and trigger mode the same way.
+	INT_POLARITY_MASK		= 0x0003,	///< Bits of the flags that give the polarity.
+	INT_POLARITY_LOW		= 0x0003,	///< Active low. Zero means the bus's default.
+	INT_TRIGGER_MASK		= 0x000C,	///< Bits of the flags that give the trigger mode.
+	INT_TRIGGER_LEVEL		= 0x000C	///< Level-triggered. Zero means the bus's default.
+};
+
+
+
+// Private types
+
+/// \brief	The ACPI Root System Description Pointer, as of ACPI 1.0.
+typedef struct
+{
+	char		Signature[8];	///< "RSD PTR ".
+	uint8_t		Checksum;		///< Makes the first 20 bytes sum to zero.
+	char		OemId[6];		///< Identifies the firmware vendor.
+	uint8_t		Revision;		///< 0 for ACPI 1.0, 2 for later versions.
+	uint32_t	RsdtAddress;	///< Physical address of the RSDT.
+} PACKED AcpiRsdp;
+
+
+/// \brief	The header that every ACPI table starts with.
+typedef struct
+{
+	char		Signature[4];		///< Identifies the table.
+	uint32_t	Length;				///< Length of the table, including this header.
+	uint8_t		Revision;			///< Version of the table's layout.
+	uint8_t		Checksum;			///< Makes the whole table sum to zero.
+	char		OemId[6];			///< Identifies the firmware vendor.
+	char		OemTableId[8];		///< Identifies the table, to the vendor.
+	uint32_t	OemRevision;		///< The vendor's version of the table.
+	uint32_t	CreatorId;			///< Identifies the tool that built the table.
+	uint32_t	CreatorRevision;	///< Version of the tool that built the table.
+} PACKED AcpiHeader;
+
+
+/// \brief	The ACPI Multiple APIC Description Table, up to the start of its entries.
+typedef struct
+{
+	AcpiHeader	Header;				///< Signature is "APIC".
+	uint32_t	LocalApicAddress;	///< Physical address of the local APICs.
+	uint32_t	Flags;				///< Bit 0 is set if there are also 8259As.
+} PACKED AcpiMadt;
+
+
+/// \brief	An entry of the MADT. Only the fields that are used are included.
+typedef struct
+{
+	uint8_t	Type;	///< One of the MADT_* entry types.
+	uint8_t	Length;	///< Length of the entry, including this field.
+
+	union
+	{
+		/// \brief	MADT_LOCAL_APIC.
+		struct
+		{
+			uint8_t		AcpiProcessorId;	///< The processor's ID in the ACPI namespace.
+			uint8_t		ApicId;				///< The processor's local APIC ID.
+			uint32_t	Flags;				///< MADT_LOCAL_APIC_* bits.
+		} PACKED LocalApic;
+
+		/// \brief	MADT_IO_APIC.
+		struct
+		{
+			uint8_t		IoApicId;	///< The I/O APIC's ID.
+			uint8_t		Reserved;	///< Must be zero.
+			uint32_t	Address;	///< Physical address of the I/O APIC's registers.
+			uint32_t	GsiBase;	///< Global system interrupt number of its first pin.
+		} PACKED IoApic;
+
+		/// \brief	MADT_INTERRUPT_OVERRIDE.
+		struct
+		{
+			uint8_t		Bus;	///< Always MADT_BUS_ISA.
+			uint8_t		Source;	///< The ISA IRQ.
+			uint32_t	Gsi;	///< The global system interrupt it is wired to.
+			uint16_t	Flags;	///< Polarity and trigger mode.
+		} PACKED Override;
+
+		/// \brief	MADT_LOCAL_APIC_ADDRESS.
+		struct
+		{
+			uint16_t	Reserved;		///< Must be zero.
+			uint32_t	AddressLow;		///< Low half of the 64-bit local APIC address.
+			uint32_t	AddressHigh;	///< High half of the 64-bit local APIC address.
+		} PACKED LocalApicAddress;
+	} PACKED u;
+} PACKED AcpiMadtEntry;
+
+
+/// \brief	The MP floating pointer structure.
+typedef struct
+{
+	char		Signature[4];		///< "_MP_".
+	uint32_t	ConfigTableAddress;	///< Physical address of the configuration table, if any.
+	uint8_t		Length;				///< Length of this structure in 16-byte units. Always 1.
+	uint8_t		SpecRevision;		///< Version of the MP specification.
+	uint8_t		Checksum;			///< Makes this structure sum to zero.
+	uint8_t		Features[5];		///< Non-zero Features[0] means a default configuration.
+} PACKED MpFloatingPointer;
+
+
+/// \brief	The header of the MP configuration table.
+typedef struct
+{
+	char		Signature[4];		///< "PCMP".
+	uint16_t	BaseTableLength;	///< Length of the header and the base table's entries.
+	uint8_t		SpecRevision;		///< Version of the MP specification.
+	uint8_t		Checksum;			///< Makes the header and base table sum to zero.
+	char		OemId[8];			///< Identifies the system vendor.
+	char		ProductId[12];		///< Identifies the system.
+	uint32_t	OemTableAddress;	///< Physical address of the vendor's own table, if any.
+	uint16_t	OemTableSize;		///< Length of the vendor's table.
+	uint16_t	EntryCount;			///< Number of entries in the base table.
+	uint32_t	LocalApicAddress;	///< Physical address of the local APICs.
+	uint16_t	ExtTableLength;		///< Length of the extended entries after the base table.
+	uint8_t		ExtTableChecksum;	///< Makes the extended entries sum to zero.
+	uint8_t		Reserved;			///< Must be zero.
+} PACKED MpConfigHeader;
+
+
+/// \brief	An entry of the MP configuration table. Only the fields that are used are included.
+typedef struct
+{
+	uint8_t	Type;	///< One of the MP_ENTRY_* types.
+
+	union
+	{
+		/// \brief	MP_ENTRY_PROCESSOR.
+		struct
+		{
+			uint8_t	LocalApicId;		///< The processor's local APIC ID.
+			uint8_t	LocalApicVersion;	///< Version of the processor's local APIC.
+			uint8_t	CpuFlags;			///< MP_PROCESSOR_* bits.
+		} PACKED Processor;
+
+		/// \brief	MP_ENTRY_BUS.
+		struct
+		{
+			uint8_t	BusId;		///< The ID that interrupt entries use for the bus.
+			char	BusType[6];	///< The kind of bus, padded with spaces.
+		} PACKED Bus;
+
+		/// \brief	MP_ENTRY_IO_APIC.
+		struct
+		{
+			uint8_t		IoApicId;	///< The I/O APIC's ID.
+			uint8_t		Version;	///< Version of the I/O APIC.
+			uint8_t		Flags;		///< MP_IO_APIC_* bits.
+			uint32_t	Address;	///< Physical address of the I/O APIC's registers.
+		} PACKED IoApic;
+
+		/// \brief	MP_ENTRY_IO_INTERRUPT.
+		struct
+		{
+			uint8_t		InterruptType;	///< MP_INTERRUPT_INT for an ordinary interrupt.
+			uint16_t	Flags;			///< Polarity and trigger mode.
+			uint8_t		SourceBusId;	///< The bus the interrupt comes from.
+			uint8_t		SourceBusIrq;	///< The interrupt's number on that bus.
+			uint8_t		DestIoApicId;	///< The I/O APIC it is wired to.
+			uint8_t		DestIoApicPin;	///< The pin of that I/O APIC.
+		} PACKED IoInterrupt;
+	} PACKED u;
+} PACKED MpEntry;
+
+
+
+// Private functions
+
+/// \brief	Indicates whether the given bytes start with the given signature.
+static bool ApicConfig_hasSignature( const void* bytes, const char* signature, size_t length )
+{
+	const char* chars = (const char*) bytes;
+	for (size_t i = 0; i < length; i++)
+	{
+		if (chars[i] != signature[i])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+/// \brief	Indicates whether the given bytes add up to zero, as every table's checksum requires.
+static bool ApicConfig_isChecksumValid( const void* bytes, size_t length )
+{
+	const uint8_t* b = (const uint8_t*) bytes;
+	uint8_t sum = 0;
+	for (size_t i = 0; i < length; i++)
+	{
+		sum = (uint8_t) (sum + b[i]);
+	}
+	return (sum == 0);
+}
+
+
+/// \brief	Searches a range of the first megabyte for a structure with the given signature and
+///			a valid checksum.
+///
+/// \param physAddr			physical address of the range to search.
+/// \param length			length of the range to search, in bytes.
+/// \param signature		the signature the structure starts with.
+/// \param signatureLength	the length of \a signature.
+/// \param checksumLength	the number of bytes the structure's checksum covers.
+///
+/// \return a pointer to the structure, or NULL if it isn't in the range.
+static const void* ApicConfig_scan(
+	uint32_t	physAddr,
+	uint32_t	length,
+	const char*	signature,
+	size_t		signatureLength,
+	size_t		checksumLength
+)
+{
+	KDebug_assert( physAddr + length <= BIOS_ROM_BASE + BIOS_ROM_LENGTH );
+
+	const uint8_t* start = (const uint8_t*) (KERNEL_VIRTUAL_BASE + physAddr);
+	for (uint32_t offset = 0; offset + checksumLength <= length; offset += SCAN_ALIGNMENT)
+	{
+		if (ApicConfig_hasSignature( start + offset, signature, signatureLength ) &&
+			ApicConfig_isChecksumValid( start + offset, checksumLength ))
+		{
+			return start + offset;
+		}
+	}
+	return NULL;
+}
+
+
+/// \brief	Searches the places the firmware may leave a structure in the first megabyte.
+///
+/// The first KB of the EBDA is searched first, or the last KB of base memory if there is no EBDA,
+/// and then the BIOS ROM.
+///
+/// \return a pointer to the structure, or NULL if it can't be found.
+static const void* ApicConfig_scanFirmware(
+	const char*	signature,
+	size_t		signatureLength,
+	size_t		checksumLength
+)
+{
+	uint16_t ebdaSegment = *((const uint16_t*) (KERNEL_VIRTUAL_BASE + BDA_EBDA_SEGMENT));
+	uint32_t ebdaPhysAddr = (uint32_t) ebdaSegment << 4;
+
+	if ((ebdaPhysAddr == 0) || (ebdaPhysAddr + EBDA_SCAN_LENGTH > BIOS_ROM_BASE))
+	{
+		ebdaPhysAddr = BASE_MEMORY_LAST_KB;
+	}
+
+	const void* found = ApicConfig_scan(
+		ebdaPhysAddr,
+		EBDA_SCAN_LENGTH,
+		signature,
+		signatureLength,
+		checksumLength
+	);
+
+	if (found == NULL)
+	{
+		found = ApicConfig_scan(
+			BIOS_ROM_BASE,
+			BIOS_ROM_LENGTH,
+			signature,
+			signatureLength,
+			checksumLength
+		);
+	}
+	return found;
+}
+
+
+/// \brief	Converts the polarity and trigger flags of an ISA IRQ to APIC_IRQ_* flags.
+///
+/// ISA IRQs are active-high and edge-triggered unless the firmware says otherwise.
+static uint8_t ApicConfig_translateIsaFlags( uint16_t flags )
+{
+	uint8_t result = 0;
+	if ((flags & INT_POLARITY_MASK) == INT_POLARITY_LOW)
+	{
+		result |= APIC_IRQ_ACTIVE_LOW;
+	}
+	if ((flags & INT_TRIGGER_MASK) == INT_TRIGGER_LEVEL)
+	{
+		result |= APIC_IRQ_LEVEL;
+	}
+	return result;
+}
+
+
+/// \brief	Adds a processor to the configuration, unless it is already full.
+static void ApicConfig_addProcessor( ApicConfig* config, uint8_t localApicId )
+{
+	if (config->m_numProcessors < PROCESSOR_MAX_COUNT)
+	{
+		config->m_localApicIds[config->m_numProcessors] = localApicId;
+		config->m_numProcessors++;
+	}
+}
+
+
+/// \brief	Starts the configuration off with no processors, and with no ISA IRQs wired up.
+static void ApicConfig_clear( ApicConfig* config )
+{
+	KMem_set( config, 0, sizeof( ApicConfig ) );
+	KMem_set( config->m_isaIrqPins, APIC_NO_PIN, sizeof( config->m_isaIrqPins ) );
+}
+
+
+/// \brief	Unwires every ISA IRQ that hasn't been overridden but shares a pin with one that has.
+///
+/// Without overrides, ISA IRQ n is wired to pin n. An override moves an IRQ to a different pin,
+/// which is usually one that another IRQ was assumed to be wired to; IRQ0 moving to pin 2, where
+/// the unused cascade IRQ would otherwise be, is the common case.
+static void ApicConfig_resolveOverrides( ApicConfig* config, const bool* isOverridden )
+{
+	for (int irq = 0; irq < APIC_NUM_ISA_IRQS; irq++)
+	{
+		for (int other = 0; (other < APIC_NUM_ISA_IRQS) && !isOverridden[irq]; other++)
+		{
+			if (isOverridden[other] &&
+				(other != irq) &&
+				(config->m_isaIrqPins[other] == config->m_isaIrqPins[irq]))
+			{
+				config->m_isaIrqPins[irq] = APIC_NO_PIN;
+				break;
+			}
+		}
+	}
+}
+
+
+/// \brief	Finds the MADT through the ACPI RSDT.
+///
+/// \return the physical address of the MADT, or zero if there isn't one.
+static uint32_t ApicConfig_findMadt( void )
+{
+	const AcpiRsdp* rsdp = (const AcpiRsdp*) ApicConfig_scanFirmware(
+		"RSD PTR ",
+		sizeof( rsdp->Signature ),
+		ACPI_RSDP_CHECKSUM_LENGTH
+	);
+	if ((rsdp == NULL) || (rsdp->RsdtAddress == 0))
+	{
+		return 0;
+	}
+
+	// Each table has to be mapped in turn to look at it, which unmaps the RSDT, so the RSDT is
+	// mapped again for every entry. It only happens once per boot.
+	uint32_t rsdtPhysAddr = rsdp->RsdtAddress;
+	const AcpiHeader* rsdt =
+		(const AcpiHeader*) DeviceWindow_mapTable( rsdtPhysAddr, sizeof( AcpiHeader ) );
+	uint32_t rsdtLength = rsdt->Length;
+
+	if (!ApicConfig_hasSignature( rsdt->Signature, "RSDT", sizeof( rsdt->Signature ) ) ||
+		(rsdtLength < sizeof( AcpiHeader )) ||
+		(DeviceWindow_mapTable( rsdtPhysAddr, rsdtLength ) == NULL) ||
+		!ApicConfig_isChecksumValid( rsdt, rsdtLength ))
+	{
+		return 0;
+	}
+
+	size_t numEntries = (rsdtLength - sizeof( AcpiHeader )) / sizeof( uint32_t );
+	for (size_t i = 0; i < numEntries; i++)
+	{
+		rsdt = (const AcpiHeader*) DeviceWindow_mapTable( rsdtPhysAddr, rsdtLength );
+		const uint32_t* entries = (const uint32_t*) (rsdt + 1);
+		uint32_t tablePhysAddr = entries[i];
+
+		const AcpiHeader* table =
+			(const AcpiHeader*) DeviceWindow_mapTable( tablePhysAddr, sizeof( AcpiHeader ) );
+
+		if (ApicConfig_hasSignature( table->Signature, "APIC", sizeof( table->Signature ) ))
+		{
+			return tablePhysAddr;
+		}
+	}
+	return 0;
+}
+
+
+/// \brief	Fills in the configuration from the ACPI MADT.
+///
+/// \retval true	the MADT was found, and describes an I/O APIC for the ISA IRQs.
+/// \retval false	there is no usable MADT.
+static bool ApicConfig_readMadt( ApicConfig* config )
+{
+	uint32_t madtPhysAddr = ApicConfig_findMadt();
+	if (madtPhysAddr == 0)
+	{
+		return false;
+	}
+
+	const AcpiMadt* madt =
+		(const AcpiMadt*) DeviceWindow_mapTable( madtPhysAddr, sizeof( AcpiHeader ) );
+	uint32_t madtLength = madt->Header.Length;
+
+	if ((madtLength < sizeof( AcpiMadt )) ||
+		(DeviceWindow_mapTable( madtPhysAddr, madtLength ) == NULL) ||
+		!ApicConfig_isChecksumValid( madt, madtLength ))
+	{
+		return false;
+	}
+
+	ApicConfig_clear( config );
+	config->m_localApicPhysAddr = madt->LocalApicAddress;
+
+	// Without overrides, the ISA IRQs are wired to the first 16 global system interrupts. The I/O
+	// APIC that has those is the one whose pins start at zero.
+	uint32_t ioApicGsiBase = 0;
+	bool isOverridden[APIC_NUM_ISA_IRQS] = { false };
+
+	for (int irq = 0; irq < APIC_NUM_ISA_IRQS; irq++)
+	{
+		config->m_isaIrqPins[irq] = (uint8_t) irq;
+	}
+
+	const uint8_t* end = ((const uint8_t*) madt) + madtLength;
+	const uint8_t* next = (const uint8_t*) (madt + 1);
+	while (next + 2 <= end)
+	{
+		const AcpiMadtEntry* entry = (const AcpiMadtEntry*) next;
+		if ((entry->Length < 2) || (next + entry->Length > end))
+		{
+			break;
+		}
+		next += entry->Length;
+
+		switch (entry->Type)
+		{
+		case MADT_LOCAL_APIC:
+			if ((entry->u.LocalApic.Flags & MADT_LOCAL_APIC_ENABLED) != 0)
+			{
+				ApicConfig_addProcessor( config, entry->u.LocalApic.ApicId );
+			}
+			break;
+
+		case MADT_IO_APIC:
+			if ((entry->u.IoApic.GsiBase == 0) || (config->m_ioApicPhysAddr == 0))
+			{
+				config->m_ioApicPhysAddr = entry->u.IoApic.Address;
+				ioApicGsiBase = entry->u.IoApic.GsiBase;
+			}
+			break;
+
+		case MADT_INTERRUPT_OVERRIDE:
+			if ((entry->u.Override.Bus == MADT_BUS_ISA) &&
+				(entry->u.Override.Source < APIC_NUM_ISA_IRQS))
+			{
+				uint8_t irq = entry->u.Override.Source;
+				uint16_t flags = entry->u.Override.Flags;
+				config->m_isaIrqFlags[irq] = ApicConfig_translateIsaFlags( flags );
+
+				// The pin is made relative to the I/O APIC once they have all been seen.
+				config->m_isaIrqPins[irq] = (entry->u.Override.Gsi < APIC_NO_PIN) ?
+					(uint8_t) entry->u.Override.Gsi : APIC_NO_PIN;
+				isOverridden[irq] = true;
+			}
+			break;
+
+		case MADT_LOCAL_APIC_ADDRESS:
+			// A 64-bit address is no use without PAE.
+			if (entry->u.LocalApicAddress.AddressHigh == 0)
+			{
+				config->m_localApicPhysAddr = entry->u.LocalApicAddress.AddressLow;
+			}
+			break;
+
+		default:
+			break;	// Nothing else is needed yet.
+		}
+	}
+
+	if ((config->m_ioApicPhysAddr == 0) || (config->m_localApicPhysAddr == 0))
+	{
+		return false;
+	}
+
+	ApicConfig_resolveOverrides( config, isOverridden );
+	for (int irq = 0; irq < APIC_NUM_ISA_IRQS; irq++)
+	{
+		uint8_t gsi = config->m_isaIrqPins[irq];
+		config->m_isaIrqPins[irq] = ((gsi != APIC_NO_PIN) && (gsi >= ioApicGsiBase)) ?
+			(uint8_t) (gsi - ioApicGsiBase) : APIC_NO_PIN;
+	}
+	return true;
+}
+
+
+/// \brief	Fills in the configuration for one of the MP specification's default configurations.
+///
+/// All of them have two processors, and wire the ISA IRQs straight through to the I/O APIC,
+/// except that IRQ0 goes to pin 2 in place of the cascade.
+static void ApicConfig_useMpDefault( ApicConfig* config )
+{
+	ApicConfig_clear( config );
+	config->m_localApicPhysAddr	= MP_DEFAULT_LOCAL_APIC;
+	config->m_ioApicPhysAddr	= MP_DEFAULT_IO_APIC;
+
+	for (int irq = 0; irq < APIC_NUM_ISA_IRQS; irq++)
+	{
+		config->m_isaIrqPins[irq] = (uint8_t) irq;
+	}
+	config->m_isaIrqPins[0] = 2;
+	config->m_isaIrqPins[2] = APIC_NO_PIN;
+
+	for (int i = 0; i < MP_DEFAULT_NUM_CPUS; i++)
+	{
+		ApicConfig_addProcessor( config, (uint8_t) i );
+	}
+}
+
+
+/// \brief	Fills in the configuration from the MP configuration table.
+///
+/// \param tablePhysAddr	physical address of the table.
+///
+/// \retval true	the table describes an I/O APIC for the ISA IRQs.
+/// \retval false	the table is damaged, or has no I/O APIC that the ISA IRQs go to.
+static bool ApicConfig_readMpTable( ApicConfig* config, uint32_t tablePhysAddr )
+{
+	const MpConfigHeader* header =
+		(const MpConfigHeader*) DeviceWindow_mapTable( tablePhysAddr, sizeof( MpConfigHeader ) );
+	uint16_t tableLength = header->BaseTableLength;
+
+	if (!ApicConfig_hasSignature( header->Signature, "PCMP", sizeof( header->Signature ) ) ||
+		(tableLength < sizeof( MpConfigHeader )) ||
+		!ApicConfig_isChecksumValid( header, tableLength ))
+	{
+		return false;
+	}
+
+	ApicConfig_clear( config );
+	config->m_localApicPhysAddr = header->LocalApicAddress;
+
+	// The interrupt entries refer to buses and I/O APICs by ID, and may come before the entries
+	// for them, so this takes two passes: One for the buses, and one for everything else.
+	uint32_t isIsaBus[MP_MAX_BUSES / 32] = { 0 };
+	uint8_t isaIoApicId = MP_ALL_IO_APICS;
+	const uint8_t* end = ((const uint8_t*) header) + tableLength;
+
+	for (int pass = 0; pass < 2; pass++)
+	{
+		const uint8_t* next = (const uint8_t*) (header + 1);
+		for (uint16_t i = 0; (i < header->EntryCount) && (next < end); i++)
+		{
+			const MpEntry* entry = (const MpEntry*) next;
+			next += (entry->Type == MP_ENTRY_PROCESSOR) ? MP_PROCESSOR_LENGTH : MP_OTHER_LENGTH;
+			if (next > end)
+			{
+				break;
+			}
+
+			if (pass == 0)
+			{
+				// EISA buses carry ISA IRQs too.
+				if ((entry->Type == MP_ENTRY_BUS) &&
+					(ApicConfig_hasSignature( entry->u.Bus.BusType, "ISA   ", 6 ) ||
+					 ApicConfig_hasSignature( entry->u.Bus.BusType, "EISA  ", 6 )))
+				{
+					uint8_t busId = entry->u.Bus.BusId;
+					isIsaBus[busId / 32] = KMem_bitSet32( isIsaBus[busId / 32], busId % 32 );
+				}
+				continue;
+			}
+
+			switch (entry->Type)
+			{
+			case MP_ENTRY_PROCESSOR:
+				if ((entry->u.Processor.CpuFlags & MP_PROCESSOR_ENABLED) != 0)
+				{
+					ApicConfig_addProcessor( config, entry->u.Processor.LocalApicId );
+				}
+				break;
+
+			case MP_ENTRY_IO_INTERRUPT:
+			{
+				uint8_t busId	= entry->u.IoInterrupt.SourceBusId;
+				uint8_t irq		= entry->u.IoInterrupt.SourceBusIrq;
+				uint8_t ioApic	= entry->u.IoInterrupt.DestIoApicId;
+
+				// The first ISA IRQ decides which I/O APIC the rest have to be on.
+				if ((entry->u.IoInterrupt.InterruptType == MP_INTERRUPT_INT) &&
+					KMem_isBitSet32( isIsaBus[busId / 32], busId % 32 ) &&
+					(irq < APIC_NUM_ISA_IRQS) &&
+					((isaIoApicId == MP_ALL_IO_APICS) || (ioApic == isaIoApicId) ||
+					 (ioApic == MP_ALL_IO_APICS)))
+				{
+					if (ioApic != MP_ALL_IO_APICS)
+					{
+						isaIoApicId = ioApic;
+					}
+					config->m_isaIrqPins[irq]	= entry->u.IoInterrupt.DestIoApicPin;
+					config->m_isaIrqFlags[irq]	=
+						ApicConfig_translateIsaFlags( entry->u.IoInterrupt.Flags );
+				}
+				break;
+			}
+
+			default:
+				break;	// The I/O APICs are found below, once the right one is known.
+			}
+		}
+	}
+
+	// Now find the address of the I/O APIC the ISA IRQs go to. If they were all sent to every I/O
+	// APIC, the first one will do.
+	const uint8_t* next = (const uint8_t*) (header + 1);
+	for (uint16_t i = 0; (i < header->EntryCount) && (next < end); i++)
+	{
+		const MpEntry* entry = (const MpEntry*) next;
+		next += (entry->Type == MP_ENTRY_PROCESSOR) ? MP_PROCESSOR_LENGTH : MP_OTHER_LENGTH;
+		if (next > end)
+		{
+			break;
+		}
+
+		if ((entry->Type == MP_ENTRY_IO_APIC) &&
+			((entry->u.IoApic.Flags & MP_IO_APIC_ENABLED) != 0) &&
+			((isaIoApicId == MP_ALL_IO_APICS) || (entry->u.IoApic.IoApicId == isaIoApicId)))
+		{
+			config->m_ioApicPhysAddr = entry->u.IoApic.Address;
+			break;
+		}
+	}
+
+	return (config->m_ioApicPhysAddr != 0) && (config->m_localApicPhysAddr != 0);
+}
+
+
+
+// Public functions
+
+bool ApicConfig_discover( ApicConfig* config )
+{
+	KDebug_assertArg( config != NULL );
+
+	const MpFloatingPointer* mp = (const MpFloatingPointer*) ApicConfig_scanFirmware(
+		"_MP_",
+		sizeof( mp->Signature ),
+		sizeof( MpFloatingPointer )
+	);
+
+	bool found = ApicConfig_readMadt( config );
+	if (!found && (mp != NULL))
+	{
+		if (mp->Features[0] != 0)
+		{
+			ApicConfig_useMpDefault( config );
+			found = true;
+		}
+		else if (mp->ConfigTableAddress != 0)
+		{
+			found = ApicConfig_readMpTable( config, mp->ConfigTableAddress );
+		}
+	}
+
+	// Only the MP tables say whether there is an IMCR to switch, even when the rest of the
+	// configuration came from ACPI.
+	config->m_hasImcr = found && (mp != NULL) && ((mp->Features[1] & MP_FEATURE2_IMCRP) != 0);
+	return found;
+}
@@ -0,0 +1,169 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/Architecture/x86/HAL/CpuFeatures_x86.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/06
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	This file implements the x86 processor feature detection module.
+///
+// ===========================================================================
+
+
+#include "Kernel/KCommon/KMem.h"
+#include "HAL/Cpuid.h"
+#include "HAL/CpuFeatures.h"
+
+
+// Private constants
+
+/// \brief	Defines private constants for the CpuFeatures module.
+enum CpuFeatures_consts
+{
+	CPUID_LEAF_FEATURES			= 1,			///< Standard feature flags.
+	CPUID_LEAF_EXT_FEATURES		= 7,			///< Structured extended feature flags.
+	CPUID_LEAF_EXT_MAX			= 0x80000000,	///< Returns the maximum extended leaf.
+	CPUID_LEAF_EXT_AMD_FEATURES	= 0x80000001,	///< Extended feature flags.
+	CPUID_LEAF_EXT_POWER		= 0x80000007,	///< Advanced power management flags.
+
+	LEAF1_EDX_TSC				= 4,			///< Bit of leaf 1 EDX: RDTSC.
+	LEAF1_EDX_APIC				= 9,			///< Bit of leaf 1 EDX: on-chip local APIC.
+	LEAF1_EDX_FXSR				= 24,			///< Bit of leaf 1 EDX: FXSAVE/FXRSTOR.
+	LEAF1_EDX_SSE2				= 26,			///< Bit of leaf 1 EDX: SSE2.
+	LEAF1_ECX_POPCNT			= 23,			///< Bit of leaf 1 ECX: POPCNT.
+	LEAF7_EBX_BMI1				= 3,			///< Bit of leaf 7 EBX: BMI1 (includes TZCNT).
+	LEAF7_EBX_ERMSB				= 9,			///< Bit of leaf 7 EBX: enhanced REP MOVSB/STOSB.
+	EXT1_ECX_ABM				= 5,			///< Bit of 0x80000001 ECX: ABM, which is LZCNT.
+	EXT7_EDX_INVARIANT_TSC		= 8				///< Bit of 0x80000007 EDX: invariant TSC.
+};
+
+
+
+// Private variables
+
+/// \brief	Features of the bootstrap processor, as a bitwise OR of CpuFeature values.
+static uint32_t s_features = 0;
+
+
+
+// Private functions
+
+/// \brief	Enables the SSE state, so that SSE and SSE2 instructions can be used.
+///
+/// Checks that x87 emulation is off (CR0.EM), then sets CR4.OSFXSR.
+///
+/// \retval true	SSE instructions can now be used.
+/// \retval false	x87 emulation is on, so SSE instructions would fault.
+extern bool CpuFeatures_x86_enableSse( void );
+
+
+
+// Public functions
+
+void CpuFeatures_init( void )
+{
+	// There are no assertions here, since a zero-size IDT is loaded when this is called. A failed
+	// one would just reboot the machine instead of bugchecking.
+	if (!Cpuid_isSupported())
+	{
+		return;
+	}
+
+	uint32_t features = CPUFEATURE_CPUID;
+
+	CpuidRegisters regs;
+	Cpuid_query( 0, 0, &regs );
+	uint32_t maxLeaf = regs.eax;
+
+	if (maxLeaf >= CPUID_LEAF_FEATURES)
+	{
+		Cpuid_query( CPUID_LEAF_FEATURES, 0, &regs );
+
+		if (KMem_isBitSet32( regs.edx, LEAF1_EDX_TSC ))
+		{
+			features |= CPUFEATURE_TSC;
+		}
+		if (KMem_isBitSet32( regs.ecx, LEAF1_ECX_POPCNT ))
+		{
+			features |= CPUFEATURE_POPCNT;
+		}
+		if (KMem_isBitSet32( regs.edx, LEAF1_EDX_APIC ))
+		{
+			features |= CPUFEATURE_APIC;
+		}
+
+		// The XMM registers are only usable once the kernel has told the processor that it knows
+		// about FXSAVE. The kernel never uses FXSAVE itself yet; routines that use SSE2 save and
+		// restore the XMM registers they use, since TrapFrames don't include them.
+		if (KMem_isBitSet32( regs.edx, LEAF1_EDX_SSE2 ) &&
+			KMem_isBitSet32( regs.edx, LEAF1_EDX_FXSR ) &&
+			CpuFeatures_x86_enableSse())
+		{
+			features |= CPUFEATURE_SSE2;
+		}
+	}
+
+	if (maxLeaf >= CPUID_LEAF_EXT_FEATURES)
+	{
+		Cpuid_query( CPUID_LEAF_EXT_FEATURES, 0, &regs );
+
+		if (KMem_isBitSet32( regs.ebx, LEAF7_EBX_BMI1 ))
+		{
+			features |= CPUFEATURE_TZCNT;
+		}
+		if (KMem_isBitSet32( regs.ebx, LEAF7_EBX_ERMSB ))
+		{
+			features |= CPUFEATURE_ERMSB;
+		}
+	}
+
+	// Processors without extended leaves just echo back the highest standard leaf, which never
+	// has the top bit set.
+	Cpuid_query( CPUID_LEAF_EXT_MAX, 0, &regs );
+	uint32_t maxExtLeaf = ((regs.eax & CPUID_LEAF_EXT_MAX) != 0) ? regs.eax : 0;
+
+	if (maxExtLeaf >= CPUID_LEAF_EXT_AMD_FEATURES)
+	{
+		Cpuid_query( CPUID_LEAF_EXT_AMD_FEATURES, 0, &regs );
+
+		if (KMem_isBitSet32( regs.ecx, EXT1_ECX_ABM ))
+		{
+			features |= CPUFEATURE_LZCNT;
+		}
+	}
+
+	if (maxExtLeaf >= CPUID_LEAF_EXT_POWER)
+	{
+		Cpuid_query( CPUID_LEAF_EXT_POWER, 0, &regs );
+
+		if (((features & CPUFEATURE_TSC) != 0) &&
+			KMem_isBitSet32( regs.edx, EXT7_EDX_INVARIANT_TSC ))
+		{
+			features |= CPUFEATURE_INVARIANT_TSC;
+		}
+	}
+
+	s_features = features;
+}
+
+
+uint32_t CpuFeatures_getAll( void )
+{
+	return s_features;
+}
+
+
+bool CpuFeatures_has( CpuFeature feature )
+{
+	return (s_features & (uint32_t) feature) != 0;
+}
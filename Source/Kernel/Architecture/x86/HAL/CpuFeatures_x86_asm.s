@@ -0,0 +1,40 @@
+; ===========================================================================
+;
+;             Copyright (C) 2004-2006 Bruce Johnston
+;
+; ===========================================================================
+;
+;   //osdev/precursor/Source/Kernel/Architecture/x86/HAL/CpuFeatures_x86_asm.s
+;
+; ===========================================================================
+;
+;	Originating Author:	BruceJ
+;	Originating Date:	2006/May/06
+;
+; ===========================================================================
+; This file contains the parts of the CpuFeatures module that can't be
+; written in C.
+; ===========================================================================
+
+
+CR0_EM		equ 1 << 2		; x87 emulation. SSE instructions fault if this is set.
+CR4_OSFXSR	equ 1 << 9		; OS supports FXSAVE/FXRSTOR. SSE instructions fault if clear.
+
+
+; ===========================================================================
+section .text
+align 4
+
+global CpuFeatures_x86_enableSse
+
+CpuFeatures_x86_enableSse:
+		xor eax, eax			; Assume failure.
+		mov ecx, cr0
+		test ecx, CR0_EM
+		jnz .done
+		mov ecx, cr4
+		or ecx, CR4_OSFXSR
+		mov cr4, ecx
+		mov eax, 1
+.done:
+		ret
@@ -0,0 +1,68 @@
+; ===========================================================================
+;
+;             Copyright (C) 2004-2006 Bruce Johnston
+;
+; ===========================================================================
+;
+;   //osdev/precursor/Source/Kernel/Architecture/x86/HAL/Cpuid_x86_asm.s
+;
+; ===========================================================================
+;
+;	Originating Author:	BruceJ
+;	Originating Date:	2006/Apr/23
+;
+; ===========================================================================
+; This file contains the implementation of the Cpuid utility functions.
+; ===========================================================================
+
+
+EFLAGS_ID	equ 1 << 21		; ID flag. If it can be toggled, CPUID is supported.
+
+
+; ===========================================================================
+section .text
+align 4
+
+global Cpuid_isSupported
+
+Cpuid_isSupported:
+		pushfd					; Get the original EFLAGS into ecx.
+		pop ecx
+		mov eax, ecx
+		xor eax, EFLAGS_ID		; Try to flip the ID flag.
+		push eax
+		popfd
+		pushfd					; Read EFLAGS back to see if the flip stuck.
+		pop eax
+		push ecx				; Restore the original EFLAGS.
+		popfd
+		xor eax, ecx			; eax = 1 if ID changed, 0 otherwise.
+		shr eax, 21
+		and eax, 1
+		ret
+
+
+global Cpuid_query
+
+Cpuid_query:
+		; ebx and edi are callee-saved, and CPUID trashes ebx.
+		push ebx
+		push edi
+
+		; Parameters. The function is so short there isn't any point in using ebp.
+		%define leaf	dword [esp + 12]	; Value for EAX.
+		%define subLeaf	dword [esp + 16]	; Value for ECX.
+		%define regs	dword [esp + 20]	; Pointer to CpuidRegisters.
+
+		mov eax, leaf
+		mov ecx, subLeaf
+		cpuid
+		mov edi, regs
+		mov [edi], eax
+		mov [edi + 4], ebx
+		mov [edi + 8], ecx
+		mov [edi + 12], edx
+
+		pop edi
+		pop ebx
+		ret
@@ -0,0 +1,78 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/Architecture/x86/HAL/DeviceWindow.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/16
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	This file defines a utility that lets the x86 HAL reach physical
+///			memory outside the kernel's 4MB, such as the registers of the APICs
+///			and the firmware tables that describe them.
+///
+/// There is no VMM yet, so each window is just a spare 4MB PDE of the boot
+/// page directory, starting at HAL_DEVICE_WINDOW_BASE. Windows are only
+/// moved during initialization of the bootstrap processor, with interrupts
+/// disabled, so there is no locking. Firmware tables borrow the same windows,
+/// so they can only be read before any registers are mapped. After that,
+/// each window stays put.
+///
+/// ***FIXME: This goes away once there is a VMM that can map device memory
+/// properly.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_ARCHITECTURE_X86_HAL_DEVICEWINDOW_H_
+#define _KERNEL_ARCHITECTURE_X86_HAL_DEVICEWINDOW_H_
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/// \brief	Identifies one of the HAL's windows on physical memory.
+typedef enum
+{
+	DEVICE_WINDOW_LOCAL_APIC	= 0,	///< Maps the local APIC's registers.
+	DEVICE_WINDOW_IO_APIC		= 1,	///< Maps the I/O APIC's registers.
+	DEVICE_WINDOW_COUNT			= 2		///< Number of windows.
+
+} DeviceWindow;
+
+
+/// \brief	Maps the 4MB of physical memory that holds the given device registers into a window,
+///			with caching disabled.
+///
+/// \param window	the window to use.
+/// \param physAddr	the physical address of the registers.
+///
+/// \return the virtual address at which \a physAddr can be reached.
+volatile void* DeviceWindow_mapRegisters( DeviceWindow window, uint32_t physAddr );
+
+
+/// \brief	Maps a firmware table so that it can be read.
+///
+/// \param physAddr	the physical address of the table.
+/// \param size		the size of the table, in bytes.
+///
+/// Both windows are used, so that a table that starts anywhere in one 4MB page and spills into
+/// the next is still reachable. Mapping another table unmaps this one. Tables must all be read
+/// before DeviceWindow_mapRegisters() is first called, since they share its windows.
+///
+/// In checked builds, a bugcheck will occur if any registers have already been mapped.
+///
+/// \return the virtual address at which \a physAddr can be read, or NULL if \a size is more than
+///			4MB.
+const void* DeviceWindow_mapTable( uint32_t physAddr, size_t size );
+
+
+#endif
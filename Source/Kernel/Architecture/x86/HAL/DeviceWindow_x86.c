@@ -0,0 +1,128 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/Architecture/x86/HAL/DeviceWindow_x86.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/16
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	This file implements the DeviceWindow utility with spare 4MB PDEs
+///			of the boot page directory.
+///
+// ===========================================================================
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "DeviceWindow.h"
+#include "Kernel/HAL/Mem.h"
+#include "Kernel/KCommon/KDebug.h"
+
+
+// Private constants
+
+/// \brief	Defines private constants for the DeviceWindow utility.
+enum DeviceWindow_consts
+{
+	LARGE_PAGE_SIZE		= 4 * 1024 * 1024,	///< Size of a page mapped by a single PDE.
+	LARGE_PAGE_SHIFT	= 22,				///< log2 of LARGE_PAGE_SIZE.
+	PDE_PRESENT			= 0x00000001,		///< Bit 0: P. The page is present.
+	PDE_WRITABLE		= 0x00000002,		///< Bit 1: RW. The page is read/write.
+	PDE_WRITE_THROUGH	= 0x00000008,		///< Bit 3: PWT. Writes go straight to memory.
+	PDE_CACHE_DISABLE	= 0x00000010,		///< Bit 4: PCD. The page is never cached.
+	PDE_LARGE_PAGE		= 0x00000080,		///< Bit 7: PS. The page is 4MB.
+
+	/// \brief	Index of the PDE that maps the first window.
+	FIRST_WINDOW_PDE_INDEX	= HAL_DEVICE_WINDOW_BASE >> LARGE_PAGE_SHIFT
+};
+
+
+
+// Private variables
+
+/// \brief	The page directory set up by the boot code. It is still the current page directory.
+extern uint32_t BootPageDirectory[];
+
+/// \brief	Set once any window maps device registers, after which tables can't be mapped.
+static bool s_areRegistersMapped = false;
+
+
+
+// Private functions
+
+/// \brief	Invalidates the TLB entry for the page containing the given virtual address.
+///
+/// \param vaddr	any virtual address within the page.
+///
+/// This is MM's helper. libMM is linked before libHAL, but this still resolves, since MM_x86.c
+/// has already pulled it in.
+extern void MM_x86_invalidatePage( const void* vaddr );
+
+
+/// \brief	Points a window at the 4MB page containing the given physical address.
+///
+/// \param window	the window to move.
+/// \param physAddr	any physical address within the page to map.
+/// \param flags	the PDE bits to map the page with, other than its address.
+///
+/// \return the virtual address at which \a physAddr can be reached.
+static volatile void* DeviceWindow_map( size_t window, uint32_t physAddr, uint32_t flags )
+{
+	KDebug_assertArg( window < DEVICE_WINDOW_COUNT );
+
+	uint32_t largePageBase = physAddr & ~((uint32_t) (LARGE_PAGE_SIZE - 1));
+	uint32_t pde = largePageBase | flags | PDE_LARGE_PAGE | PDE_PRESENT;
+	volatile uint8_t* windowBase =
+		(volatile uint8_t*) (HAL_DEVICE_WINDOW_BASE + (window * LARGE_PAGE_SIZE));
+
+	if (BootPageDirectory[FIRST_WINDOW_PDE_INDEX + window] != pde)
+	{
+		BootPageDirectory[FIRST_WINDOW_PDE_INDEX + window] = pde;
+		MM_x86_invalidatePage( (const void*) windowBase );
+	}
+	return windowBase + (physAddr - largePageBase);
+}
+
+
+
+// Public functions
+
+volatile void* DeviceWindow_mapRegisters( DeviceWindow window, uint32_t physAddr )
+{
+	s_areRegistersMapped = true;
+	return DeviceWindow_map(
+		(size_t) window,
+		physAddr,
+		PDE_CACHE_DISABLE | PDE_WRITE_THROUGH | PDE_WRITABLE
+	);
+}
+
+
+const void* DeviceWindow_mapTable( uint32_t physAddr, size_t size )
+{
+	// Tables borrow the register windows, so mapping one now would pull the registers out from
+	// under whoever is using them.
+	KDebug_assertMsg( !s_areRegistersMapped, "Tables can't be mapped once registers are." );
+
+	if (size > LARGE_PAGE_SIZE)
+	{
+		return NULL;
+	}
+
+	// Tables are plain memory, so they can be cached. The second window is only there in case the
+	// table runs off the end of the first. It wraps around at 4GB, which is harmless, since the
+	// firmware never puts tables up there.
+	const void* table = (const void*) DeviceWindow_map( 0, physAddr, 0 );
+	DeviceWindow_map( 1, physAddr + LARGE_PAGE_SIZE, 0 );
+	return table;
+}
@@ -0,0 +1,109 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/Architecture/x86/HAL/InterruptController_x86.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/16
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	This file defines the InterruptController class for the x86
+///			architecture. It picks the best interrupt controller hardware the
+///			system has when the bootstrap processor initializes it, and then
+///			delegates to that implementation.
+///
+/// The local and I/O APICs are used if the firmware describes them, since an
+/// EOI is a single write to memory rather than one or two slow port writes,
+/// and since each IRQ can be sent to any processor. Otherwise, the pair of
+/// 8259As that every AT-compatible PC has is used.
+///
+// ===========================================================================
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include "InterruptController_x86.h"
+#include "Kernel/HAL/InterruptController.h"
+#include "Kernel/KCommon/KDebug.h"
+
+
+// Private types
+
+/// \brief	Declaration of the InterruptController object type.
+struct InterruptControllerStruct
+{
+	// Empty for now.
+};
+
+
+
+// Private variables
+
+/// \brief	The InterruptController is all in the implementation, so one instance will do.
+static volatile InterruptController s_instance;
+
+
+/// \brief	The implementation in use, or NULL until the bootstrap processor has picked one.
+static const InterruptControllerImpl* s_impl = NULL;
+
+
+
+// Public functions
+
+void InterruptController_initForCurrentProcessor( void )
+{
+	if (s_impl == NULL)
+	{
+		s_impl = InterruptController_x86_Apic_probe()
+			? &InterruptController_x86_Apic
+			: &InterruptController_x86_8259A;
+	}
+	s_impl->initForCurrentProcessor();
+}
+
+
+volatile InterruptController* InterruptController_getForCurrentProcessor( void )
+{
+	KDebug_assert( s_impl != NULL );
+	return &s_instance;
+}
+
+
+void InterruptController_mask( InterruptController* controller, uint32_t irqNumber )
+{
+	(void) controller;	// Ignore -- no extra state needed.
+	s_impl->mask( irqNumber );
+}
+
+
+void InterruptController_unmask( InterruptController* controller, uint32_t irqNumber )
+{
+	(void) controller;	// Ignore -- no extra state needed.
+	s_impl->unmask( irqNumber );
+}
+
+
+void InterruptController_endOfInterrupt( InterruptController* controller, uint32_t irqNumber )
+{
+	(void) controller;	// Ignore -- no extra state needed.
+	s_impl->endOfInterrupt( irqNumber );
+}
+
+
+bool InterruptController_setAffinity(
+	InterruptController*	controller,
+	uint32_t				irqNumber,
+	int						processorId
+)
+{
+	(void) controller;	// Ignore -- no extra state needed.
+	return s_impl->setAffinity( irqNumber, processorId );
+}
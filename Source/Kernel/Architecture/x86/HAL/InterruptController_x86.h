@@ -0,0 +1,88 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/Architecture/x86/HAL/InterruptController_x86.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/16
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	This file defines the interface between the x86 InterruptController
+///			class and the hardware-specific implementations that it chooses
+///			between at boot.
+///
+/// On x86, IRQ numbers are interrupt vector numbers minus INT_HW_IRQ0 with
+/// either implementation, so IRQs 0 to 15 are always the ISA IRQs.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_ARCHITECTURE_X86_HAL_INTERRUPTCONTROLLER_X86_H_
+#define _KERNEL_ARCHITECTURE_X86_HAL_INTERRUPTCONTROLLER_X86_H_
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/// \brief	The functions that implement the InterruptController class for one kind of hardware.
+///
+/// Each one works like the InterruptController function of the same name, except that there is
+/// no InterruptController* to pass.
+typedef struct
+{
+	/// \brief	Initializes the hardware for the current processor.
+	void (*initForCurrentProcessor)( void );
+
+	/// \brief	Disables the given IRQ.
+	void (*mask)( uint32_t irqNumber );
+
+	/// \brief	Enables the given IRQ.
+	void (*unmask)( uint32_t irqNumber );
+
+	/// \brief	Signals that processing of the given IRQ is complete.
+	void (*endOfInterrupt)( uint32_t irqNumber );
+
+	/// \brief	Sends the given IRQ to the given processor.
+	bool (*setAffinity)( uint32_t irqNumber, int processorId );
+
+} InterruptControllerImpl;
+
+
+/// \brief	The implementation for a pair of Intel 8259A-compatible PICs. This is the fallback for
+///			systems without APICs.
+extern const InterruptControllerImpl InterruptController_x86_8259A;
+
+
+/// \brief	The implementation for the local APIC of each processor plus an I/O APIC.
+///
+/// It may only be used if InterruptController_x86_Apic_probe() succeeds.
+extern const InterruptControllerImpl InterruptController_x86_Apic;
+
+
+/// \brief	Moves the 8259As' vectors out of the way of the exceptions, and masks every IRQ.
+///
+/// This is used when the APICs take over, since the 8259As can still raise spurious interrupts.
+/// It must be called with interrupts disabled.
+void InterruptController_x86_8259A_disable( void );
+
+
+/// \brief	Finds the APICs, and maps their registers.
+///
+/// This must be called once, during initialization of the bootstrap processor, with interrupts
+/// disabled.
+///
+/// \retval true	the system has a local APIC and an I/O APIC that the ISA IRQs go to, so
+///					InterruptController_x86_Apic can be used.
+/// \retval false	the 8259As have to be used.
+bool InterruptController_x86_Apic_probe( void );
+
+
+#endif
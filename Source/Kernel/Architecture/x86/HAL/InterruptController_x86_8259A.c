@@ -15,34 +15,26 @@
 ///
 /// \file
 ///
-/// \brief	This file defines the InterruptController class for the x86 UP
-///			architecture. It encapsulates a pair of Intel 8259A-compatible PICs
-///			chained together (in other words, the norm for AT-compatible PCs).
+/// \brief	This file implements the InterruptController class for the x86
+///			architecture with a pair of Intel 8259A-compatible PICs chained
+///			together (in other words, the norm for AT-compatible PCs).
+///
+/// The 8259As can only interrupt the bootstrap processor, so this is the
+/// fallback for systems without APICs.
 ///
 // ===========================================================================
 
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include "IO.h"
-#include "Kernel/HAL/InterruptController.h"
+#include "InterruptController_x86.h"
 #include "Kernel/KCommon/KDebug.h"
 #include "Kernel/KCommon/KMem.h"
 #include "Kernel/Architecture/x86/HAL/PrecursorVectors_x86.h"	// For INT_HW_IRQ0.
 
 
-/// \brief	Declaration of the InterruptController object type.
-struct InterruptControllerStruct
-{
-	// Empty for now.
-};
-
-
-
-/// \brief	There is only one pair of PICs in an x86 UP system...
-static volatile InterruptController s_instance;
-
-
 /// \brief	Defines local constants for the InterruptController class.
 enum InterruptController_consts
 {
@@ -96,9 +88,8 @@ static inline void InterruptController_choosePortAndPicRelativeIrq(
 
 
 
-// Public functions.
-
-void InterruptController_initForCurrentProcessor( void )
+/// \brief	Initializes the PICs, and leaves every IRQ masked.
+static void InterruptController_8259A_setUp( void )
 {
 	// Mask all IRQs.
 	IO_out8( PIC_MASTER_DATA, 0xFF );
@@ -120,22 +111,26 @@ void InterruptController_initForCurrentProcessor( void )
 	IO_out8( PIC_MASTER_DATA, ICW4_8086 );
 	IO_out8( PIC_SLAVE_DATA, ICW4_8086 );
 
-	// Unmask all IRQs.
-	IO_out8( PIC_MASTER_DATA, 0 );
-	IO_out8( PIC_SLAVE_DATA, 0 );
+	// Keep all IRQs masked. The ICWs leave the masks alone, but it doesn't hurt to be sure.
+	IO_out8( PIC_MASTER_DATA, 0xFF );
+	IO_out8( PIC_SLAVE_DATA, 0xFF );
 }
 
 
-volatile InterruptController* InterruptController_getForCurrentProcessor( void )
+/// \brief	Initializes the PICs, and unmasks every IRQ.
+static void InterruptController_8259A_initForCurrentProcessor( void )
 {
-	return &s_instance;
+	InterruptController_8259A_setUp();
+
+	// Unmask all IRQs.
+	IO_out8( PIC_MASTER_DATA, 0 );
+	IO_out8( PIC_SLAVE_DATA, 0 );
 }
 
 
-void InterruptController_mask( InterruptController* controller, uint32_t irqNumber )
+/// \brief	Implements InterruptController_mask().
+static void InterruptController_8259A_mask( uint32_t irqNumber )
 {
-	(void) controller;	// Ignore -- no extra state needed.
-
 	uint16_t port;
 	uint8_t picRelativeIrq;
 
@@ -146,10 +141,9 @@ void InterruptController_mask( InterruptController* controller, uint32_t irqNumb
 }
 
 
-void InterruptController_unmask( InterruptController* controller, uint32_t irqNumber )
+/// \brief	Implements InterruptController_unmask().
+static void InterruptController_8259A_unmask( uint32_t irqNumber )
 {
-	(void) controller;	// Ignore -- no extra state needed.
-
 	uint16_t port;
 	uint8_t picRelativeIrq;
 
@@ -160,10 +154,9 @@ void InterruptController_unmask( InterruptController* controller, uint32_t irqNu
 }
 
 
-void InterruptController_endOfInterrupt( InterruptController* controller, uint32_t irqNumber )
+/// \brief	Implements InterruptController_endOfInterrupt().
+static void InterruptController_8259A_endOfInterrupt( uint32_t irqNumber )
 {
-	(void) controller;	// Ignore -- no extra state needed.
-
 	KDebug_assertArg( irqNumber < NUM_IRQS );
 
 	// Send EOI to the master.
@@ -172,8 +165,38 @@ void InterruptController_endOfInterrupt( InterruptController* controller, uint32
 	if (irqNumber >= NUM_IRQS_PER_PIC)
 	{
 		// Send EOI to the slave.
-		IO_out8( PIC_MASTER_COMMAND, PIC_EOI );
+		IO_out8( PIC_SLAVE_COMMAND, PIC_EOI );
 	}
 }
 
 
+/// \brief	Implements InterruptController_setAffinity(). The PICs are only wired to the bootstrap
+///			processor, so that is the only place an IRQ can go.
+static bool InterruptController_8259A_setAffinity( uint32_t irqNumber, int processorId )
+{
+	(void) irqNumber;	// Unused in release builds.
+	KDebug_assertArg( irqNumber < NUM_IRQS );
+	return (processorId == 0);
+}
+
+
+
+// Public variables
+
+const InterruptControllerImpl InterruptController_x86_8259A =
+{
+	InterruptController_8259A_initForCurrentProcessor,
+	InterruptController_8259A_mask,
+	InterruptController_8259A_unmask,
+	InterruptController_8259A_endOfInterrupt,
+	InterruptController_8259A_setAffinity
+};
+
+
+
+// Public functions
+
+void InterruptController_x86_8259A_disable( void )
+{
+	InterruptController_8259A_setUp();
+}
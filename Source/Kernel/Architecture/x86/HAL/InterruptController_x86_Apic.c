@@ -0,0 +1,389 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/Architecture/x86/HAL/InterruptController_x86_Apic.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/16
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	This file implements the InterruptController class for the x86
+///			architecture with the local APIC of each processor plus the I/O
+///			APIC that the ISA IRQs are wired to.
+///
+/// Each ISA IRQ n arrives on vector INT_HW_IRQ0 + n, just as it does with the
+/// 8259As, wherever the firmware says it is wired. An EOI is a single write
+/// to the local APIC, which also tells the I/O APIC for level-triggered
+/// IRQs. Every IRQ starts out going to the bootstrap processor, and can be
+/// sent to any other with InterruptController_setAffinity().
+///
+/// The I/O APIC's registers are reached through a select register and a data
+/// register, so a Lock keeps processors from interleaving their accesses. A
+/// copy of the low half of each redirection entry is kept, so masking and
+/// unmasking an IRQ are single writes.
+///
+// ===========================================================================
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ApicConfig.h"
+#include "DeviceWindow.h"
+#include "HAL/CpuFeatures.h"
+#include "InterruptController_x86.h"
+#include "IO.h"
+#include "LocalApic.h"
+#include "Kernel/HAL/Lock.h"
+#include "Kernel/HAL/Processor.h"
+#include "Kernel/KCommon/KDebug.h"
+#include "Kernel/Architecture/x86/HAL/PrecursorVectors_x86.h"	// For INT_HW_IRQ0.
+
+
+// Private constants
+
+/// \brief	Defines private constants for the APIC implementation of InterruptController.
+enum InterruptController_Apic_consts
+{
+	LOCAL_APIC_MIN_VERSION		= 0x10,			///< Older versions are discrete 82489DXs.
+	LOCAL_APIC_MAX_VERSION		= 0x1F,			///< Anything newer isn't an APIC we know.
+
+	IO_APIC_SELECT				= 0x00 / 4,		///< Index of the register select register.
+	IO_APIC_DATA				= 0x10 / 4,		///< Index of the data register.
+	IO_APIC_VERSION				= 0x01,			///< Version, and the number of pins less one.
+	IO_APIC_REDIRECTION_TABLE	= 0x10,			///< First half of the first redirection entry.
+	IO_APIC_MAX_PIN_SHIFT		= 16,			///< Shift of the last pin in IO_APIC_VERSION.
+	IO_APIC_NO_PINS				= 0xFF,			///< What the last pin reads as if nothing is there.
+
+	REDIRECTION_ACTIVE_LOW		= 0x00002000,	///< The pin is active low.
+	REDIRECTION_LEVEL			= 0x00008000,	///< The pin is level-triggered.
+	REDIRECTION_MASKED			= 0x00010000,	///< The pin is masked.
+	REDIRECTION_DEST_SHIFT		= 24,			///< Shift of the local APIC ID in the high half.
+
+	IMCR_SELECT					= 0x22,			///< Port that selects an IMCR register.
+	IMCR_DATA					= 0x23,			///< Port that writes the selected register.
+	IMCR_REGISTER				= 0x70,			///< The IMCR itself.
+	IMCR_APIC_MODE				= 0x01			///< Sends interrupts to the APICs, not the CPU.
+};
+
+
+
+// Private variables
+
+/// \brief	What the firmware says about the APICs.
+static ApicConfig s_config;
+
+/// \brief	The local APIC registers, or NULL if the APICs aren't in use.
+static volatile uint32_t* s_localApic = NULL;
+
+/// \brief	The I/O APIC registers.
+static volatile uint32_t* s_ioApic = NULL;
+
+/// \brief	The number of pins the I/O APIC has.
+static uint32_t s_numIoApicPins = 0;
+
+/// \brief	The low half of the redirection entry of each ISA IRQ, including the mask bit.
+static uint32_t s_redirections[APIC_NUM_ISA_IRQS];
+
+/// \brief	Keeps processors from interleaving their accesses to the I/O APIC.
+///
+/// An all-zero Lock is the same as one returned by Lock_create(), so no initialization is needed.
+static Lock s_ioApicLock;
+
+/// \brief	Whether the I/O APIC has been set up yet. Only the first processor does it.
+static bool s_isIoApicInitialized = false;
+
+
+
+// Private functions
+
+/// \brief	Reads a register of the I/O APIC. The caller must hold s_ioApicLock.
+static uint32_t InterruptController_Apic_readIoApic( uint32_t reg )
+{
+	s_ioApic[IO_APIC_SELECT] = reg;
+	return s_ioApic[IO_APIC_DATA];
+}
+
+
+/// \brief	Writes a register of the I/O APIC. The caller must hold s_ioApicLock.
+static void InterruptController_Apic_writeIoApic( uint32_t reg, uint32_t value )
+{
+	s_ioApic[IO_APIC_SELECT] = reg;
+	s_ioApic[IO_APIC_DATA] = value;
+}
+
+
+/// \brief	Gets the I/O APIC pin of the given ISA IRQ, or APIC_NO_PIN if it isn't wired up.
+static uint8_t InterruptController_Apic_getPin( uint32_t irqNumber )
+{
+	KDebug_assertArg( irqNumber < APIC_NUM_ISA_IRQS );
+	uint8_t pin = s_config.m_isaIrqPins[irqNumber];
+	return (pin < s_numIoApicPins) ? pin : APIC_NO_PIN;
+}
+
+
+/// \brief	Writes the low half of an ISA IRQ's redirection entry from its copy.
+///
+/// \param irqNumber	the ISA IRQ to update.
+/// \param isMasked		whether the IRQ should be masked from now on.
+static void InterruptController_Apic_setMasked( uint32_t irqNumber, bool isMasked )
+{
+	uint8_t pin = InterruptController_Apic_getPin( irqNumber );
+	if (pin == APIC_NO_PIN)
+	{
+		return;	// There is nothing to mask or unmask.
+	}
+
+	Lock_acquire( &s_ioApicLock );
+
+	s_redirections[irqNumber] = isMasked
+		? (s_redirections[irqNumber] | REDIRECTION_MASKED)
+		: (s_redirections[irqNumber] & ~((uint32_t) REDIRECTION_MASKED));
+
+	InterruptController_Apic_writeIoApic(
+		IO_APIC_REDIRECTION_TABLE + (2 * pin),
+		s_redirections[irqNumber]
+	);
+
+	Lock_release( &s_ioApicLock );
+}
+
+
+/// \brief	Masks every pin of the I/O APIC, then points each ISA IRQ at its vector on the
+///			current processor and unmasks it.
+static void InterruptController_Apic_initIoApic( void )
+{
+	uint8_t localApicId = (uint8_t) (LocalApic_read( LOCAL_APIC_ID ) >> LOCAL_APIC_ID_SHIFT);
+
+	Lock_acquire( &s_ioApicLock );
+
+	for (uint32_t pin = 0; pin < s_numIoApicPins; pin++)
+	{
+		InterruptController_Apic_writeIoApic( IO_APIC_REDIRECTION_TABLE + (2 * pin),
+			REDIRECTION_MASKED );
+	}
+
+	for (uint32_t irq = 0; irq < APIC_NUM_ISA_IRQS; irq++)
+	{
+		uint8_t pin = InterruptController_Apic_getPin( irq );
+		if (pin == APIC_NO_PIN)
+		{
+			continue;
+		}
+
+		// Fixed delivery to a single processor in physical destination mode is all zeroes.
+		uint32_t redirection = INT_HW_IRQ0 + irq;
+		if ((s_config.m_isaIrqFlags[irq] & APIC_IRQ_ACTIVE_LOW) != 0)
+		{
+			redirection |= REDIRECTION_ACTIVE_LOW;
+		}
+		if ((s_config.m_isaIrqFlags[irq] & APIC_IRQ_LEVEL) != 0)
+		{
+			redirection |= REDIRECTION_LEVEL;
+		}
+		s_redirections[irq] = redirection;
+
+		InterruptController_Apic_writeIoApic( IO_APIC_REDIRECTION_TABLE + (2 * pin) + 1,
+			(uint32_t) localApicId << REDIRECTION_DEST_SHIFT );
+		InterruptController_Apic_writeIoApic( IO_APIC_REDIRECTION_TABLE + (2 * pin),
+			redirection );
+	}
+
+	Lock_release( &s_ioApicLock );
+}
+
+
+/// \brief	Implements InterruptController_initForCurrentProcessor().
+///
+/// The first processor also takes the interrupts away from the 8259As and sets up the I/O APIC,
+/// so that, like the 8259As, every ISA IRQ starts out unmasked.
+static void InterruptController_Apic_initForCurrentProcessor( void )
+{
+	KDebug_assert( s_localApic != NULL );
+
+	// Accept every priority of interrupt, and leave the timer and error interrupts masked until
+	// someone wants them. The 8259As are out of the picture, so LINT0 is masked too. LINT1 is
+	// where the chipset sends NMIs.
+	LocalApic_write( LOCAL_APIC_TPR, 0 );
+	LocalApic_write( LOCAL_APIC_LVT_TIMER, LOCAL_APIC_LVT_MASKED | INT_APIC_TIMER );
+	LocalApic_write( LOCAL_APIC_LVT_ERROR, LOCAL_APIC_LVT_MASKED );
+	LocalApic_write( LOCAL_APIC_LVT_LINT0, LOCAL_APIC_LVT_MASKED );
+	LocalApic_write( LOCAL_APIC_LVT_LINT1, LOCAL_APIC_LVT_NMI );
+	LocalApic_write( LOCAL_APIC_SVR, LOCAL_APIC_SVR_ENABLE | INT_APIC_SPURIOUS );
+	LocalApic_write( LOCAL_APIC_ESR, 0 );
+
+	// Clear out anything the firmware may have left in service.
+	LocalApic_write( LOCAL_APIC_EOI, 0 );
+
+	if (!s_isIoApicInitialized)
+	{
+		InterruptController_x86_8259A_disable();
+
+		// Systems that boot in PIC mode have the 8259As wired straight to the processor until
+		// the IMCR is switched over.
+		if (s_config.m_hasImcr)
+		{
+			IO_out8( IMCR_SELECT, IMCR_REGISTER );
+			IO_out8( IMCR_DATA, IMCR_APIC_MODE );
+		}
+
+		InterruptController_Apic_initIoApic();
+		s_isIoApicInitialized = true;
+	}
+}
+
+
+/// \brief	Implements InterruptController_mask().
+static void InterruptController_Apic_mask( uint32_t irqNumber )
+{
+	InterruptController_Apic_setMasked( irqNumber, true );
+}
+
+
+/// \brief	Implements InterruptController_unmask().
+static void InterruptController_Apic_unmask( uint32_t irqNumber )
+{
+	InterruptController_Apic_setMasked( irqNumber, false );
+}
+
+
+/// \brief	Implements InterruptController_endOfInterrupt().
+///
+/// The local APIC knows which interrupt is in service, so the IRQ doesn't matter. This includes
+/// the local APIC's own interrupts, such as the timer, which have no ISA IRQ number.
+static void InterruptController_Apic_endOfInterrupt( uint32_t irqNumber )
+{
+	(void) irqNumber;
+	s_localApic[LOCAL_APIC_EOI / sizeof( uint32_t )] = 0;
+}
+
+
+/// \brief	Implements InterruptController_setAffinity().
+static bool InterruptController_Apic_setAffinity( uint32_t irqNumber, int processorId )
+{
+	uint8_t pin = InterruptController_Apic_getPin( irqNumber );
+	if ((pin == APIC_NO_PIN) || (processorId < 0) || (processorId >= s_config.m_numProcessors))
+	{
+		return false;
+	}
+
+	uint32_t destination = (uint32_t) s_config.m_localApicIds[processorId];
+
+	Lock_acquire( &s_ioApicLock );
+
+	InterruptController_Apic_writeIoApic( IO_APIC_REDIRECTION_TABLE + (2 * pin) + 1,
+		destination << REDIRECTION_DEST_SHIFT );
+
+	Lock_release( &s_ioApicLock );
+	return true;
+}
+
+
+
+// Public variables
+
+const InterruptControllerImpl InterruptController_x86_Apic =
+{
+	InterruptController_Apic_initForCurrentProcessor,
+	InterruptController_Apic_mask,
+	InterruptController_Apic_unmask,
+	InterruptController_Apic_endOfInterrupt,
+	InterruptController_Apic_setAffinity
+};
+
+
+
+// Public functions
+
+bool InterruptController_x86_Apic_probe( void )
+{
+	KDebug_assert( s_localApic == NULL );
+
+	if (!CpuFeatures_has( CPUFEATURE_APIC ) || !ApicConfig_discover( &s_config ))
+	{
+		return false;
+	}
+
+	volatile uint32_t* localApic = (volatile uint32_t*) DeviceWindow_mapRegisters(
+		DEVICE_WINDOW_LOCAL_APIC,
+		s_config.m_localApicPhysAddr
+	);
+	s_ioApic = (volatile uint32_t*) DeviceWindow_mapRegisters(
+		DEVICE_WINDOW_IO_APIC,
+		s_config.m_ioApicPhysAddr
+	);
+
+	// If the firmware has turned the local APIC off, or if something other than an APIC is at
+	// the addresses the tables give, the registers won't make sense.
+	uint32_t version = localApic[LOCAL_APIC_VERSION / sizeof( uint32_t )] & 0xFF;
+	uint32_t lastPin = (InterruptController_Apic_readIoApic( IO_APIC_VERSION )
+		>> IO_APIC_MAX_PIN_SHIFT) & 0xFF;
+
+	if ((version < LOCAL_APIC_MIN_VERSION) || (version > LOCAL_APIC_MAX_VERSION) ||
+		(lastPin == IO_APIC_NO_PINS))
+	{
+		s_ioApic = NULL;
+		return false;
+	}
+	s_numIoApicPins = lastPin + 1;
+
+	// Processor IDs are handed out in the order the firmware lists the processors, except that
+	// the bootstrap processor is always processor 0.
+	uint8_t bootstrapId =
+		(uint8_t) (localApic[LOCAL_APIC_ID / sizeof( uint32_t )] >> LOCAL_APIC_ID_SHIFT);
+
+	int bootstrapIndex = s_config.m_numProcessors;
+	for (int i = 0; i < s_config.m_numProcessors; i++)
+	{
+		if (s_config.m_localApicIds[i] == bootstrapId)
+		{
+			bootstrapIndex = i;
+			break;
+		}
+	}
+
+	if (bootstrapIndex == s_config.m_numProcessors)
+	{
+		// The tables left it out, or there were too many processors to fit it in.
+		bootstrapIndex = (s_config.m_numProcessors < PROCESSOR_MAX_COUNT)
+			? s_config.m_numProcessors++
+			: (s_config.m_numProcessors - 1);
+	}
+
+	for (int i = bootstrapIndex; i > 0; i--)
+	{
+		s_config.m_localApicIds[i] = s_config.m_localApicIds[i - 1];
+	}
+	s_config.m_localApicIds[0] = bootstrapId;
+
+	s_localApic = localApic;
+	return true;
+}
+
+
+bool LocalApic_isEnabled( void )
+{
+	return (s_localApic != NULL);
+}
+
+
+uint32_t LocalApic_read( uint32_t reg )
+{
+	KDebug_assert( s_localApic != NULL );
+	return s_localApic[reg / sizeof( uint32_t )];
+}
+
+
+void LocalApic_write( uint32_t reg, uint32_t value )
+{
+	KDebug_assert( s_localApic != NULL );
+	s_localApic[reg / sizeof( uint32_t )] = value;
+}
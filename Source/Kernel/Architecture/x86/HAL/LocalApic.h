@@ -0,0 +1,83 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/Architecture/x86/HAL/LocalApic.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/16
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	This file defines a utility for reaching the registers of the
+///			current processor's local APIC.
+///
+/// Every processor sees its own local APIC at the same address, so there is
+/// no need to say which one. The registers are only mapped once the
+/// InterruptController has chosen to use the APICs.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_ARCHITECTURE_X86_HAL_LOCALAPIC_H_
+#define _KERNEL_ARCHITECTURE_X86_HAL_LOCALAPIC_H_
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/// \brief	Defines the offsets of the local APIC registers, and the bits within them.
+enum LocalApic_consts
+{
+	LOCAL_APIC_ID				= 0x020,	///< Local APIC ID, in bits 24 to 31.
+	LOCAL_APIC_VERSION			= 0x030,	///< Version, in bits 0 to 7.
+	LOCAL_APIC_TPR				= 0x080,	///< Task priority.
+	LOCAL_APIC_EOI				= 0x0B0,	///< Any write signals end of interrupt.
+	LOCAL_APIC_SVR				= 0x0F0,	///< Spurious interrupt vector, and the enable bit.
+	LOCAL_APIC_ESR				= 0x280,	///< Error status.
+	LOCAL_APIC_LVT_TIMER		= 0x320,	///< Local vector table entry for the timer.
+	LOCAL_APIC_LVT_LINT0		= 0x350,	///< Local vector table entry for the LINT0 pin.
+	LOCAL_APIC_LVT_LINT1		= 0x360,	///< Local vector table entry for the LINT1 pin.
+	LOCAL_APIC_LVT_ERROR		= 0x370,	///< Local vector table entry for errors.
+	LOCAL_APIC_TIMER_INITIAL	= 0x380,	///< Count the timer starts from. Zero stops it.
+	LOCAL_APIC_TIMER_CURRENT	= 0x390,	///< Count the timer is at now.
+	LOCAL_APIC_TIMER_DIVIDE		= 0x3E0,	///< Divides the bus clock to get the timer's rate.
+
+	LOCAL_APIC_ID_SHIFT			= 24,			///< Shift of the ID in LOCAL_APIC_ID.
+	LOCAL_APIC_SVR_ENABLE		= 0x00000100,	///< Turns the local APIC on.
+	LOCAL_APIC_LVT_MASKED		= 0x00010000,	///< The local interrupt is masked.
+	LOCAL_APIC_LVT_NMI			= 0x00000400,	///< Delivery mode: NMI.
+	LOCAL_APIC_TIMER_ONE_SHOT	= 0x00000000,	///< Timer mode: Count down once, then stop.
+	LOCAL_APIC_TIMER_DIVIDE_16	= 0x00000003	///< Divide configuration: Divide by 16.
+};
+
+
+/// \brief	Indicates whether the InterruptController is using the APICs.
+///
+/// \retval true	the InterruptController uses the APICs, so the local APIC registers are mapped.
+/// \retval false	the 8259As are in use, so the local APIC must be left alone.
+bool LocalApic_isEnabled( void );
+
+
+/// \brief	Reads a register of the current processor's local APIC.
+///
+/// \param reg	the offset of the register, which is one of the LocalApic_consts.
+///
+/// \return the value of the register.
+uint32_t LocalApic_read( uint32_t reg );
+
+
+/// \brief	Writes a register of the current processor's local APIC.
+///
+/// \param reg		the offset of the register, which is one of the LocalApic_consts.
+/// \param value	the value to write.
+void LocalApic_write( uint32_t reg, uint32_t value );
+
+
+#endif
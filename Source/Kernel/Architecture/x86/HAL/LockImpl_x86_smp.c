@@ -0,0 +1,66 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/Architecture/x86/HAL/LockImpl_x86_smp.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/08
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	This file implements part of the LockImpl, QueueLockImpl, and
+///			RWLockImpl classes for the x86 MP architecture.
+///
+// ===========================================================================
+
+
+#define _KERNEL_HAL_LOCK_C_
+#include "Kernel/HAL/Lock.h"
+#undef _KERNEL_HAL_LOCK_C_
+
+#define _KERNEL_HAL_QUEUELOCK_C_
+#include "Kernel/HAL/QueueLock.h"
+#undef _KERNEL_HAL_QUEUELOCK_C_
+
+#define _KERNEL_HAL_RWLOCK_C_
+#include "Kernel/HAL/RWLock.h"
+#undef _KERNEL_HAL_RWLOCK_C_
+
+#include "Kernel/KCommon/KMem.h"
+
+
+// Public functions.
+
+Lock Lock_create( void )
+{
+	// Both tickets start at zero, which means the lock is free.
+	Lock newLock;
+	KMem_set( &newLock, 0, sizeof( Lock ) );
+	return newLock;
+}
+
+
+QueueLock QueueLock_create( void )
+{
+	QueueLock newLock;
+	newLock.m_tail = NULL;
+	return newLock;
+}
+
+
+RWLock RWLock_create( void )
+{
+	// No readers and no writer.
+	RWLock newLock;
+	newLock.m_state			= 0;
+	newLock.m_writerLock	= Lock_create();
+	return newLock;
+}
+
@@ -0,0 +1,280 @@
+; ===========================================================================
+;
+;             Copyright (C) 2004-2006 Bruce Johnston
+;
+; ===========================================================================
+;
+;   //osdev/precursor/Source/Kernel/Architecture/x86/HAL/LockImpl_x86_smp_asm.s
+;
+; ===========================================================================
+;
+;	Originating Author:	BruceJ
+;	Originating Date:	2006/May/08
+;
+; ===========================================================================
+; This file contains part of the implementation of the Lock, QueueLock, and
+; RWLock classes for the x86 MP architecture. Lock is a ticket lock and
+; QueueLock is an MCS lock. Both disable interrupts before they start
+; waiting, and keep them disabled while they hold the lock, just like the UP
+; versions. RWLock is a reader count with a writer bit, and writers line up
+; on a Lock.
+; ===========================================================================
+
+
+; Field offsets of Lock. Keep these in synch with x86_smp/HAL/LockImpl.h.
+LOCK_NOW_SERVING	equ 0		; Word: ticket of the holder.
+LOCK_NEXT_TICKET	equ 2		; Word: next ticket to hand out.
+LOCK_OLD_EFLAGS		equ 4		; Dword: EFLAGS from before the lock was acquired.
+
+; Taking a ticket adds this to the first dword, which bumps m_nextTicket without touching
+; m_nowServing.
+LOCK_TICKET_INCREMENT	equ 00010000h
+
+; Field offsets of QueueLock and QueueLockNode. Keep these in synch with
+; x86_smp/HAL/QueueLockImpl.h.
+QLOCK_TAIL			equ 0		; Dword: address of the last node in the queue, or NULL.
+QNODE_NEXT			equ 0		; Dword: address of the next node in the queue, or NULL.
+QNODE_IS_WAITING	equ 4		; Dword: non-zero until the lock is handed to this node.
+QNODE_OLD_EFLAGS	equ 8		; Dword: EFLAGS from before the lock was acquired.
+
+; Field offsets of RWLock and RWLockReader. Keep these in synch with x86_smp/HAL/RWLockImpl.h.
+RWLOCK_STATE		equ 0		; Dword: reader count, plus RWLOCK_WRITER.
+RWLOCK_WRITER_LOCK	equ 4		; Lock: serializes writers.
+RWREADER_OLD_EFLAGS	equ 0		; Dword: EFLAGS from before the lock was acquired.
+
+; Set in the RWLock state while a writer holds the lock or is waiting for readers to leave.
+RWLOCK_WRITER		equ 80000000h
+
+
+
+; ===========================================================================
+section .text
+align 4
+
+global Lock_acquire
+
+Lock_acquire:
+	; Parameters. The function is so short there isn't any point in using ebp.
+	%define	lockAddr dword [esp + 4]		; Address of the Lock structure.
+	mov eax, lockAddr
+	pushfd
+	cli
+
+	; Take a ticket. This also gets the ticket being served at the same moment, so an uncontended
+	; acquire is a single locked instruction.
+	mov edx, LOCK_TICKET_INCREMENT
+	lock xadd [eax], edx
+	mov ecx, edx
+	shr ecx, 16					; cx = our ticket; dx = ticket being served.
+	cmp dx, cx
+	je .acquired
+
+.spin:
+	; Only the holder writes m_nowServing, so everyone waiting just reads the shared cache line
+	; until it changes.
+	pause
+	cmp cx, word [eax + LOCK_NOW_SERVING]
+	jne .spin
+
+.acquired:
+	; The old EFLAGS can only be stored once we own the lock, since the previous holder needs
+	; its own value until it releases.
+	pop dword [eax + LOCK_OLD_EFLAGS]
+	ret
+
+
+global Lock_release
+
+Lock_release:
+	; Parameters. The function is so short there isn't any point in using ebp.
+	%define	lockAddr dword [esp + 4]		; Address of the Lock structure.
+	mov eax, lockAddr
+
+	; Get the old EFLAGS before the next holder can overwrite them.
+	push dword [eax + LOCK_OLD_EFLAGS]
+
+	; Serve the next ticket. Only the holder ever writes this word, and x86 doesn't move stores
+	; ahead of earlier loads or stores, so a plain increment is enough to release the lock. A
+	; concurrent LOCK XADD in Lock_acquire only changes the other word.
+	inc word [eax + LOCK_NOW_SERVING]
+	popfd
+	ret
+
+
+global QueueLock_acquire
+
+QueueLock_acquire:
+	; Parameters. The function is so short there isn't any point in using ebp.
+	%define	lockAddr dword [esp + 4]		; Address of the QueueLock structure.
+	%define	nodeAddr dword [esp + 8]		; Address of the caller's QueueLockNode.
+	mov edx, lockAddr
+	mov ecx, nodeAddr
+
+	; Unlike Lock, the old EFLAGS go in the caller's node, which nobody else writes.
+	pushfd
+	cli
+	pop dword [ecx + QNODE_OLD_EFLAGS]
+
+	mov dword [ecx + QNODE_NEXT], 0
+	mov dword [ecx + QNODE_IS_WAITING], 1
+
+	; Join the end of the queue. XCHG with memory is always locked.
+	mov eax, ecx
+	xchg [edx + QLOCK_TAIL], eax
+	test eax, eax
+	jz .acquired				; There was nobody in the queue, so the lock is ours.
+
+	; Let the previous tail know where to hand the lock, then wait for it to do so. Each waiter
+	; spins on its own node, so a hand-off only disturbs one other processor's cache.
+	mov [eax + QNODE_NEXT], ecx
+
+.spin:
+	pause
+	cmp dword [ecx + QNODE_IS_WAITING], 0
+	jne .spin
+
+.acquired:
+	ret
+
+
+global QueueLock_release
+
+QueueLock_release:
+	; Parameters. The function is so short there isn't any point in using ebp.
+	%define	lockAddr dword [esp + 4]		; Address of the QueueLock structure.
+	%define	nodeAddr dword [esp + 8]		; Address of the caller's QueueLockNode.
+	mov edx, lockAddr
+	mov ecx, nodeAddr
+
+	mov eax, [ecx + QNODE_NEXT]
+	test eax, eax
+	jnz .handOff
+
+	; Nobody has linked in behind us yet. If we're still the tail, the queue is empty, so mark the
+	; lock free and we're done.
+	push ebx
+	xor ebx, ebx
+	mov eax, ecx
+	lock cmpxchg [edx + QLOCK_TAIL], ebx
+	pop ebx
+	je .done
+
+	; Someone swapped themselves in as the tail, but hasn't linked in behind us yet. They will
+	; shortly, so wait for it.
+.waitForNext:
+	pause
+	mov eax, [ecx + QNODE_NEXT]
+	test eax, eax
+	jz .waitForNext
+
+.handOff:
+	; As with Lock_release, a plain store is enough to release on x86.
+	mov dword [eax + QNODE_IS_WAITING], 0
+
+.done:
+	push dword [ecx + QNODE_OLD_EFLAGS]
+	popfd
+	ret
+
+
+global RWLock_acquireRead
+
+RWLock_acquireRead:
+	; Parameters. The function is so short there isn't any point in using ebp.
+	%define	lockAddr	dword [esp + 4]		; Address of the RWLock structure.
+	%define	readerAddr	dword [esp + 8]		; Address of the caller's RWLockReader.
+	mov edx, lockAddr
+	mov ecx, readerAddr
+
+	; Readers can't share a place to keep the old EFLAGS, so each one keeps its own.
+	pushfd
+	cli
+	pop dword [ecx + RWREADER_OLD_EFLAGS]
+
+.retry:
+	; Count ourselves in. If there's no writer, that's all it takes, and readers never wait for
+	; each other.
+	mov eax, 1
+	lock xadd [edx + RWLOCK_STATE], eax
+	test eax, RWLOCK_WRITER
+	jnz .backOff
+	ret
+
+.backOff:
+	; There's a writer, so count ourselves back out, and wait for it to finish with interrupts
+	; the way the caller had them.
+	lock dec dword [edx + RWLOCK_STATE]
+	push dword [ecx + RWREADER_OLD_EFLAGS]
+	popfd
+
+.spin:
+	pause
+	test dword [edx + RWLOCK_STATE], RWLOCK_WRITER
+	jnz .spin
+
+	cli
+	jmp .retry
+
+
+global RWLock_releaseRead
+
+RWLock_releaseRead:
+	; Parameters. The function is so short there isn't any point in using ebp.
+	%define	lockAddr	dword [esp + 4]		; Address of the RWLock structure.
+	%define	readerAddr	dword [esp + 8]		; Address of the caller's RWLockReader.
+	mov edx, lockAddr
+	mov ecx, readerAddr
+
+	; A writer may be setting its bit at the same time, so this has to be locked.
+	lock dec dword [edx + RWLOCK_STATE]
+	push dword [ecx + RWREADER_OLD_EFLAGS]
+	popfd
+	ret
+
+
+global RWLock_acquireWrite
+
+RWLock_acquireWrite:
+	; Parameters. The function is so short there isn't any point in using ebp.
+	%define	lockAddr	dword [esp + 4]		; Address of the RWLock structure.
+
+	; Get in line behind any other writers. This also disables interrupts and keeps the old
+	; EFLAGS in the writer Lock.
+	mov eax, lockAddr
+	add eax, RWLOCK_WRITER_LOCK
+	push eax
+	call Lock_acquire
+	add esp, 4
+
+	; Keep new readers out, then wait for the ones already in to leave. Readers that back out
+	; after seeing the bit only bump the count for a moment.
+	mov eax, lockAddr
+	lock or dword [eax + RWLOCK_STATE], RWLOCK_WRITER
+
+.spin:
+	test dword [eax + RWLOCK_STATE], ~RWLOCK_WRITER
+	jz .acquired
+	pause
+	jmp .spin
+
+.acquired:
+	ret
+
+
+global RWLock_releaseWrite
+
+RWLock_releaseWrite:
+	; Parameters. The function is so short there isn't any point in using ebp.
+	%define	lockAddr	dword [esp + 4]		; Address of the RWLock structure.
+	mov eax, lockAddr
+
+	; Readers may be bumping the count while they back out, so this has to be locked.
+	lock and dword [eax + RWLOCK_STATE], ~RWLOCK_WRITER
+
+	; Let the next writer in, and restore the interrupts.
+	add eax, RWLOCK_WRITER_LOCK
+	push eax
+	call Lock_release
+	add esp, 4
+	ret
+
@@ -15,8 +15,8 @@
 ///
 /// \file
 ///
-/// \brief	This file implements part of the LockImpl class for the x86 UP
-///			architecture.
+/// \brief	This file implements part of the LockImpl, QueueLockImpl, and
+///			RWLockImpl classes for the x86 UP architecture.
 ///
 // ===========================================================================
 
@@ -25,6 +25,14 @@
 #include "Kernel/HAL/Lock.h"
 #undef _KERNEL_HAL_LOCK_C_
 
+#define _KERNEL_HAL_QUEUELOCK_C_
+#include "Kernel/HAL/QueueLock.h"
+#undef _KERNEL_HAL_QUEUELOCK_C_
+
+#define _KERNEL_HAL_RWLOCK_C_
+#include "Kernel/HAL/RWLock.h"
+#undef _KERNEL_HAL_RWLOCK_C_
+
 #include "Kernel/KCommon/KMem.h"
 
 
@@ -37,3 +45,19 @@ Lock Lock_create( void )
 	return newLock;
 }
 
+
+QueueLock QueueLock_create( void )
+{
+	QueueLock newLock;
+	KMem_set( &newLock, 0, sizeof( QueueLock ) );
+	return newLock;
+}
+
+
+RWLock RWLock_create( void )
+{
+	RWLock newLock;
+	KMem_set( &newLock, 0, sizeof( RWLock ) );
+	return newLock;
+}
+
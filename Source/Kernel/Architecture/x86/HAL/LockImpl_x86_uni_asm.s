@@ -12,7 +12,12 @@
 ;	Originating Date:	2005/Mar/31
 ;
 ; ===========================================================================
-; This file contains part of the implementation of the Lock class.
+; This file contains part of the implementation of the Lock, QueueLock, and
+; RWLock classes. On a uniprocessor, a QueueLock is laid out just like a Lock
+; and never has anyone to queue behind, so they share the same code. The
+; QueueLockNode parameter is ignored. Writing an RWLock is the same as
+; acquiring a Lock too, and reading one only differs in that the old EFLAGS
+; go in the RWLockReader instead of the lock.
 ; ===========================================================================
 
 
@@ -22,8 +27,12 @@ section .text
 align 4
 
 global Lock_acquire
+global QueueLock_acquire
+global RWLock_acquireWrite
 
 Lock_acquire:
+QueueLock_acquire:
+RWLock_acquireWrite:
 	; Parameters. The function is so short there isn't any point in using ebp.
 	%define	lock dword [esp + 4]		; Address of the Lock structure.
 	mov eax, lock
@@ -34,8 +43,12 @@ Lock_acquire:
 
 
 global Lock_release
+global QueueLock_release
+global RWLock_releaseWrite
 
 Lock_release:
+QueueLock_release:
+RWLock_releaseWrite:
 	; Parameters. The function is so short there isn't any point in using ebp.
 	%define	lock dword [esp + 4]		; Address of the Lock structure.
 	mov eax, lock
@@ -43,3 +56,26 @@ Lock_release:
 	popfd
 	ret
 
+
+global RWLock_acquireRead
+
+RWLock_acquireRead:
+	; Parameters. The function is so short there isn't any point in using ebp.
+	%define	reader dword [esp + 8]		; Address of the RWLockReader structure.
+	mov eax, reader
+	pushfd
+	cli
+	pop dword [eax]
+	ret
+
+
+global RWLock_releaseRead
+
+RWLock_releaseRead:
+	; Parameters. The function is so short there isn't any point in using ebp.
+	%define	reader dword [esp + 8]		; Address of the RWLockReader structure.
+	mov eax, reader
+	push dword [eax]
+	popfd
+	ret
+
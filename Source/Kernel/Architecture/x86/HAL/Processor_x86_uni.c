@@ -23,6 +23,7 @@
 // ===========================================================================
 
 
+#include <stddef.h>
 #include "Kernel/HAL/Processor.h"
 #include "Kernel/KCommon/KMem.h"
 #include "Kernel/KCommon/KDebug.h"
@@ -90,7 +91,7 @@ static IInterruptHandler DefaultHandler_getHandler( void )
 enum Processor_consts
 {
 	NUM_GDT_ENTRIES	= 6,	///< 1 for null selector, 1 for TSS, 4 for code + data ring 0 + 3.
-	NUM_IDT_ENTRIES = 49,	///< 19 exceptions, NMI, 12 reserved, 16 IRQs, 1 syscall vector.
+	NUM_IDT_ENTRIES = 64,	///< 19 exceptions, NMI, 12 reserved, 16 IRQs, syscall, 15 local APIC.
 	NULL_GDT_INDEX	= 0,	///< Index of "null selector" in GDT.
 	TSS_GDT_INDEX	= 1,	///< Index of global TSS in GDT.
 	CS0_GDT_INDEX	= 2,	///< Index of kernel code segment in GDT.
@@ -182,6 +183,21 @@ extern void Int45Handler( void );		///< Called by hardware in response to interr
 extern void Int46Handler( void );		///< Called by hardware in response to interrupt vector 46.
 extern void Int47Handler( void );		///< Called by hardware in response to interrupt vector 47.
 extern void Int48Handler( void );		///< Called by hardware in response to interrupt vector 48.
+extern void Int49Handler( void );		///< Called by hardware in response to interrupt vector 49.
+extern void Int50Handler( void );		///< Called by hardware in response to interrupt vector 50.
+extern void Int51Handler( void );		///< Called by hardware in response to interrupt vector 51.
+extern void Int52Handler( void );		///< Called by hardware in response to interrupt vector 52.
+extern void Int53Handler( void );		///< Called by hardware in response to interrupt vector 53.
+extern void Int54Handler( void );		///< Called by hardware in response to interrupt vector 54.
+extern void Int55Handler( void );		///< Called by hardware in response to interrupt vector 55.
+extern void Int56Handler( void );		///< Called by hardware in response to interrupt vector 56.
+extern void Int57Handler( void );		///< Called by hardware in response to interrupt vector 57.
+extern void Int58Handler( void );		///< Called by hardware in response to interrupt vector 58.
+extern void Int59Handler( void );		///< Called by hardware in response to interrupt vector 59.
+extern void Int60Handler( void );		///< Called by hardware in response to interrupt vector 60.
+extern void Int61Handler( void );		///< Called by hardware in response to interrupt vector 61.
+extern void Int62Handler( void );		///< Called by hardware in response to interrupt vector 62.
+extern void Int63Handler( void );		///< Called by hardware in response to interrupt vector 63.
 
 
 // The following functions cannot be static because they are called from assembler.
@@ -323,6 +339,21 @@ IdtEntry* Processor_initIdt( Processor* processor )
 	CREATE_INT_HANDLER_IDT_ENTRY( processor, 46 );
 	CREATE_INT_HANDLER_IDT_ENTRY( processor, 47 );
 	CREATE_INT_HANDLER_IDT_ENTRY( processor, 48 );
+	CREATE_INT_HANDLER_IDT_ENTRY( processor, 49 );
+	CREATE_INT_HANDLER_IDT_ENTRY( processor, 50 );
+	CREATE_INT_HANDLER_IDT_ENTRY( processor, 51 );
+	CREATE_INT_HANDLER_IDT_ENTRY( processor, 52 );
+	CREATE_INT_HANDLER_IDT_ENTRY( processor, 53 );
+	CREATE_INT_HANDLER_IDT_ENTRY( processor, 54 );
+	CREATE_INT_HANDLER_IDT_ENTRY( processor, 55 );
+	CREATE_INT_HANDLER_IDT_ENTRY( processor, 56 );
+	CREATE_INT_HANDLER_IDT_ENTRY( processor, 57 );
+	CREATE_INT_HANDLER_IDT_ENTRY( processor, 58 );
+	CREATE_INT_HANDLER_IDT_ENTRY( processor, 59 );
+	CREATE_INT_HANDLER_IDT_ENTRY( processor, 60 );
+	CREATE_INT_HANDLER_IDT_ENTRY( processor, 61 );
+	CREATE_INT_HANDLER_IDT_ENTRY( processor, 62 );
+	CREATE_INT_HANDLER_IDT_ENTRY( processor, 63 );
 
 	return processor->m_idt;
 }
@@ -429,3 +460,45 @@ void Processor_registerHandler(
 }
 
 
+
+
+TrapFrame* Processor_createKernelThreadFrame(
+	void*						stackBase,
+	size_t						stackSize,
+	Processor_threadStartFunc	start,
+	void*						arg,
+	Processor_threadExitFunc	exitFunc
+)
+{
+	KDebug_assertArg( stackBase != NULL );
+	KDebug_assertArg( start != NULL );
+	KDebug_assertArg( exitFunc != NULL );
+
+	// iretd doesn't pop ESP and SS when it stays in ring 0, so the part of the TrapFrame where
+	// they would be is where the new thread's stack starts. Put a return address and an argument
+	// there, so that it looks to start() as if it had been called by exitFunc().
+	size_t kernelFrameSize = offsetof( TrapFrame, esp3 );
+	size_t callFrameSize = 2 * sizeof( uint32_t );
+	KDebug_assertArg( stackSize >= kernelFrameSize + callFrameSize );
+
+	uintptr_t stackTop	= ((uintptr_t) stackBase + stackSize) & ~((uintptr_t) 3);	// Align to 4.
+	uint32_t* callFrame	= (uint32_t*) (stackTop - callFrameSize);
+	callFrame[0] = (uint32_t) exitFunc;
+	callFrame[1] = (uint32_t) arg;
+
+	TrapFrame* frame = (TrapFrame*) ((uintptr_t) callFrame - kernelFrameSize);
+	KMem_set( frame, 0, kernelFrameSize );
+
+	frame->gs	= KERNEL_DATASEG_SELECTOR;
+	frame->fs	= KERNEL_DATASEG_SELECTOR;
+	frame->es	= KERNEL_DATASEG_SELECTOR;
+	frame->ds	= KERNEL_DATASEG_SELECTOR;
+	frame->cs	= KERNEL_CODESEG_SELECTOR;
+	frame->eip	= (uint32_t) start;
+
+	// EBP is left as 0 so that stack traces end at start().
+	frame->eflags.Reserved1	= 1;
+	frame->eflags.IF		= 1;
+
+	return frame;
+}
@@ -25,10 +25,12 @@ extern Processor_initGdt
 extern Processor_initIdt
 extern Processor_initTss
 extern Processor_initDispatchTable
+extern CpuFeatures_init
+extern KMem_init
 
 ; Keep these in synch with the definitions in the C file.
 GDT_SIZE	equ 6 * 8
-IDT_SIZE	equ 49 * 8
+IDT_SIZE	equ 64 * 8
 CS0_SEL		equ 2 << 3
 SS0_SEL		equ 3 << 3
 
@@ -150,6 +152,23 @@ IntHandler		47		; Hardware IRQ15
 ; For handy reference, this is 0x30 hex. So, userland code must execute int 30h to invoke a
 ; Precursor system call.
 IntHandler		48
+; The local APIC's own interrupts. Only 49 (timer) and 63 (spurious) are used so far; The rest are
+; reserved for other local interrupt sources.
+IntHandler		49
+IntHandler		50
+IntHandler		51
+IntHandler		52
+IntHandler		53
+IntHandler		54
+IntHandler		55
+IntHandler		56
+IntHandler		57
+IntHandler		58
+IntHandler		59
+IntHandler		60
+IntHandler		61
+IntHandler		62
+IntHandler		63
 
 
 EnterKernel:
@@ -167,6 +186,8 @@ PFEnterKernel:			; PF handler pushes its own GPRs and saves cr2.
 	mov es, eax			;  switch. If this is an initial entry into the kernel, then this stack
 	mov fs, eax			;  switch just happened. Otherwise, it happend on the first entry, but
 	mov gs, eax			;  the kernel itself guarantees that CS and SS will not be changed.
+	cld					; C code expects DF to be clear, but the interrupted code may have set
+						;  it (e.g. -- KMem_move() copying backwards). iretd will restore it.
 
 	; Get current Processor* in eax.
 	call Processor_getCurrent
@@ -213,6 +234,9 @@ Processor_initPrimary:
 	; any failures have a predictable result (i.e. -- automatic reboot).
 	lidt [ZeroSizeIdt]			; Load the IDTR with a zero-size IDT.
 
+	call CpuFeatures_init		; Find out what this processor can do, then let KMem pick the
+	call KMem_init				; routines that suit it before any other C code gets to use them.
+
 	call Processor_getCurrent	; Get current Processor* and put it in ebx for easy access.
 	mov ebx, eax
 	push ebx
@@ -0,0 +1,68 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/Architecture/x86/HAL/SystemTimer_x86.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/16
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	This file defines the SystemTimer class for the x86 architecture.
+///			It picks the best timer hardware the system has when the bootstrap
+///			processor initializes it, and then delegates to that implementation.
+///
+/// The local APIC timer is used if the APICs are in use and the processor has
+/// an invariant timestamp counter, since reading the clock is then a single
+/// instruction rather than a handful of port accesses, and since it can wait
+/// far longer than the 8254 between interrupts. Otherwise, the 8254 PIT that
+/// every AT-compatible PC has is used.
+///
+// ===========================================================================
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Kernel/HAL/SystemTimer.h"
+#include "Kernel/KCommon/KDebug.h"
+#include "SystemTimer_x86.h"
+
+
+// Private variables
+
+/// \brief	The implementation in use, or NULL until the bootstrap processor has picked one.
+static const SystemTimerImpl* s_impl = NULL;
+
+
+
+// Public functions
+
+void SystemTimer_initForCurrentProcessor( void )
+{
+	if (s_impl == NULL)
+	{
+		s_impl = SystemTimer_x86_Apic_isUsable() ? &SystemTimer_x86_Apic : &SystemTimer_x86_8254;
+	}
+	s_impl->initForCurrentProcessor();
+}
+
+
+uint64_t SystemTimer_getTime( void )
+{
+	KDebug_assert( s_impl != NULL );
+	return s_impl->getTime();
+}
+
+
+void SystemTimer_setNextInterrupt( uint64_t deadline )
+{
+	KDebug_assert( s_impl != NULL );
+	s_impl->setNextInterrupt( deadline );
+}
@@ -0,0 +1,71 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/Architecture/x86/HAL/SystemTimer_x86.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/16
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	This file defines the interface between the x86 SystemTimer class
+///			and the hardware-specific implementations that it chooses between
+///			at boot.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_ARCHITECTURE_X86_HAL_SYSTEMTIMER_X86_H_
+#define _KERNEL_ARCHITECTURE_X86_HAL_SYSTEMTIMER_X86_H_
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/// \brief	The functions that implement the SystemTimer class for one kind of hardware.
+///
+/// Each one works exactly like the SystemTimer function of the same name.
+typedef struct
+{
+	/// \brief	Starts the clock and the timer hardware for the current processor.
+	void (*initForCurrentProcessor)( void );
+
+	/// \brief	Gets the current time.
+	uint64_t (*getTime)( void );
+
+	/// \brief	Programs the next interrupt.
+	void (*setNextInterrupt)( uint64_t deadline );
+
+} SystemTimerImpl;
+
+
+/// \brief	The implementation for channel 0 of the 8254 PIT, which interrupts on INT_HW_IRQ0. This
+///			is the fallback for systems where the local APIC timer can't be used.
+extern const SystemTimerImpl SystemTimer_x86_8254;
+
+
+/// \brief	The implementation for the local APIC timer, which interrupts on INT_APIC_TIMER.
+///
+/// It may only be used if SystemTimer_x86_Apic_isUsable() returns \c true.
+extern const SystemTimerImpl SystemTimer_x86_Apic;
+
+
+/// \brief	Indicates whether the local APIC timer can be used.
+///
+/// This must be called after InterruptController_initForCurrentProcessor() has been called on the
+/// bootstrap processor.
+///
+/// \retval true	the InterruptController is using the APICs, and the processor has a timestamp
+///					counter that runs at a constant rate to keep time with.
+/// \retval false	the 8254 has to be used.
+bool SystemTimer_x86_Apic_isUsable( void );
+
+
+#endif
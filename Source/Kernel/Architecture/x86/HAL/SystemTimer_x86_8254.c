@@ -0,0 +1,188 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/Architecture/x86/HAL/SystemTimer_x86_8254.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/12
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	This file implements the SystemTimer class for the x86
+///			architecture using channel 0 of the Intel 8254-compatible PIT.
+///			It is the fallback for systems where the local APIC timer can't
+///			be used.
+///
+/// Channel 0 of the PIT is wired to IRQ0, so the timer interrupts arrive on
+/// INT_HW_IRQ0. It is run in mode 0, which counts down once and raises IRQ0
+/// when it reaches zero. The PIT counts at about 1.19 MHz with a 16-bit
+/// counter, so it can wait at most about 55 ms; An idle processor with
+/// nothing to wait for still takes about 18 interrupts a second.
+///
+/// The clock is kept in PIT counts: Each time the counter is reprogrammed,
+/// the counts that elapsed since it was last programmed are added to the
+/// total. The read-back command gives both the counter and the state of its
+/// output, so the counts are right even if the interrupt is still pending.
+/// Only the few counts between reading the counter and reloading it are lost.
+///
+// ===========================================================================
+
+
+#include <stdint.h>
+#include "IO.h"
+#include "Kernel/KCommon/KDebug.h"
+#include "Kernel/KCommon/KMem.h"
+#include "SystemTimer_x86.h"
+
+
+// Private constants
+
+/// \brief	Defines local constants for the SystemTimer class.
+enum SystemTimer_consts
+{
+	PIT_MAX_COUNT			= 0x10000,	///< Largest count. It is programmed as 0.
+	PIT_MIN_COUNT			= 2,		///< Smallest count worth programming.
+	PIT_CHANNEL0_DATA		= 0x0040,	///< Channel 0 data port.
+	PIT_COMMAND				= 0x0043,	///< Mode/command port.
+	PIT_SELECT_CHANNEL0		= 0x00,		///< Command bits that select channel 0.
+	PIT_ACCESS_LOHI			= 0x30,		///< Command bits for writing the low, then high byte.
+	PIT_MODE_ONE_SHOT		= 0x00,		///< Command bits for mode 0, interrupt on terminal count.
+	PIT_READ_BACK_CHANNEL0	= 0xC2,		///< Read-back command for channel 0's status and count.
+	PIT_STATUS_OUTPUT		= 0x80,		///< Status bit that is set once the count has reached zero.
+	PIT_STATUS_NULL_COUNT	= 0x40,		///< Status bit that is set until a new count is loaded.
+
+	/// \brief	The longest wait to program, in microseconds. It is a little less than the PIT can
+	///			count so that the conversion below can't overflow.
+	MAX_WAIT_MICROSECONDS	= 54000,
+
+	/// \brief	PIT counts per microsecond, times 65536, and rounded up so waits never come short.
+	COUNTS_PER_MICROSECOND_16_16	= 78197,
+
+	/// \brief	Microseconds per PIT count, times 65536.
+	MICROSECONDS_PER_COUNT_16_16	= 54925
+};
+
+
+
+// Private variables
+
+/// \brief	The number of counts in all the intervals before the current one.
+static uint64_t s_countsBefore = 0;
+
+/// \brief	The number of counts that the current interval started with.
+static uint32_t s_intervalCounts = PIT_MAX_COUNT;
+
+
+
+// Private functions
+
+/// \brief	Gets the number of counts since the PIT was last programmed.
+static uint32_t SystemTimer_getCountsInInterval( void )
+{
+	IO_out8( PIT_COMMAND, PIT_READ_BACK_CHANNEL0 );
+	uint8_t status	= IO_in8( PIT_CHANNEL0_DATA );
+	uint8_t low		= IO_in8( PIT_CHANNEL0_DATA );
+	uint8_t high	= IO_in8( PIT_CHANNEL0_DATA );
+	uint32_t count	= ((uint32_t) high << 8) | low;
+
+	if ((status & PIT_STATUS_NULL_COUNT) != 0)
+	{
+		// The new count hasn't even been loaded yet.
+		return 0;
+	}
+	else if ((status & PIT_STATUS_OUTPUT) != 0)
+	{
+		// The interval is over, and the counter has carried on down from 0xFFFF since.
+		return s_intervalCounts + ((PIT_MAX_COUNT - count) & (PIT_MAX_COUNT - 1));
+	}
+	else
+	{
+		// A count of 0 means the interval started at 0x10000 and hasn't counted down yet.
+		return s_intervalCounts - ((count == 0) ? PIT_MAX_COUNT : count);
+	}
+}
+
+
+/// \brief	Converts a number of PIT counts to microseconds.
+static uint64_t SystemTimer_toMicroseconds( uint64_t counts )
+{
+	// Convert 16 bits at a time so that the multiplication can't overflow, and so that it doesn't
+	// need a 64-bit division, which the kernel has no runtime support for.
+	return ((counts >> 16) * MICROSECONDS_PER_COUNT_16_16)
+		+ (((counts & 0xFFFF) * MICROSECONDS_PER_COUNT_16_16) >> 16);
+}
+
+
+/// \brief	Starts a new interval of the given number of counts.
+static void SystemTimer_startInterval( uint32_t counts )
+{
+	KDebug_assert( (PIT_MIN_COUNT <= counts) && (counts <= PIT_MAX_COUNT) );
+	s_intervalCounts = counts;
+
+	// A count of 0x10000 doesn't fit in 16 bits, but the PIT treats 0 as 0x10000, which is
+	// exactly what truncating it gives.
+	uint16_t count = (uint16_t) counts;
+
+	IO_out8( PIT_COMMAND, PIT_SELECT_CHANNEL0 | PIT_ACCESS_LOHI | PIT_MODE_ONE_SHOT );
+	IO_out8( PIT_CHANNEL0_DATA, KMem_low8( count ) );
+	IO_out8( PIT_CHANNEL0_DATA, KMem_high8( count ) );
+}
+
+
+/// \brief	Implements SystemTimer_initForCurrentProcessor().
+static void SystemTimer_8254_initForCurrentProcessor( void )
+{
+	s_countsBefore = 0;
+	SystemTimer_startInterval( PIT_MAX_COUNT );
+}
+
+
+/// \brief	Implements SystemTimer_getTime().
+static uint64_t SystemTimer_8254_getTime( void )
+{
+	return SystemTimer_toMicroseconds( s_countsBefore + SystemTimer_getCountsInInterval() );
+}
+
+
+/// \brief	Implements SystemTimer_setNextInterrupt().
+static void SystemTimer_8254_setNextInterrupt( uint64_t deadline )
+{
+	// The current interval ends here, whether or not it has run out.
+	s_countsBefore += SystemTimer_getCountsInInterval();
+	uint64_t now = SystemTimer_toMicroseconds( s_countsBefore );
+
+	uint32_t wait;
+	if (deadline <= now)
+	{
+		wait = 0;
+	}
+	else if (deadline - now > MAX_WAIT_MICROSECONDS)
+	{
+		wait = MAX_WAIT_MICROSECONDS;
+	}
+	else
+	{
+		wait = (uint32_t) (deadline - now);
+	}
+
+	uint32_t counts = ((wait * COUNTS_PER_MICROSECOND_16_16) + 0xFFFF) >> 16;
+	SystemTimer_startInterval( (counts < PIT_MIN_COUNT) ? PIT_MIN_COUNT : counts );
+}
+
+
+
+// Public variables
+
+const SystemTimerImpl SystemTimer_x86_8254 =
+{
+	SystemTimer_8254_initForCurrentProcessor,
+	SystemTimer_8254_getTime,
+	SystemTimer_8254_setNextInterrupt
+};
@@ -0,0 +1,286 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/Architecture/x86/HAL/SystemTimer_x86_Apic.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/16
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	This file implements the SystemTimer class for the x86
+///			architecture using the local APIC timer, with the timestamp
+///			counter as the clock.
+///
+/// The local APIC timer interrupts on INT_APIC_TIMER. It is run in one-shot
+/// mode, counting down from a 32-bit count at a sixteenth of the bus clock,
+/// so it can wait far longer than the 8254. Once it reaches zero, though, it
+/// stops, so it can't keep time the way the 8254 does. The timestamp counter
+/// does that instead, which is why this implementation is only used if the
+/// TSC is invariant. Reading the clock is then a single instruction, and a
+/// processor with nothing to wait for isn't interrupted at all.
+///
+/// Neither the TSC nor the local APIC timer runs at a rate that can be looked
+/// up, so both are measured against channel 2 of the 8254 when the timer is
+/// first checked for, which takes about 50 ms. Channel 2 is the one wired to
+/// the speaker; Unlike channel 0, it can be polled without interrupting.
+///
+// ===========================================================================
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "HAL/CpuFeatures.h"
+#include "HAL/Tsc.h"
+#include "IO.h"
+#include "LocalApic.h"
+#include "Kernel/HAL/InterruptController.h"
+#include "Kernel/KCommon/KDebug.h"
+#include "Kernel/KCommon/KMem.h"
+#include "Kernel/Architecture/x86/HAL/PrecursorVectors_x86.h"	// For INT_APIC_TIMER.
+#include "SystemTimer_x86.h"
+
+
+// Private constants
+
+/// \brief	Defines private constants for the local APIC implementation of SystemTimer.
+enum SystemTimer_Apic_consts
+{
+	PIT_CHANNEL2_DATA		= 0x0042,	///< Channel 2 data port.
+	PIT_COMMAND				= 0x0043,	///< Mode/command port.
+	PIT_CHANNEL2_ONE_SHOT	= 0xB0,		///< Channel 2, low then high byte, mode 0.
+	PIT_CONTROL				= 0x0061,	///< System control port B, which gates channel 2.
+	PIT_CONTROL_GATE2		= 0x01,		///< Lets channel 2 count.
+	PIT_CONTROL_SPEAKER		= 0x02,		///< Connects channel 2 to the speaker.
+	PIT_CONTROL_OUT2		= 0x20,		///< Set once channel 2 has counted down to zero.
+	PIT_IRQ					= 0,		///< The IRQ that channel 0 of the PIT raises.
+
+	/// \brief	PIT counts to calibrate against. At 1193182 Hz, this is 50 ms to within a
+	///			microsecond.
+	CALIBRATION_PIT_COUNTS		= 59659,
+
+	/// \brief	The length of the calibration, in microseconds.
+	CALIBRATION_MICROSECONDS	= 50000,
+
+	/// \brief	The longest wait to program, in microseconds. It keeps the conversion to counts
+	///			below from overflowing, even with a bus clock of several GHz.
+	MAX_WAIT_MICROSECONDS		= 1000000
+};
+
+
+/// \brief	The count the local APIC timer starts from during calibration.
+static const uint32_t CALIBRATION_START_COUNT = 0xFFFFFFFF;
+
+
+
+// Private variables
+
+/// \brief	Microseconds per TSC tick, times 2^32. Zero until the timer has been calibrated.
+static uint32_t s_microsecondsPerTick_0_32 = 0;
+
+/// \brief	Local APIC timer counts per microsecond, times 65536, and rounded up so that waits never
+///			come short.
+static uint32_t s_countsPerMicrosecond_16_16 = 0;
+
+/// \brief	The TSC when the clock was started.
+static uint64_t s_tscAtStart = 0;
+
+/// \brief	Whether the clock has been started.
+static bool s_isClockStarted = false;
+
+
+
+// Private functions
+
+/// \brief	Divides a 64-bit number by a 32-bit one, when the quotient is known to fit in 32 bits.
+///
+/// The kernel has no runtime support for 64-bit division, so this works a bit at a time, the
+/// long way. It is only used during calibration.
+static uint32_t SystemTimer_Apic_divide( uint64_t dividend, uint32_t divisor )
+{
+	KDebug_assertArg( divisor != 0 );
+
+	uint64_t quotient = 0;
+	uint64_t remainder = 0;
+	for (int bit = 63; bit >= 0; bit--)
+	{
+		remainder = (remainder << 1) | ((dividend >> bit) & 1);
+		quotient <<= 1;
+		if (remainder >= divisor)
+		{
+			remainder -= divisor;
+			quotient |= 1;
+		}
+	}
+
+	KDebug_assert( (quotient >> 32) == 0 );
+	return (uint32_t) quotient;
+}
+
+
+/// \brief	Measures the rates of the TSC and the local APIC timer against the 8254.
+///
+/// \retval true	both rates were measured.
+/// \retval false	one of them didn't seem to be running, or the 8254 never finished counting.
+static bool SystemTimer_Apic_calibrate( void )
+{
+	// Load channel 2 with its gate closed, so that it doesn't start counting until everything is
+	// ready. Writing the mode drops its output until it reaches zero.
+	uint8_t control = IO_in8( PIT_CONTROL );
+	IO_out8( PIT_CONTROL, control & ~(PIT_CONTROL_GATE2 | PIT_CONTROL_SPEAKER) );
+	IO_out8( PIT_COMMAND, PIT_CHANNEL2_ONE_SHOT );
+	IO_out8( PIT_CHANNEL2_DATA, KMem_low8( CALIBRATION_PIT_COUNTS ) );
+	IO_out8( PIT_CHANNEL2_DATA, KMem_high8( CALIBRATION_PIT_COUNTS ) );
+
+	LocalApic_write( LOCAL_APIC_TIMER_DIVIDE, LOCAL_APIC_TIMER_DIVIDE_16 );
+	LocalApic_write( LOCAL_APIC_LVT_TIMER,
+		LOCAL_APIC_LVT_MASKED | LOCAL_APIC_TIMER_ONE_SHOT | INT_APIC_TIMER );
+
+	IO_out8( PIT_CONTROL, (control & ~PIT_CONTROL_SPEAKER) | PIT_CONTROL_GATE2 );
+	LocalApic_write( LOCAL_APIC_TIMER_INITIAL, CALIBRATION_START_COUNT );
+	uint64_t tscBefore = Tsc_read();
+
+	// Wait for channel 2 to reach zero. If the gate or channel 2 doesn't work, as on some virtual
+	// machines and legacy-free boards, it never will, so give up once the TSC has run for 2^32
+	// ticks. That is still over 800 ms at 5 GHz, far longer than the calibration should take, and
+	// the check below rejects it.
+	uint64_t tscAfter = tscBefore;
+	while (((IO_in8( PIT_CONTROL ) & PIT_CONTROL_OUT2) == 0) &&
+		(((tscAfter - tscBefore) >> 32) == 0))
+	{
+		tscAfter = Tsc_read();
+	}
+
+	tscAfter = Tsc_read();
+	uint32_t counts = CALIBRATION_START_COUNT - LocalApic_read( LOCAL_APIC_TIMER_CURRENT );
+	LocalApic_write( LOCAL_APIC_TIMER_INITIAL, 0 );
+	IO_out8( PIT_CONTROL, control );
+
+	// A 50 ms TSC delta only overflows 32 bits above 85 GHz. Anything under a tick per
+	// microsecond would make the TSC useless as a clock anyway.
+	uint64_t ticks = tscAfter - tscBefore;
+	if ((ticks <= CALIBRATION_MICROSECONDS) || ((ticks >> 32) != 0) || (counts == 0))
+	{
+		return false;
+	}
+
+	s_microsecondsPerTick_0_32 = SystemTimer_Apic_divide(
+		(uint64_t) CALIBRATION_MICROSECONDS << 32,
+		(uint32_t) ticks
+	);
+	s_countsPerMicrosecond_16_16 = SystemTimer_Apic_divide(
+		((uint64_t) counts << 16) + (CALIBRATION_MICROSECONDS - 1),
+		CALIBRATION_MICROSECONDS
+	);
+	return true;
+}
+
+
+/// \brief	Converts a number of TSC ticks to microseconds.
+static uint64_t SystemTimer_Apic_toMicroseconds( uint64_t ticks )
+{
+	// Multiply each half separately so that nothing overflows, and so that it doesn't need any
+	// runtime support.
+	uint32_t high	= (uint32_t) (ticks >> 32);
+	uint32_t low	= (uint32_t) ticks;
+	return ((uint64_t) high * s_microsecondsPerTick_0_32)
+		+ (((uint64_t) low * s_microsecondsPerTick_0_32) >> 32);
+}
+
+
+/// \brief	Implements SystemTimer_getTime().
+static uint64_t SystemTimer_Apic_getTime( void )
+{
+	return SystemTimer_Apic_toMicroseconds( Tsc_read() - s_tscAtStart );
+}
+
+
+/// \brief	Implements SystemTimer_setNextInterrupt().
+static void SystemTimer_Apic_setNextInterrupt( uint64_t deadline )
+{
+	if (deadline == UINT64_MAX)
+	{
+		// The TSC keeps time on its own, so the timer can just be stopped.
+		LocalApic_write( LOCAL_APIC_TIMER_INITIAL, 0 );
+		return;
+	}
+
+	uint64_t now = SystemTimer_Apic_getTime();
+
+	uint32_t wait;
+	if (deadline <= now)
+	{
+		wait = 0;
+	}
+	else if (deadline - now > MAX_WAIT_MICROSECONDS)
+	{
+		wait = MAX_WAIT_MICROSECONDS;
+	}
+	else
+	{
+		wait = (uint32_t) (deadline - now);
+	}
+
+	// Writing the initial count starts a new countdown, and cancels the old one.
+	uint64_t counts = (((uint64_t) wait * s_countsPerMicrosecond_16_16) + 0xFFFF) >> 16;
+	LocalApic_write( LOCAL_APIC_TIMER_INITIAL, (counts == 0) ? 1 : (uint32_t) counts );
+}
+
+
+/// \brief	Implements SystemTimer_initForCurrentProcessor().
+///
+/// Invariant TSCs run in step on every processor, so the clock is only started once, by the
+/// bootstrap processor.
+static void SystemTimer_Apic_initForCurrentProcessor( void )
+{
+	KDebug_assert( s_countsPerMicrosecond_16_16 != 0 );
+
+	// Channel 0 of the PIT keeps interrupting in whatever mode the BIOS left it in, and nothing
+	// needs it any more. It is safe to cast away volatile, since interrupts must be disabled.
+	InterruptController* pic = (InterruptController*) InterruptController_getForCurrentProcessor();
+	InterruptController_mask( pic, PIT_IRQ );
+
+	if (!s_isClockStarted)
+	{
+		s_tscAtStart = Tsc_read();
+		s_isClockStarted = true;
+	}
+
+	LocalApic_write( LOCAL_APIC_TIMER_DIVIDE, LOCAL_APIC_TIMER_DIVIDE_16 );
+	LocalApic_write( LOCAL_APIC_LVT_TIMER, LOCAL_APIC_TIMER_ONE_SHOT | INT_APIC_TIMER );
+	SystemTimer_Apic_setNextInterrupt( SystemTimer_Apic_getTime() + MAX_WAIT_MICROSECONDS );
+}
+
+
+
+// Public variables
+
+const SystemTimerImpl SystemTimer_x86_Apic =
+{
+	SystemTimer_Apic_initForCurrentProcessor,
+	SystemTimer_Apic_getTime,
+	SystemTimer_Apic_setNextInterrupt
+};
+
+
+
+// Public functions
+
+bool SystemTimer_x86_Apic_isUsable( void )
+{
+	if (s_countsPerMicrosecond_16_16 != 0)
+	{
+		return true;
+	}
+
+	return LocalApic_isEnabled()
+		&& CpuFeatures_has( CPUFEATURE_INVARIANT_TSC )
+		&& SystemTimer_Apic_calibrate();
+}
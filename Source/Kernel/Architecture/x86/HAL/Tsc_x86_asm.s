@@ -0,0 +1,29 @@
+; ===========================================================================
+;
+;             Copyright (C) 2004-2006 Bruce Johnston
+;
+; ===========================================================================
+;
+;   //osdev/precursor/Source/Kernel/Architecture/x86/HAL/Tsc_x86_asm.s
+;
+; ===========================================================================
+;
+;	Originating Author:	BruceJ
+;	Originating Date:	2006/May/10
+;
+; ===========================================================================
+; This file contains the implementation of the Tsc utility functions.
+; ===========================================================================
+
+
+
+; ===========================================================================
+section .text
+align 4
+
+global Tsc_read
+
+Tsc_read:
+		; RDTSC leaves the counter in edx:eax, which is exactly where a uint64_t is returned.
+		rdtsc
+		ret
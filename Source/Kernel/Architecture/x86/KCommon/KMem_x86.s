@@ -17,100 +17,633 @@
 
 
 
+; Copies and fills shorter than this are done a byte at a time. Aligning the destination first
+; would cost more than it saves.
+DWORD_MIN_BYTES	equ 16
+
+; Copies and fills shorter than this don't use SSE2, since saving and restoring the XMM registers
+; would cost more than it saves.
+SSE2_MIN_BYTES	equ 256
+
+; The SSE2 routines run with interrupts disabled, since a thread switch doesn't save the XMM
+; registers, and a thread preempted in the middle of a copy would resume with another thread's
+; data in them. Longer copies and fills let interrupts in after every chunk of this many bytes,
+; once nothing is left in the XMM registers that they still need.
+SSE2_CHUNK_BYTES	equ 4096
+
+; The interrupt flag in EFLAGS.
+EFLAGS_IF		equ 0x00000200
+
+; Size of the pages that KMem_clearPage() and KMem_copyPage() work on. Keep this in synch with
+; PAGE_SIZE in MMImpl.h.
+PAGE_BYTES		equ 4096
+
+; Keep these in synch with the CpuFeature definitions in CpuFeatures.h.
+CPUFEATURE_SSE2		equ 0x00000008
+CPUFEATURE_POPCNT	equ 0x00000010
+CPUFEATURE_LZCNT	equ 0x00000020
+CPUFEATURE_TZCNT	equ 0x00000040
+CPUFEATURE_ERMSB	equ 0x00000080
+
+
+; KMem_init() asks the HAL what the processor supports. libKCommon is linked after libHAL, but
+; this still resolves, since Processor_initPrimary() has already pulled in the CpuFeatures module.
+extern CpuFeatures_getAll
+
+
+; ===========================================================================
+section .data
+align 4
+; The implementations of the dispatched KMem functions to use. These start out pointing at the
+; versions that work on any processor. KMem_init() switches them to faster versions if the
+; processor supports them.
+KMemCopyImpl:
+	dd	KMem_copyDword
+KMemSetImpl:
+	dd	KMem_setDword
+KMemClearPageImpl:
+	dd	KMem_clearPageDword
+KMemCopyPageImpl:
+	dd	KMem_copyPageDword
+KMemFindLowestSetBitImpl:
+	dd	KMem_findLowestSetBitBsf
+KMemFindHighestSetBitImpl:
+	dd	KMem_findHighestSetBitBsr
+KMemCountSetBitsImpl:
+	dd	KMem_countSetBitsSwar
+
+
 ; ===========================================================================
 section .text
 align 4
 
+global KMem_init
+
+KMem_init:
+	call CpuFeatures_getAll
+	push eax
+	call KMem_x86_initForFeatures
+	add esp, 4
+	ret
+
+
+global KMem_x86_initForFeatures
+
+KMem_x86_initForFeatures:
+	mov eax, [esp + 4]	; The features to pick implementations for.
+
+	; Start over with the versions that work on any processor, so that tests can narrow the
+	; features down again after KMem_init() has run.
+	mov dword [KMemCopyImpl], KMem_copyDword
+	mov dword [KMemSetImpl], KMem_setDword
+	mov dword [KMemClearPageImpl], KMem_clearPageDword
+	mov dword [KMemCopyPageImpl], KMem_copyPageDword
+	mov dword [KMemFindLowestSetBitImpl], KMem_findLowestSetBitBsf
+	mov dword [KMemFindHighestSetBitImpl], KMem_findHighestSetBitBsr
+	mov dword [KMemCountSetBitsImpl], KMem_countSetBitsSwar
+
+	test eax, CPUFEATURE_SSE2
+	jz .checkErms
+	mov dword [KMemCopyImpl], KMem_copySse2
+	mov dword [KMemSetImpl], KMem_setSse2
+	mov dword [KMemClearPageImpl], KMem_clearPageSse2
+	mov dword [KMemCopyPageImpl], KMem_copyPageSse2
+
+.checkErms:
+	; With fast strings, a plain rep movsb or rep stosb beats anything that can be done by hand,
+	; SSE2 included. The page routines keep using SSE2 though, since they are there to bypass
+	; the caches, not just to be fast.
+	test eax, CPUFEATURE_ERMSB
+	jz .checkTzcnt
+	mov dword [KMemCopyImpl], KMem_copyErms
+	mov dword [KMemSetImpl], KMem_setErms
+
+.checkTzcnt:
+	test eax, CPUFEATURE_TZCNT
+	jz .checkLzcnt
+	mov dword [KMemFindLowestSetBitImpl], KMem_findLowestSetBitTzcnt
+
+.checkLzcnt:
+	test eax, CPUFEATURE_LZCNT
+	jz .checkPopcnt
+	mov dword [KMemFindHighestSetBitImpl], KMem_findHighestSetBitLzcnt
+
+.checkPopcnt:
+	test eax, CPUFEATURE_POPCNT
+	jz .done
+	mov dword [KMemCountSetBitsImpl], KMem_countSetBitsPopcnt
+
+.done:
+	ret
+
+
 global KMem_copy
 
 KMem_copy:
+	; The parameters are left on the stack exactly as they are, so the implementation can just
+	; pick them up from there.
+	jmp [KMemCopyImpl]
+
+
+KMem_copyDword:
+	push esi
+	push edi
+
 	; Parameters. Avoid using ebp for performance reasons.
-	%define	dest		dword [esp + 4]		; Destination address.
-	%define source		dword [esp + 8]		; Source address.
-	%define numBytes	dword [esp + 12]	; Byte count.
+	%define	dest		dword [esp + 12]	; Destination address.
+	%define source		dword [esp + 16]	; Source address.
+	%define numBytes	dword [esp + 20]	; Byte count.
 
 	; ASSUMPTIONS:
 	; - DF in EFLAGS is clear, as it should be according to C calling conventions.
 	; - ES is set up to access the kernel-mode data segment (it should never be changed anywhere
 	;	else in the kernel).
 
-	;***FIXME: Optimize later. For now, just do byte-by-byte copy.
-	mov eax, esi	; Save current value.
-	mov edx, edi	; Save current value.
-
 	mov edi, dest
 	mov esi, source
-	mov ecx, numBytes
+	mov edx, numBytes
+	cmp edx, DWORD_MIN_BYTES
+	jb .tail
+
+	; Copy bytes until the destination is dword-aligned, then copy whole dwords.
+	mov ecx, edi
+	neg ecx
+	and ecx, 3
+	sub edx, ecx
+	rep movsb
+	mov ecx, edx
+	shr ecx, 2
+	rep movsd
+	and edx, 3
+
+.tail:
+	mov ecx, edx	; Copy whatever is left over a byte at a time.
 	rep movsb
 
-	mov edi, edx	; Restore old value.
-	mov esi, eax	; Restore old value.
+	pop edi
+	pop esi
 	ret
 
 
-global KMem_move
+KMem_copySse2:
+	; Short copies aren't worth the trouble.
+	cmp dword [esp + 12], SSE2_MIN_BYTES
+	jb KMem_copyDword
+
+	push esi
+	push edi
+	pushfd
+	cli
+	sub esp, 64
+	movdqu [esp], xmm0
+	movdqu [esp + 16], xmm1
+	movdqu [esp + 32], xmm2
+	movdqu [esp + 48], xmm3
 
-KMem_move:
 	; Parameters. Avoid using ebp for performance reasons.
-	%define	dest		dword [esp + 4]		; Destination address.
-	%define source		dword [esp + 8]		; Source address.
-	%define numBytes	dword [esp + 12]	; Byte count.
+	%define	flags		dword [esp + 64]	; Caller's EFLAGS.
+	%define	dest		dword [esp + 80]	; Destination address.
+	%define source		dword [esp + 84]	; Source address.
+	%define numBytes	dword [esp + 88]	; Byte count.
 
 	; ASSUMPTIONS:
 	; - DF in EFLAGS is clear, as it should be according to C calling conventions.
 	; - ES is set up to access the kernel-mode data segment (it should never be changed anywhere
 	;	else in the kernel).
 
-	;***FIXME: Optimize later. For now, just do byte-by-byte move.
+	mov edi, dest
+	mov esi, source
+	mov edx, numBytes
+
+	; Copy bytes until the destination is 16-byte aligned. The source may still be unaligned, so
+	; it is read with unaligned loads. There are at least 64 bytes left, since SSE2_MIN_BYTES is
+	; far more than 15 + 64.
+	mov ecx, edi
+	neg ecx
+	and ecx, 15
+	sub edx, ecx
+	rep movsb
+	mov ecx, edx
+	shr ecx, 6
+	and edx, 63
+
+.chunk:
+	; Copy up to a chunk's worth of 64-byte blocks.
+	mov eax, SSE2_CHUNK_BYTES / 64
+	cmp ecx, eax
+	cmovb eax, ecx
+	sub ecx, eax
+
+.loop:
+	; Copy 64 bytes at a time. All four loads are done before any stores, which is what makes
+	; it safe for KMem_move() to use this when the destination is below the source.
+	movdqu xmm0, [esi]
+	movdqu xmm1, [esi + 16]
+	movdqu xmm2, [esi + 32]
+	movdqu xmm3, [esi + 48]
+	movdqa [edi], xmm0
+	movdqa [edi + 16], xmm1
+	movdqa [edi + 32], xmm2
+	movdqa [edi + 48], xmm3
+	add esi, 64
+	add edi, 64
+	dec eax
+	jnz .loop
+
+	; Between chunks, nothing in the XMM registers is needed any more, so a thread switch can't
+	; hurt. Let pending interrupts in if the caller had them enabled. The nop is needed because
+	; sti only takes effect after the instruction that follows it.
+	test ecx, ecx
+	jz .leftovers
+	test flags, EFLAGS_IF
+	jz .chunk
+	sti
+	nop
+	cli
+	jmp .chunk
+
+.leftovers:
+
+	; Copy the leftovers a dword, then a byte, at a time.
+	mov ecx, edx
+	shr ecx, 2
+	rep movsd
+	mov ecx, edx
+	and ecx, 3
+	rep movsb
+
+	movdqu xmm0, [esp]
+	movdqu xmm1, [esp + 16]
+	movdqu xmm2, [esp + 32]
+	movdqu xmm3, [esp + 48]
+	add esp, 64
+	popfd
+	pop edi
+	pop esi
+	ret
+
 
-	mov eax, esi	; Save current value.
-	mov edx, edi	; Save current value.
+KMem_copyErms:
+	push esi
+	push edi
+
+	; Parameters. Avoid using ebp for performance reasons.
+	%define	dest		dword [esp + 12]	; Destination address.
+	%define source		dword [esp + 16]	; Source address.
+	%define numBytes	dword [esp + 20]	; Byte count.
+
+	; ASSUMPTIONS:
+	; - DF in EFLAGS is clear, as it should be according to C calling conventions.
+	; - ES is set up to access the kernel-mode data segment (it should never be changed anywhere
+	;	else in the kernel).
 
 	mov edi, dest
 	mov esi, source
 	mov ecx, numBytes
+	rep movsb			; The processor picks the best way to do it.
 
-	; Save old flags in case we need to mess with direction flag. Must do this *after* getting
-	; parameters above (because it affects esp)!
-	pushfd
+	pop edi
+	pop esi
+	ret
 
-	; See if we need to copy backwards...
-	cmp edi, esi
-	jb DoCopy
-	std		; Prepare to copy backwards.
 
-DoCopy:
-	rep movsb
+global KMem_move
+
+KMem_move:
+	push esi
+	push edi
+
+	; Parameters. Avoid using ebp for performance reasons.
+	%define	dest		dword [esp + 12]	; Destination address.
+	%define source		dword [esp + 16]	; Source address.
+	%define numBytes	dword [esp + 20]	; Byte count.
+
+	; ASSUMPTIONS:
+	; - DF in EFLAGS is clear, as it should be according to C calling conventions.
+	; - ES is set up to access the kernel-mode data segment (it should never be changed anywhere
+	;	else in the kernel).
 
-	popfd			; Restore old flags.
+	mov edi, dest
+	mov esi, source
+	mov ecx, numBytes
 
-	mov edi, edx	; Restore old value.
-	mov esi, eax	; Restore old value.
+	; If the destination is below the source, or starts at or past the end of it, then copying
+	; forwards is safe. Both cases are caught by one unsigned comparison, since dest - source
+	; wraps around to a huge number when dest is below source.
+	mov eax, edi
+	sub eax, esi
+	cmp eax, ecx
+	jae .forward
+
+	; The destination overlaps the end of the source, so copy backwards, starting with the odd
+	; bytes at the top and then a dword at a time. This is rare enough (and the regions small
+	; enough) that there is no SSE2 version.
+	std
+	lea esi, [esi + ecx - 1]
+	lea edi, [edi + ecx - 1]
+	mov edx, ecx
+	and ecx, 3
+	rep movsb
+	sub esi, 3		; Point at the start of the last whole dword rather than its last byte.
+	sub edi, 3
+	mov ecx, edx
+	shr ecx, 2
+	rep movsd
+	cld				; Restore the direction flag as C expects it.
+
+	pop edi
+	pop esi
 	ret
 
+.forward:
+	pop edi
+	pop esi
+	jmp [KMemCopyImpl]	; The parameters are back where the implementation expects them.
+
 
 global KMem_set
 
 KMem_set:
+	; The parameters are left on the stack exactly as they are, so the implementation can just
+	; pick them up from there.
+	jmp [KMemSetImpl]
+
+
+KMem_setDword:
+	push edi
+
+	; Parameters. Avoid using ebp for performance reasons.
+	%define	dest		dword [esp + 8]		; Destination address.
+	%define val			byte [esp + 12]		; Value.
+	%define numBytes	dword [esp + 16]	; Byte count.
+
+	; ASSUMPTIONS:
+	; - DF in EFLAGS is clear, as it should be according to C calling conventions.
+	; - ES is set up to access the kernel-mode data segment (it should never be changed anywhere
+	;	else in the kernel).
+
+	mov edi, dest
+	movzx eax, val
+	imul eax, eax, 0x01010101	; Replicate the value into every byte of eax.
+	mov edx, numBytes
+	cmp edx, DWORD_MIN_BYTES
+	jb .tail
+
+	; Fill bytes until the destination is dword-aligned, then fill whole dwords.
+	mov ecx, edi
+	neg ecx
+	and ecx, 3
+	sub edx, ecx
+	rep stosb
+	mov ecx, edx
+	shr ecx, 2
+	rep stosd
+	and edx, 3
+
+.tail:
+	mov ecx, edx	; Fill whatever is left over a byte at a time.
+	rep stosb
+
+	pop edi
+	ret
+
+
+KMem_setSse2:
+	; Short fills aren't worth the trouble.
+	cmp dword [esp + 12], SSE2_MIN_BYTES
+	jb KMem_setDword
+
+	push esi
+	push edi
+	pushfd
+	cli
+	sub esp, 16
+	movdqu [esp], xmm0
+
 	; Parameters. Avoid using ebp for performance reasons.
-	%define	dest		dword [esp + 4]		; Destination address.
-	%define val			byte [esp + 8]		; Value.
-	%define numBytes	dword [esp + 12]	; Byte count.
+	%define	flags		dword [esp + 16]	; Caller's EFLAGS.
+	%define	dest		dword [esp + 32]	; Destination address.
+	%define val			byte [esp + 36]		; Value.
+	%define numBytes	dword [esp + 40]	; Byte count.
 
 	; ASSUMPTIONS:
 	; - DF in EFLAGS is clear, as it should be according to C calling conventions.
 	; - ES is set up to access the kernel-mode data segment (it should never be changed anywhere
 	;	else in the kernel).
 
-	;***FIXME: Optimize later. For now, just do byte-by-byte fill.
-	mov edx, edi	; Save it for later.
+	mov edi, dest
+	movzx eax, val
+	imul eax, eax, 0x01010101	; Replicate the value into every byte of eax...
+	movd xmm0, eax
+	pshufd xmm0, xmm0, 0		; ...and then into every byte of xmm0.
+	mov edx, numBytes
+
+	; Fill bytes until the destination is 16-byte aligned, then fill 64 bytes at a time.
+	mov ecx, edi
+	neg ecx
+	and ecx, 15
+	sub edx, ecx
+	rep stosb
+	mov ecx, edx
+	shr ecx, 6
+	and edx, 63
+
+.chunk:
+	; Fill up to a chunk's worth of 64-byte blocks.
+	mov esi, SSE2_CHUNK_BYTES / 64
+	cmp ecx, esi
+	cmovb esi, ecx
+	sub ecx, esi
+
+.loop:
+	movdqa [edi], xmm0
+	movdqa [edi + 16], xmm0
+	movdqa [edi + 32], xmm0
+	movdqa [edi + 48], xmm0
+	add edi, 64
+	dec esi
+	jnz .loop
+
+	; Let pending interrupts in between chunks, as KMem_copySse2 does. A thread switch may
+	; clobber xmm0, so it is filled with the value again afterwards.
+	test ecx, ecx
+	jz .leftovers
+	test flags, EFLAGS_IF
+	jz .chunk
+	sti
+	nop
+	cli
+	movd xmm0, eax
+	pshufd xmm0, xmm0, 0
+	jmp .chunk
+
+.leftovers:
+
+	; Fill the leftovers a dword, then a byte, at a time.
+	mov ecx, edx
+	shr ecx, 2
+	rep stosd
+	mov ecx, edx
+	and ecx, 3
+	rep stosb
+
+	movdqu xmm0, [esp]
+	add esp, 16
+	popfd
+	pop edi
+	pop esi
+	ret
+
+
+KMem_setErms:
+	push edi
+
+	; Parameters. Avoid using ebp for performance reasons.
+	%define	dest		dword [esp + 8]		; Destination address.
+	%define val			byte [esp + 12]		; Value.
+	%define numBytes	dword [esp + 16]	; Byte count.
+
+	; ASSUMPTIONS:
+	; - DF in EFLAGS is clear, as it should be according to C calling conventions.
+	; - ES is set up to access the kernel-mode data segment (it should never be changed anywhere
+	;	else in the kernel).
 
 	mov edi, dest
 	mov al, val
 	mov ecx, numBytes
-	rep stosb
+	rep stosb			; The processor picks the best way to do it.
+
+	pop edi
+	ret
+
+
+global KMem_clearPage
+
+KMem_clearPage:
+	jmp [KMemClearPageImpl]
+
+
+KMem_clearPageDword:
+	push edi
+
+	; Parameters. Avoid using ebp for performance reasons.
+	%define	page		dword [esp + 8]		; Page-aligned address of the page.
+
+	mov edi, page
+	xor eax, eax
+	mov ecx, PAGE_BYTES / 4
+	rep stosd
+
+	pop edi
+	ret
+
+
+KMem_clearPageSse2:
+	pushfd		; A page is one chunk, so interrupts stay disabled throughout; see SSE2_CHUNK_BYTES.
+	cli
+	sub esp, 16
+	movdqu [esp], xmm0
+
+	; Parameters. Avoid using ebp for performance reasons.
+	%define	page		dword [esp + 24]	; Page-aligned address of the page.
+
+	; Non-temporal stores go around the caches through the write-combining buffers, so zeroing
+	; a page doesn't evict anything that the caller is still using.
+	mov edx, page
+	mov ecx, PAGE_BYTES / 64
+	pxor xmm0, xmm0
+
+.loop:
+	movntdq [edx], xmm0
+	movntdq [edx + 16], xmm0
+	movntdq [edx + 32], xmm0
+	movntdq [edx + 48], xmm0
+	add edx, 64
+	dec ecx
+	jnz .loop
+
+	; Non-temporal stores are weakly ordered. Make sure they are all visible before anyone else
+	; (like another processor that the page is about to be handed to) can look at the page.
+	sfence
+
+	movdqu xmm0, [esp]
+	add esp, 16
+	popfd
+	ret
+
+
+global KMem_copyPage
+
+KMem_copyPage:
+	jmp [KMemCopyPageImpl]
+
+
+KMem_copyPageDword:
+	push esi
+	push edi
+
+	; Parameters. Avoid using ebp for performance reasons.
+	%define	dest		dword [esp + 12]	; Page-aligned destination address.
+	%define source		dword [esp + 16]	; Page-aligned source address.
+
+	; ASSUMPTIONS:
+	; - DF in EFLAGS is clear, as it should be according to C calling conventions.
+	; - ES is set up to access the kernel-mode data segment (it should never be changed anywhere
+	;	else in the kernel).
+
+	mov edi, dest
+	mov esi, source
+	mov ecx, PAGE_BYTES / 4
+	rep movsd
 
-	mov edi, edx	; Restore old value.
+	pop edi
+	pop esi
+	ret
+
+
+KMem_copyPageSse2:
+	pushfd		; A page is one chunk, so interrupts stay disabled throughout; see SSE2_CHUNK_BYTES.
+	cli
+	sub esp, 64
+	movdqu [esp], xmm0
+	movdqu [esp + 16], xmm1
+	movdqu [esp + 32], xmm2
+	movdqu [esp + 48], xmm3
+
+	; Parameters. Avoid using ebp for performance reasons.
+	%define	dest		dword [esp + 72]	; Page-aligned destination address.
+	%define source		dword [esp + 76]	; Page-aligned source address.
+
+	mov edx, dest
+	mov eax, source
+	mov ecx, PAGE_BYTES / 64
+
+.loop:
+	; Both pages are aligned, so aligned loads can be used. The source is prefetched a few lines
+	; ahead without allocating it in the outer caches, and the destination is written with
+	; non-temporal stores, so the copy leaves the caches more or less as it found them.
+	prefetchnta [eax + 256]
+	movdqa xmm0, [eax]
+	movdqa xmm1, [eax + 16]
+	movdqa xmm2, [eax + 32]
+	movdqa xmm3, [eax + 48]
+	movntdq [edx], xmm0
+	movntdq [edx + 16], xmm1
+	movntdq [edx + 32], xmm2
+	movntdq [edx + 48], xmm3
+	add eax, 64
+	add edx, 64
+	dec ecx
+	jnz .loop
+
+	sfence		; Non-temporal stores are weakly ordered; see KMem_clearPageSse2.
+
+	movdqu xmm0, [esp]
+	movdqu xmm1, [esp + 16]
+	movdqu xmm2, [esp + 32]
+	movdqu xmm3, [esp + 48]
+	add esp, 64
+	popfd
 	ret
 
 
@@ -161,6 +694,10 @@ KMem_high16:
 global KMem_findLowestSetBit
 
 KMem_findLowestSetBit:
+	jmp [KMemFindLowestSetBitImpl]
+
+
+KMem_findLowestSetBitBsf:
 	; Parameters. Avoid using ebp for performance reasons.
 	%define val		dword [esp + 4]	; Value to scan.
 
@@ -170,3 +707,82 @@ KMem_findLowestSetBit:
 .done:
 	ret
 
+
+KMem_findLowestSetBitTzcnt:
+	; Parameters. Avoid using ebp for performance reasons.
+	%define val		dword [esp + 4]	; Value to scan.
+
+	; Unlike bsf, tzcnt doesn't leave its destination undefined for zero, and is much faster on
+	; some processors.
+	tzcnt eax, val
+	jnc .done			; CF is set only if val is zero.
+	mov eax, 0xFFFFFFFF
+.done:
+	ret
+
+
+global KMem_findHighestSetBit
+
+KMem_findHighestSetBit:
+	jmp [KMemFindHighestSetBitImpl]
+
+
+KMem_findHighestSetBitBsr:
+	; Parameters. Avoid using ebp for performance reasons.
+	%define val		dword [esp + 4]	; Value to scan.
+
+	bsr eax, val
+	jnz .done
+	mov eax, 0xFFFFFFFF
+.done:
+	ret
+
+
+KMem_findHighestSetBitLzcnt:
+	; Parameters. Avoid using ebp for performance reasons.
+	%define val		dword [esp + 4]	; Value to scan.
+
+	; lzcnt returns 32 for zero, so 31 - lzcnt gives -1 for zero without a branch.
+	lzcnt ecx, val
+	mov eax, 31
+	sub eax, ecx
+	ret
+
+
+global KMem_countSetBits
+
+KMem_countSetBits:
+	jmp [KMemCountSetBitsImpl]
+
+
+KMem_countSetBitsSwar:
+	; Parameters. Avoid using ebp for performance reasons.
+	%define val		dword [esp + 4]	; Value to count.
+
+	; Add up the bits in parallel: first in pairs, then nibbles, then bytes. The multiply adds
+	; the four byte counts together into the top byte.
+	mov eax, val
+	mov ecx, eax
+	shr ecx, 1
+	and ecx, 0x55555555
+	sub eax, ecx
+	mov ecx, eax
+	shr ecx, 2
+	and eax, 0x33333333
+	and ecx, 0x33333333
+	add eax, ecx
+	mov ecx, eax
+	shr ecx, 4
+	add eax, ecx
+	and eax, 0x0F0F0F0F
+	imul eax, eax, 0x01010101
+	shr eax, 24
+	ret
+
+
+KMem_countSetBitsPopcnt:
+	; Parameters. Avoid using ebp for performance reasons.
+	%define val		dword [esp + 4]	; Value to count.
+
+	popcnt eax, val
+	ret
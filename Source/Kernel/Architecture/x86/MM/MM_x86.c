@@ -0,0 +1,199 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/Architecture/x86/MM/MM_x86.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/Apr/23
+//
+// ===========================================================================
+///
+///	\file
+///
+/// \brief	Contains the x86-specific implementation of the Memory Manager
+///			utilities declared in MM.h.
+///
+// ===========================================================================
+
+
+#include "Kernel/MM/MM.h"
+#include "Kernel/KCommon/KMem.h"
+#include "Kernel/HAL/Lock.h"
+#include "HAL/Cpuid.h"
+
+
+// Private constants
+
+/// \brief	Defines private constants for the x86 implementation of MM.
+enum MM_x86_consts
+{
+	CPUID_LEAF_CACHE_PARAMS = 4,			///< Intel deterministic cache parameters leaf.
+	CPUID_LEAF_EXT_MAX		= 0x80000000,	///< Returns the maximum extended leaf.
+	CPUID_LEAF_EXT_L2		= 0x80000006,	///< L2 cache size and associativity leaf.
+
+	CACHE_TYPE_NULL			= 0,			///< No more caches (leaf 4).
+	CACHE_TYPE_INSTRUCTION	= 2,			///< Instruction cache (leaf 4).
+
+	MAX_CACHE_SUBLEAVES		= 16,			///< Sanity limit on leaf 4 sub-leaves.
+	L2_ASSOC_FULL			= 0xF,			///< Fully associative L2 (leaf 0x80000006).
+
+	LARGE_PAGE_SIZE			= 4 * 1024 * 1024,	///< Size of a page mapped by a single PDE.
+	PDE_PRESENT				= 0x00000001,		///< Bit 0: P. The page is present.
+	PDE_WRITABLE			= 0x00000002,		///< Bit 1: RW. The page is read/write.
+	PDE_LARGE_PAGE			= 0x00000080,		///< Bit 7: PS. The page is 4MB.
+
+	/// \brief	Index of the PDE that maps the scratch window.
+	SCRATCH_WINDOW_PDE_INDEX = MM_SCRATCH_WINDOW_BASE >> (PTE_BITS + PAGE_BITS)
+};
+
+
+/// \brief	The page directory set up by the boot code. It is still the current page directory.
+///
+/// ***FIXME: This goes away once there is a VMM that can create temporary mappings properly.
+extern uint32_t BootPageDirectory[];
+
+
+/// \brief	Invalidates the TLB entry for the page containing the given virtual address.
+///
+/// \param vaddr	any virtual address within the page.
+extern void MM_x86_invalidatePage( const void* vaddr );
+
+
+/// \brief	Maps the 4-bit L2 associativity field of CPUID leaf 0x80000006 to a number of ways.
+///
+/// Zero means that the cache is disabled or that the encoding is reserved.
+static const uint8_t s_l2AssocWays[16] =
+{
+	0, 1, 2, 0, 4, 0, 8, 0, 16, 0, 32, 48, 64, 96, 128, 0
+};
+
+
+/// \brief	The number of cache colours, or zero if it hasn't been calculated yet.
+static size_t s_numCacheColours = 0;
+
+
+/// \brief	Serializes use of the scratch window.
+///
+/// An all-zero Lock is the same as one returned by Lock_create(), so no initialization is needed.
+static Lock s_scratchWindowLock;
+
+
+
+// Private functions
+
+/// \brief	Finds the size of one way of the L2 cache using CPUID.
+///
+/// Intel's deterministic cache parameters leaf is tried first, then the extended L2 leaf that
+/// both AMD and Intel support.
+///
+/// \return the number of bytes in one way of the L2 cache, or zero if it can't be determined.
+static size_t MM_getL2WaySize( void )
+{
+	if (!Cpuid_isSupported())
+	{
+		return 0;
+	}
+
+	CpuidRegisters regs;
+	Cpuid_query( 0, 0, &regs );
+
+	if (regs.eax >= CPUID_LEAF_CACHE_PARAMS)
+	{
+		for (uint32_t subLeaf = 0; subLeaf < MAX_CACHE_SUBLEAVES; subLeaf++)
+		{
+			Cpuid_query( CPUID_LEAF_CACHE_PARAMS, subLeaf, &regs );
+
+			uint32_t type	= regs.eax & 0x1F;
+			uint32_t level	= (regs.eax >> 5) & 0x7;
+
+			if (type == CACHE_TYPE_NULL)
+			{
+				break;
+			}
+
+			if ((level == 2) && (type != CACHE_TYPE_INSTRUCTION))
+			{
+				// One way holds (line size * partitions * sets) bytes.
+				size_t lineSize		= (regs.ebx & 0xFFF) + 1;
+				size_t partitions	= ((regs.ebx >> 12) & 0x3FF) + 1;
+				size_t sets			= regs.ecx + 1;
+				return lineSize * partitions * sets;
+			}
+		}
+	}
+
+	Cpuid_query( CPUID_LEAF_EXT_MAX, 0, &regs );
+	if (((regs.eax & CPUID_LEAF_EXT_MAX) != 0) && (regs.eax >= CPUID_LEAF_EXT_L2))
+	{
+		Cpuid_query( CPUID_LEAF_EXT_L2, 0, &regs );
+
+		size_t sizeInKB		= regs.ecx >> 16;
+		uint32_t assocCode	= (regs.ecx >> 12) & 0xF;
+
+		if (assocCode == L2_ASSOC_FULL)
+		{
+			return PAGE_SIZE;	// Every frame can go anywhere, so there is only one colour.
+		}
+		else if ((sizeInKB > 0) && (s_l2AssocWays[assocCode] > 0))
+		{
+			return MM_KB( sizeInKB ) / s_l2AssocWays[assocCode];
+		}
+	}
+	return 0;
+}
+
+
+
+// Public functions
+
+size_t MM_getNumCacheColours( void )
+{
+	// There is no need to synchronize this. Every processor will calculate the same answer.
+	if (s_numCacheColours == 0)
+	{
+		size_t numColours = MM_getL2WaySize() / PAGE_SIZE;
+
+		if (numColours > MAX_CACHE_COLOURS)
+		{
+			numColours = MAX_CACHE_COLOURS;
+		}
+
+		// Round down to a power of two so that colours can be calculated with a mask.
+		size_t powerOfTwo = 1;
+		while ((powerOfTwo << 1) <= numColours)
+		{
+			powerOfTwo <<= 1;
+		}
+		s_numCacheColours = powerOfTwo;
+	}
+	return s_numCacheColours;
+}
+
+
+void MM_zeroFrame( phys_addr_t frameAddr )
+{
+	KDebug_assertArg( MM_isFrameAligned( frameAddr ) );
+
+	// There is no VMM yet, so the only way to reach an arbitrary frame is to point a spare 4MB PDE
+	// of the boot page directory at the large page containing it. The TLB entry is flushed every
+	// time, even if the PDE already has the right value. Another processor may have moved the
+	// window since this one last used it, and the stale mapping could still be in this
+	// processor's TLB, even if the PDE has since been moved back.
+	phys_addr_t largePageBase = frameAddr & ~((phys_addr_t) (LARGE_PAGE_SIZE - 1));
+	uint32_t pde = largePageBase | PDE_LARGE_PAGE | PDE_WRITABLE | PDE_PRESENT;
+	void* windowBase = (void*) MM_SCRATCH_WINDOW_BASE;
+
+	Lock_acquire( &s_scratchWindowLock );
+
+	BootPageDirectory[SCRATCH_WINDOW_PDE_INDEX] = pde;
+	MM_x86_invalidatePage( windowBase );
+
+	KMem_clearPage( ((uint8_t*) windowBase) + (frameAddr - largePageBase) );
+
+	Lock_release( &s_scratchWindowLock );
+}
@@ -0,0 +1,32 @@
+; ===========================================================================
+;
+;             Copyright (C) 2004-2006 Bruce Johnston
+;
+; ===========================================================================
+;
+;   //osdev/precursor/Source/Kernel/Architecture/x86/MM/MM_x86_asm.s
+;
+; ===========================================================================
+;
+;	Originating Author:	BruceJ
+;	Originating Date:	2006/Apr/30
+;
+; ===========================================================================
+; This file contains the x86-specific Memory Manager routines that can't be
+; written in C.
+; ===========================================================================
+
+
+; ===========================================================================
+section .text
+align 4
+
+global MM_x86_invalidatePage
+
+MM_x86_invalidatePage:
+		; Parameters.
+		%define vaddr	dword [esp + 4]		; Any virtual address within the page.
+
+		mov eax, vaddr
+		invlpg [eax]		; Flush the TLB entry for the page (4KB or 4MB) containing vaddr.
+		ret
@@ -31,6 +31,8 @@
 /// It must be called with interrupts disabled for the current processor.
 ///
 /// This method is responsible for initializing the InterruptController for the current Processor.
+/// It also sets up the Processor's Timer wheel, whose interrupts drive the Scheduler once
+/// Scheduler_initForCurrentProcessor() has been called.
 void InterruptDispatcher_initForCurrentProcessor( void );
 
 
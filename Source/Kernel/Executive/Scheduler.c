@@ -0,0 +1,610 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/Executive/Scheduler.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/12
+//
+// ===========================================================================
+///
+///	\file
+///
+/// \brief	Contains the implementation of the Scheduler class.
+///
+// ===========================================================================
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Kernel/HAL/Atomic.h"
+#include "Kernel/HAL/Lock.h"
+#include "Kernel/HAL/Processor.h"
+#include "Kernel/HAL/WorkDeque.h"
+#include "Kernel/KCommon/KDebug.h"
+#include "Kernel/KCommon/KMem.h"
+#include "Scheduler.h"
+#include "Thread.h"
+#include "Timer.h"
+
+
+// Private types
+
+/// \brief	Defines the fields of a single processor's run queue.
+typedef struct
+{
+	/// \brief	Synchronizes changes to the run queue, except for stealing.
+	///
+	/// Threads are only added to the bottoms of the deques, and the ready mask is only changed,
+	/// with the lock held. The lock is normally only acquired on the owning processor, so it is
+	/// hardly ever contended; Its main job is to keep the timer interrupt out while a thread is
+	/// changing the run queue. Thieves don't take it at all, since they only use the tops of the
+	/// deques.
+	Lock m_lock;
+
+	/// \brief	Bit p is set if there may be ready threads of priority p.
+	///
+	/// A bit can stay set for a while after a thief has emptied its deque. It is cleared the next
+	/// time the owner finds the deque empty.
+	uintptr_t m_readyMask;
+
+	/// \brief	The number of threads in all the deques and overflow lists. Thieves use it to find
+	///			the busiest run queue.
+	uintptr_t m_numReady;
+
+	/// \brief	The ready threads of each priority, oldest at the top.
+	WorkDeque m_ready[THREAD_PRIORITY_COUNT];
+
+	/// \brief	The oldest ready threads of each priority that didn't fit in their deque.
+	///
+	/// Only preempted threads end up here, since Scheduler_addThread() fails instead. They are
+	/// newer than everything in the deque, and are moved to its bottom as soon as it has room.
+	/// Until then, they can't be stolen.
+	Thread* m_overflowHead[THREAD_PRIORITY_COUNT];
+
+	/// \brief	The newest ready threads of each priority that didn't fit in their deque.
+	Thread* m_overflowTail[THREAD_PRIORITY_COUNT];
+
+	/// \brief	The processor's idle thread. It is never in a deque, so it can't be stolen.
+	Thread* m_idleThread;
+
+	/// \brief	The thread running on the processor, or NULL if the Scheduler hasn't been
+	///			initialized on it yet.
+	Thread* m_current;
+
+	/// \brief	The thread that exited at the last context switch, if any.
+	///
+	/// Its stack was still in use while the switch was being made, so it isn't marked as exited
+	/// until the next timer interrupt.
+	Thread* m_lastExited;
+
+	/// \brief	The thread that was preempted at the last context switch, if any.
+	///
+	/// Its stack was still in use while the switch was being made, so it isn't put in a deque,
+	/// where a thief could resume it on another processor, until the next timer interrupt.
+	Thread* m_lastPreempted;
+
+	/// \brief	Expires when the running thread's time slice is used up.
+	///
+	/// It is also armed to expire right away whenever the running thread should be reconsidered
+	/// sooner, such as when a thread of higher priority is added. While the idle thread runs, it
+	/// only expires if there may be work to steal.
+	Timer m_sliceTimer;
+
+	/// \brief	Set when m_sliceTimer expires, and cleared when the Scheduler deals with it.
+	bool m_isSliceUsedUp;
+
+} SchedulerRunQueue;
+
+
+
+// Private variables
+
+/// \brief	One run queue per processor, indexed by processor ID.
+static volatile SchedulerRunQueue s_runQueues[PROCESSOR_MAX_COUNT];
+
+
+
+// Private functions
+
+/// \brief	Gets the ID of the current processor.
+///
+/// Unless interrupts are disabled, the caller may be stolen by another processor right after this
+/// method returns. That is harmless as long as the caller only uses the run queue with its lock
+/// held, since whoever holds the lock may add threads to it.
+///
+/// \return the current processor's ID.
+static inline int Scheduler_getCurrentProcessorId( void )
+{
+	int id = Processor_getID( Processor_getCurrent() );
+	KDebug_assert( (0 <= id) && (id < PROCESSOR_MAX_COUNT) );
+	return id;
+}
+
+
+/// \brief	Called when a run queue's slice timer expires.
+///
+/// \param timer	the slice timer.
+/// \param context	the run queue.
+///
+/// This only notes that the slice is used up, since Timer functions can't switch threads. The
+/// timer interrupt handler calls Scheduler_handleTimerInterrupt() right after, which does the rest.
+static void Scheduler_handleSliceExpired( Timer* timer, void* context )
+{
+	(void) timer;
+	volatile SchedulerRunQueue* queue = (volatile SchedulerRunQueue*) context;
+
+	Lock_acquire( &(queue->m_lock) );
+	queue->m_isSliceUsedUp = true;
+	Lock_release( &(queue->m_lock) );
+}
+
+
+/// \brief	Starts a new time slice for the running thread.
+///
+/// \param queue	the run queue. The caller must hold its lock.
+///
+/// The idle thread doesn't get a slice, since it is only there to be preempted. On MP systems, it
+/// is woken up now and then to look for work to steal, but on UP systems, it is left alone until
+/// something else interrupts it.
+static void Scheduler_startSlice( SchedulerRunQueue* queue )
+{
+	if (queue->m_current != queue->m_idleThread)
+	{
+		Timer_arm( &(queue->m_sliceTimer), Timer_getTime() + SCHEDULER_TIME_SLICE );
+	}
+	else if (PROCESSOR_MAX_COUNT > 1)
+	{
+		Timer_arm( &(queue->m_sliceTimer), Timer_getTime() + SCHEDULER_BALANCE_INTERVAL );
+	}
+	else
+	{
+		Timer_cancel( &(queue->m_sliceTimer) );
+	}
+}
+
+
+/// \brief	Ends the running thread's time slice now, so that the Scheduler reconsiders it as soon
+///			as the timer interrupt can be taken.
+///
+/// \param queue	the run queue. The caller must hold its lock.
+static void Scheduler_endSlice( SchedulerRunQueue* queue )
+{
+	// A deadline of zero has always passed.
+	Timer_arm( &(queue->m_sliceTimer), 0 );
+}
+
+
+/// \brief	Marks the given priority as possibly having ready threads.
+///
+/// \param queue		the run queue. The caller must hold its lock.
+/// \param priority	the priority.
+static inline void Scheduler_markReady( SchedulerRunQueue* queue, int priority )
+{
+	uintptr_t mask = KMem_bitSet( queue->m_readyMask, (uint8_t) priority );
+	Atomic_writeExplicit( &(queue->m_readyMask), mask, ATOMIC_RELAXED );
+}
+
+
+/// \brief	Adds a thread to the back of the line for its priority, if there is room in the deque.
+///
+/// \param queue	the run queue. The caller must hold its lock.
+/// \param thread	the ready thread to add.
+///
+/// \retval true	the thread was added.
+/// \retval false	the deque is full, or older threads are waiting in the overflow list. Nothing
+///					was changed.
+static bool Scheduler_tryEnqueue( SchedulerRunQueue* queue, Thread* thread )
+{
+	int priority = thread->m_priority;
+
+	// Don't let the thread jump ahead of the ones that are already waiting for room.
+	if (queue->m_overflowHead[priority] != NULL)
+	{
+		return false;
+	}
+
+	// Count the thread first, so that a thief who takes it right away can't make the count wrap.
+	Atomic_fetchAddExplicit( &(queue->m_numReady), 1, ATOMIC_RELAXED );
+
+	if (!WorkDeque_push( &(queue->m_ready[priority]), thread ))
+	{
+		Atomic_fetchAddExplicit( &(queue->m_numReady), (uintptr_t) -1, ATOMIC_RELAXED );
+		return false;
+	}
+
+	Scheduler_markReady( queue, priority );
+	return true;
+}
+
+
+/// \brief	Adds a thread that already belongs to the run queue to the back of the line for its
+///			priority. Unlike Scheduler_tryEnqueue(), this never fails.
+///
+/// \param queue	the run queue. The caller must hold its lock.
+/// \param thread	the ready thread to add.
+static void Scheduler_requeue( SchedulerRunQueue* queue, Thread* thread )
+{
+	if (Scheduler_tryEnqueue( queue, thread ))
+	{
+		return;
+	}
+
+	// The deque is full, so the thread waits in the overflow list until it has room.
+	int priority = thread->m_priority;
+	thread->m_nextOverflow = NULL;
+	if (queue->m_overflowTail[priority] != NULL)
+	{
+		queue->m_overflowTail[priority]->m_nextOverflow = thread;
+	}
+	else
+	{
+		queue->m_overflowHead[priority] = thread;
+	}
+	queue->m_overflowTail[priority] = thread;
+
+	Atomic_fetchAddExplicit( &(queue->m_numReady), 1, ATOMIC_RELAXED );
+	Scheduler_markReady( queue, priority );
+}
+
+
+/// \brief	Moves as many threads as will fit from the overflow list of the given priority to the
+///			bottom of its deque.
+///
+/// \param queue		the run queue. The caller must hold its lock.
+/// \param priority	the priority.
+static void Scheduler_drainOverflow( SchedulerRunQueue* queue, int priority )
+{
+	Thread* thread = queue->m_overflowHead[priority];
+	while (thread != NULL)
+	{
+		// Once the thread is in the deque, a thief may take it and change its link, so read the
+		// link first.
+		Thread* next = thread->m_nextOverflow;
+		if (!WorkDeque_push( &(queue->m_ready[priority]), thread ))
+		{
+			break;
+		}
+		thread = next;
+	}
+
+	queue->m_overflowHead[priority] = thread;
+	if (thread == NULL)
+	{
+		queue->m_overflowTail[priority] = NULL;
+	}
+}
+
+
+/// \brief	Removes the oldest thread of the highest priority that has any ready threads, as long as
+///			that priority is at least the given one.
+///
+/// \param queue		the run queue. The caller must hold its lock.
+/// \param minPriority	the lowest priority to consider.
+///
+/// \retval Thread*	the thread that was removed.
+/// \retval NULL	no threads of at least \a minPriority are ready.
+static Thread* Scheduler_takeLocal( SchedulerRunQueue* queue, int minPriority )
+{
+	// Each pass either finds a thread or clears a bit, so this doesn't loop for long.
+	int priority = KMem_findHighestSetBit( queue->m_readyMask );
+	while (priority >= minPriority)
+	{
+		// Thieves may have made room for threads waiting in the overflow list. Then take from the
+		// top, just like a thief would, so that threads of the same priority run in the order in
+		// which they became ready.
+		Scheduler_drainOverflow( queue, priority );
+		Thread* thread = (Thread*) WorkDeque_steal( &(queue->m_ready[priority]) );
+		if (thread != NULL)
+		{
+			Atomic_fetchAddExplicit( &(queue->m_numReady), (uintptr_t) -1, ATOMIC_RELAXED );
+			return thread;
+		}
+
+		// If thieves emptied the deque but threads are still waiting, the next pass will move
+		// some of them in. Otherwise, only threads holding the lock can refill it, so the bit can
+		// be cleared safely.
+		if (queue->m_overflowHead[priority] == NULL)
+		{
+			uintptr_t mask = KMem_bitClear( queue->m_readyMask, (uint8_t) priority );
+			Atomic_writeExplicit( &(queue->m_readyMask), mask, ATOMIC_RELAXED );
+			priority = KMem_findHighestSetBit( mask );
+		}
+	}
+	return NULL;
+}
+
+
+/// \brief	Steals the highest-priority ready thread from the processor with the most ready
+///			threads.
+///
+/// \param thiefId	the ID of the processor that is looking for work.
+///
+/// This doesn't take any locks, so it can't hold up the other processors.
+///
+/// \retval Thread*	the thread that was stolen.
+/// \retval NULL	the other processors have nothing to spare.
+static Thread* Scheduler_steal( int thiefId )
+{
+	volatile SchedulerRunQueue* victim = NULL;
+	uintptr_t mostReady = 0;
+
+	// The counts are only hints, but it doesn't matter if the busiest one is slightly off.
+	for (int i = 0; i < PROCESSOR_MAX_COUNT; i++)
+	{
+		uintptr_t numReady = Atomic_readExplicit( &(s_runQueues[i].m_numReady), ATOMIC_RELAXED );
+		if ((i != thiefId) && (numReady > mostReady))
+		{
+			victim		= &(s_runQueues[i]);
+			mostReady	= numReady;
+		}
+	}
+
+	if (victim == NULL)
+	{
+		return NULL;
+	}
+
+	uintptr_t mask = Atomic_readExplicit( &(victim->m_readyMask), ATOMIC_RELAXED );
+	for (int priority = KMem_findHighestSetBit( mask );
+		priority > THREAD_PRIORITY_IDLE;
+		priority = KMem_findHighestSetBit( mask ))
+	{
+		Thread* thread = (Thread*) WorkDeque_steal( &(victim->m_ready[priority]) );
+		if (thread != NULL)
+		{
+			Atomic_fetchAddExplicit( &(victim->m_numReady), (uintptr_t) -1, ATOMIC_RELAXED );
+			return thread;
+		}
+		mask = KMem_bitClear( mask, (uint8_t) priority );
+	}
+	return NULL;
+}
+
+
+/// \brief	Picks the thread that should replace the running thread, if any.
+///
+/// \param queue			the run queue. The caller must hold its lock.
+/// \param id				the ID of the processor that owns \a queue.
+/// \param current			the running thread.
+/// \param isSliceUsedUp	whether the running thread's time slice is used up.
+///
+/// The running thread is replaced if it has exited, if a thread of higher priority is ready, or if
+/// its time slice is used up and a thread of the same priority is ready. When the processor would
+/// otherwise go idle, a thread is stolen from the busiest other processor instead.
+///
+/// \retval Thread*	the thread to switch to. This is never \a current.
+/// \retval NULL	the running thread should keep running.
+static Thread* Scheduler_pickNext(
+	SchedulerRunQueue*	queue,
+	int					id,
+	const Thread*		current,
+	bool				isSliceUsedUp
+)
+{
+	bool isExiting	= (current->m_state == THREAD_EXITING);
+	bool isIdle		= (current == queue->m_idleThread);
+
+	int minPriority;
+	if (isExiting || isIdle)
+	{
+		minPriority = THREAD_PRIORITY_IDLE + 1;
+	}
+	else if (isSliceUsedUp)
+	{
+		minPriority = current->m_priority;
+	}
+	else
+	{
+		minPriority = current->m_priority + 1;
+	}
+
+	Thread* next = Scheduler_takeLocal( queue, minPriority );
+	if ((next == NULL) && (isExiting || isIdle))
+	{
+		next = Scheduler_steal( id );
+		if ((next == NULL) && isExiting)
+		{
+			next = queue->m_idleThread;
+		}
+	}
+	return next;
+}
+
+
+/// \brief	Sets the running thread aside to be put back in the run queue (unless it has exited or
+///			is the idle thread), and makes the given thread the running one.
+///
+/// \param queue	the run queue. The caller must hold its lock.
+/// \param id		the ID of the processor that owns \a queue.
+/// \param current	the running thread.
+/// \param next		the thread to run next.
+static void Scheduler_switchTo( SchedulerRunQueue* queue, int id, Thread* current, Thread* next )
+{
+	if (current->m_state == THREAD_EXITING)
+	{
+		KDebug_assert( queue->m_lastExited == NULL );
+		queue->m_lastExited = current;
+	}
+	else
+	{
+		current->m_state = THREAD_READY;
+		if (current != queue->m_idleThread)
+		{
+			KDebug_assert( queue->m_lastPreempted == NULL );
+			queue->m_lastPreempted = current;
+		}
+	}
+
+	// The thread may have been stolen from another processor, in which case it belongs here now.
+	next->m_state		= THREAD_RUNNING;
+	next->m_processorId	= id;
+	queue->m_current	= next;
+}
+
+
+
+// Public functions
+
+void Scheduler_initForCurrentProcessor( Thread* idleThread )
+{
+	KDebug_assertArg( idleThread != NULL );
+	KDebug_assert( Processor_areInterruptsDisabled() );
+
+	int id = Scheduler_getCurrentProcessorId();
+
+	// NOTE: It is safe to cast away volatile here, since interrupts must be disabled according to
+	// this method's contract, and other processors don't touch a run queue until it has ready
+	// threads.
+	SchedulerRunQueue* queue = (SchedulerRunQueue*) &(s_runQueues[id]);
+
+	queue->m_lock			= Lock_create();
+	queue->m_readyMask		= 0;
+	queue->m_numReady		= 0;
+	queue->m_lastExited		= NULL;
+	queue->m_lastPreempted	= NULL;
+	queue->m_isSliceUsedUp	= false;
+	Timer_init( &(queue->m_sliceTimer), Scheduler_handleSliceExpired, queue );
+	for (size_t i = 0; i < THREAD_PRIORITY_COUNT; i++)
+	{
+		WorkDeque_init( &(queue->m_ready[i]) );
+		queue->m_overflowHead[i] = NULL;
+		queue->m_overflowTail[i] = NULL;
+	}
+
+	// The caller's machine state will be captured in a TrapFrame the first time it is preempted.
+	idleThread->m_trapFrame		= NULL;
+	idleThread->m_state			= THREAD_RUNNING;
+	idleThread->m_priority		= THREAD_PRIORITY_IDLE;
+	idleThread->m_processorId	= id;
+
+	queue->m_idleThread	= idleThread;
+	queue->m_current	= idleThread;
+	Scheduler_startSlice( queue );
+}
+
+
+bool Scheduler_addThread( Thread* thread )
+{
+	KDebug_assertArg( thread != NULL );
+	KDebug_assertArg( thread->m_state == THREAD_READY );
+
+	int id = Scheduler_getCurrentProcessorId();
+	volatile SchedulerRunQueue* queue = &(s_runQueues[id]);
+
+	Lock_acquire( &(queue->m_lock) );
+	SchedulerRunQueue* lockedQueue = (SchedulerRunQueue*) queue;
+
+	Thread* current = lockedQueue->m_current;
+	KDebug_assert( current != NULL );
+
+	// Claim the thread before it goes in the deque, since a thief may claim it right after.
+	int oldProcessorId = thread->m_processorId;
+	thread->m_processorId = id;
+
+	bool isAdded = Scheduler_tryEnqueue( lockedQueue, thread );
+	if (!isAdded)
+	{
+		thread->m_processorId = oldProcessorId;
+	}
+	else if ((current == lockedQueue->m_idleThread) || (thread->m_priority > current->m_priority))
+	{
+		// Don't make the new thread wait for the end of the slice if it should preempt.
+		Scheduler_endSlice( lockedQueue );
+	}
+
+	Lock_release( &(queue->m_lock) );
+	return isAdded;
+}
+
+
+TrapFrame* Scheduler_handleTimerInterrupt( TrapFrame* trapFrame )
+{
+	KDebug_assertArg( trapFrame != NULL );
+	KDebug_assert( Processor_areInterruptsDisabled() );
+
+	int id = Scheduler_getCurrentProcessorId();
+	volatile SchedulerRunQueue* queue = &(s_runQueues[id]);
+
+	Lock_acquire( &(queue->m_lock) );
+	SchedulerRunQueue* lockedQueue = (SchedulerRunQueue*) queue;
+
+	TrapFrame* newFrame = NULL;
+	Thread* current = lockedQueue->m_current;
+
+	// Nothing to do until the Scheduler has been initialized on this processor.
+	if (current != NULL)
+	{
+		// We're on another thread's stack now, so the one that exited last time is done with its
+		// own.
+		if (lockedQueue->m_lastExited != NULL)
+		{
+			lockedQueue->m_lastExited->m_state = THREAD_EXITED;
+			lockedQueue->m_lastExited = NULL;
+		}
+
+		// The same goes for the one that was preempted, so it is safe to let thieves have it now.
+		// Doing this before picking lets it be chosen again right away.
+		if (lockedQueue->m_lastPreempted != NULL)
+		{
+			Scheduler_requeue( lockedQueue, lockedQueue->m_lastPreempted );
+			lockedQueue->m_lastPreempted = NULL;
+		}
+
+		// Most timer interrupts are for other timers, in which case only a newly added thread of
+		// higher priority can preempt the running one.
+		bool isSliceUsedUp = lockedQueue->m_isSliceUsedUp;
+		lockedQueue->m_isSliceUsedUp = false;
+
+		Thread* next = Scheduler_pickNext( lockedQueue, id, current, isSliceUsedUp );
+		if (next != NULL)
+		{
+			current->m_trapFrame = trapFrame;
+			Scheduler_switchTo( lockedQueue, id, current, next );
+			newFrame = next->m_trapFrame;
+		}
+
+		// Start a slice for the new thread, or a new one for the running thread if nothing else of
+		// the same priority wants to run.
+		if ((next != NULL) || isSliceUsedUp)
+		{
+			Scheduler_startSlice( lockedQueue );
+		}
+	}
+
+	Lock_release( &(queue->m_lock) );
+	return newFrame;
+}
+
+
+void Scheduler_exitCurrentThread( void )
+{
+	// With interrupts off, this thread can't be preempted, and so can't be stolen either. That
+	// keeps the processor ID valid until the thread is marked.
+	Processor_disableInterrupts();
+	volatile SchedulerRunQueue* queue = &(s_runQueues[Scheduler_getCurrentProcessorId()]);
+
+	Lock_acquire( &(queue->m_lock) );
+	SchedulerRunQueue* lockedQueue = (SchedulerRunQueue*) queue;
+
+	Thread* current = lockedQueue->m_current;
+	KDebug_assert( current != NULL );
+	KDebug_assert( current != lockedQueue->m_idleThread );
+	current->m_state = THREAD_EXITING;
+	Scheduler_endSlice( lockedQueue );
+
+	Lock_release( &(queue->m_lock) );
+
+	// The timer interrupt will switch away from this thread for good.
+	Processor_enableInterrupts();
+	while (true)
+	{
+		Processor_waitForInterrupt();
+	}
+}
+
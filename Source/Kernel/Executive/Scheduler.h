@@ -0,0 +1,128 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/Executive/Scheduler.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/12
+//
+// ===========================================================================
+///
+///	\file
+///
+/// \brief	Defines the Scheduler class, which decides which Thread runs on
+///			each processor.
+///
+/// Each processor has its own run queue, so that picking the next thread
+/// never touches another processor's data. A run queue keeps a FIFO line of
+/// ready threads for each priority, plus a bitmask with one bit set for each
+/// line that isn't empty. Finding the next thread is just a matter of finding
+/// the highest set bit in the mask, so it takes the same time no matter how
+/// many threads are ready.
+///
+/// Scheduling is preemptive and is driven by the timer interrupt. The running
+/// thread is preempted as soon as a thread of higher priority is added.
+/// Otherwise, it runs until its time slice is used up, at which point it goes
+/// to the back of the line for its priority. Threads of lower priority only
+/// run when no thread of higher priority is ready, so the idle thread only
+/// runs when there is nothing else to do. Each processor has a Timer that
+/// marks the end of the current slice, rather than a periodic tick. On UP
+/// systems, it isn't armed at all while the idle thread runs, so an idle
+/// processor is left alone.
+///
+/// A thread starts out on the processor that added it. When a processor runs
+/// out of threads, rather than going idle, it steals the highest-priority
+/// ready thread from the processor with the most ready threads, which then
+/// stays on its new processor. Each line is a lock-free WorkDeque that the
+/// owner adds to at the bottom and that everyone takes from at the top, so a
+/// thief never holds up the processor it is stealing from. An idle processor
+/// wakes up every SCHEDULER_BALANCE_INTERVAL to look for work to steal. On UP
+/// systems, there is never anyone to steal from, so it doesn't bother.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_EXECUTIVE_SCHEDULER_H_
+#define _KERNEL_EXECUTIVE_SCHEDULER_H_
+
+
+#include "Kernel/HAL/TrapFrame.h"
+#include "Kernel/HAL/WorkDeque.h"
+#include "Thread.h"
+#include "Timer.h"
+
+
+// Public constants
+
+/// \brief	Defines the constants that control scheduling, in microseconds.
+enum Scheduler_consts
+{
+	/// \brief	How long a thread may run before others of the same priority get a turn.
+	SCHEDULER_TIME_SLICE		= 50000,
+
+	/// \brief	How often an idle processor looks for work to steal on MP systems. It matches the
+	///			time slice, so an idle processor wakes up no more often than a busy one switches.
+	SCHEDULER_BALANCE_INTERVAL	= SCHEDULER_TIME_SLICE
+};
+
+
+
+/// \brief	Initializes the current processor's run queue, and makes the thread that is already
+///			running on the processor its idle thread.
+///
+/// \param idleThread	the Thread that will represent the code that called this method.
+///
+/// The caller becomes a thread of priority THREAD_PRIORITY_IDLE. It runs whenever no other thread
+/// on the processor is ready, and so must never exit; Usually it just waits for interrupts in a
+/// loop. Its stack is whatever stack it was already using.
+///
+/// This method must be called once on each processor in the system during kernel initialization,
+/// after Timer_initForCurrentProcessor() and before Scheduler_addThread() is called on that
+/// processor. It must be called with interrupts disabled for the current processor. Until it is
+/// called, Scheduler_handleTimerInterrupt() does nothing.
+void Scheduler_initForCurrentProcessor( Thread* idleThread );
+
+
+/// \brief	Adds a thread to the current processor's run queue.
+///
+/// \param thread	a Thread that was just initialized by Thread_init().
+///
+/// The thread runs once it is the highest-priority ready thread on the processor. If that is
+/// already the case, the running thread is preempted right away.
+///
+/// Each processor's run queue has room for WORK_DEQUE_CAPACITY new threads of each priority.
+/// Threads that are already running never lose their place, even when their priority is full.
+///
+/// \retval true	the thread was added.
+/// \retval false	the run queue has no room for more threads of the same priority. The thread
+///					was left as it was, so it can be added again later.
+bool Scheduler_addThread( Thread* thread );
+
+
+/// \brief	Called by the timer interrupt handler to switch to another thread if it is time to.
+///
+/// \param trapFrame	the machine state of the interrupted thread.
+///
+/// This method must be called with interrupts disabled, after the interrupt has been acknowledged
+/// and Timer_handleInterrupt() has run the expired timers, since it may not return to the
+/// interrupted thread for some time.
+///
+/// \retval NULL		the interrupted thread can continue to run.
+/// \retval	TrapFrame*	the context of the thread to switch to.
+TrapFrame* Scheduler_handleTimerInterrupt( TrapFrame* trapFrame );
+
+
+/// \brief	Ends the current thread.
+///
+/// This is called when a thread's start function returns, and never returns itself. The thread
+/// keeps running, with interrupts enabled, until the timer interrupt that this method asks for
+/// switches away from it for good.
+void Scheduler_exitCurrentThread( void );
+
+
+#endif
+
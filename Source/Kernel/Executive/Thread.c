@@ -0,0 +1,56 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/Executive/Thread.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/12
+//
+// ===========================================================================
+///
+///	\file
+///
+/// \brief	Contains the implementation of the Thread class.
+///
+// ===========================================================================
+
+
+#include "Kernel/KCommon/KDebug.h"
+#include "Scheduler.h"
+#include "Thread.h"
+
+
+// Public functions
+
+void Thread_init(
+	Thread*						thread,
+	void*						stackBase,
+	size_t						stackSize,
+	Processor_threadStartFunc	start,
+	void*						arg,
+	int							priority
+)
+{
+	KDebug_assertArg( thread != NULL );
+	KDebug_assertArg( (THREAD_PRIORITY_IDLE < priority) && (priority <= THREAD_PRIORITY_HIGHEST) );
+
+	// When start() returns, it returns straight into the Scheduler.
+	thread->m_trapFrame = Processor_createKernelThreadFrame(
+		stackBase,
+		stackSize,
+		start,
+		arg,
+		Scheduler_exitCurrentThread
+	);
+
+	thread->m_state			= THREAD_READY;
+	thread->m_priority		= priority;
+	thread->m_processorId	= 0;
+	thread->m_nextOverflow	= NULL;
+}
+
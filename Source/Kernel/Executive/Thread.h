@@ -0,0 +1,134 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/Executive/Thread.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/12
+//
+// ===========================================================================
+///
+///	\file
+///
+/// \brief	Defines the Thread class, which represents a kernel thread that the
+///			Scheduler can run.
+///
+/// A thread is created with Thread_init() and then handed to
+/// Scheduler_addThread() to start it. There is no VMM or kernel heap yet, so
+/// the caller provides the memory for both the Thread and its kernel stack,
+/// and must keep them around until Thread_hasExited() returns \c true.
+///
+/// A thread ends when its start function returns. There is no way to block
+/// a thread yet, so a thread is always either running, waiting in a run
+/// queue, or finished.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_EXECUTIVE_THREAD_H_
+#define _KERNEL_EXECUTIVE_THREAD_H_
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "Kernel/HAL/Processor.h"
+#include "Kernel/HAL/TrapFrame.h"
+
+
+// Public constants
+
+/// \brief	Defines the range of thread priorities.
+///
+/// Higher numbers mean higher priorities. There must be no more priorities than there are bits in
+/// a uintptr_t, since the Scheduler keeps one bit per priority to find the next thread to run.
+enum Thread_consts
+{
+	THREAD_PRIORITY_COUNT	= 32,	///< Number of distinct priorities.
+	THREAD_PRIORITY_IDLE	= 0,	///< Priority of each processor's idle thread.
+	THREAD_PRIORITY_NORMAL	= THREAD_PRIORITY_COUNT / 2,	///< Priority of most threads.
+	THREAD_PRIORITY_HIGHEST	= THREAD_PRIORITY_COUNT - 1		///< The highest priority there is.
+};
+
+
+/// \brief	Defines the states that a thread goes through.
+typedef enum
+{
+	THREAD_READY,	///< Waiting in a run queue for its turn to run.
+	THREAD_RUNNING,	///< Running on a processor.
+	THREAD_EXITING,	///< Finished, but still running until the next context switch.
+	THREAD_EXITED	///< Finished, and never to run again.
+} ThreadState;
+
+
+
+/// \brief	Defines the fields of the Thread class.
+///
+/// The fields are only meant to be used by Thread and the Scheduler. Except during Thread_init(),
+/// they are protected by the lock of the run queue that the thread belongs to. A ready thread can
+/// be stolen by another processor, in which case it belongs to that processor's run queue from
+/// then on.
+typedef struct ThreadStruct
+{
+	/// \brief	The machine state to restore when the thread next runs. Only valid while the
+	///			thread isn't running.
+	TrapFrame* m_trapFrame;
+
+	/// \brief	Where the thread is in its life.
+	volatile ThreadState m_state;
+
+	/// \brief	The thread's priority, from THREAD_PRIORITY_IDLE to THREAD_PRIORITY_HIGHEST.
+	int m_priority;
+
+	/// \brief	The ID of the processor whose run queue the thread belongs to.
+	int m_processorId;
+
+	/// \brief	The next thread in the run queue's overflow list, if the thread is in one.
+	struct ThreadStruct* m_nextOverflow;
+
+} Thread;
+
+
+
+/// \brief	Initializes a new thread that is ready to be passed to Scheduler_addThread().
+///
+/// \param thread		the Thread to initialize.
+/// \param stackBase	the lowest address of the thread's kernel stack.
+/// \param stackSize	the size of the thread's kernel stack, in bytes.
+/// \param start		the function at which the thread starts running.
+/// \param arg			the argument to pass to \a start.
+/// \param priority		the thread's priority. Must not be THREAD_PRIORITY_IDLE, which is
+///						reserved for the idle threads.
+///
+/// The thread starts running \a start with interrupts enabled, and exits when \a start returns.
+///
+/// In checked builds, a bugcheck will occur if \a thread, \a stackBase or \a start is NULL, if the
+/// stack is too small, or if \a priority is out of range.
+void Thread_init(
+	Thread*						thread,
+	void*						stackBase,
+	size_t						stackSize,
+	Processor_threadStartFunc	start,
+	void*						arg,
+	int							priority
+);
+
+
+/// \brief	Determines whether the given thread has finished and been switched away from for the
+///			last time.
+///
+/// \param thread	the Thread to check.
+///
+/// \return	\c true if neither the Thread nor its stack will be used again; \c false otherwise.
+static inline bool Thread_hasExited( const volatile Thread* thread )
+{
+	return (thread->m_state == THREAD_EXITED);
+}
+
+
+#endif
+
@@ -0,0 +1,492 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/Executive/Timer.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/15
+//
+// ===========================================================================
+///
+///	\file
+///
+/// \brief	Contains the implementation of the Timer class.
+///
+// ===========================================================================
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Kernel/HAL/Lock.h"
+#include "Kernel/HAL/Processor.h"
+#include "Kernel/HAL/SystemTimer.h"
+#include "Kernel/KCommon/KDebug.h"
+#include "Kernel/KCommon/KMem.h"
+#include "Timer.h"
+
+
+// Private constants
+
+/// \brief	Defines the shape of the timer wheels.
+enum Timer_consts
+{
+	/// \brief	Each wheel tick is 2^TIMER_TICK_SHIFT microseconds, or 256 us.
+	TIMER_TICK_SHIFT	= 8,
+
+	/// \brief	Each level has 2^TIMER_SLOT_BITS slots, so that its bitmap fits in a uintptr_t.
+	TIMER_SLOT_BITS		= 5,
+
+	/// \brief	The number of slots in each level.
+	TIMER_NUM_SLOTS		= 1 << TIMER_SLOT_BITS,
+
+	/// \brief	The number of levels. Together, they reach 2^40 ticks, or about 9 years, ahead.
+	TIMER_NUM_LEVELS	= 8,
+
+	/// \brief	The value of Timer::m_level for a timer that is about to be run.
+	TIMER_LEVEL_EXPIRING	= 0xFF
+};
+
+
+/// \brief	The furthest ahead of the wheel's current tick that a timer can be put. Timers that are
+///			further ahead go in the last slot that reaches, and are moved on from there.
+static const uint64_t TIMER_MAX_TICKS_AHEAD = (1ULL << (TIMER_SLOT_BITS * TIMER_NUM_LEVELS)) - 1;
+
+
+
+// Private types
+
+/// \brief	Defines the fields of a single processor's hierarchical timer wheel.
+///
+/// Each level is a ring of slots, and each slot is a list of timers. A slot in level 0 holds the
+/// timers that expire in one tick. A slot in level k covers 2^(5k) ticks, and holds the timers that
+/// expire during them but are too far off for any lower level. When the wheel reaches the start of
+/// such a slot, its timers are cascaded, which means that they are put back in the wheel and so
+/// land in a lower level, until they reach level 0. Arming and cancelling a timer is just adding it
+/// to or removing it from a list, so both take the same time no matter how many timers are armed.
+///
+/// There is no periodic tick to turn the wheel. Instead, the bitmaps of occupied slots show which
+/// tick next has anything to do, and the SystemTimer is programmed for it. The wheel jumps straight
+/// there, since all the ticks in between would do nothing.
+typedef struct
+{
+	/// \brief	Synchronizes access to the wheel and to the processor's SystemTimer.
+	Lock m_lock;
+
+	/// \brief	The next tick to be processed. Every earlier tick has been.
+	uint64_t m_nextTick;
+
+	/// \brief	The tick for which the SystemTimer is programmed, or UINT64_MAX if none.
+	uint64_t m_programmedTick;
+
+	/// \brief	Bit s of element k is set if slot s of level k has any timers.
+	uintptr_t m_occupied[TIMER_NUM_LEVELS];
+
+	/// \brief	The first timer in each slot of each level.
+	Timer* m_slots[TIMER_NUM_LEVELS][TIMER_NUM_SLOTS];
+
+	/// \brief	The timers that have expired but haven't been run yet.
+	Timer* m_expiring;
+
+} TimerWheel;
+
+
+
+// Private variables
+
+/// \brief	One timer wheel per processor, indexed by processor ID.
+static volatile TimerWheel s_timerWheels[PROCESSOR_MAX_COUNT];
+
+
+
+// Private functions
+
+/// \brief	Gets the current processor's timer wheel.
+///
+/// \return the timer wheel of the current processor.
+static inline volatile TimerWheel* Timer_getCurrentWheel( void )
+{
+	int id = Processor_getID( Processor_getCurrent() );
+	KDebug_assert( (0 <= id) && (id < PROCESSOR_MAX_COUNT) );
+	return &(s_timerWheels[id]);
+}
+
+
+/// \brief	Gets the number of bits to shift a tick right by to get its slot index in a level.
+static inline unsigned int Timer_getLevelShift( unsigned int level )
+{
+	return level * TIMER_SLOT_BITS;
+}
+
+
+/// \brief	Gets the list that the given armed timer is in.
+///
+/// \param wheel	the timer wheel. The caller must hold its lock.
+/// \param timer	the armed timer.
+///
+/// \return a pointer to the first timer of the list.
+static inline Timer** Timer_getList( TimerWheel* wheel, const Timer* timer )
+{
+	if (timer->m_level == TIMER_LEVEL_EXPIRING)
+	{
+		return &(wheel->m_expiring);
+	}
+	return &(wheel->m_slots[timer->m_level][timer->m_slot]);
+}
+
+
+/// \brief	Adds a timer to the front of a list.
+static inline void Timer_push( Timer** list, Timer* timer )
+{
+	timer->m_prev = NULL;
+	timer->m_next = *list;
+	if (*list != NULL)
+	{
+		(*list)->m_prev = timer;
+	}
+	*list = timer;
+}
+
+
+/// \brief	Puts a timer in the slot of the wheel where its deadline falls.
+///
+/// \param wheel	the timer wheel. The caller must hold its lock.
+/// \param timer	the timer to add. It must not be in any list.
+static void Timer_insert( TimerWheel* wheel, Timer* timer )
+{
+	// Round up, so that a timer never expires early. Those that are already due expire on the
+	// next tick.
+	uint64_t tick = (timer->m_deadline >> TIMER_TICK_SHIFT)
+		+ (((timer->m_deadline & ((1 << TIMER_TICK_SHIFT) - 1)) != 0) ? 1 : 0);
+
+	if (tick < wheel->m_nextTick)
+	{
+		tick = wheel->m_nextTick;
+	}
+	else if (tick - wheel->m_nextTick > TIMER_MAX_TICKS_AHEAD)
+	{
+		tick = wheel->m_nextTick + TIMER_MAX_TICKS_AHEAD;
+	}
+
+	// Find the lowest level that reaches far enough ahead.
+	uint64_t ticksAhead = tick - wheel->m_nextTick;
+	unsigned int level = 0;
+	while ((level < TIMER_NUM_LEVELS - 1)
+		&& ((ticksAhead >> Timer_getLevelShift( level + 1 )) != 0))
+	{
+		level++;
+	}
+
+	uint8_t slot = (uint8_t) ((tick >> Timer_getLevelShift( level )) & (TIMER_NUM_SLOTS - 1));
+	timer->m_level	= (uint8_t) level;
+	timer->m_slot	= slot;
+	Timer_push( &(wheel->m_slots[level][slot]), timer );
+	wheel->m_occupied[level] = KMem_bitSet( wheel->m_occupied[level], slot );
+}
+
+
+/// \brief	Takes an armed timer out of the wheel.
+///
+/// \param wheel	the timer wheel. The caller must hold its lock.
+/// \param timer	the armed timer to remove.
+static void Timer_unlink( TimerWheel* wheel, Timer* timer )
+{
+	Timer** list = Timer_getList( wheel, timer );
+
+	if (timer->m_prev != NULL)
+	{
+		timer->m_prev->m_next = timer->m_next;
+	}
+	else
+	{
+		*list = timer->m_next;
+	}
+
+	if (timer->m_next != NULL)
+	{
+		timer->m_next->m_prev = timer->m_prev;
+	}
+
+	if ((*list == NULL) && (timer->m_level != TIMER_LEVEL_EXPIRING))
+	{
+		wheel->m_occupied[timer->m_level] =
+			KMem_bitClear( wheel->m_occupied[timer->m_level], timer->m_slot );
+	}
+
+	timer->m_next		= NULL;
+	timer->m_prev		= NULL;
+	timer->m_isArmed	= false;
+}
+
+
+/// \brief	Finds the next tick that has anything to do: Either timers expire, or timers have to be
+///			cascaded to a lower level.
+///
+/// \param wheel	the timer wheel. The caller must hold its lock.
+///
+/// This looks at one bitmap per level, so it takes the same time no matter how many timers are
+/// armed.
+///
+/// \return the next tick to process, or UINT64_MAX if no timers are armed.
+static uint64_t Timer_findNextTick( const TimerWheel* wheel )
+{
+	uint64_t nextTick = UINT64_MAX;
+
+	for (unsigned int level = 0; level < TIMER_NUM_LEVELS; level++)
+	{
+		uintptr_t occupied = wheel->m_occupied[level];
+		if (occupied == 0)
+		{
+			continue;
+		}
+
+		unsigned int shift		= Timer_getLevelShift( level );
+		uint64_t levelTick		= wheel->m_nextTick >> shift;
+		unsigned int current	= (unsigned int) (levelTick & (TIMER_NUM_SLOTS - 1));
+
+		// Rotate the bitmap so that bit i stands for the slot i slots after the current one.
+		uintptr_t ahead = occupied;
+		if (current != 0)
+		{
+			ahead = ((occupied >> current) | (occupied << (TIMER_NUM_SLOTS - current)))
+				& (((uintptr_t) 2 << (TIMER_NUM_SLOTS - 1)) - 1);
+		}
+
+		// The current slot of a higher level has already been cascaded, unless the wheel is
+		// right at its start. If anything is in it now, it is for the next time around.
+		int slotsAhead;
+		bool isCurrentDone = (level > 0) && ((wheel->m_nextTick & ((1ULL << shift) - 1)) != 0);
+		if (isCurrentDone && (KMem_bitClear( ahead, 0 ) == 0))
+		{
+			slotsAhead = TIMER_NUM_SLOTS;
+		}
+		else
+		{
+			slotsAhead = KMem_findLowestSetBit( isCurrentDone ? KMem_bitClear( ahead, 0 ) : ahead );
+		}
+
+		uint64_t tick = (levelTick + (uint64_t) slotsAhead) << shift;
+		if (tick < nextTick)
+		{
+			nextTick = tick;
+		}
+	}
+	return nextTick;
+}
+
+
+/// \brief	Processes the wheel's next tick: Cascades the higher-level slots that start on it, and
+///			moves the timers that expire on it to the expiring list.
+///
+/// \param wheel	the timer wheel. The caller must hold its lock.
+static void Timer_processTick( TimerWheel* wheel )
+{
+	uint64_t tick = wheel->m_nextTick;
+
+	// Level k only moves on when every level below it wraps around.
+	for (unsigned int level = 1; level < TIMER_NUM_LEVELS; level++)
+	{
+		unsigned int shift = Timer_getLevelShift( level );
+		if ((tick & ((1ULL << shift) - 1)) != 0)
+		{
+			break;
+		}
+
+		uint8_t slot = (uint8_t) ((tick >> shift) & (TIMER_NUM_SLOTS - 1));
+		Timer* timer = wheel->m_slots[level][slot];
+		wheel->m_slots[level][slot] = NULL;
+		wheel->m_occupied[level] = KMem_bitClear( wheel->m_occupied[level], slot );
+
+		while (timer != NULL)
+		{
+			Timer* next = timer->m_next;
+			Timer_insert( wheel, timer );
+			timer = next;
+		}
+	}
+
+	// Everything in the current slot of level 0 expires on this tick, so it is all moved at once.
+	uint8_t slot = (uint8_t) (tick & (TIMER_NUM_SLOTS - 1));
+	Timer* timer = wheel->m_slots[0][slot];
+	wheel->m_slots[0][slot] = NULL;
+	wheel->m_occupied[0] = KMem_bitClear( wheel->m_occupied[0], slot );
+
+	while (timer != NULL)
+	{
+		Timer* next = timer->m_next;
+		timer->m_level = TIMER_LEVEL_EXPIRING;
+		Timer_push( &(wheel->m_expiring), timer );
+		timer = next;
+	}
+
+	wheel->m_nextTick = tick + 1;
+}
+
+
+/// \brief	Programs the SystemTimer for the wheel's next tick that has anything to do.
+///
+/// \param wheel	the timer wheel. The caller must hold its lock.
+static void Timer_programNextTick( TimerWheel* wheel )
+{
+	uint64_t nextTick = Timer_findNextTick( wheel );
+	wheel->m_programmedTick = nextTick;
+
+	// Ticks that far off can't be converted, but there's no hurry for them anyway.
+	bool isConvertible = (nextTick <= (UINT64_MAX >> TIMER_TICK_SHIFT));
+	SystemTimer_setNextInterrupt( isConvertible ? (nextTick << TIMER_TICK_SHIFT) : UINT64_MAX );
+}
+
+
+
+// Public functions
+
+void Timer_initForCurrentProcessor( void )
+{
+	KDebug_assert( Processor_areInterruptsDisabled() );
+
+	// NOTE: It is safe to cast away volatile here, since interrupts must be disabled according to
+	// this method's contract, and no other processor uses this wheel.
+	TimerWheel* wheel = (TimerWheel*) Timer_getCurrentWheel();
+	wheel->m_lock			= Lock_create();
+	wheel->m_programmedTick	= UINT64_MAX;
+	wheel->m_expiring		= NULL;
+	for (size_t level = 0; level < TIMER_NUM_LEVELS; level++)
+	{
+		wheel->m_occupied[level] = 0;
+		for (size_t slot = 0; slot < TIMER_NUM_SLOTS; slot++)
+		{
+			wheel->m_slots[level][slot] = NULL;
+		}
+	}
+
+	SystemTimer_initForCurrentProcessor();
+	wheel->m_nextTick = SystemTimer_getTime() >> TIMER_TICK_SHIFT;
+}
+
+
+uint64_t Timer_getTime( void )
+{
+	// The lock is only needed to keep interrupts off while the hardware is read.
+	volatile TimerWheel* wheel = Timer_getCurrentWheel();
+	Lock_acquire( &(wheel->m_lock) );
+	uint64_t now = SystemTimer_getTime();
+	Lock_release( &(wheel->m_lock) );
+	return now;
+}
+
+
+void Timer_init( Timer* timer, Timer_expiredFunc expired, void* context )
+{
+	KDebug_assertArg( timer != NULL );
+	KDebug_assertArg( expired != NULL );
+
+	timer->m_deadline		= 0;
+	timer->m_expired		= expired;
+	timer->m_context		= context;
+	timer->m_next			= NULL;
+	timer->m_prev			= NULL;
+	timer->m_processorId	= 0;
+	timer->m_level			= 0;
+	timer->m_slot			= 0;
+	timer->m_isArmed		= false;
+}
+
+
+void Timer_arm( Timer* timer, uint64_t deadline )
+{
+	KDebug_assertArg( timer != NULL );
+
+	// The timer may be armed on another processor, so take it out of that wheel first.
+	Timer_cancel( timer );
+
+	int id = Processor_getID( Processor_getCurrent() );
+	volatile TimerWheel* wheel = &(s_timerWheels[id]);
+
+	Lock_acquire( &(wheel->m_lock) );
+	TimerWheel* lockedWheel = (TimerWheel*) wheel;
+
+	timer->m_deadline		= deadline;
+	timer->m_processorId	= id;
+	timer->m_isArmed		= true;
+	Timer_insert( lockedWheel, timer );
+
+	// The SystemTimer has to interrupt sooner if this timer has to be expired or cascaded before
+	// anything else.
+	if (Timer_findNextTick( lockedWheel ) < lockedWheel->m_programmedTick)
+	{
+		Timer_programNextTick( lockedWheel );
+	}
+
+	Lock_release( &(wheel->m_lock) );
+}
+
+
+bool Timer_cancel( Timer* timer )
+{
+	KDebug_assertArg( timer != NULL );
+
+	if (!timer->m_isArmed)
+	{
+		return false;
+	}
+
+	// The timer may expire before the lock is acquired, so check again once it is. There is no
+	// need to reprogram the SystemTimer if the next timer goes; The interrupt will just find
+	// nothing to do.
+	volatile TimerWheel* wheel = &(s_timerWheels[timer->m_processorId]);
+	Lock_acquire( &(wheel->m_lock) );
+
+	bool wasArmed = timer->m_isArmed;
+	if (wasArmed)
+	{
+		Timer_unlink( (TimerWheel*) wheel, timer );
+	}
+
+	Lock_release( &(wheel->m_lock) );
+	return wasArmed;
+}
+
+
+void Timer_handleInterrupt( void )
+{
+	KDebug_assert( Processor_areInterruptsDisabled() );
+
+	volatile TimerWheel* wheel = Timer_getCurrentWheel();
+	Lock_acquire( &(wheel->m_lock) );
+	TimerWheel* lockedWheel = (TimerWheel*) wheel;
+
+	// Timers that are armed for now or earlier while this runs are run too.
+	uint64_t nowTick = SystemTimer_getTime() >> TIMER_TICK_SHIFT;
+	uint64_t nextTick;
+	while ((nextTick = Timer_findNextTick( lockedWheel )) <= nowTick)
+	{
+		// Every tick before the next one would do nothing, so skip straight to it.
+		lockedWheel->m_nextTick = nextTick;
+		Timer_processTick( lockedWheel );
+
+		while (lockedWheel->m_expiring != NULL)
+		{
+			Timer* timer = lockedWheel->m_expiring;
+			Timer_unlink( lockedWheel, timer );
+
+			// The lock can't be held while the function runs, since it may well arm a timer.
+			Lock_release( &(wheel->m_lock) );
+			timer->m_expired( timer, timer->m_context );
+			Lock_acquire( &(wheel->m_lock) );
+		}
+	}
+
+	// Nothing is left to do up to now, so timers armed from here on are measured from the next
+	// tick.
+	if (lockedWheel->m_nextTick <= nowTick)
+	{
+		lockedWheel->m_nextTick = nowTick + 1;
+	}
+
+	Timer_programNextTick( lockedWheel );
+	Lock_release( &(wheel->m_lock) );
+}
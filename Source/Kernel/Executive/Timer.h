@@ -0,0 +1,145 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/Executive/Timer.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/15
+//
+// ===========================================================================
+///
+///	\file
+///
+/// \brief	Defines the Timer class, which calls a function at a given time.
+///
+/// Each processor keeps its armed timers in a hierarchical timer wheel, so
+/// that arming and cancelling a timer takes the same short time whether a
+/// handful of timers are armed or tens of thousands. The wheel is divided into
+/// ticks of 256 microseconds, and all the timers that expire in the same tick
+/// are run together. There is no periodic tick, though: The SystemTimer is
+/// programmed in one-shot mode for the next tick that has anything to do, so
+/// a processor that has nothing to wait for isn't interrupted just to find
+/// that out.
+///
+/// Times are in microseconds since the processor's clock was started. A timer
+/// never expires before its deadline, and normally expires less than a tick
+/// after it. Expired timers are run from the timer interrupt, with interrupts
+/// disabled. Their functions must not block, and should be short.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_EXECUTIVE_TIMER_H_
+#define _KERNEL_EXECUTIVE_TIMER_H_
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/// \brief	Calls a function at a given time.
+typedef struct TimerStruct Timer;
+
+
+/// \brief	Function that is called when a Timer expires.
+///
+/// \param timer	the Timer that expired. It is no longer armed, so it may be armed again.
+/// \param context	the context that was passed to Timer_init().
+typedef void (*Timer_expiredFunc)( Timer* timer, void* context );
+
+
+/// \brief	Defines the fields of the Timer class.
+///
+/// The fields are only meant to be used by Timer. While the timer is armed, they are protected by
+/// the lock of the timer wheel that it is in.
+struct TimerStruct
+{
+	/// \brief	The time at which the timer expires.
+	uint64_t m_deadline;
+
+	/// \brief	The function to call when the timer expires.
+	Timer_expiredFunc m_expired;
+
+	/// \brief	The argument to pass to m_expired.
+	void* m_context;
+
+	/// \brief	The next timer in the same slot of the wheel.
+	Timer* m_next;
+
+	/// \brief	The previous timer in the same slot of the wheel, or NULL if this one is first.
+	Timer* m_prev;
+
+	/// \brief	The ID of the processor whose wheel the timer is in. Only valid while armed.
+	int m_processorId;
+
+	/// \brief	The level of the wheel that the timer is in. Only valid while armed.
+	uint8_t m_level;
+
+	/// \brief	The slot of the level that the timer is in. Only valid while armed.
+	uint8_t m_slot;
+
+	/// \brief	Whether the timer is in a wheel.
+	bool m_isArmed;
+};
+
+
+
+/// \brief	Starts the current processor's clock, and sets up its empty timer wheel.
+///
+/// This method must be called once on each processor in the system during kernel initialization,
+/// before any Timer is armed on that processor. It must be called with interrupts disabled for the
+/// current processor.
+void Timer_initForCurrentProcessor( void );
+
+
+/// \brief	Gets the current time on the current processor's clock.
+///
+/// \return the number of microseconds since Timer_initForCurrentProcessor() was called.
+uint64_t Timer_getTime( void );
+
+
+/// \brief	Initializes a new Timer that isn't armed.
+///
+/// \param timer	the Timer to initialize.
+/// \param expired	the function to call each time the timer expires.
+/// \param context	the argument to pass to \a expired.
+///
+/// In checked builds, a bugcheck will occur if \a timer or \a expired is NULL.
+void Timer_init( Timer* timer, Timer_expiredFunc expired, void* context );
+
+
+/// \brief	Arms the Timer on the current processor, so that it expires at the given time.
+///
+/// \param timer	the Timer to arm.
+/// \param deadline	the time at which \a timer expires, as returned by Timer_getTime(). If it has
+///					already passed, the timer expires as soon as the timer interrupt can be taken.
+///
+/// If the timer is already armed, its old deadline is forgotten. Timers that expire in the same
+/// tick of the wheel are run in no particular order. A Timer must not be armed or cancelled by two
+/// processors at once.
+void Timer_arm( Timer* timer, uint64_t deadline );
+
+
+/// \brief	Disarms the Timer, so that it won't expire.
+///
+/// \param timer	the Timer to cancel.
+///
+/// \retval true	the timer was armed.
+/// \retval false	the timer wasn't armed, or has already expired.
+bool Timer_cancel( Timer* timer );
+
+
+/// \brief	Called by the timer interrupt handler to run the timers that have expired on the
+///			current processor, and to program the SystemTimer for the next one.
+///
+/// This method must be called with interrupts disabled, after the interrupt has been
+/// acknowledged.
+void Timer_handleInterrupt( void );
+
+
+#endif
+
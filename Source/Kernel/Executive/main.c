@@ -23,6 +23,7 @@
 
 
 #include "Kernel/KRunTime/DisplayTextStream.h"
+#include "Kernel/KRunTime/KLockStats.h"
 #include "Kernel/KRunTime/KOut.h"
 #include "Kernel/KRunTime/KShutdown.h"
 #include "Kernel/KCommon/KDebug.h"
@@ -30,6 +31,7 @@
 #include "Kernel/MM/PhysicalMemoryManager.h"
 #include "ExceptionDispatcher.h"
 #include "InterruptDispatcher.h"
+#include "Scheduler.h"
 #include "BootLoaderInfo.h"
 
 
@@ -48,6 +50,14 @@ static const char* BUILD_NAME = "Checked";
 #endif
 
 
+/// \brief	Number of frames to scrub in each pass through the idle loop.
+static const size_t IDLE_SCRUB_BATCH_SIZE = 8;
+
+
+/// \brief	The thread that kmain() becomes once the Scheduler is running.
+static Thread s_idleThread;
+
+
 /// \brief	C-language entry point of the Precursor microkernel.
 ///
 /// \param bootInfo	information from the bootloader that will be used to initialize the kernel.
@@ -90,19 +100,37 @@ void kmain( BootLoaderInfo* bootInfo )
 		PhysicalMemoryManager_initStageOne( ramList, reservedList, moduleList );
 		
 	KOut_writeLine(
-		"\nSpace required for Physical Memory Manager: %d frames ***FIXME",
+		"\nSpace required for Physical Memory Manager: %d bytes",
 		spaceRequiredForPmm
 	);
 	
-	//***FIXME: Allocate & map enough space and then call initStageTwo().
+	//***FIXME: Allocate & map enough space and then call initStageTwo(). This has to wait until
+	// there is a VMM to map the working space into kernel space. Until then, the PMM stays in
+	// "initialization mode": the PageFrameDatabase is never created, allocateZeroed() clears every
+	// frame on the spot, and the idle loop's scrubFreeFrames() always returns zero, so it just
+	// halts. The PFDB path is only exercised by the bootable PmmTest and the hosted tests.
 
 	KOut_writeLine( "\nI'd boot, but I don't know how yet..." );
 
+#ifdef LOCK_STATS
+	// Show which critical sections kept interrupts off the longest during initialization.
+	KOut_writeLine( "" );
+	KLockStats_dump();
+#endif
+
+	// From here on, kmain() is the idle thread. Every other thread takes precedence over it.
+	Scheduler_initForCurrentProcessor( &s_idleThread );
 	Processor_enableInterrupts();
 
+	// This is the idle loop. Use the time to scrub free frames so that allocating a zero-filled
+	// frame doesn't have to clear it on the spot. Only halt once there is nothing left to scrub.
+	volatile PhysicalMemoryManager* pmm = PhysicalMemoryManager_getInstance();
 	while (true)
 	{
-		Processor_waitForInterrupt();
+		if (PhysicalMemoryManager_scrubFreeFrames( pmm, IDLE_SCRUB_BATCH_SIZE ) == 0)
+		{
+			Processor_waitForInterrupt();
+		}
 	}
 }
 
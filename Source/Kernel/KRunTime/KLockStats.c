@@ -0,0 +1,141 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/KRunTime/KLockStats.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/10
+//
+// ===========================================================================
+///
+///	\file
+///
+/// \brief	Implements a utility for reporting the statistics kept by the
+///			instrumented locks.
+///
+// ===========================================================================
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Kernel/HAL/LockStats.h"
+#include "Kernel/KRunTime/KLockStats.h"
+#include "Kernel/KRunTime/KOut.h"
+
+
+// Private constants
+
+/// \brief	Defines private constants for the KLockStats utility.
+enum KLockStats_consts
+{
+	FILE_WIDTH		= 20,	///< Width of the source file column.
+	LINE_WIDTH		= 5,	///< Width of the line number column.
+	COUNT_WIDTH		= 9,	///< Width of the acquire count column.
+	CYCLES_WIDTH	= 10	///< Width of each column of cycles.
+};
+
+
+
+// Private functions
+
+/// \brief	Strips the directories from a path, since __FILE__ is relative to wherever make ran.
+///
+/// \param path	a path to a file.
+///
+/// \return the part of \a path after the last '/'.
+static const char* KLockStats_getFileName( const char* path )
+{
+	const char* name = path;
+	for (const char* c = path; *c != '\0'; c++)
+	{
+		if (*c == '/')
+		{
+			name = c + 1;
+		}
+	}
+	return name;
+}
+
+
+/// \brief	Converts a cycle count to a machine word for printing, saturating if it doesn't fit.
+static uintptr_t KLockStats_clamp( uint64_t cycles )
+{
+	return (cycles > UINTPTR_MAX) ? UINTPTR_MAX : (uintptr_t) cycles;
+}
+
+
+/// \brief	Divides a total number of cycles by a count.
+///
+/// \param total	the total number of cycles.
+/// \param count	the number of measurements in \a total. Must not be zero.
+///
+/// The kernel doesn't link with libgcc, so 64-bit division isn't available from C on x86. This
+/// does it the long way, one bit at a time, which is fine for a report.
+///
+/// \return \a total / \a count.
+static uint64_t KLockStats_average( uint64_t total, uintptr_t count )
+{
+	uint64_t quotient	= 0;
+	uint64_t remainder	= 0;
+	for (int bit = 63; bit >= 0; bit--)
+	{
+		remainder = (remainder << 1) | ((total >> bit) & 1);
+		if (remainder >= count)
+		{
+			remainder -= count;
+			quotient |= ((uint64_t) 1) << bit;
+		}
+	}
+	return quotient;
+}
+
+
+
+// Public functions
+
+void KLockStats_dump( void )
+{
+	LockSite* site = LockStats_getFirstSite();
+	if (site == NULL)
+	{
+		//***FIXME: i18n
+		KOut_writeLine( "No lock statistics. Build with LOCK_STATS=1 to keep them." );
+		return;
+	}
+
+	KOut_writeLine(
+		"%-*s %*s %*s %*s %*s %*s",
+		FILE_WIDTH + LINE_WIDTH,	"Lock site",
+		COUNT_WIDTH,				"Acquires",
+		CYCLES_WIDTH,				"Avg hold",
+		CYCLES_WIDTH,				"Max hold",
+		CYCLES_WIDTH,				"Avg spin",
+		CYCLES_WIDTH,				"Max spin"
+	);
+
+	for ( ; site != NULL; site = LockStats_getNextSite( site ))
+	{
+		// The counts are read without synchronization, so they can be slightly out of step with
+		// each other if locks are in use while this runs. Clamp so that doesn't divide by zero.
+		uintptr_t count		= site->m_acquireCount;
+		uintptr_t divisor	= (count == 0) ? 1 : count;
+		uint64_t avgHold	= KLockStats_average( site->m_totalHoldCycles, divisor );
+		uint64_t avgSpin	= KLockStats_average( site->m_totalSpinCycles, divisor );
+
+		KOut_write( "%-*s", FILE_WIDTH, KLockStats_getFileName( site->m_file ) );
+		KOut_write( "%-*d", LINE_WIDTH, site->m_line );
+		KOut_writeLine(
+			" %*u %*u %*u %*u %*u",
+			COUNT_WIDTH,	count,
+			CYCLES_WIDTH,	KLockStats_clamp( avgHold ),
+			CYCLES_WIDTH,	KLockStats_clamp( site->m_maxHoldCycles ),
+			CYCLES_WIDTH,	KLockStats_clamp( avgSpin ),
+			CYCLES_WIDTH,	KLockStats_clamp( site->m_maxSpinCycles )
+		);
+	}
+}
@@ -0,0 +1,745 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/MM/PageFrameDatabase.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/Apr/02
+//
+// ===========================================================================
+///
+///	\file
+///
+/// \brief	Contains the implementation of the PageFrameDatabase, which tracks
+///			the state of every frame and keeps free frames in per-colour free
+///			lists.
+///
+// ===========================================================================
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "Kernel/KCommon/KDebug.h"
+#include "Kernel/KCommon/KMem.h"
+
+#define _KERNEL_MM_PAGEFRAMEDATABASE_C_
+#include "Kernel/MM/PageFrameDatabase.h"
+
+
+// Private types and constants
+
+/// \brief	The record kept by the PageFrameDatabase for each frame.
+typedef struct PageFrameStruct
+{
+	/// \brief	Frame number of the next frame in the same free list. Only meaningful while the
+	///			frame is free.
+	size_t m_nextFree;
+
+	/// \brief	The current PageFrameState of the frame.
+	uint8_t m_state;
+
+} PageFrame;
+
+
+/// \brief	Defines private constants for the implementation of PageFrameDatabase.
+enum PageFrameDatabase_consts
+{
+	/// \brief	Marks the end of the free list.
+	///
+	/// Frame zero can never be free since its address is PHYS_NULL, so its frame number doubles
+	/// as the "null" link.
+	FREE_LIST_END = 0
+};
+
+
+
+// Private functions
+
+/// \brief	Gets the record for the frame containing the given physical address.
+///
+/// \param pfdb			the PageFrameDatabase.
+/// \param frameAddr	a physical address within the frame.
+///
+/// In checked builds, this method will cause a bugcheck if \a pfdb is NULL or if \a frameAddr is
+/// beyond the last frame tracked by \a pfdb.
+///
+/// \return a pointer to the record for the frame.
+static inline volatile PageFrame* PageFrameDatabase_getFrame(
+	const volatile PageFrameDatabase*	pfdb,
+	phys_addr_t							frameAddr
+)
+{
+	// Note that no locking is necessary for m_frames or m_numFrames since their values never
+	// change during the lifetime of this object.
+	KDebug_assertArg( pfdb != NULL );
+
+	size_t frameNumber = MM_getFrameNumber( frameAddr );
+	KDebug_assertArg( frameNumber < pfdb->m_numFrames );
+	return &(pfdb->m_frames[frameNumber]);
+}
+
+
+/// \brief	Pushes the given frame onto the front of the free list for its colour.
+///
+/// \param pfdb			the PageFrameDatabase.
+/// \param frameNumber	the frame number of the frame to free.
+/// \param isZeroed		\c true to put the frame on the zeroed list instead of the free list.
+///
+/// This method is not thread-safe. The caller must acquire the lock on \a pfdb before calling
+/// this method, unless the database is still being initialized.
+static inline void PageFrameDatabase_pushFreeFrame(
+	PageFrameDatabase*	pfdb,
+	size_t				frameNumber,
+	bool				isZeroed
+)
+{
+	KDebug_assert( frameNumber != FREE_LIST_END );
+
+	size_t colour = MM_getFrameColour( frameNumber, pfdb->m_numColours );
+	size_t* listHeads = (isZeroed) ? pfdb->m_zeroedListHeads : pfdb->m_freeListHeads;
+
+	PageFrame* frame	= &(pfdb->m_frames[frameNumber]);
+	frame->m_state		= PFSTATE_FREE;
+	frame->m_nextFree	= listHeads[colour];
+
+	listHeads[colour] = frameNumber;
+	pfdb->m_numFreeFrames++;
+
+	if (isZeroed)
+	{
+		pfdb->m_numZeroedFrames++;
+	}
+}
+
+
+
+/// \brief	Takes a frame off the given set of per-colour lists that best matches the given colour
+///			hint.
+///
+/// \param pfdb			the PageFrameDatabase.
+/// \param listHeads	either the free lists or the zeroed lists of \a pfdb.
+/// \param colourHint	the colour hint; NULL means no preference.
+///
+/// The frame is put into the PFSTATE_KERNEL state. The caller is responsible for updating
+/// m_numZeroedFrames if the frame came from the zeroed lists.
+///
+/// This method is not thread-safe. The caller must acquire the lock on \a pfdb before calling
+/// this method.
+///
+/// \return the frame number of the frame, or FREE_LIST_END if the lists are empty.
+static size_t PageFrameDatabase_popFromLists(
+	PageFrameDatabase*	pfdb,
+	size_t*				listHeads,
+	void*				colourHint
+)
+{
+	size_t numColours = pfdb->m_numColours;
+	size_t colour = (colourHint != NULL)
+		? MM_getPageColour( colourHint, numColours )
+		: pfdb->m_nextColour;
+
+	// Look for the closest colour that still has a free frame.
+	size_t frameNumber = FREE_LIST_END;
+	for (size_t i = 0; (i < numColours) && (frameNumber == FREE_LIST_END); i++)
+	{
+		frameNumber = listHeads[colour];
+		if (frameNumber == FREE_LIST_END)
+		{
+			colour = (colour + 1) & (numColours - 1);
+		}
+	}
+
+	if (frameNumber != FREE_LIST_END)
+	{
+		PageFrame* frame = &(pfdb->m_frames[frameNumber]);
+		KDebug_assert( frame->m_state == PFSTATE_FREE );
+
+		listHeads[colour] = frame->m_nextFree;
+		pfdb->m_numFreeFrames--;
+
+		frame->m_state		= PFSTATE_KERNEL;
+		frame->m_nextFree	= FREE_LIST_END;
+
+		if (colourHint == NULL)
+		{
+			pfdb->m_nextColour = (colour + 1) & (numColours - 1);
+		}
+	}
+	return frameNumber;
+}
+
+
+/// \brief	Takes a free frame that best matches the given colour hint.
+///
+/// \param pfdb			the PageFrameDatabase.
+/// \param colourHint	the colour hint; NULL means no preference.
+/// \param preferZeroed	\c true to take a zeroed frame if there is one, or \c false to take a
+///						zeroed frame only if there is nothing else left.
+/// \param isZeroed		receives \c true if the frame came from the zeroed lists.
+///
+/// The frame is put into the PFSTATE_KERNEL state.
+///
+/// This method is not thread-safe. The caller must acquire the lock on \a pfdb before calling
+/// this method.
+///
+/// \return the frame number of the frame, or FREE_LIST_END if there are no free frames left.
+static size_t PageFrameDatabase_popFreeFrame(
+	PageFrameDatabase*	pfdb,
+	void*				colourHint,
+	bool				preferZeroed,
+	bool*				isZeroed
+)
+{
+	// Decide which set of lists to use up front using the counts, so that we never walk every
+	// colour of an empty set of lists.
+	size_t numDirtyFrames = pfdb->m_numFreeFrames - pfdb->m_numZeroedFrames;
+	bool useZeroed = (preferZeroed) ? (pfdb->m_numZeroedFrames > 0) : (numDirtyFrames == 0);
+
+	size_t frameNumber = PageFrameDatabase_popFromLists(
+		pfdb,
+		(useZeroed) ? pfdb->m_zeroedListHeads : pfdb->m_freeListHeads,
+		colourHint
+	);
+
+	if ((frameNumber != FREE_LIST_END) && useZeroed)
+	{
+		pfdb->m_numZeroedFrames--;
+	}
+
+	*isZeroed = useZeroed;
+	return frameNumber;
+}
+
+
+/// \brief	Checks that the given frame may be freed, then puts it back on its free list.
+///
+/// \param pfdb			the PageFrameDatabase.
+/// \param frameAddr	the physical address of the frame to free.
+/// \param isZeroed		\c true if the caller has filled the frame with zeroes.
+///
+/// See PageFrameDatabase_free() for the checks that are made.
+///
+/// This method is not thread-safe. The caller must acquire the lock on \a pfdb before calling
+/// this method.
+static void PageFrameDatabase_freeFrame(
+	PageFrameDatabase*	pfdb,
+	phys_addr_t			frameAddr,
+	bool				isZeroed
+)
+{
+	KDebug_assertArg( frameAddr != PHYS_NULL );
+	KDebug_assertArg( MM_isFrameAligned( frameAddr ) );
+
+	size_t frameNumber = MM_getFrameNumber( frameAddr );
+	KDebug_assertArg( frameNumber < pfdb->m_numFrames );
+	if (frameNumber >= pfdb->m_numFrames)
+	{
+		return;
+	}
+
+	uint8_t state = pfdb->m_frames[frameNumber].m_state;
+
+	// The caller isn't allowed to free memory that is already free or that isn't RAM.
+	KDebug_assert( (state == PFSTATE_KERNEL) || (state == PFSTATE_MODULE) );
+
+	if ((state == PFSTATE_KERNEL) || (state == PFSTATE_MODULE))
+	{
+		PageFrameDatabase_pushFreeFrame( pfdb, frameNumber, isZeroed );
+	}
+}
+
+
+
+/// \brief	Unlinks every frame that is no longer free from the given list.
+///
+/// \param pfdb		the PageFrameDatabase.
+/// \param listHead	the head of one of the free or zeroed lists of \a pfdb.
+///
+/// This method is not thread-safe. The caller must acquire the lock on \a pfdb before calling
+/// this method.
+///
+/// \return the number of frames unlinked.
+static size_t PageFrameDatabase_unlinkAllocated( PageFrameDatabase* pfdb, size_t* listHead )
+{
+	size_t numUnlinked = 0;
+	size_t* link = listHead;
+
+	while (*link != FREE_LIST_END)
+	{
+		PageFrame* frame = &(pfdb->m_frames[*link]);
+		if (frame->m_state != PFSTATE_FREE)
+		{
+			*link = frame->m_nextFree;
+			frame->m_nextFree = FREE_LIST_END;
+			numUnlinked++;
+		}
+		else
+		{
+			link = &(frame->m_nextFree);
+		}
+	}
+	return numUnlinked;
+}
+
+
+/// \brief	Allocates every frame of the given run of free frames.
+///
+/// \param pfdb				the PageFrameDatabase.
+/// \param firstFrameNumber	the frame number of the first frame in the run.
+/// \param numFrames		the number of frames in the run. They must all be free.
+///
+/// The frames are put into the PFSTATE_KERNEL state, then taken off whichever lists they were on.
+///
+/// This method is not thread-safe. The caller must acquire the lock on \a pfdb before calling
+/// this method.
+static void PageFrameDatabase_takeRun(
+	PageFrameDatabase*	pfdb,
+	size_t				firstFrameNumber,
+	size_t				numFrames
+)
+{
+	for (size_t i = firstFrameNumber; i < firstFrameNumber + numFrames; i++)
+	{
+		KDebug_assert( pfdb->m_frames[i].m_state == PFSTATE_FREE );
+		pfdb->m_frames[i].m_state = PFSTATE_KERNEL;
+	}
+
+	// Only the lists for the colours in the run can hold its frames.
+	size_t numColours = pfdb->m_numColours;
+	size_t numLists = (numFrames < numColours) ? numFrames : numColours;
+
+	for (size_t i = 0; i < numLists; i++)
+	{
+		size_t colour = MM_getFrameColour( firstFrameNumber + i, numColours );
+
+		size_t numDirty = PageFrameDatabase_unlinkAllocated( pfdb, &(pfdb->m_freeListHeads[colour]) );
+		size_t numZeroed =
+			PageFrameDatabase_unlinkAllocated( pfdb, &(pfdb->m_zeroedListHeads[colour]) );
+
+		pfdb->m_numFreeFrames	-= numDirty + numZeroed;
+		pfdb->m_numZeroedFrames	-= numZeroed;
+	}
+}
+
+
+
+/// \brief	Interface dispatch table for PageFrameDatabase's implementation of IPmmAllocator.
+static IPmmAllocator_itable s_itable =
+{
+	(IPmmAllocator_allocateFunc) PageFrameDatabase_allocate,
+	(IPmmAllocator_freeFunc) PageFrameDatabase_free,
+	(IPmmAllocator_allocateManyFunc) PageFrameDatabase_allocateMany,
+	(IPmmAllocator_freeManyFunc) PageFrameDatabase_freeMany
+};
+
+
+
+// Public functions
+
+size_t PageFrameDatabase_calculateSizeInBytes( size_t numFrames )
+{
+	return numFrames * sizeof( PageFrame );
+}
+
+
+PageFrameDatabase PageFrameDatabase_create(
+	void*	workingSpace,	// in, own
+	size_t	sizeInBytes,	// in
+	size_t	numFrames		// in
+)
+{
+	KDebug_assertArg( workingSpace != NULL );
+	KDebug_assertArg( KMem_isAligned32( (uintptr_t) workingSpace ) );
+	KDebug_assertArg( numFrames > 0 );
+	KDebug_assertArg( sizeInBytes >= PageFrameDatabase_calculateSizeInBytes( numFrames ) );
+	(void) sizeInBytes;	// Only used in checked builds.
+
+	PageFrameDatabase pfdb;
+	pfdb.m_frames			= (PageFrame*) workingSpace;
+	pfdb.m_numFrames		= numFrames;
+	pfdb.m_numColours		= MM_getNumCacheColours();
+	pfdb.m_nextColour		= 0;
+	pfdb.m_numFreeFrames	= 0;
+	pfdb.m_numZeroedFrames	= 0;
+	pfdb.m_lock				= QueueLock_create();
+
+	for (size_t colour = 0; colour < MAX_CACHE_COLOURS; colour++)
+	{
+		pfdb.m_freeListHeads[colour]	= FREE_LIST_END;
+		pfdb.m_zeroedListHeads[colour]	= FREE_LIST_END;
+	}
+
+	// Every frame starts out reserved. The initializer will tell us which frames are RAM.
+	for (size_t i = 0; i < numFrames; i++)
+	{
+		pfdb.m_frames[i].m_nextFree	= FREE_LIST_END;
+		pfdb.m_frames[i].m_state	= PFSTATE_RESERVED;
+	}
+	return pfdb;
+}
+
+
+size_t PageFrameDatabase_getNumFrames( const volatile PageFrameDatabase* pfdb )
+{
+	KDebug_assertArg( pfdb != NULL );
+	return pfdb->m_numFrames;
+}
+
+
+size_t PageFrameDatabase_getNumFreeFrames( const volatile PageFrameDatabase* pfdb )
+{
+	KDebug_assertArg( pfdb != NULL );
+	return pfdb->m_numFreeFrames;
+}
+
+
+size_t PageFrameDatabase_getNumZeroedFrames( const volatile PageFrameDatabase* pfdb )
+{
+	KDebug_assertArg( pfdb != NULL );
+	return pfdb->m_numZeroedFrames;
+}
+
+
+PageFrameState PageFrameDatabase_getFrameState(
+	const volatile PageFrameDatabase*	pfdb,
+	phys_addr_t							frameAddr
+)
+{
+	KDebug_assertArg( MM_isFrameAligned( frameAddr ) );
+	return (PageFrameState) PageFrameDatabase_getFrame( pfdb, frameAddr )->m_state;
+}
+
+
+void PageFrameDatabase_setFrameState(
+	PageFrameDatabase*	pfdb,
+	phys_addr_t			frameAddr,
+	PageFrameState		state
+)
+{
+	KDebug_assertArg( pfdb != NULL );
+	KDebug_assertArg( MM_isFrameAligned( frameAddr ) );
+
+	size_t frameNumber = MM_getFrameNumber( frameAddr );
+	if (frameNumber < pfdb->m_numFrames)
+	{
+		pfdb->m_frames[frameNumber].m_state = (uint8_t) state;
+	}
+}
+
+
+void PageFrameDatabase_setRegionState(
+	PageFrameDatabase*	pfdb,
+	PmmRegion			region,
+	PageFrameState		state
+)
+{
+	KDebug_assertArg( pfdb != NULL );
+
+	phys_addr_t base = PmmRegion_base( &region );
+	phys_addr_t last = PmmRegion_last( &region );
+
+	size_t firstFrame	= MM_getFrameNumber( base );
+	size_t lastFrame	= MM_getFrameNumber( last );
+
+	if (state == PFSTATE_FREE)
+	{
+		// Only whole frames of RAM are usable. Trim any partial frames from either end.
+		if (!MM_isFrameAligned( base ))
+		{
+			firstFrame++;
+		}
+
+		if (!MM_isFrameAligned( last + 1 ))
+		{
+			if (lastFrame == 0)
+			{
+				return;		// The region is smaller than a frame.
+			}
+			lastFrame--;
+		}
+	}
+
+	if (lastFrame >= pfdb->m_numFrames)
+	{
+		lastFrame = pfdb->m_numFrames - 1;
+	}
+
+	// Frame numbers are much smaller than the physical address space, so i can't overflow here.
+	for (size_t i = firstFrame; i <= lastFrame; i++)
+	{
+		pfdb->m_frames[i].m_state = (uint8_t) state;
+	}
+}
+
+
+void PageFrameDatabase_buildFreeList( PageFrameDatabase* pfdb )
+{
+	KDebug_assertArg( pfdb != NULL );
+
+	// Frame zero is PHYS_NULL, and it also serves as the end-of-list marker.
+	pfdb->m_frames[0].m_state = PFSTATE_RESERVED;
+
+	for (size_t colour = 0; colour < MAX_CACHE_COLOURS; colour++)
+	{
+		pfdb->m_freeListHeads[colour]	= FREE_LIST_END;
+		pfdb->m_zeroedListHeads[colour]	= FREE_LIST_END;
+	}
+	pfdb->m_numFreeFrames	= 0;
+	pfdb->m_numZeroedFrames	= 0;
+	pfdb->m_nextColour		= 0;
+
+	// Walk backwards so that the lowest free frame of each colour ends up at the head of its list.
+	// Nothing is known about the contents of any frame yet, so none of them count as zeroed.
+	for (size_t i = pfdb->m_numFrames - 1; i > 0; i--)
+	{
+		if (pfdb->m_frames[i].m_state == PFSTATE_FREE)
+		{
+			PageFrameDatabase_pushFreeFrame( pfdb, i, false );
+		}
+	}
+}
+
+
+phys_addr_t PageFrameDatabase_allocate( volatile PageFrameDatabase* this, void* colourHint )
+{
+	KDebug_assertArg( this != NULL );
+
+	bool isZeroed;
+
+	QueueLockNode node;
+	QueueLock_acquire( &(this->m_lock), &node );
+	size_t frameNumber =
+		PageFrameDatabase_popFreeFrame( (PageFrameDatabase*) this, colourHint, false, &isZeroed );
+	QueueLock_release( &(this->m_lock), &node );
+
+	// Frame zero doubles as the end-of-list marker, so this returns PHYS_NULL if the lists were
+	// empty.
+	return MM_getFrameAddress( frameNumber );
+}
+
+
+phys_addr_t PageFrameDatabase_allocateZeroed(
+	volatile PageFrameDatabase*	this,
+	void*						colourHint,
+	bool*						isZeroed
+)
+{
+	KDebug_assertArg( this != NULL );
+	KDebug_assertArg( isZeroed != NULL );
+
+	QueueLockNode node;
+	QueueLock_acquire( &(this->m_lock), &node );
+	size_t frameNumber =
+		PageFrameDatabase_popFreeFrame( (PageFrameDatabase*) this, colourHint, true, isZeroed );
+	QueueLock_release( &(this->m_lock), &node );
+
+	return MM_getFrameAddress( frameNumber );
+}
+
+
+phys_addr_t PageFrameDatabase_allocateDirty( volatile PageFrameDatabase* this )
+{
+	KDebug_assertArg( this != NULL );
+
+	size_t frameNumber = FREE_LIST_END;
+
+	QueueLockNode node;
+	QueueLock_acquire( &(this->m_lock), &node );
+	PageFrameDatabase* lockedThis = (PageFrameDatabase*) this;
+
+	// Don't let the scrubber have a frame that is already zeroed.
+	if (lockedThis->m_numFreeFrames > lockedThis->m_numZeroedFrames)
+	{
+		bool isZeroed;
+		frameNumber = PageFrameDatabase_popFreeFrame( lockedThis, NULL, false, &isZeroed );
+		KDebug_assert( !isZeroed );
+	}
+
+	QueueLock_release( &(this->m_lock), &node );
+	return MM_getFrameAddress( frameNumber );
+}
+
+
+void PageFrameDatabase_freeZeroed( volatile PageFrameDatabase* this, phys_addr_t frameAddr )
+{
+	KDebug_assertArg( this != NULL );
+
+	QueueLockNode node;
+	QueueLock_acquire( &(this->m_lock), &node );
+	PageFrameDatabase_freeFrame( (PageFrameDatabase*) this, frameAddr, true );
+	QueueLock_release( &(this->m_lock), &node );
+}
+
+
+void PageFrameDatabase_free( volatile PageFrameDatabase* this, phys_addr_t frameAddr )
+{
+	KDebug_assertArg( this != NULL );
+
+	QueueLockNode node;
+	QueueLock_acquire( &(this->m_lock), &node );
+	PageFrameDatabase_freeFrame( (PageFrameDatabase*) this, frameAddr, false );
+	QueueLock_release( &(this->m_lock), &node );
+}
+
+
+size_t PageFrameDatabase_allocateMany(
+	volatile PageFrameDatabase*	this,
+	phys_addr_t*				frameAddrs,
+	size_t						numFrames,
+	void*						colourHint
+)
+{
+	KDebug_assertArg( this != NULL );
+	KDebug_assertArg( (frameAddrs != NULL) || (numFrames == 0) );
+
+	size_t numAllocated = 0;
+	uint8_t* pageAddr = (uint8_t*) colourHint;
+
+	QueueLockNode node;
+	QueueLock_acquire( &(this->m_lock), &node );
+	PageFrameDatabase* lockedThis = (PageFrameDatabase*) this;
+
+	while (numAllocated < numFrames)
+	{
+		bool isZeroed;
+		size_t frameNumber = PageFrameDatabase_popFreeFrame( lockedThis, pageAddr, false, &isZeroed );
+		if (frameNumber == FREE_LIST_END)
+		{
+			break;
+		}
+		frameAddrs[numAllocated++] = MM_getFrameAddress( frameNumber );
+
+		// Each frame gets the colour of the next virtual page.
+		if (pageAddr != NULL)
+		{
+			pageAddr += PAGE_SIZE;
+		}
+	}
+
+	QueueLock_release( &(this->m_lock), &node );
+	return numAllocated;
+}
+
+
+void PageFrameDatabase_freeMany(
+	volatile PageFrameDatabase*	this,
+	const phys_addr_t*			frameAddrs,
+	size_t						numFrames
+)
+{
+	KDebug_assertArg( this != NULL );
+	KDebug_assertArg( (frameAddrs != NULL) || (numFrames == 0) );
+
+	QueueLockNode node;
+	QueueLock_acquire( &(this->m_lock), &node );
+	PageFrameDatabase* lockedThis = (PageFrameDatabase*) this;
+
+	for (size_t i = 0; i < numFrames; i++)
+	{
+		PageFrameDatabase_freeFrame( lockedThis, frameAddrs[i], false );
+	}
+
+	QueueLock_release( &(this->m_lock), &node );
+}
+
+
+phys_addr_t PageFrameDatabase_allocateRange(
+	volatile PageFrameDatabase*	this,
+	size_t						numFrames,
+	phys_size_t					alignment,
+	phys_addr_t					maxAddr
+)
+{
+	KDebug_assertArg( this != NULL );
+	KDebug_assertArg( numFrames > 0 );
+	KDebug_assertArg( (alignment & (alignment - 1)) == 0 );
+
+	if (alignment < PAGE_SIZE)
+	{
+		alignment = PAGE_SIZE;
+	}
+	size_t alignFrames = alignment / PAGE_SIZE;
+
+	// A frame that straddles maxAddr doesn't count. Note that maxAddr + 1 wraps around to zero
+	// (which is aligned) at the very top of the physical address space.
+	size_t endFrameNumber = MM_getFrameNumber( maxAddr );
+	if (MM_isFrameAligned( maxAddr + 1 ))
+	{
+		endFrameNumber++;
+	}
+
+	size_t firstFrameNumber = FREE_LIST_END;
+
+	QueueLockNode node;
+	QueueLock_acquire( &(this->m_lock), &node );
+	PageFrameDatabase* lockedThis = (PageFrameDatabase*) this;
+
+	if (endFrameNumber > lockedThis->m_numFrames)
+	{
+		endFrameNumber = lockedThis->m_numFrames;
+	}
+
+	// First fit, from the bottom up. Frame zero is never free, so start at the next aligned frame.
+	// Each candidate is checked from the top down, so that when it doesn't fit, the search can
+	// skip to the first aligned frame past the highest one in use.
+	size_t candidate = alignFrames;
+	while ((candidate < endFrameNumber) && (numFrames <= endFrameNumber - candidate))
+	{
+		size_t end = candidate + numFrames;
+		while ((end > candidate) && (lockedThis->m_frames[end - 1].m_state == PFSTATE_FREE))
+		{
+			end--;
+		}
+
+		if (end == candidate)
+		{
+			firstFrameNumber = candidate;
+			PageFrameDatabase_takeRun( lockedThis, firstFrameNumber, numFrames );
+			break;
+		}
+		candidate = (end + alignFrames - 1) & ~(alignFrames - 1);
+	}
+
+	QueueLock_release( &(this->m_lock), &node );
+
+	// Frame zero doubles as "not found", so this returns PHYS_NULL if nothing fit.
+	return MM_getFrameAddress( firstFrameNumber );
+}
+
+
+void PageFrameDatabase_freeRange(
+	volatile PageFrameDatabase*	this,
+	phys_addr_t					firstFrameAddr,
+	size_t						numFrames
+)
+{
+	KDebug_assertArg( this != NULL );
+	KDebug_assertArg( MM_isFrameAligned( firstFrameAddr ) );
+
+	size_t firstFrameNumber = MM_getFrameNumber( firstFrameAddr );
+
+	QueueLockNode node;
+	QueueLock_acquire( &(this->m_lock), &node );
+	PageFrameDatabase* lockedThis = (PageFrameDatabase*) this;
+
+	for (size_t i = 0; i < numFrames; i++)
+	{
+		PageFrameDatabase_freeFrame( lockedThis, MM_getFrameAddress( firstFrameNumber + i ), false );
+	}
+
+	QueueLock_release( &(this->m_lock), &node );
+}
+
+
+IPmmAllocator PageFrameDatabase_getAsPmmAllocator( volatile PageFrameDatabase* pfdb )
+{
+	IPmmAllocator iAllocator;
+	iAllocator.obj	= pfdb;			// Point to the given object.
+	iAllocator.iptr	= &s_itable;	// Point at the right interface dispatch table.
+	return iAllocator;
+}
@@ -23,8 +23,10 @@
 
 #include <stdbool.h>
 #include "Kernel/MM/PhysicalMemoryManager.h"
-#include "Kernel/MM/ConcatPmmRegionList.h"
+#include "Kernel/MM/PageFrameDatabase.h"
+#include "Kernel/MM/PmmRegionTable.h"
 #include "Kernel/MM/MM.h"
+#include "PmmFrameCache.h"
 #include "PmmWatermarkAllocator.h"
 #include "Kernel/KCommon/KMem.h"
 #include "Kernel/KCommon/KDebug.h"
@@ -35,23 +37,100 @@
 struct PhysicalMemoryManagerStruct
 {
 	IPmmAllocator			m_currentAllocator;		///< The current allocator for kernel requests.
-	char					m_pfdb;					///< The PageFrameDatabase. ***FIXME
+	PageFrameDatabase		m_pfdb;					///< The PageFrameDatabase.
+	PmmFrameCache			m_frameCache;			///< Per-processor magazines in front of the PFDB.
+	size_t					m_numFrames;			///< # of frames to be tracked by the PFDB.
 	PmmWatermarkAllocator	m_initialAllocator;		///< The allocator for "initialization" mode.
-	size_t					m_initialAllocatorSpace[NUM_BLOCKS];	///< For initial allocator.
-	IPmmRegionList			m_ramList;				///< The list of all RAM regions.
-	IPmmRegionList			m_reservedList;			///< The list of all reserved regions.
-	IPmmRegionList			m_moduleList;			///< The list of all kernel & module regions.
-	ConcatPmmRegionList		m_usedList;				///< The union of the reserved & module lists.
+	size_t					m_initialAllocatorSpace[REGION_SPACE_IN_BLOCKS];	///< For initial allocator.
+	PmmRegionTable			m_regionTable;			///< Sorted, non-overlapping physical memory map.
+	PmmRegionTableList		m_ramList;				///< Enumerates the RAM regions in the table.
+	PmmRegionTableList		m_usedList;				///< Enumerates the reserved & module regions.
 	bool					m_isFullyInitialized;	///< \c true after initStageTwo() is called.
 };
 
 
 
+/// \brief	Defines private constants for the implementation of PhysicalMemoryManager.
+enum PhysicalMemoryManager_consts
+{
+	/// \brief	Number of frames moved from the initial allocator to the PFDB at a time.
+	HANDOFF_BATCH_SIZE = 64
+};
+
+
+
 /// \brief	The one-and-only instance of PhysicalMemoryManager.
 static volatile PhysicalMemoryManager s_instance;
 
 
 
+// Private functions
+
+/// \brief	Sets the state of every frame in every region of the given type.
+///
+/// \param pfdb		the PageFrameDatabase to update.
+/// \param table	the region table.
+/// \param type		the type of region to look for.
+/// \param state	the state to give the frames in those regions.
+static void PhysicalMemoryManager_setRegionStates(
+	PageFrameDatabase*		pfdb,
+	const PmmRegionTable*	table,
+	PmmRegionType			type,
+	PageFrameState			state
+)
+{
+	size_t numEntries = PmmRegionTable_getNumEntries( table );
+	for (size_t i = 0; i < numEntries; i++)
+	{
+		PmmRegion crnt;
+		if (PmmRegionTable_getEntry( table, i, &crnt ) == type)
+		{
+			PageFrameDatabase_setRegionState( pfdb, crnt, state );
+		}
+	}
+}
+
+
+/// \brief	Hands every frame that the initial allocator still has over to the PageFrameDatabase.
+///
+/// \param pmm	the PhysicalMemoryManager.
+///
+/// Every frame of RAM in the PFDB must already be in the PFSTATE_KERNEL state, and the free lists
+/// must be empty. Whatever the initial allocator can still hand out is therefore exactly the RAM
+/// that nobody has allocated yet. It is drained in batches, so that its lock and the PFDB's lock
+/// are each taken once per batch rather than once per frame.
+static void PhysicalMemoryManager_handOffFreeFrames( PhysicalMemoryManager* pmm )
+{
+	volatile PmmWatermarkAllocator* initialAllocator = &(pmm->m_initialAllocator);
+	volatile PageFrameDatabase* pfdb = &(pmm->m_pfdb);
+
+	phys_addr_t batch[HANDOFF_BATCH_SIZE];
+	size_t numInBatch;
+	do
+	{
+		numInBatch =
+			PmmWatermarkAllocator_allocateMany( initialAllocator, batch, HANDOFF_BATCH_SIZE, NULL );
+
+		// A frame that straddles RAM and a reserved or module region isn't RAM as far as the PFDB
+		// is concerned, even if the initial allocator would have handed it out. Leave it where it
+		// is.
+		size_t numToFree = 0;
+		for (size_t i = 0; i < numInBatch; i++)
+		{
+			if (PageFrameDatabase_getFrameState( pfdb, batch[i] ) == PFSTATE_KERNEL)
+			{
+				batch[numToFree++] = batch[i];
+			}
+		}
+
+		PageFrameDatabase_freeMany( pfdb, batch, numToFree );
+	} while (numInBatch == HANDOFF_BATCH_SIZE);
+}
+
+
+
+// Public functions
+
 size_t PhysicalMemoryManager_initStageOne(
 	IPmmRegionList ramList,
 	IPmmRegionList reservedList,
@@ -64,40 +143,43 @@ size_t PhysicalMemoryManager_initStageOne(
 	
 	KMem_set( pmm, 0, sizeof( PhysicalMemoryManager ) );
 
-	// First, calculate how much space the PFDB will need for initStageTwo(). First we need to
-	// calculate how many frames the PMM will be managing. This can be discovered by looking for
-	// the highest region in the RAM list.
+	// Boil the bootloader's memory maps down into a table that is sorted and has no overlaps, so
+	// that nobody has to go back to the bootloader's data structures (or resolve the overlaps)
+	// again.
+	bool isTableComplete =
+		PmmRegionTable_init( &(pmm->m_regionTable), ramList, reservedList, moduleList );
+	KDebug_assert( isTableComplete );
+	(void) isTableComplete;
+
+	pmm->m_ramList	= PmmRegionTableList_create( &(pmm->m_regionTable), PMMREGION_RAM );
+	pmm->m_usedList	= PmmRegionTableList_create( &(pmm->m_regionTable), PMMREGION_USED );
+
+	// Next, calculate how much space the PFDB will need for initStageTwo(). First we need to
+	// calculate how many frames the PMM will be managing. Since the table is sorted, this is just
+	// the end of the highest RAM region.
 	phys_addr_t highestAddr = 0;
-	
-	ramList.iptr->reset( ramList.obj );
-	while (ramList.iptr->moveNext( ramList.obj ))
+
+	for (size_t i = PmmRegionTable_getNumEntries( &(pmm->m_regionTable) ); i > 0; i--)
 	{
-		PmmRegion crnt = ramList.iptr->getCurrent( ramList.obj );
-		phys_addr_t last = PmmRegion_last( &crnt );
-		if (last > highestAddr)
+		PmmRegion crnt;
+		if (PmmRegionTable_getEntry( &(pmm->m_regionTable), i - 1, &crnt ) == PMMREGION_RAM)
 		{
-			highestAddr = last;
+			highestAddr = PmmRegion_last( &crnt );
+			break;
 		}
 	}
 
 	size_t numFrames = MM_getFrameNumber( highestAddr ) + 1;
 
 	pmm->m_isFullyInitialized	= false;
-	pmm->m_ramList				= ramList;
-	pmm->m_reservedList			= reservedList;
-	pmm->m_moduleList			= moduleList;
-
-	// Chain the module and reserved lists together. They are passed in separately so that the PFDB
-	// can tell the difference between the kernel & module regions and the reserved regions
-	// reported by the bootloader.	
-	pmm->m_usedList = ConcatPmmRegionList_create( pmm->m_reservedList, pmm->m_moduleList );
+	pmm->m_numFrames			= numFrames;
 
-	// Create the initial watermark allocator. Don't forget to use the complete "reserved" list
-	// that includes the kernel and its modules!
+	// Create the initial watermark allocator. Since the kernel & module regions trump RAM in the
+	// table, none of them will be handed out.
 	pmm->m_initialAllocator =
 		PmmWatermarkAllocator_create(
-			pmm->m_ramList,
-			ConcatPmmRegionList_getAsPmmRegionList( &(pmm->m_usedList) ),
+			PmmRegionTableList_getAsPmmRegionList( &(pmm->m_ramList) ),
+			PmmRegionTableList_getAsPmmRegionList( &(pmm->m_usedList) ),
 			pmm->m_initialAllocatorSpace
 		);
 
@@ -106,7 +188,7 @@ size_t PhysicalMemoryManager_initStageOne(
 	pmm->m_currentAllocator =
 		PmmWatermarkAllocator_getAsPmmAllocator( &(pmm->m_initialAllocator) );
 		
-	return numFrames;	//***FIXME: Pass this to PFDB_calculateYaddaYadda()...
+	return PageFrameDatabase_calculateSizeInBytes( numFrames );
 }
 
 
@@ -115,9 +197,48 @@ void PhysicalMemoryManager_initStageTwo(
 	size_t	sizeInBytes		// in
 )
 {
-	//***FIXME: Implement.
-	(void) workingSpace;
-	(void) sizeInBytes;
+	// It's ok to cast away volatile because this method is supposed to be called only once on
+	// one CPU with interrupts disabled.
+	PhysicalMemoryManager* pmm = (PhysicalMemoryManager*) &s_instance;
+
+	KDebug_assert( !pmm->m_isFullyInitialized );
+	KDebug_assertArg( workingSpace != NULL );
+	KDebug_assertArg( sizeInBytes >= PageFrameDatabase_calculateSizeInBytes( pmm->m_numFrames ) );
+
+	pmm->m_pfdb = PageFrameDatabase_create( workingSpace, sizeInBytes, pmm->m_numFrames );
+	PageFrameDatabase* pfdb = &(pmm->m_pfdb);
+
+	// Every frame starts out reserved. First, mark all the RAM as free. This trims any partial
+	// frames from the ends of each RAM region.
+	const PmmRegionTable* table = &(pmm->m_regionTable);
+	PhysicalMemoryManager_setRegionStates( pfdb, table, PMMREGION_RAM, PFSTATE_FREE );
+
+	// The table entries never overlap, but a frame can still straddle two entries of different
+	// types. Reserved regions trump RAM, and the kernel & module regions trump everything, so do
+	// them last.
+	PhysicalMemoryManager_setRegionStates( pfdb, table, PMMREGION_RESERVED, PFSTATE_RESERVED );
+	PhysicalMemoryManager_setRegionStates( pfdb, table, PMMREGION_MODULE, PFSTATE_MODULE );
+
+	// Some of the RAM has already been handed out by the initial allocator (including the PFDB's
+	// own working space), and only the initial allocator knows which. Start by assuming that all
+	// of it belongs to the kernel, then free whatever the initial allocator has left.
+	for (size_t i = 1; i < pmm->m_numFrames; i++)
+	{
+		phys_addr_t frameAddr = MM_getFrameAddress( i );
+		if (PageFrameDatabase_getFrameState( pfdb, frameAddr ) == PFSTATE_FREE)
+		{
+			PageFrameDatabase_setFrameState( pfdb, frameAddr, PFSTATE_KERNEL );
+		}
+	}
+
+	PageFrameDatabase_buildFreeList( pfdb );
+	PhysicalMemoryManager_handOffFreeFrames( pmm );
+
+	// From now on, the PFDB handles all requests, with a magazine per processor in front of it so
+	// that the common case doesn't take the PFDB's lock. The initial allocator is never used again.
+	PmmFrameCache_init( &(pmm->m_frameCache), PageFrameDatabase_getAsPmmAllocator( pfdb ) );
+	pmm->m_currentAllocator		= PmmFrameCache_getAsPmmAllocator( &(pmm->m_frameCache) );
+	pmm->m_isFullyInitialized	= true;
 }
 
 
@@ -127,19 +248,146 @@ volatile PhysicalMemoryManager* PhysicalMemoryManager_getInstance()
 }
 
 
-//***FIXME: Return type.
-volatile char* PhysicalMemoryManager_getPageFrameDatabase(
+volatile PageFrameDatabase* PhysicalMemoryManager_getPageFrameDatabase(
 	volatile PhysicalMemoryManager* pmm
 )
 {
 	KDebug_assertArg( pmm != NULL );
+	KDebug_assert( pmm->m_isFullyInitialized );
 	return &(pmm->m_pfdb);
 }
 
 
+const PmmRegionTable* PhysicalMemoryManager_getRegionTable(
+	const volatile PhysicalMemoryManager* pmm
+)
+{
+	KDebug_assertArg( pmm != NULL );
+
+	// The table never changes after initStageOne(), so there's no harm in casting away volatile.
+	return (const PmmRegionTable*) &(pmm->m_regionTable);
+}
+
+
 IPmmAllocator PhysicalMemoryManager_getAllocator( const volatile PhysicalMemoryManager* pmm )
 {
 	KDebug_assertArg( pmm != NULL );
 	return pmm->m_currentAllocator;
 }
 
+
+phys_addr_t PhysicalMemoryManager_allocateRange(
+	volatile PhysicalMemoryManager*	pmm,
+	size_t							numFrames,
+	phys_size_t						alignment,
+	phys_addr_t						maxAddr
+)
+{
+	KDebug_assertArg( pmm != NULL );
+
+	if (!pmm->m_isFullyInitialized)
+	{
+		return PHYS_NULL;
+	}
+
+	volatile PageFrameDatabase* pfdb = &(pmm->m_pfdb);
+	phys_addr_t firstFrameAddr = PageFrameDatabase_allocateRange( pfdb, numFrames, alignment, maxAddr );
+
+	if (firstFrameAddr == PHYS_NULL)
+	{
+		// Frames sitting in the processors' caches look allocated to the PFDB, and could be what
+		// stands between two free runs. Give them back and try once more.
+		PmmFrameCache_drainAll( &(pmm->m_frameCache) );
+		firstFrameAddr = PageFrameDatabase_allocateRange( pfdb, numFrames, alignment, maxAddr );
+	}
+	return firstFrameAddr;
+}
+
+
+void PhysicalMemoryManager_freeRange(
+	volatile PhysicalMemoryManager*	pmm,
+	phys_addr_t						firstFrameAddr,
+	size_t							numFrames
+)
+{
+	KDebug_assertArg( pmm != NULL );
+	KDebug_assert( pmm->m_isFullyInitialized );
+
+	// Go straight to the PFDB, so that the run doesn't get broken up among the processors' caches.
+	PageFrameDatabase_freeRange( &(pmm->m_pfdb), firstFrameAddr, numFrames );
+}
+
+
+phys_addr_t PhysicalMemoryManager_allocateZeroed(
+	volatile PhysicalMemoryManager*	pmm,
+	void*							colourHint
+)
+{
+	KDebug_assertArg( pmm != NULL );
+
+	phys_addr_t frameAddr = PHYS_NULL;
+	bool isZeroed = false;
+
+	if (pmm->m_isFullyInitialized)
+	{
+		frameAddr = PageFrameDatabase_allocateZeroed( &(pmm->m_pfdb), colourHint, &isZeroed );
+	}
+
+	if (frameAddr == PHYS_NULL)
+	{
+		// The initial allocator doesn't know anything about the contents of its frames. Neither do
+		// the magazines, but they may still have frames left once the PFDB has run dry.
+		IPmmAllocator allocator = pmm->m_currentAllocator;
+		frameAddr = allocator.iptr->allocate( allocator.obj, colourHint );
+	}
+
+	if ((frameAddr != PHYS_NULL) && !isZeroed)
+	{
+		MM_zeroFrame( frameAddr );
+	}
+	return frameAddr;
+}
+
+
+void PhysicalMemoryManager_drainFrameCaches( volatile PhysicalMemoryManager* pmm )
+{
+	KDebug_assertArg( pmm != NULL );
+
+	if (pmm->m_isFullyInitialized)
+	{
+		PmmFrameCache_drainAll( &(pmm->m_frameCache) );
+	}
+}
+
+
+size_t PhysicalMemoryManager_scrubFreeFrames(
+	volatile PhysicalMemoryManager*	pmm,
+	size_t							maxFrames
+)
+{
+	KDebug_assertArg( pmm != NULL );
+
+	if (!pmm->m_isFullyInitialized)
+	{
+		return 0;
+	}
+
+	volatile PageFrameDatabase* pfdb = &(pmm->m_pfdb);
+
+	size_t numScrubbed = 0;
+	while (numScrubbed < maxFrames)
+	{
+		// Take the frame out of circulation while it's being cleared, so that the PFDB doesn't have
+		// to be locked for the duration.
+		phys_addr_t frameAddr = PageFrameDatabase_allocateDirty( pfdb );
+		if (frameAddr == PHYS_NULL)
+		{
+			break;
+		}
+
+		MM_zeroFrame( frameAddr );
+		PageFrameDatabase_freeZeroed( pfdb, frameAddr );
+		numScrubbed++;
+	}
+	return numScrubbed;
+}
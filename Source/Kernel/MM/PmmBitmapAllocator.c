@@ -29,6 +29,23 @@
 #include "PmmBitmapAllocator.h"
 
 
+// Private constants
+
+/// \brief	Defines private constants for the implementation of PmmBitmapAllocator.
+enum PmmBitmapAllocator_privateConsts
+{
+	/// \brief	Passed to PmmBitmapAllocator_scan() to accept a frame of any colour.
+	///
+	/// This can never be a real colour since real colours are less than MAX_CACHE_COLOURS.
+	ANY_COLOUR = MAX_CACHE_COLOURS
+};
+
+
+/// \brief	Returned by PmmBitmapAllocator_findNonEmpty() when there are no more candidate blocks.
+static const size_t NO_BLOCK = SIZE_MAX;
+
+
+
 // Private functions
 
 /// \brief	Calculates the block number (i.e. -- bitmap array index) containing the bit that tracks
@@ -62,12 +79,21 @@ static size_t PmmBitmapAllocator_getBlockNumberForFrameNumber(
 
 /// \brief	Calculates the index of the bit within a block that tracks the indicated frame.
 ///
+/// \param this			the PmmBitmapAllocator.
 /// \param frameNumber	the frame number of the frame.
 ///
+/// Like the block number, the bit is relative to the first frame tracked by this allocator, so
+/// the region doesn't have to start on a block boundary.
+///
 /// \return an index into a block of the bitmap array; Guaranteed to be valid.
-static uint8_t PmmBitmapAllocator_getBitInBlockForFrameNumber( size_t frameNumber )
+static uint8_t PmmBitmapAllocator_getBitInBlockForFrameNumber(
+	volatile PmmBitmapAllocator*	this,
+	size_t							frameNumber
+)
 {
-	return frameNumber % BITS_PER_BLOCK;
+	// Note that an atomic read is not necessary for m_baseFrameNumber since its value never
+	// changes during the lifetime of this object.
+	return (uint8_t) ((frameNumber - this->m_baseFrameNumber) % BITS_PER_BLOCK);
 }
 
 
@@ -104,105 +130,395 @@ static phys_addr_t PmmBitmapAllocator_getPhysAddrForBlockNumberAndBitInBlock(
 
 
 
-/// \brief	Interface dispatch table for PmmBitmapAllocator's implementation of IPmmAllocator.
-static IPmmAllocator_itable s_itable =
+/// \brief	Marks the given block as non-empty in the summary level above it.
+///
+/// \param this			the PmmBitmapAllocator.
+/// \param level		the level containing the block; Zero is the bitmap itself.
+/// \param blockNumber	the index of the block within \a level.
+///
+/// The caller must have just changed the block from empty (zero) to non-empty. If that in turn
+/// makes the summary block non-empty, the next level up is updated as well, and so on.
+///
+/// This method is thread-safe. The underlying implementation is lock-free.
+static void PmmBitmapAllocator_markNonEmpty(
+	volatile PmmBitmapAllocator*	this,
+	size_t							level,
+	size_t							blockNumber
+)
 {
-	(IPmmAllocator_allocateFunc) PmmBitmapAllocator_allocate,
-	(IPmmAllocator_freeFunc) PmmBitmapAllocator_free
-};
+	// Note that an atomic read is not necessary for m_summary or m_numSummaryLevels since their
+	// values never change during the lifetime of this object.
+	while (level < this->m_numSummaryLevels)
+	{
+		size_t* summary = this->m_summary[level];
+		size_t i = blockNumber / BITS_PER_BLOCK;
+		uint8_t bit = (uint8_t) (blockNumber % BITS_PER_BLOCK);
 
+		// This read has to be sequentially consistent. Freeing a frame sets its bit and then looks
+		// here, while PmmBitmapAllocator_markEmpty() clears the summary bit and then looks at the
+		// children. Between them, at least one of the two sides is guaranteed to see the other's
+		// write. On x86 this is still a plain MOV, since the writes were both locked.
+		size_t block = 0;
+		do
+		{
+			block = Atomic_readExplicit( &(summary[i]), ATOMIC_SEQ_CST );
 
+			// If the bit is already set, the levels above are already taken care of.
+			if (KMem_isBitSet( block, bit ))
+			{
+				return;
+			}
+		} while (!Atomic_compareAndSwap( &(summary[i]), block, KMem_bitSet( block, bit ) ));
 
-// Public functions
+		// Only whoever makes a summary block non-empty has to tell the level above about it.
+		if (block != 0)
+		{
+			return;
+		}
+		level++;
+		blockNumber = i;
+	}
+}
 
-PmmBitmapAllocator PmmBitmapAllocator_create(
-	size_t*		bitmapSpace,
-	size_t		numBlocks,
-	phys_addr_t	baseAddress
+
+/// \brief	Marks the given block as empty in the summary level above it.
+///
+/// \param this			the PmmBitmapAllocator.
+/// \param level		the level containing the block; Zero is the bitmap itself.
+/// \param blockNumber	the index of the block within \a level.
+///
+/// The caller must have seen the block become empty (zero). If clearing its summary bit makes the
+/// summary block empty, the next level up is updated as well, and so on.
+///
+/// This method is thread-safe. The underlying implementation is lock-free.
+static void PmmBitmapAllocator_markEmpty(
+	volatile PmmBitmapAllocator*	this,
+	size_t							level,
+	size_t							blockNumber
 )
 {
-	KDebug_assertArg( bitmapSpace != NULL );
-	KDebug_assertArg( numBlocks > 0 );
-	KDebug_assertArg( MM_isFrameAligned( baseAddress ) );
-	
-	// Zero out the bitmap space so that every frame is initially allocated.
-	KMem_set( bitmapSpace, 0, numBlocks * sizeof( size_t ) );
+	while (level < this->m_numSummaryLevels)
+	{
+		size_t* summary = this->m_summary[level];
+		size_t i = blockNumber / BITS_PER_BLOCK;
+		uint8_t bit = (uint8_t) (blockNumber % BITS_PER_BLOCK);
 
-	PmmBitmapAllocator allocator;
-	allocator.m_bitmap				= bitmapSpace;
-	allocator.m_lastAllocatedIndex	= 0;
-	allocator.m_numBlocks			= numBlocks;
-	allocator.m_baseFrameNumber		= MM_getFrameNumber( baseAddress );
-	return allocator;
+		size_t block = 0;
+		size_t newBlock = 0;
+		do
+		{
+			block = Atomic_readExplicit( &(summary[i]), ATOMIC_RELAXED );
+
+			// Someone else beat us to it.
+			if (!KMem_isBitSet( block, bit ))
+			{
+				return;
+			}
+			newBlock = KMem_bitClear( block, bit );
+		} while (!Atomic_compareAndSwap( &(summary[i]), block, newBlock ));
+
+		// Another CPU may have freed something in the block after we saw it empty, but before we
+		// cleared its bit. That CPU may have found the bit still set and left it alone, so it's
+		// up to us to put it back.
+		size_t* children = (level == 0) ? this->m_bitmap : this->m_summary[level - 1];
+		if (Atomic_readExplicit( &(children[blockNumber]), ATOMIC_SEQ_CST ) != 0)
+		{
+			PmmBitmapAllocator_markNonEmpty( this, level, blockNumber );
+			return;
+		}
+
+		if (newBlock != 0)
+		{
+			return;
+		}
+		level++;
+		blockNumber = i;
+	}
 }
 
 
-size_t PmmBitmapAllocator_blocksToFrames( size_t numBlocks )
+/// \brief	Finds the first block at or after the given one that may have a bit set.
+///
+/// \param this		the PmmBitmapAllocator.
+/// \param level	the level to search; Zero is the bitmap itself.
+/// \param start	the index within \a level at which to start looking.
+///
+/// The search is guided by the summary level above \a level, and by the levels above that when a
+/// summary block turns out to be empty. It therefore takes a handful of find-lowest-set-bit
+/// operations, regardless of the size of the bitmap.
+///
+/// This method is thread-safe. The underlying implementation is lock-free. The block it returns
+/// may be empty by the time the caller looks at it.
+///
+/// \retval size_t		the index within \a level of a block whose summary bit is set.
+/// \retval NO_BLOCK	there are no such blocks at or after \a start.
+static size_t PmmBitmapAllocator_findNonEmpty(
+	volatile PmmBitmapAllocator*	this,
+	size_t							level,
+	size_t							start
+)
 {
-	return numBlocks * BITS_PER_BLOCK;
+	size_t* summary = this->m_summary[level];
+	size_t numBlocks = (level == 0) ? this->m_numBlocks : this->m_summarySizes[level - 1];
+
+	while (start < numBlocks)
+	{
+		size_t i = start / BITS_PER_BLOCK;
+		uint8_t bit = (uint8_t) (start % BITS_PER_BLOCK);
+
+		// Ignore the bits for blocks before start.
+		size_t block = Atomic_read( &(summary[i]) ) & (~((size_t) 0) << bit);
+		if (block != 0)
+		{
+			return (i * BITS_PER_BLOCK) + (size_t) KMem_findLowestSetBit( block );
+		}
+
+		// There is nothing more in this summary block. The top level is always a single block, so
+		// if this is it, there is nothing left at all. Otherwise, ask the level above where the
+		// next non-empty summary block is. The check against MAX_SUMMARY_LEVELS is redundant, but
+		// it bounds the recursion for the compiler's benefit.
+		if (((level + 1) >= this->m_numSummaryLevels) || ((level + 1) >= MAX_SUMMARY_LEVELS))
+		{
+			return NO_BLOCK;
+		}
+
+		size_t next = PmmBitmapAllocator_findNonEmpty( this, level + 1, i + 1 );
+		if (next == NO_BLOCK)
+		{
+			return NO_BLOCK;
+		}
+		start = next * BITS_PER_BLOCK;
+	}
+	return NO_BLOCK;
 }
 
 
-size_t PmmBitmapAllocator_framesToBlocks( size_t numFrames )
+/// \brief	Finds the next bitmap block to search when rotating around the bitmap.
+///
+/// \param this			the PmmBitmapAllocator.
+/// \param firstBlock	the block at which the rotation started.
+/// \param prevBlock	the block searched last, or NO_BLOCK to start the rotation.
+///
+/// Only blocks that the summary says may have free frames are visited. Each such block is visited
+/// at most once per rotation.
+///
+/// This method is thread-safe. The underlying implementation is lock-free.
+///
+/// \retval size_t		the next bitmap block to search.
+/// \retval NO_BLOCK	the rotation is complete.
+static size_t PmmBitmapAllocator_findNextCandidate(
+	volatile PmmBitmapAllocator*	this,
+	size_t							firstBlock,
+	size_t							prevBlock
+)
 {
-	return numFrames / BITS_PER_BLOCK;
+	size_t start = (prevBlock == NO_BLOCK) ? firstBlock : prevBlock + 1;
+	size_t next = PmmBitmapAllocator_findNonEmpty( this, 0, start );
+
+	// If we haven't wrapped around yet, try again from the start of the bitmap.
+	if ((prevBlock == NO_BLOCK) || (prevBlock >= firstBlock))
+	{
+		if (next != NO_BLOCK)
+		{
+			return next;
+		}
+		next = PmmBitmapAllocator_findNonEmpty( this, 0, 0 );
+	}
+
+	// Stop once we're back where we started. Note that NO_BLOCK is never less than firstBlock.
+	return (next < firstBlock) ? next : NO_BLOCK;
 }
 
 
-phys_addr_t PmmBitmapAllocator_allocate( volatile PmmBitmapAllocator* this, void* colourHint )
+
+/// \brief	Sets or clears the bits for a run of consecutive frames, a whole block at a time.
+///
+/// \param this				the PmmBitmapAllocator.
+/// \param firstFrameAddr	the physical address of the first frame in the run.
+/// \param numFrames		the number of frames in the run.
+/// \param isFree			\c true to mark the frames free, \c false to mark them allocated.
+///
+/// Each block touched by the run is updated with a single CAS, using a mask that covers just the
+/// part of the run that falls within that block. Frames that are already in the desired state
+/// are left alone.
+///
+/// In checked builds, a bugcheck will occur if \a firstFrameAddr is not page-aligned, or if the
+/// run is not entirely within the region tracked by this allocator.
+///
+/// This method is thread-safe. The underlying implementation is lock-free.
+static void PmmBitmapAllocator_fillRange(
+	volatile PmmBitmapAllocator*	this,
+	phys_addr_t						firstFrameAddr,
+	size_t							numFrames,
+	bool							isFree
+)
 {
 	KDebug_assertArg( this != NULL );
-	
-	// For now, the implementation ignores the colour hint.
-	(void) colourHint;
+	KDebug_assertArg( MM_isFrameAligned( firstFrameAddr ) );
+
+	if (numFrames == 0)
+	{
+		return;
+	}
 
+	// These calls do bounds checking for us (in checked builds).
+	size_t frameNumber = MM_getFrameNumber( firstFrameAddr );
+	size_t i = PmmBitmapAllocator_getBlockNumberForFrameNumber( this, frameNumber );
+	uint8_t bit = PmmBitmapAllocator_getBitInBlockForFrameNumber( this, frameNumber );
+	(void) PmmBitmapAllocator_getBlockNumberForFrameNumber( this, frameNumber + (numFrames - 1) );
+
+	while (numFrames > 0)
+	{
+		// Build a mask for the part of the run that falls within this block. Only the first and
+		// last blocks can be partial.
+		size_t numBits = BITS_PER_BLOCK - bit;
+		if (numBits > numFrames)
+		{
+			numBits = numFrames;
+		}
+
+		size_t mask = (numBits == BITS_PER_BLOCK)
+			? ~((size_t) 0)
+			: ((((size_t) 1) << numBits) - 1) << bit;
+
+		size_t block = 0;
+		size_t newBlock = 0;
+		do
+		{
+			block = Atomic_readExplicit( &(this->m_bitmap[i]), ATOMIC_RELAXED );
+			newBlock = (isFree) ? (block | mask) : (block & ~mask);
+		} while ((newBlock != block) &&
+				 !Atomic_compareAndSwap( &(this->m_bitmap[i]), block, newBlock ));
+
+		// Keep the summary in step with the block.
+		if ((block == 0) && (newBlock != 0))
+		{
+			PmmBitmapAllocator_markNonEmpty( this, 0, i );
+		}
+		else if ((block != 0) && (newBlock == 0))
+		{
+			PmmBitmapAllocator_markEmpty( this, 0, i );
+		}
+
+		numFrames -= numBits;
+		bit = 0;
+		i++;
+	}
+}
+
+
+
+/// \brief	Calculates a mask of the bits in the given block that track frames of the given colour.
+///
+/// \param this			the PmmBitmapAllocator.
+/// \param blockNumber	an index into the bitmap array.
+/// \param colour		the desired colour, or ANY_COLOUR.
+///
+/// \return a mask with a bit set for each frame of colour \a colour tracked by the block.
+static size_t PmmBitmapAllocator_getColourMask(
+	volatile PmmBitmapAllocator*	this,
+	size_t							blockNumber,
+	size_t							colour
+)
+{
+	// Note that an atomic read is not necessary for m_baseFrameNumber or m_numColours since their
+	// values never change during the lifetime of this object.
+	size_t numColours = this->m_numColours;
+	if ((colour == ANY_COLOUR) || (numColours <= 1))
+	{
+		return ~((size_t) 0);
+	}
+
+	// Find the first bit in the block with the right colour. Colours are a power of two, so
+	// unsigned wrap-around gives the right answer here.
+	size_t firstFrameNumber = this->m_baseFrameNumber + (blockNumber * BITS_PER_BLOCK);
+	size_t offset = (colour - firstFrameNumber) & (numColours - 1);
+	if (offset >= BITS_PER_BLOCK)
+	{
+		return 0;	// There are more colours than bits, and none of them match in this block.
+	}
+
+	// The colour repeats every numColours bits.
+	size_t mask = 0;
+	for (size_t bit = offset; bit < BITS_PER_BLOCK; bit += numColours)
+	{
+		mask = KMem_bitSet( mask, (uint8_t) bit );
+	}
+	return mask;
+}
+
+
+/// \brief	Scans the bitmap for a free frame of the given colour and allocates it.
+///
+/// \param this		the PmmBitmapAllocator.
+/// \param colour	the desired colour, or ANY_COLOUR.
+///
+/// This method is thread-safe. The underlying implementation is lock-free.
+///
+/// \retval phys_addr_t	the physical address of the frame just allocated.
+/// \retval PHYS_NULL	there are no free frames of the given colour.
+static phys_addr_t PmmBitmapAllocator_scan( volatile PmmBitmapAllocator* this, size_t colour )
+{
 	// Use atomic read/write to read the last allocated index field. Remember, this is a lock-free
 	// implementation and there may be other CPUs attempting to read or write this field at the
-	// same time.
-	size_t lastAllocatedIndex = Atomic_read( &(this->m_lastAllocatedIndex) );
-	
-	// Note that an atomic read is not necessary for m_numBlocks since its value never
-	// changes during the lifetime of this object.
-	size_t beforeLast = (lastAllocatedIndex == 0) ? this->m_numBlocks - 1 : lastAllocatedIndex - 1;
+	// same time. It is only a hint, though, so it doesn't need to be ordered with anything else.
+	size_t lastAllocatedIndex =
+		Atomic_readExplicit( &(this->m_lastAllocatedIndex), ATOMIC_RELAXED );
 
-	// Rotate around the bitmap, starting with the last block that had a free frame in it.
-	for (size_t i = lastAllocatedIndex; i != beforeLast; i = (i + 1) % this->m_numBlocks)
+	// Rotate around the bitmap, starting with the last block that had a free frame in it. Only
+	// the blocks that the summary says have free frames in them are visited.
+	for (size_t i = PmmBitmapAllocator_findNextCandidate( this, lastAllocatedIndex, NO_BLOCK );
+		i != NO_BLOCK;
+		i = PmmBitmapAllocator_findNextCandidate( this, lastAllocatedIndex, i ))
 	{
+		size_t colourMask = PmmBitmapAllocator_getColourMask( this, i, colour );
+
 		// There will be other CPUs trying to read this block at the same time, so use an atomic
 		// read.
-		size_t block = Atomic_read( &(this->m_bitmap[i]) );
+		size_t block = Atomic_readExplicit( &(this->m_bitmap[i]), ATOMIC_RELAXED );
 
 		// Test 32 frames at once.
-		while (block != 0)
+		while ((block & colourMask) != 0)
 		{
 			// There is at least one free frame, so try to grab it before another CPU does.
-			int signedBit = KMem_findLowestSetBit( block );
-			
+			int signedBit = KMem_findLowestSetBit( block & colourMask );
+
 			// "block" is a local variable, so it can't change between the time it passed the
 			// "while" condition and the time it was scanned for a set bit. This assertion is
 			// therefore OK, and is *not* a race condition.
 			KDebug_assert( (0 <= signedBit) && (signedBit < BITS_PER_BLOCK) );
 
 			uint8_t bit = (uint8_t) signedBit;
-			
+
 			size_t newBlock = KMem_bitClear( block, bit );
 
 			if (Atomic_compareAndSwap( &(this->m_bitmap[i]), block, newBlock ))
 			{
+				// If that was the last free frame in the block, the summary has to know.
+				if (newBlock == 0)
+				{
+					PmmBitmapAllocator_markEmpty( this, 0, i );
+				}
+
 				// Remember to use an atomic write to update m_lastAllocatedIndex.
-				Atomic_write( &(this->m_lastAllocatedIndex), i );
+				Atomic_writeExplicit( &(this->m_lastAllocatedIndex), i, ATOMIC_RELAXED );
 				return PmmBitmapAllocator_getPhysAddrForBlockNumberAndBitInBlock( this, i, bit );
 			}
 			else
 			{
 				// Something changed in the block. Go around for another pass to
 				// see if we missed the last free frame.
-				block = Atomic_read( &(this->m_bitmap[i]) );
+				block = Atomic_readExplicit( &(this->m_bitmap[i]), ATOMIC_RELAXED );
 			}
 		}
 
 		// If we fell through, the block was either all allocated already, or some
-		// other CPU allocated the last frame before we could get it. Try the next block.
+		// other CPU allocated the last frame before we could get it. If it's empty, make sure the
+		// summary doesn't send anyone here again, then try the next block.
+		if (block == 0)
+		{
+			PmmBitmapAllocator_markEmpty( this, 0, i );
+		}
 	}
 	// *Probably* no memory left. Other CPUs may have freed some while we were searching.
 	// The same kind of condition exists in a lock-based system, in that other CPUs may be
@@ -212,6 +528,262 @@ phys_addr_t PmmBitmapAllocator_allocate( volatile PmmBitmapAllocator* this, void
 }
 
 
+
+/// \brief	Rounds the given frame index up so that the frame it refers to is aligned.
+///
+/// \param this			the PmmBitmapAllocator.
+/// \param frameIndex	a frame index, relative to the first frame tracked by this allocator.
+/// \param alignFrames	the desired alignment in frames; Must be a power of two.
+///
+/// Alignment is in terms of physical frame numbers, not frame indices, so the region tracked by
+/// this allocator doesn't have to be aligned itself.
+///
+/// \return the lowest frame index at or above \a frameIndex whose frame number is a multiple of
+///			\a alignFrames.
+static size_t PmmBitmapAllocator_alignFrameIndex(
+	volatile PmmBitmapAllocator*	this,
+	size_t							frameIndex,
+	size_t							alignFrames
+)
+{
+	// Note that an atomic read is not necessary for m_baseFrameNumber since its value never
+	// changes during the lifetime of this object.
+	size_t frameNumber = this->m_baseFrameNumber + frameIndex;
+	size_t alignedFrameNumber = (frameNumber + alignFrames - 1) & ~(alignFrames - 1);
+	return alignedFrameNumber - this->m_baseFrameNumber;
+}
+
+
+/// \brief	Calculates a mask of the bits in a block that are covered by the given run of frames.
+///
+/// \param firstIndex	the frame index of the first frame in the run.
+/// \param endIndex		the frame index just past the last frame in the run.
+/// \param blockNumber	an index into the bitmap array. The run must overlap this block.
+///
+/// \return a mask with a bit set for each frame of the run tracked by the block.
+static size_t PmmBitmapAllocator_getRunMask(
+	size_t	firstIndex,
+	size_t	endIndex,
+	size_t	blockNumber
+)
+{
+	size_t blockStart = blockNumber * BITS_PER_BLOCK;
+	size_t blockEnd = blockStart + BITS_PER_BLOCK;
+	size_t firstBit = (firstIndex > blockStart) ? (firstIndex - blockStart) : 0;
+	size_t endBit = (endIndex < blockEnd) ? (endIndex - blockStart) : BITS_PER_BLOCK;
+
+	size_t mask = ~((size_t) 0) << firstBit;
+	if (endBit < BITS_PER_BLOCK)
+	{
+		mask &= (((size_t) 1) << endBit) - 1;
+	}
+	return mask;
+}
+
+
+/// \brief	Looks for an allocated frame in the given run of frames.
+///
+/// \param this			the PmmBitmapAllocator.
+/// \param firstIndex	the frame index of the first frame in the run.
+/// \param numFrames	the number of frames in the run.
+///
+/// The run is checked a block at a time, from the top down, so that the caller can skip as far
+/// ahead as possible.
+///
+/// This method is thread-safe. The underlying implementation is lock-free. The result may be
+/// stale by the time the caller looks at it.
+///
+/// \retval size_t		the frame index of the highest allocated frame in the run.
+/// \retval NO_BLOCK	every frame in the run is free.
+static size_t PmmBitmapAllocator_findHighestAllocated(
+	volatile PmmBitmapAllocator*	this,
+	size_t							firstIndex,
+	size_t							numFrames
+)
+{
+	size_t endIndex = firstIndex + numFrames;
+	size_t firstBlock = firstIndex / BITS_PER_BLOCK;
+
+	for (size_t i = (endIndex - 1) / BITS_PER_BLOCK + 1; i > firstBlock; i--)
+	{
+		size_t blockNumber = i - 1;
+		size_t mask = PmmBitmapAllocator_getRunMask( firstIndex, endIndex, blockNumber );
+		size_t allocated = ~Atomic_read( &(this->m_bitmap[blockNumber]) ) & mask;
+		if (allocated != 0)
+		{
+			return (blockNumber * BITS_PER_BLOCK) + (size_t) KMem_findHighestSetBit( allocated );
+		}
+	}
+	return NO_BLOCK;
+}
+
+
+/// \brief	Attempts to allocate every frame in the given run of frames.
+///
+/// \param this			the PmmBitmapAllocator.
+/// \param firstIndex	the frame index of the first frame in the run.
+/// \param numFrames	the number of frames in the run.
+///
+/// Each block is claimed with a single CAS, and only if all of its frames in the run are still
+/// free. If another CPU gets to one of the frames first, the blocks already claimed are given
+/// back, so the run is either allocated in its entirety or not at all.
+///
+/// This method is thread-safe. The underlying implementation is lock-free.
+///
+/// \retval true	the whole run was allocated.
+/// \retval false	at least one frame in the run was already allocated; Nothing was allocated.
+static bool PmmBitmapAllocator_claimRun(
+	volatile PmmBitmapAllocator*	this,
+	size_t							firstIndex,
+	size_t							numFrames
+)
+{
+	size_t endIndex = firstIndex + numFrames;
+	size_t lastBlock = (endIndex - 1) / BITS_PER_BLOCK;
+
+	for (size_t i = firstIndex / BITS_PER_BLOCK; i <= lastBlock; i++)
+	{
+		size_t mask = PmmBitmapAllocator_getRunMask( firstIndex, endIndex, i );
+
+		size_t block = 0;
+		bool isRunFree = true;
+		do
+		{
+			block = Atomic_readExplicit( &(this->m_bitmap[i]), ATOMIC_RELAXED );
+			isRunFree = ((block & mask) == mask);
+		} while (isRunFree && !Atomic_compareAndSwap( &(this->m_bitmap[i]), block, block & ~mask ));
+
+		if (!isRunFree)
+		{
+			// Give back whatever we claimed in the blocks before this one.
+			size_t blockStart = i * BITS_PER_BLOCK;
+			size_t numClaimed = (blockStart > firstIndex) ? (blockStart - firstIndex) : 0;
+			PmmBitmapAllocator_fillRange(
+				this,
+				PmmBitmapAllocator_getPhysAddrForBlockNumberAndBitInBlock(
+					this,
+					firstIndex / BITS_PER_BLOCK,
+					(uint8_t) (firstIndex % BITS_PER_BLOCK)
+				),
+				numClaimed,
+				true
+			);
+			return false;
+		}
+
+		if ((block & ~mask) == 0)
+		{
+			PmmBitmapAllocator_markEmpty( this, 0, i );
+		}
+	}
+	return true;
+}
+
+
+
+/// \brief	Interface dispatch table for PmmBitmapAllocator's implementation of IPmmAllocator.
+static IPmmAllocator_itable s_itable =
+{
+	(IPmmAllocator_allocateFunc) PmmBitmapAllocator_allocate,
+	(IPmmAllocator_freeFunc) PmmBitmapAllocator_free,
+	(IPmmAllocator_allocateManyFunc) PmmBitmapAllocator_allocateMany,
+	(IPmmAllocator_freeManyFunc) PmmBitmapAllocator_freeMany
+};
+
+
+
+// Public functions
+
+PmmBitmapAllocator PmmBitmapAllocator_create(
+	size_t*		bitmapSpace,
+	size_t		numBlocks,
+	phys_addr_t	baseAddress
+)
+{
+	KDebug_assertArg( bitmapSpace != NULL );
+	KDebug_assertArg( numBlocks > 0 );
+	KDebug_assertArg( MM_isFrameAligned( baseAddress ) );
+	
+	// Zero out the bitmap space so that every frame is initially allocated, and every summary
+	// level agrees that every block is empty.
+	KMem_set(
+		bitmapSpace,
+		0,
+		PmmBitmapAllocator_calculateSpaceInBlocks( numBlocks ) * sizeof( size_t )
+	);
+
+	PmmBitmapAllocator allocator;
+
+	// Lay out the summary levels right after the bitmap. Keep adding levels until one fits in a
+	// single block.
+	size_t* levelSpace = bitmapSpace + numBlocks;
+	size_t levelSize = numBlocks;
+	allocator.m_numSummaryLevels = 0;
+	do
+	{
+		KDebug_assertArg( allocator.m_numSummaryLevels < MAX_SUMMARY_LEVELS );
+
+		levelSize = (levelSize + BITS_PER_BLOCK - 1) / BITS_PER_BLOCK;
+		allocator.m_summary[allocator.m_numSummaryLevels]		= levelSpace;
+		allocator.m_summarySizes[allocator.m_numSummaryLevels]	= levelSize;
+		allocator.m_numSummaryLevels++;
+		levelSpace += levelSize;
+	} while (levelSize > 1);
+
+	allocator.m_bitmap				= bitmapSpace;
+	allocator.m_lastAllocatedIndex	= 0;
+	allocator.m_numBlocks			= numBlocks;
+	allocator.m_baseFrameNumber		= MM_getFrameNumber( baseAddress );
+	allocator.m_numColours			= MM_getNumCacheColours();
+	return allocator;
+}
+
+
+size_t PmmBitmapAllocator_calculateSpaceInBlocks( size_t numBlocks )
+{
+	size_t spaceInBlocks = numBlocks;
+	size_t levelSize = numBlocks;
+	do
+	{
+		levelSize = (levelSize + BITS_PER_BLOCK - 1) / BITS_PER_BLOCK;
+		spaceInBlocks += levelSize;
+	} while (levelSize > 1);
+	return spaceInBlocks;
+}
+
+
+size_t PmmBitmapAllocator_blocksToFrames( size_t numBlocks )
+{
+	return numBlocks * BITS_PER_BLOCK;
+}
+
+
+size_t PmmBitmapAllocator_framesToBlocks( size_t numFrames )
+{
+	return numFrames / BITS_PER_BLOCK;
+}
+
+
+phys_addr_t PmmBitmapAllocator_allocate( volatile PmmBitmapAllocator* this, void* colourHint )
+{
+	KDebug_assertArg( this != NULL );
+
+	// Note that an atomic read is not necessary for m_numColours since its value never changes
+	// during the lifetime of this object.
+	if ((colourHint != NULL) && (this->m_numColours > 1))
+	{
+		size_t colour = MM_getPageColour( colourHint, this->m_numColours );
+		phys_addr_t frameAddr = PmmBitmapAllocator_scan( this, colour );
+		if (frameAddr != PHYS_NULL)
+		{
+			return frameAddr;
+		}
+		// There are no frames of the right colour left. Settle for any colour.
+	}
+	return PmmBitmapAllocator_scan( this, ANY_COLOUR );
+}
+
+
 phys_addr_t PmmBitmapAllocator_allocateFrame(
 	volatile PmmBitmapAllocator*	this,
 	phys_addr_t						frameAddr
@@ -222,31 +794,156 @@ phys_addr_t PmmBitmapAllocator_allocateFrame(
 	KDebug_assertArg( MM_isFrameAligned( frameAddr ) );
 	
 	size_t frameNumber = MM_getFrameNumber( frameAddr );
-	uint8_t bit = PmmBitmapAllocator_getBitInBlockForFrameNumber( frameNumber );
+	uint8_t bit = PmmBitmapAllocator_getBitInBlockForFrameNumber( this, frameNumber );
 
 	// This call does bounds checking for us (in checked builds).
 	size_t i = PmmBitmapAllocator_getBlockNumberForFrameNumber( this, frameNumber );
-	
-	size_t block = 0;
-	size_t newBlock = 0;
 
-	// Try to flip our bit in the block. Keep trying as long as other CPUs keep flipping other
-	// bits in the same block.
-	do
+	// Clearing the bit is a single locked instruction, so there's no retrying when other CPUs are
+	// flipping other bits in the same block. If the bit was already clear, the frame is already
+	// allocated, so give up.
+	if (!Atomic_bitTestAndReset( &(this->m_bitmap[i]), bit ))
+	{
+		return PHYS_NULL;
+	}
+
+	// We don't get the rest of the block back, so check whether it's empty now. If another CPU
+	// emptied it at the same time, we may both tell the summary, which is harmless.
+	if (Atomic_readExplicit( &(this->m_bitmap[i]), ATOMIC_SEQ_CST ) == 0)
+	{
+		PmmBitmapAllocator_markEmpty( this, 0, i );
+	}
+	return frameAddr;
+}
+
+
+phys_addr_t PmmBitmapAllocator_allocateRange(
+	volatile PmmBitmapAllocator*	this,
+	size_t							numFrames,
+	phys_size_t						alignment,
+	phys_addr_t						maxAddr
+)
+{
+	KDebug_assertArg( this != NULL );
+	KDebug_assertArg( numFrames > 0 );
+	KDebug_assertArg( (alignment & (alignment - 1)) == 0 );
+
+	if (alignment < PAGE_SIZE)
 	{
-		block = Atomic_read( &(this->m_bitmap[i]) );
+		alignment = PAGE_SIZE;
+	}
+	size_t alignFrames = alignment / PAGE_SIZE;
 
-		// If the frame is already allocated, give up.
-		if (!KMem_isBitSet( block, bit ))
+	// Work out how many frames at the bottom of the region are eligible. A frame that straddles
+	// maxAddr doesn't count. Note that maxAddr + 1 wraps around to zero (which is aligned) at the
+	// very top of the physical address space.
+	// Note that an atomic read is not necessary for m_baseFrameNumber or m_numBlocks since their
+	// values never change during the lifetime of this object.
+	size_t endFrameNumber = MM_getFrameNumber( maxAddr );
+	if (MM_isFrameAligned( maxAddr + 1 ))
+	{
+		endFrameNumber++;
+	}
+	if (endFrameNumber <= this->m_baseFrameNumber)
+	{
+		return PHYS_NULL;
+	}
+
+	size_t endIndex = endFrameNumber - this->m_baseFrameNumber;
+	size_t numTrackedFrames = PmmBitmapAllocator_blocksToFrames( this->m_numBlocks );
+	if (endIndex > numTrackedFrames)
+	{
+		endIndex = numTrackedFrames;
+	}
+
+	// First fit, from the bottom up. Whenever a candidate run turns out to contain an allocated
+	// frame, skip to the first aligned frame past the highest one, since no run that starts at or
+	// below it can fit.
+	size_t firstIndex = PmmBitmapAllocator_alignFrameIndex( this, 0, alignFrames );
+	while ((firstIndex < endIndex) && (numFrames <= endIndex - firstIndex))
+	{
+		// If there are no free frames from here to the end of the block, let the summary tell us
+		// where the next free frame is instead of checking every block along the way.
+		size_t i = firstIndex / BITS_PER_BLOCK;
+		uint8_t bit = (uint8_t) (firstIndex % BITS_PER_BLOCK);
+		if ((Atomic_read( &(this->m_bitmap[i]) ) & (~((size_t) 0) << bit)) == 0)
+		{
+			size_t next = PmmBitmapAllocator_findNonEmpty( this, 0, i + 1 );
+			if (next == NO_BLOCK)
+			{
+				break;
+			}
+			firstIndex =
+				PmmBitmapAllocator_alignFrameIndex( this, next * BITS_PER_BLOCK, alignFrames );
+			continue;
+		}
+
+		size_t allocatedIndex =
+			PmmBitmapAllocator_findHighestAllocated( this, firstIndex, numFrames );
+
+		if (allocatedIndex != NO_BLOCK)
 		{
-			return PHYS_NULL;
+			firstIndex = PmmBitmapAllocator_alignFrameIndex( this, allocatedIndex + 1, alignFrames );
 		}
-		
-		newBlock = KMem_bitClear( block, bit );
-	} while (!Atomic_compareAndSwap( &(this->m_bitmap[i]), block, newBlock ));
-	
-	// We fell through -- that means we successfully allocated the frame.
-	return frameAddr;
+		else if (PmmBitmapAllocator_claimRun( this, firstIndex, numFrames ))
+		{
+			return MM_getFrameAddress( this->m_baseFrameNumber + firstIndex );
+		}
+		// Otherwise, another CPU got to part of the run first. Look at it again.
+	}
+	return PHYS_NULL;
+}
+
+
+bool PmmBitmapAllocator_isFrameFree(
+	volatile PmmBitmapAllocator*	this,
+	phys_addr_t						frameAddr
+)
+{
+	KDebug_assertArg( this != NULL );
+	KDebug_assertArg( MM_isFrameAligned( frameAddr ) );
+
+	size_t frameNumber = MM_getFrameNumber( frameAddr );
+	uint8_t bit = PmmBitmapAllocator_getBitInBlockForFrameNumber( this, frameNumber );
+
+	// This call does bounds checking for us (in checked builds).
+	size_t i = PmmBitmapAllocator_getBlockNumberForFrameNumber( this, frameNumber );
+
+	size_t block = Atomic_readExplicit( &(this->m_bitmap[i]), ATOMIC_RELAXED );
+	return KMem_isBitSet( block, bit );
+}
+
+
+size_t PmmBitmapAllocator_countFreeFrames( volatile PmmBitmapAllocator* this )
+{
+	KDebug_assertArg( this != NULL );
+
+	size_t numFree = 0;
+	for (size_t i = 0; i < this->m_numBlocks; i++)
+	{
+		numFree += (size_t) KMem_countSetBits( Atomic_read( &(this->m_bitmap[i]) ) );
+	}
+	return numFree;
+}
+
+
+void PmmBitmapAllocator_freeFrames(
+	volatile PmmBitmapAllocator*	this,
+	phys_addr_t						firstFrameAddr,
+	size_t							numFrames
+)
+{
+	PmmBitmapAllocator_fillRange( this, firstFrameAddr, numFrames, true );
+}
+
+
+void PmmBitmapAllocator_reserveFrames(
+	volatile PmmBitmapAllocator*	this,
+	phys_addr_t						firstFrameAddr,
+	size_t							numFrames
+)
+{
+	PmmBitmapAllocator_fillRange( this, firstFrameAddr, numFrames, false );
 }
 
 
@@ -257,25 +954,153 @@ void PmmBitmapAllocator_free( volatile PmmBitmapAllocator* this, phys_addr_t fra
 	KDebug_assertArg( MM_isFrameAligned( frameAddr ) );
 	
 	size_t frameNumber = MM_getFrameNumber( frameAddr );
-	uint8_t bit = PmmBitmapAllocator_getBitInBlockForFrameNumber( frameNumber );
+	uint8_t bit = PmmBitmapAllocator_getBitInBlockForFrameNumber( this, frameNumber );
 	
 	// This call does bounds checking for us (in checked builds).
 	size_t i = PmmBitmapAllocator_getBlockNumberForFrameNumber( this, frameNumber );
 
-	size_t block = 0;
-	size_t newBlock = 0;
+	// Setting the bit is a single locked instruction, so there's no retrying when other CPUs are
+	// flipping other bits in the same block. The caller isn't allowed to free memory that is
+	// already free.
+	bool wasFree = Atomic_bitTestAndSet( &(this->m_bitmap[i]), bit );
+	KDebug_assert( !wasFree );
+	(void) wasFree;
 
-	// Try to flip our bit in the block. Keep trying as long as other CPUs keep flipping other
-	// bits in the same block.
-	do
+	// We don't get the rest of the block back, so we can't tell whether it was full. Tell the
+	// summary anyway; if its bit is already set, this is just one read.
+	PmmBitmapAllocator_markNonEmpty( this, 0, i );
+}
+
+
+size_t PmmBitmapAllocator_allocateMany(
+	volatile PmmBitmapAllocator*	this,
+	phys_addr_t*					frameAddrs,
+	size_t							numFrames,
+	void*							colourHint
+)
+{
+	KDebug_assertArg( this != NULL );
+	KDebug_assertArg( (frameAddrs != NULL) || (numFrames == 0) );
+
+	// Claiming a whole run of bits at once can't honour colours, so go one frame at a time if the
+	// caller cares about colour.
+	if ((colourHint != NULL) && (this->m_numColours > 1))
+	{
+		uint8_t* pageAddr = (uint8_t*) colourHint;
+		for (size_t n = 0; n < numFrames; n++)
+		{
+			frameAddrs[n] = PmmBitmapAllocator_allocate( this, pageAddr );
+			if (frameAddrs[n] == PHYS_NULL)
+			{
+				return n;
+			}
+			pageAddr += PAGE_SIZE;
+		}
+		return numFrames;
+	}
+
+	size_t numAllocated = 0;
+	size_t lastAllocatedIndex =
+		Atomic_readExplicit( &(this->m_lastAllocatedIndex), ATOMIC_RELAXED );
+
+	// Rotate around the bitmap once, just like PmmBitmapAllocator_scan(), but claim as many free
+	// frames from each block as we still need with a single CAS.
+	for (size_t i = PmmBitmapAllocator_findNextCandidate( this, lastAllocatedIndex, NO_BLOCK );
+		(i != NO_BLOCK) && (numAllocated < numFrames);
+		i = PmmBitmapAllocator_findNextCandidate( this, lastAllocatedIndex, i ))
+	{
+		size_t block = Atomic_readExplicit( &(this->m_bitmap[i]), ATOMIC_RELAXED );
+
+		while ((block != 0) && (numAllocated < numFrames))
+		{
+			// Pick off the lowest free frames until we have enough.
+			size_t claimed = 0;
+			size_t remaining = block;
+			for (size_t n = numAllocated; (n < numFrames) && (remaining != 0); n++)
+			{
+				size_t lowestBit = remaining & (~remaining + 1);
+				claimed |= lowestBit;
+				remaining &= ~lowestBit;
+			}
+
+			if (Atomic_compareAndSwap( &(this->m_bitmap[i]), block, block & ~claimed ))
+			{
+				while (claimed != 0)
+				{
+					uint8_t bit = (uint8_t) KMem_findLowestSetBit( claimed );
+					claimed = KMem_bitClear( claimed, bit );
+					frameAddrs[numAllocated++] =
+						PmmBitmapAllocator_getPhysAddrForBlockNumberAndBitInBlock( this, i, bit );
+				}
+				Atomic_writeExplicit( &(this->m_lastAllocatedIndex), i, ATOMIC_RELAXED );
+			}
+
+			// Either we got what we wanted, or something changed in the block. Either way, take
+			// another look in case there are still frames left that we could use.
+			block = Atomic_readExplicit( &(this->m_bitmap[i]), ATOMIC_RELAXED );
+		}
+
+		// Whether we emptied the block or found it empty, the summary has to know.
+		if (block == 0)
+		{
+			PmmBitmapAllocator_markEmpty( this, 0, i );
+		}
+	}
+	return numAllocated;
+}
+
+
+void PmmBitmapAllocator_freeMany(
+	volatile PmmBitmapAllocator*	this,
+	const phys_addr_t*				frameAddrs,
+	size_t							numFrames
+)
+{
+	KDebug_assertArg( this != NULL );
+	KDebug_assertArg( (frameAddrs != NULL) || (numFrames == 0) );
+
+	size_t n = 0;
+	while (n < numFrames)
 	{
-		block = Atomic_read( &(this->m_bitmap[i]) );
+		KDebug_assertArg( frameAddrs[n] != PHYS_NULL );
+		KDebug_assertArg( MM_isFrameAligned( frameAddrs[n] ) );
+
+		// Gather up the run of frames that share a block with this one, so they can all be freed
+		// with one CAS.
+		size_t frameNumber = MM_getFrameNumber( frameAddrs[n] );
+		size_t i = PmmBitmapAllocator_getBlockNumberForFrameNumber( this, frameNumber );
+		size_t freed =
+			KMem_bitSet( 0, PmmBitmapAllocator_getBitInBlockForFrameNumber( this, frameNumber ) );
 
-		// The caller isn't allowed to free memory that is already free.		
-		KDebug_assert( !KMem_isBitSet( block, bit ) );
-		
-		newBlock = KMem_bitSet( block, bit );
-	} while (!Atomic_compareAndSwap( &(this->m_bitmap[i]), block, newBlock ));
+		for (n++; n < numFrames; n++)
+		{
+			KDebug_assertArg( frameAddrs[n] != PHYS_NULL );
+			KDebug_assertArg( MM_isFrameAligned( frameAddrs[n] ) );
+
+			frameNumber = MM_getFrameNumber( frameAddrs[n] );
+			if ((frameNumber < this->m_baseFrameNumber) ||
+				(((frameNumber - this->m_baseFrameNumber) / BITS_PER_BLOCK) != i))
+			{
+				break;
+			}
+
+			uint8_t bit = PmmBitmapAllocator_getBitInBlockForFrameNumber( this, frameNumber );
+
+			// The caller isn't allowed to free the same frame twice.
+			KDebug_assert( !KMem_isBitSet( freed, bit ) );
+			freed = KMem_bitSet( freed, bit );
+		}
+
+		size_t block = Atomic_fetchOr( &(this->m_bitmap[i]), freed );
+
+		// The caller isn't allowed to free memory that is already free.
+		KDebug_assert( (block & freed) == 0 );
+
+		if (block == 0)
+		{
+			PmmBitmapAllocator_markNonEmpty( this, 0, i );
+		}
+	}
 }
 
 
@@ -18,6 +18,20 @@
 /// \brief	Defines the PmmBitmapAllocator class, which implements a frame
 ///			allocator that tracks a fixed number of frames with a bitmap.
 ///
+/// Besides the bitmap itself, the allocator keeps a hierarchy of summary
+/// bitmaps. Each bit of the first summary level is set when the
+/// corresponding block of the bitmap may have a free frame in it; each bit
+/// of the next level up is set when the corresponding block of the level
+/// below it may have a bit set; and so on, until a level fits in a single
+/// block. Finding a free frame, or proving that there are none, only needs a
+/// find-lowest-set-bit operation per level instead of a walk over the whole
+/// bitmap.
+///
+/// The summary levels are maintained lock-free alongside the bitmap. A
+/// summary bit may be set for a block that is actually empty (the search
+/// simply moves on), but it is never clear for a block that has free frames
+/// in it once the operation that freed them has returned.
+///
 // ===========================================================================
 
 #ifndef _KERNEL_MM_PMMBITMAPALLOCATOR_H_
@@ -25,6 +39,7 @@
 
 
 #include <stddef.h>
+#include <stdbool.h>
 #include "Kernel/MM/IPmmAllocator.h"
 
 
@@ -35,6 +50,11 @@ enum PmmBitmapAllocator_consts
 {
 	BITS_PER_BYTE = 8,									///< Magic number (# bits per byte).
 	BITS_PER_BLOCK = BITS_PER_BYTE * sizeof( size_t ),	///< # of bits in element of bitmap array.
+
+	/// \brief	Maximum number of summary levels above the bitmap.
+	///
+	/// Three levels are enough to track every frame in a 32-bit physical address space.
+	MAX_SUMMARY_LEVELS = 3
 };
 
 
@@ -58,6 +78,18 @@ typedef struct PmmBitmapAllocator
 	/// \brief	The frame number of the first frame of the region being tracked by this allocator.
 	size_t m_baseFrameNumber;
 
+	/// \brief	The number of cache colours, as reported by MM_getNumCacheColours().
+	size_t m_numColours;
+
+	/// \brief	Base address of each summary level, starting with the one just above the bitmap.
+	size_t* m_summary[MAX_SUMMARY_LEVELS];
+
+	/// \brief	The number of blocks in each summary level.
+	size_t m_summarySizes[MAX_SUMMARY_LEVELS];
+
+	/// \brief	The number of summary levels in use. The last one is always a single block.
+	size_t m_numSummaryLevels;
+
 #else
 
 	#ifndef DOXYGEN_SHOULD_SKIP_THIS
@@ -65,6 +97,10 @@ typedef struct PmmBitmapAllocator
 	size_t		m_reserved1;
 	size_t		m_reserved2;
 	phys_addr_t	m_reserved3;
+	size_t		m_reserved4;
+	size_t*		m_reserved5[MAX_SUMMARY_LEVELS];
+	size_t		m_reserved6[MAX_SUMMARY_LEVELS];
+	size_t		m_reserved7;
 	#endif
 
 #endif
@@ -74,11 +110,17 @@ typedef struct PmmBitmapAllocator
 
 /// \brief	Creates a new PmmBitmapAllocator instance.
 ///
-/// \param bitmapSpace	base address of the array to hold the bitmap.
-/// \param numBlocks	size of the \a bitmapSpace array, in elements.
+/// \param bitmapSpace	base address of the array to hold the bitmap and its summary levels.
+/// \param numBlocks	the number of blocks in the bitmap itself.
 /// \param baseAddress	base physical address of the region to be managed by the allocator.
 ///
-/// If \a bitmapSpace is NULL or numBlocks is zero, a bugcheck will occur in checked builds.
+/// The \a bitmapSpace array must have at least as many elements as returned by
+/// PmmBitmapAllocator_calculateSpaceInBlocks() for \a numBlocks. The summary levels are placed
+/// right after the bitmap.
+///
+/// If \a bitmapSpace is NULL or numBlocks is zero, a bugcheck will occur in checked builds. If
+/// \a numBlocks is too large to be summarized in MAX_SUMMARY_LEVELS levels, a bugcheck will occur
+/// in checked builds.
 /// If \a baseAddress is not page-aligned, a bugcheck will occur in checked builds.
 ///
 /// The initial state of the allocator is that all frames are allocated.
@@ -91,6 +133,18 @@ PmmBitmapAllocator PmmBitmapAllocator_create(
 );
 
 
+/// \brief	Calculates the total number of blocks of space needed for a bitmap of the given size,
+///			including its summary levels.
+///
+/// \param numBlocks	the number of blocks in the bitmap itself.
+///
+/// This method is useful for calculating the size of the array to pass to
+/// PmmBitmapAllocator_create().
+///
+/// \return the number of elements the \a bitmapSpace array must have.
+size_t PmmBitmapAllocator_calculateSpaceInBlocks( size_t numBlocks );
+
+
 /// \brief	Calculates the number of frames that can be tracked by the given number of bitmap
 ///			blocks.
 ///
@@ -115,11 +169,18 @@ size_t PmmBitmapAllocator_framesToBlocks( size_t numFrames );
 /// \brief	Implementation of IPmmAllocator_allocate().
 ///
 /// \param this			the allocator from which to allocate.
-/// \param colourHint	the colour hint; Currently ignored by this implementation.
+/// \param colourHint	the colour hint; NULL means no preference.
 ///
-/// This method is thread-safe. The underlying implementation is lock-free.
+/// If a colour hint is given, the bitmap is first scanned for a free frame of the same colour as
+/// the page containing \a colourHint. If there are none, any free frame is returned instead.
+/// Without a hint, frames are handed out in roughly ascending order, which cycles evenly through
+/// the colours.
 ///
-/// ***FIXME: Pay attention to the colour hint!
+/// Only blocks that the summary levels report as non-empty are examined, so an allocation without
+/// a colour hint takes time proportional to the number of summary levels, not the size of the
+/// bitmap. This is also true when there are no free frames at all.
+///
+/// This method is thread-safe. The underlying implementation is lock-free.
 ///
 /// \retval phys_addr_t	the physical address of the frame just allocated; Guaranteed to be
 ///						page-aligned.
@@ -150,6 +211,136 @@ phys_addr_t PmmBitmapAllocator_allocateFrame(
 );
 
 
+/// \brief	Allocates a run of physically contiguous frames with the given alignment, entirely
+///			at or below the given address.
+///
+/// \param this			the allocator from which to allocate.
+/// \param numFrames	the number of frames to allocate.
+/// \param alignment	the alignment of the first frame in bytes; Must be a power of two. Values
+///						less than PAGE_SIZE (including zero) mean page alignment.
+/// \param maxAddr		the highest physical address that the run may include. For example,
+///						0x00FFFFFF for ISA DMA, or MAX_PHYS_ADDR for no limit.
+///
+/// The bitmap is searched from the bottom up for the first run of free frames that fits. Frames
+/// are examined a block at a time, and the search skips past the highest allocated frame of each
+/// candidate that doesn't fit, as well as any blocks that the summary reports as empty.
+///
+/// The run is claimed a block at a time. If another CPU allocates one of its frames in the
+/// meantime, the partial claim is undone and the search carries on, so the run is never left
+/// half-allocated. Free the run with PmmBitmapAllocator_freeFrames().
+///
+/// In checked builds, a bugcheck will occur if \a numFrames is zero or if \a alignment is not a
+/// power of two.
+///
+/// This method is thread-safe. The underlying implementation is lock-free.
+///
+/// \note
+/// This method is not part of the IPmmAllocator interface. It is a special feature of
+/// PmmBitmapAllocator.
+///
+/// \retval phys_addr_t	the physical address of the first frame of the run; Guaranteed to be
+///						aligned on \a alignment.
+/// \retval PHYS_NULL	there is no run of free frames that satisfies the constraints.
+phys_addr_t PmmBitmapAllocator_allocateRange(
+	volatile PmmBitmapAllocator*	this,
+	size_t							numFrames,
+	phys_size_t						alignment,
+	phys_addr_t						maxAddr
+);
+
+
+/// \brief	Indicates whether the given frame is currently free.
+///
+/// \param this			the allocator that tracks the frame.
+/// \param frameAddr	the physical address of the frame to test.
+///
+/// In checked builds, a bugcheck will occur if \a frameAddr is not page-aligned or not in the
+/// region tracked by this allocator.
+///
+/// This method is thread-safe. The underlying implementation is lock-free, but the returned value
+/// may be stale by the time the caller looks at it.
+///
+/// \note
+/// This method is not part of the IPmmAllocator interface. It is a special feature of
+/// PmmBitmapAllocator.
+///
+/// \retval true	\a frameAddr is free.
+/// \retval false	\a frameAddr is allocated.
+bool PmmBitmapAllocator_isFrameFree(
+	volatile PmmBitmapAllocator*	this,
+	phys_addr_t						frameAddr
+);
+
+
+/// \brief	Counts the free frames tracked by the given allocator.
+///
+/// \param this	the allocator to examine.
+///
+/// This takes time proportional to the number of blocks in the bitmap, so it is meant for
+/// statistics and consistency checks rather than allocation decisions.
+///
+/// This method is thread-safe. The underlying implementation is lock-free, but the count may be
+/// stale by the time the caller looks at it, and is only exact if nothing is allocated or freed
+/// while it runs.
+///
+/// \note
+/// This method is not part of the IPmmAllocator interface. It is a special feature of
+/// PmmBitmapAllocator.
+///
+/// \return the number of free frames.
+size_t PmmBitmapAllocator_countFreeFrames( volatile PmmBitmapAllocator* this );
+
+
+/// \brief	Marks a run of consecutive frames as free.
+///
+/// \param this				the allocator that tracks the frames.
+/// \param firstFrameAddr	the physical address of the first frame in the run.
+/// \param numFrames		the number of frames in the run.
+///
+/// The bitmap is updated a whole block at a time, so this takes time proportional to the number
+/// of blocks spanned by the run rather than the number of frames. Unlike PmmBitmapAllocator_free(),
+/// frames that are already free are silently left alone. This makes it suitable for describing
+/// memory maps, which may overlap.
+///
+/// In checked builds, a bugcheck will occur if \a firstFrameAddr is not page-aligned, or if the
+/// run is not entirely within the region tracked by this allocator.
+///
+/// This method is thread-safe. The underlying implementation is lock-free.
+///
+/// \note
+/// This method is not part of the IPmmAllocator interface. It is a special feature of
+/// PmmBitmapAllocator.
+void PmmBitmapAllocator_freeFrames(
+	volatile PmmBitmapAllocator*	this,
+	phys_addr_t						firstFrameAddr,
+	size_t							numFrames
+);
+
+
+/// \brief	Marks a run of consecutive frames as allocated.
+///
+/// \param this				the allocator that tracks the frames.
+/// \param firstFrameAddr	the physical address of the first frame in the run.
+/// \param numFrames		the number of frames in the run.
+///
+/// This is the opposite of PmmBitmapAllocator_freeFrames(), and works the same way. Frames that
+/// are already allocated are silently left alone.
+///
+/// In checked builds, a bugcheck will occur if \a firstFrameAddr is not page-aligned, or if the
+/// run is not entirely within the region tracked by this allocator.
+///
+/// This method is thread-safe. The underlying implementation is lock-free.
+///
+/// \note
+/// This method is not part of the IPmmAllocator interface. It is a special feature of
+/// PmmBitmapAllocator.
+void PmmBitmapAllocator_reserveFrames(
+	volatile PmmBitmapAllocator*	this,
+	phys_addr_t						firstFrameAddr,
+	size_t							numFrames
+);
+
+
 /// \brief	Implementation of IPmmAllocator_free().
 ///
 /// \param this			the allocator to which to free.
@@ -163,6 +354,45 @@ phys_addr_t PmmBitmapAllocator_allocateFrame(
 void PmmBitmapAllocator_free( volatile PmmBitmapAllocator* this, phys_addr_t frameAddr );
 
 
+/// \brief	Implementation of IPmmAllocator_allocateMany().
+///
+/// \param this			the allocator from which to allocate.
+/// \param frameAddrs	receives the physical addresses of the frames allocated.
+/// \param numFrames	the number of frames to allocate.
+/// \param colourHint	the colour hint for the first frame; NULL means no preference.
+///
+/// Without a colour hint, up to a whole block's worth of frames (BITS_PER_BLOCK) is claimed with
+/// a single CAS, so the cost of the scan and the atomic operation is amortized. With a colour
+/// hint, each frame is allocated separately so that its colour can be matched.
+///
+/// This method is thread-safe. The underlying implementation is lock-free.
+///
+/// \return the number of frames actually allocated.
+size_t PmmBitmapAllocator_allocateMany(
+	volatile PmmBitmapAllocator*	this,
+	phys_addr_t*					frameAddrs,
+	size_t							numFrames,
+	void*							colourHint
+);
+
+
+/// \brief	Implementation of IPmmAllocator_freeMany().
+///
+/// \param this			the allocator to which to free.
+/// \param frameAddrs	the physical addresses of the frames to free.
+/// \param numFrames	the number of frames to free.
+///
+/// Each run of consecutive elements of \a frameAddrs that are tracked by the same bitmap block is
+/// freed with a single CAS. The same checks as PmmBitmapAllocator_free() apply to each element.
+///
+/// This method is thread-safe. The underlying implementation is lock-free.
+void PmmBitmapAllocator_freeMany(
+	volatile PmmBitmapAllocator*	this,
+	const phys_addr_t*				frameAddrs,
+	size_t							numFrames
+);
+
+
 /// \brief	Gets a reference to the IPmmAllocator implementation of the given PmmBitmapAllocator.
 ///
 /// \param allocator the PmmBitmapAllocator instance.
@@ -0,0 +1,400 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/MM/PmmBuddyAllocator.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/Apr/09
+//
+// ===========================================================================
+///
+///	\file
+///
+/// \brief	Contains the implementation of IPmmAllocator that uses the buddy
+///			system to hand out physically contiguous blocks of frames.
+///
+// ===========================================================================
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "Kernel/KCommon/KDebug.h"
+#include "Kernel/KCommon/KMem.h"
+
+#define _KERNEL_MM_PMMBUDDYALLOCATOR_C_
+#include "Kernel/MM/PmmBuddyAllocator.h"
+
+
+// Private types and constants
+
+/// \brief	The record kept by the PmmBuddyAllocator for each frame.
+///
+/// Only the record for the first frame of a block is meaningful. The records for the rest of the
+/// frames in the block are ignored until the block is split.
+typedef struct PmmBuddyFrameStruct
+{
+	/// \brief	Index of the next block in the same free list. Only meaningful while the block is
+	///			free.
+	size_t m_next;
+
+	/// \brief	Index of the previous block in the same free list. Only meaningful while the block
+	///			is free.
+	size_t m_prev;
+
+	/// \brief	The order of the block that starts at this frame.
+	uint8_t m_order;
+
+	/// \brief	Indicates whether this frame is the first frame of a free block.
+	bool m_isFree;
+
+} PmmBuddyFrame;
+
+
+/// \brief	Marks the end of a free list.
+///
+/// Unlike the PageFrameDatabase, index zero is a perfectly good block, so an out-of-range index is
+/// used as the "null" link instead.
+static const size_t NO_BLOCK = SIZE_MAX;
+
+
+
+// Private functions
+
+/// \brief	Removes the given block from the free list for its order.
+///
+/// \param this			the PmmBuddyAllocator.
+/// \param blockIndex	the index of the first frame of the block.
+///
+/// This method is not thread-safe. The caller must hold the lock on \a this.
+static void PmmBuddyAllocator_unlinkBlock( PmmBuddyAllocator* this, size_t blockIndex )
+{
+	PmmBuddyFrame* block = &(this->m_frames[blockIndex]);
+	KDebug_assert( block->m_isFree );
+
+	if (block->m_prev != NO_BLOCK)
+	{
+		this->m_frames[block->m_prev].m_next = block->m_next;
+	}
+	else
+	{
+		this->m_freeListHeads[block->m_order] = block->m_next;
+	}
+
+	if (block->m_next != NO_BLOCK)
+	{
+		this->m_frames[block->m_next].m_prev = block->m_prev;
+	}
+
+	block->m_isFree	= false;
+	block->m_next	= NO_BLOCK;
+	block->m_prev	= NO_BLOCK;
+
+	this->m_numFreeFrames -= ((size_t) 1) << block->m_order;
+}
+
+
+/// \brief	Pushes the given block onto the front of the free list for the given order.
+///
+/// \param this			the PmmBuddyAllocator.
+/// \param blockIndex	the index of the first frame of the block.
+/// \param order		the order of the block.
+///
+/// This method is not thread-safe. The caller must hold the lock on \a this.
+static void PmmBuddyAllocator_linkBlock( PmmBuddyAllocator* this, size_t blockIndex, uint8_t order )
+{
+	PmmBuddyFrame* block = &(this->m_frames[blockIndex]);
+	KDebug_assert( !block->m_isFree );
+
+	size_t head = this->m_freeListHeads[order];
+
+	block->m_isFree	= true;
+	block->m_order	= order;
+	block->m_prev	= NO_BLOCK;
+	block->m_next	= head;
+
+	if (head != NO_BLOCK)
+	{
+		this->m_frames[head].m_prev = blockIndex;
+	}
+	this->m_freeListHeads[order] = blockIndex;
+
+	this->m_numFreeFrames += ((size_t) 1) << order;
+}
+
+
+
+/// \brief	Takes a block of the given order, splitting a larger block if necessary.
+///
+/// \param this		the PmmBuddyAllocator.
+/// \param order	the order of the block to take.
+///
+/// This method is not thread-safe. The caller must hold the lock on \a this.
+///
+/// \return the physical address of the block, or PHYS_NULL if there is no block big enough.
+static phys_addr_t PmmBuddyAllocator_takeBlock( PmmBuddyAllocator* this, uint8_t order )
+{
+	// Find the smallest free block that is big enough.
+	uint8_t foundOrder = order;
+	while ((foundOrder <= MAX_BUDDY_ORDER) && (this->m_freeListHeads[foundOrder] == NO_BLOCK))
+	{
+		foundOrder++;
+	}
+
+	if (foundOrder > MAX_BUDDY_ORDER)
+	{
+		return PHYS_NULL;
+	}
+
+	size_t blockIndex = this->m_freeListHeads[foundOrder];
+	PmmBuddyAllocator_unlinkBlock( this, blockIndex );
+
+	// Split the block in half until it's the right size, freeing the upper half each time.
+	while (foundOrder > order)
+	{
+		foundOrder--;
+		PmmBuddyAllocator_linkBlock( this, blockIndex + (((size_t) 1) << foundOrder), foundOrder );
+	}
+
+	// Remember the order so that freeOrder() can check it.
+	this->m_frames[blockIndex].m_order = order;
+
+	return MM_getFrameAddress( blockIndex + this->m_baseFrameNumber );
+}
+
+
+/// \brief	Returns a block of the given order, merging it with its buddies as far as possible.
+///
+/// \param this			the PmmBuddyAllocator.
+/// \param blockAddr	the physical address of the first frame of the block.
+/// \param order		the order of the block.
+///
+/// See PmmBuddyAllocator_freeOrder() for the checks that are made.
+///
+/// This method is not thread-safe. The caller must hold the lock on \a this.
+static void PmmBuddyAllocator_returnBlock(
+	PmmBuddyAllocator*	this,
+	phys_addr_t			blockAddr,
+	uint8_t				order
+)
+{
+	KDebug_assertArg( blockAddr != PHYS_NULL );
+	KDebug_assertArg( order <= MAX_BUDDY_ORDER );
+
+	size_t frameNumber	= MM_getFrameNumber( blockAddr );
+	size_t blockSize	= ((size_t) 1) << order;
+
+	KDebug_assertArg( (frameNumber & (blockSize - 1)) == 0 );
+	KDebug_assertArg( frameNumber >= this->m_baseFrameNumber );
+	KDebug_assertArg( frameNumber - this->m_baseFrameNumber + blockSize <= this->m_numFrames );
+	(void) blockSize;	// Only used in checked builds.
+
+	// The caller isn't allowed to free memory that is already free, or to free a different-sized
+	// block than it allocated.
+	KDebug_assert( !this->m_frames[frameNumber - this->m_baseFrameNumber].m_isFree );
+	KDebug_assert( this->m_frames[frameNumber - this->m_baseFrameNumber].m_order == order );
+
+	// Merge with the buddy for as long as it is free and whole. Buddies are found using absolute
+	// frame numbers so that blocks stay naturally aligned in physical memory.
+	while (order < MAX_BUDDY_ORDER)
+	{
+		size_t buddyFrameNumber = frameNumber ^ (((size_t) 1) << order);
+		if (buddyFrameNumber < this->m_baseFrameNumber)
+		{
+			break;
+		}
+
+		size_t buddyIndex = buddyFrameNumber - this->m_baseFrameNumber;
+		if (buddyIndex >= this->m_numFrames)
+		{
+			break;
+		}
+
+		PmmBuddyFrame* buddy = &(this->m_frames[buddyIndex]);
+		if (!buddy->m_isFree || (buddy->m_order != order))
+		{
+			break;
+		}
+
+		PmmBuddyAllocator_unlinkBlock( this, buddyIndex );
+		frameNumber &= buddyFrameNumber;	// The merged block starts at the lower of the two.
+		order++;
+	}
+
+	PmmBuddyAllocator_linkBlock( this, frameNumber - this->m_baseFrameNumber, order );
+}
+
+
+
+/// \brief	Interface dispatch table for PmmBuddyAllocator's implementation of IPmmAllocator.
+static IPmmAllocator_itable s_itable =
+{
+	(IPmmAllocator_allocateFunc) PmmBuddyAllocator_allocate,
+	(IPmmAllocator_freeFunc) PmmBuddyAllocator_free,
+	(IPmmAllocator_allocateManyFunc) PmmBuddyAllocator_allocateMany,
+	(IPmmAllocator_freeManyFunc) PmmBuddyAllocator_freeMany
+};
+
+
+
+// Public functions
+
+size_t PmmBuddyAllocator_calculateSizeInBytes( size_t numFrames )
+{
+	return numFrames * sizeof( PmmBuddyFrame );
+}
+
+
+PmmBuddyAllocator PmmBuddyAllocator_create(
+	void*		workingSpace,	// in, own
+	size_t		sizeInBytes,	// in
+	phys_addr_t	baseAddress,	// in
+	size_t		numFrames		// in
+)
+{
+	KDebug_assertArg( workingSpace != NULL );
+	KDebug_assertArg( KMem_isAligned32( (uintptr_t) workingSpace ) );
+	KDebug_assertArg( MM_isFrameAligned( baseAddress ) );
+	KDebug_assertArg( numFrames > 0 );
+	KDebug_assertArg( sizeInBytes >= PmmBuddyAllocator_calculateSizeInBytes( numFrames ) );
+	(void) sizeInBytes;	// Only used in checked builds.
+
+	PmmBuddyAllocator allocator;
+	allocator.m_frames			= (PmmBuddyFrame*) workingSpace;
+	allocator.m_numFrames		= numFrames;
+	allocator.m_baseFrameNumber	= MM_getFrameNumber( baseAddress );
+	allocator.m_numFreeFrames	= 0;
+	allocator.m_lock			= Lock_create();
+
+	for (size_t order = 0; order < NUM_BUDDY_ORDERS; order++)
+	{
+		allocator.m_freeListHeads[order] = NO_BLOCK;
+	}
+
+	// Every frame starts out as an allocated order-zero block.
+	for (size_t i = 0; i < numFrames; i++)
+	{
+		allocator.m_frames[i].m_next	= NO_BLOCK;
+		allocator.m_frames[i].m_prev	= NO_BLOCK;
+		allocator.m_frames[i].m_order	= 0;
+		allocator.m_frames[i].m_isFree	= false;
+	}
+	return allocator;
+}
+
+
+size_t PmmBuddyAllocator_getNumFreeFrames( const volatile PmmBuddyAllocator* this )
+{
+	KDebug_assertArg( this != NULL );
+	return this->m_numFreeFrames;
+}
+
+
+phys_addr_t PmmBuddyAllocator_allocateOrder( volatile PmmBuddyAllocator* this, uint8_t order )
+{
+	KDebug_assertArg( this != NULL );
+	KDebug_assertArg( order <= MAX_BUDDY_ORDER );
+
+	Lock_acquire( &(this->m_lock) );
+	phys_addr_t blockAddr = PmmBuddyAllocator_takeBlock( (PmmBuddyAllocator*) this, order );
+	Lock_release( &(this->m_lock) );
+
+	return blockAddr;
+}
+
+
+void PmmBuddyAllocator_freeOrder(
+	volatile PmmBuddyAllocator*	this,
+	phys_addr_t					blockAddr,
+	uint8_t						order
+)
+{
+	KDebug_assertArg( this != NULL );
+
+	Lock_acquire( &(this->m_lock) );
+	PmmBuddyAllocator_returnBlock( (PmmBuddyAllocator*) this, blockAddr, order );
+	Lock_release( &(this->m_lock) );
+}
+
+
+phys_addr_t PmmBuddyAllocator_allocate( volatile PmmBuddyAllocator* this, void* colourHint )
+{
+	// For now, the implementation ignores the colour hint.
+	(void) colourHint;
+	return PmmBuddyAllocator_allocateOrder( this, 0 );
+}
+
+
+void PmmBuddyAllocator_free( volatile PmmBuddyAllocator* this, phys_addr_t frameAddr )
+{
+	KDebug_assertArg( MM_isFrameAligned( frameAddr ) );
+	PmmBuddyAllocator_freeOrder( this, MM_alignToFrame( frameAddr ), 0 );
+}
+
+
+size_t PmmBuddyAllocator_allocateMany(
+	volatile PmmBuddyAllocator*	this,
+	phys_addr_t*				frameAddrs,
+	size_t						numFrames,
+	void*						colourHint
+)
+{
+	KDebug_assertArg( this != NULL );
+	KDebug_assertArg( (frameAddrs != NULL) || (numFrames == 0) );
+
+	// For now, the implementation ignores the colour hint.
+	(void) colourHint;
+
+	size_t numAllocated = 0;
+
+	Lock_acquire( &(this->m_lock) );
+	PmmBuddyAllocator* lockedThis = (PmmBuddyAllocator*) this;
+
+	while (numAllocated < numFrames)
+	{
+		phys_addr_t frameAddr = PmmBuddyAllocator_takeBlock( lockedThis, 0 );
+		if (frameAddr == PHYS_NULL)
+		{
+			break;
+		}
+		frameAddrs[numAllocated++] = frameAddr;
+	}
+
+	Lock_release( &(this->m_lock) );
+	return numAllocated;
+}
+
+
+void PmmBuddyAllocator_freeMany(
+	volatile PmmBuddyAllocator*	this,
+	const phys_addr_t*			frameAddrs,
+	size_t						numFrames
+)
+{
+	KDebug_assertArg( this != NULL );
+	KDebug_assertArg( (frameAddrs != NULL) || (numFrames == 0) );
+
+	Lock_acquire( &(this->m_lock) );
+	PmmBuddyAllocator* lockedThis = (PmmBuddyAllocator*) this;
+
+	for (size_t i = 0; i < numFrames; i++)
+	{
+		KDebug_assertArg( MM_isFrameAligned( frameAddrs[i] ) );
+		PmmBuddyAllocator_returnBlock( lockedThis, MM_alignToFrame( frameAddrs[i] ), 0 );
+	}
+
+	Lock_release( &(this->m_lock) );
+}
+
+
+IPmmAllocator PmmBuddyAllocator_getAsPmmAllocator( volatile PmmBuddyAllocator* allocator )
+{
+	IPmmAllocator iAllocator;
+	iAllocator.obj	= allocator;	// Point to the given object.
+	iAllocator.iptr	= &s_itable;	// Point at the right interface dispatch table.
+	return iAllocator;
+}
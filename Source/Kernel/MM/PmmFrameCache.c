@@ -0,0 +1,408 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/MM/PmmFrameCache.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/Apr/16
+//
+// ===========================================================================
+///
+///	\file
+///
+/// \brief	Contains the implementation of IPmmAllocator that caches free
+///			frames per processor in front of another IPmmAllocator.
+///
+// ===========================================================================
+
+
+#include "Kernel/KCommon/KDebug.h"
+
+#define _KERNEL_MM_PMMFRAMECACHE_C_
+#include "PmmFrameCache.h"
+
+
+// Private functions
+
+/// \brief	Gets the magazine belonging to the current processor.
+///
+/// \param this	the PmmFrameCache.
+///
+/// The caller may be migrated to another processor right after this method returns. That is
+/// harmless, since every magazine is protected by its own lock; the caller just ends up using a
+/// magazine that isn't local anymore.
+///
+/// \return the current processor's magazine.
+static inline volatile PmmProcessorFrameCache* PmmFrameCache_getLocalCache(
+	volatile PmmFrameCache* this
+)
+{
+	int id = Processor_getID( Processor_getCurrent() );
+	KDebug_assert( (0 <= id) && (id < PROCESSOR_MAX_COUNT) );
+	return &(this->m_caches[id]);
+}
+
+
+/// \brief	Moves up to \a count frames from the global pool into the given magazine.
+///
+/// \param this		the PmmFrameCache.
+/// \param cache	the magazine to refill. The caller must hold its lock.
+/// \param count	the number of frames to move.
+///
+/// \return the number of frames actually moved.
+static size_t PmmFrameCache_refill(
+	volatile PmmFrameCache*	this,
+	PmmProcessorFrameCache*	cache,
+	size_t					count
+)
+{
+	size_t room = FRAME_CACHE_CAPACITY - cache->m_numFrames;
+	if (count > room)
+	{
+		count = room;
+	}
+
+	IPmmAllocator globalPool = this->m_globalPool;
+	size_t moved = globalPool.iptr->allocateMany(
+		globalPool.obj,
+		&(cache->m_frames[cache->m_numFrames]),
+		count,
+		NULL
+	);
+	cache->m_numFrames += moved;
+	return moved;
+}
+
+
+/// \brief	Moves up to \a count frames from the given magazine back to the global pool.
+///
+/// \param this		the PmmFrameCache.
+/// \param cache	the magazine to spill. The caller must hold its lock.
+/// \param count	the number of frames to move.
+static void PmmFrameCache_spill(
+	volatile PmmFrameCache*	this,
+	PmmProcessorFrameCache*	cache,
+	size_t					count
+)
+{
+	if (count > cache->m_numFrames)
+	{
+		count = cache->m_numFrames;
+	}
+
+	cache->m_numFrames -= count;
+
+	IPmmAllocator globalPool = this->m_globalPool;
+	globalPool.iptr->freeMany( globalPool.obj, &(cache->m_frames[cache->m_numFrames]), count );
+}
+
+
+/// \brief	Takes the most recently freed frame out of the given magazine.
+///
+/// \param cache	the magazine. The caller must hold its lock.
+///
+/// \retval phys_addr_t	the frame.
+/// \retval PHYS_NULL	the magazine is empty.
+static inline phys_addr_t PmmFrameCache_pop( PmmProcessorFrameCache* cache )
+{
+	return (cache->m_numFrames > 0) ? cache->m_frames[--cache->m_numFrames] : PHYS_NULL;
+}
+
+
+/// \brief	Takes the most recently freed frame of the given colour out of the given magazine.
+///
+/// \param cache		the magazine. The caller must hold its lock.
+/// \param colour		the colour to look for.
+/// \param numColours	the number of colours.
+///
+/// A magazine is small enough that searching it is much cheaper than taking the global pool's lock.
+///
+/// \retval phys_addr_t	the frame.
+/// \retval PHYS_NULL	there are no frames of that colour in the magazine.
+static phys_addr_t PmmFrameCache_popColour(
+	PmmProcessorFrameCache*	cache,
+	size_t					colour,
+	size_t					numColours
+)
+{
+	for (size_t i = cache->m_numFrames; i > 0; i--)
+	{
+		phys_addr_t frameAddr = cache->m_frames[i - 1];
+		if (MM_getFrameColour( MM_getFrameNumber( frameAddr ), numColours ) == colour)
+		{
+			// The order of the frames in a magazine doesn't matter, so fill the hole with the top.
+			cache->m_frames[i - 1] = cache->m_frames[--cache->m_numFrames];
+			return frameAddr;
+		}
+	}
+	return PHYS_NULL;
+}
+
+
+/// \brief	Tries to take a frame from some other processor's magazine.
+///
+/// \param this	the PmmFrameCache.
+///
+/// This is only done as a last resort when the global pool is empty.
+///
+/// \retval phys_addr_t	a frame taken from another magazine.
+/// \retval PHYS_NULL	every magazine is empty.
+static phys_addr_t PmmFrameCache_raid( volatile PmmFrameCache* this )
+{
+	phys_addr_t frameAddr = PHYS_NULL;
+
+	for (size_t i = 0; (i < PROCESSOR_MAX_COUNT) && (frameAddr == PHYS_NULL); i++)
+	{
+		volatile PmmProcessorFrameCache* victim = &(this->m_caches[i]);
+
+		Lock_acquire( &(victim->m_lock) );
+		PmmProcessorFrameCache* lockedVictim = (PmmProcessorFrameCache*) victim;
+
+		frameAddr = PmmFrameCache_pop( lockedVictim );
+
+		Lock_release( &(victim->m_lock) );
+	}
+	return frameAddr;
+}
+
+
+
+/// \brief	Interface dispatch table for PmmFrameCache's implementation of IPmmAllocator.
+static IPmmAllocator_itable s_itable =
+{
+	(IPmmAllocator_allocateFunc) PmmFrameCache_allocate,
+	(IPmmAllocator_freeFunc) PmmFrameCache_free,
+	(IPmmAllocator_allocateManyFunc) PmmFrameCache_allocateMany,
+	(IPmmAllocator_freeManyFunc) PmmFrameCache_freeMany
+};
+
+
+
+// Public functions
+
+void PmmFrameCache_init( PmmFrameCache* cache, IPmmAllocator globalPool )
+{
+	KDebug_assertArg( cache != NULL );
+
+	cache->m_globalPool		= globalPool;
+	cache->m_numColours		= MM_getNumCacheColours();
+
+	for (size_t i = 0; i < PROCESSOR_MAX_COUNT; i++)
+	{
+		cache->m_caches[i].m_numFrames	= 0;
+		cache->m_caches[i].m_lock		= Lock_create();
+	}
+}
+
+
+phys_addr_t PmmFrameCache_allocate( volatile PmmFrameCache* this, void* colourHint )
+{
+	KDebug_assertArg( this != NULL );
+
+	// Note that m_numColours never changes after init(), so there is no need to lock it.
+	size_t numColours = this->m_numColours;
+	bool useColours = (colourHint != NULL) && (numColours > 1);
+
+	phys_addr_t frameAddr = PHYS_NULL;
+	volatile PmmProcessorFrameCache* cache = PmmFrameCache_getLocalCache( this );
+
+	Lock_acquire( &(cache->m_lock) );
+	PmmProcessorFrameCache* lockedCache = (PmmProcessorFrameCache*) cache;
+
+	if (lockedCache->m_numFrames == 0)
+	{
+		PmmFrameCache_refill( this, lockedCache, FRAME_CACHE_BATCH_SIZE );
+	}
+
+	frameAddr = useColours
+		? PmmFrameCache_popColour( lockedCache, MM_getPageColour( colourHint, numColours ), numColours )
+		: PmmFrameCache_pop( lockedCache );
+
+	Lock_release( &(cache->m_lock) );
+
+	if (useColours && (frameAddr == PHYS_NULL))
+	{
+		// There is no frame of the right colour in the magazine. The global pool keeps track of
+		// colours, so it can find the closest match. If it is empty, any colour will do.
+		IPmmAllocator globalPool = this->m_globalPool;
+		frameAddr = globalPool.iptr->allocate( globalPool.obj, colourHint );
+
+		if (frameAddr == PHYS_NULL)
+		{
+			Lock_acquire( &(cache->m_lock) );
+			frameAddr = PmmFrameCache_pop( (PmmProcessorFrameCache*) cache );
+			Lock_release( &(cache->m_lock) );
+		}
+	}
+
+	// Don't raid while holding our own lock, or two processors raiding each other would deadlock.
+	if (frameAddr == PHYS_NULL)
+	{
+		frameAddr = PmmFrameCache_raid( this );
+	}
+	return frameAddr;
+}
+
+
+void PmmFrameCache_free( volatile PmmFrameCache* this, phys_addr_t frameAddr )
+{
+	KDebug_assertArg( this != NULL );
+	KDebug_assertArg( frameAddr != PHYS_NULL );
+	KDebug_assertArg( MM_isFrameAligned( frameAddr ) );
+
+	volatile PmmProcessorFrameCache* cache = PmmFrameCache_getLocalCache( this );
+
+	Lock_acquire( &(cache->m_lock) );
+	PmmProcessorFrameCache* lockedCache = (PmmProcessorFrameCache*) cache;
+
+	// There is always room, since the magazine is spilled before it can fill up.
+	KDebug_assert( lockedCache->m_numFrames < FRAME_CACHE_CAPACITY );
+	lockedCache->m_frames[lockedCache->m_numFrames++] = MM_alignToFrame( frameAddr );
+
+	if (lockedCache->m_numFrames > FRAME_CACHE_HIGH_WATER)
+	{
+		PmmFrameCache_spill( this, lockedCache, FRAME_CACHE_BATCH_SIZE );
+	}
+
+	Lock_release( &(cache->m_lock) );
+}
+
+
+size_t PmmFrameCache_allocateMany(
+	volatile PmmFrameCache*	this,
+	phys_addr_t*			frameAddrs,
+	size_t					numFrames,
+	void*					colourHint
+)
+{
+	KDebug_assertArg( this != NULL );
+	KDebug_assertArg( (frameAddrs != NULL) || (numFrames == 0) );
+
+	size_t numColours = this->m_numColours;
+	bool useColours = (colourHint != NULL) && (numColours > 1);
+	uint8_t* pageAddr = (uint8_t*) colourHint;
+
+	size_t numAllocated = 0;
+	IPmmAllocator globalPool = this->m_globalPool;
+	volatile PmmProcessorFrameCache* cache = PmmFrameCache_getLocalCache( this );
+
+	// Take frames from the local magazine for as long as it has the colours that the caller asked
+	// for, then go straight to the global pool for the rest. There is no point in refilling the
+	// magazine just to empty it again.
+	Lock_acquire( &(cache->m_lock) );
+	PmmProcessorFrameCache* lockedCache = (PmmProcessorFrameCache*) cache;
+
+	while (numAllocated < numFrames)
+	{
+		phys_addr_t frameAddr = useColours
+			? PmmFrameCache_popColour(
+				lockedCache,
+				MM_getPageColour( pageAddr + (numAllocated * PAGE_SIZE), numColours ),
+				numColours
+			)
+			: PmmFrameCache_pop( lockedCache );
+
+		if (frameAddr == PHYS_NULL)
+		{
+			break;
+		}
+		frameAddrs[numAllocated++] = frameAddr;
+	}
+
+	Lock_release( &(cache->m_lock) );
+
+	numAllocated += globalPool.iptr->allocateMany(
+		globalPool.obj,
+		frameAddrs + numAllocated,
+		numFrames - numAllocated,
+		useColours ? pageAddr + (numAllocated * PAGE_SIZE) : NULL
+	);
+
+	if (useColours && (numAllocated < numFrames))
+	{
+		// The global pool is empty, so settle for whatever colours are left in the magazine.
+		Lock_acquire( &(cache->m_lock) );
+		lockedCache = (PmmProcessorFrameCache*) cache;
+
+		while ((numAllocated < numFrames) && (lockedCache->m_numFrames > 0))
+		{
+			frameAddrs[numAllocated++] = PmmFrameCache_pop( lockedCache );
+		}
+
+		Lock_release( &(cache->m_lock) );
+	}
+
+	while (numAllocated < numFrames)
+	{
+		phys_addr_t frameAddr = PmmFrameCache_raid( this );
+		if (frameAddr == PHYS_NULL)
+		{
+			break;
+		}
+		frameAddrs[numAllocated++] = frameAddr;
+	}
+	return numAllocated;
+}
+
+
+void PmmFrameCache_freeMany(
+	volatile PmmFrameCache*	this,
+	const phys_addr_t*		frameAddrs,
+	size_t					numFrames
+)
+{
+	KDebug_assertArg( this != NULL );
+	KDebug_assertArg( (frameAddrs != NULL) || (numFrames == 0) );
+
+	size_t numCached = 0;
+	volatile PmmProcessorFrameCache* cache = PmmFrameCache_getLocalCache( this );
+
+	// Top up the local magazine to its high-water mark, then send the rest to the global pool.
+	Lock_acquire( &(cache->m_lock) );
+	PmmProcessorFrameCache* lockedCache = (PmmProcessorFrameCache*) cache;
+
+	while ((numCached < numFrames) && (lockedCache->m_numFrames < FRAME_CACHE_HIGH_WATER))
+	{
+		KDebug_assertArg( frameAddrs[numCached] != PHYS_NULL );
+		KDebug_assertArg( MM_isFrameAligned( frameAddrs[numCached] ) );
+		lockedCache->m_frames[lockedCache->m_numFrames++] = MM_alignToFrame( frameAddrs[numCached] );
+		numCached++;
+	}
+
+	Lock_release( &(cache->m_lock) );
+
+	IPmmAllocator globalPool = this->m_globalPool;
+	globalPool.iptr->freeMany( globalPool.obj, frameAddrs + numCached, numFrames - numCached );
+}
+
+
+void PmmFrameCache_drainAll( volatile PmmFrameCache* this )
+{
+	KDebug_assertArg( this != NULL );
+
+	for (size_t i = 0; i < PROCESSOR_MAX_COUNT; i++)
+	{
+		volatile PmmProcessorFrameCache* cache = &(this->m_caches[i]);
+
+		Lock_acquire( &(cache->m_lock) );
+		PmmProcessorFrameCache* lockedCache = (PmmProcessorFrameCache*) cache;
+
+		PmmFrameCache_spill( this, lockedCache, lockedCache->m_numFrames );
+
+		Lock_release( &(cache->m_lock) );
+	}
+}
+
+
+IPmmAllocator PmmFrameCache_getAsPmmAllocator( volatile PmmFrameCache* cache )
+{
+	IPmmAllocator iAllocator;
+	iAllocator.obj	= cache;		// Point to the given object.
+	iAllocator.iptr	= &s_itable;	// Point at the right interface dispatch table.
+	return iAllocator;
+}
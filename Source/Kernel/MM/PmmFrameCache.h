@@ -0,0 +1,231 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/MM/PmmFrameCache.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/Apr/16
+//
+// ===========================================================================
+///
+/// \file
+///
+/// \brief	Defines the PmmFrameCache class, which keeps a small stack of free
+///			frames for each processor in front of another IPmmAllocator.
+///
+/// The allocators that track every frame are shared by all processors. The
+/// PageFrameDatabase serializes every call behind one QueueLock, and every
+/// call to the PmmBitmapAllocator does a CAS on a shared bitmap block. On an
+/// MP system, these cache lines would bounce between processors on every
+/// allocation. The frame cache avoids this by giving each processor its own
+/// stack of free frames (a "magazine"). The common allocate and free paths
+/// only touch the current processor's magazine.
+///
+/// When a magazine runs dry, it is refilled with a batch of frames from the
+/// underlying allocator (the "global pool"). When frees push a magazine past
+/// its high-water mark, a batch of frames is spilled back to the global pool
+/// so that other processors can get at them. If the global pool itself runs
+/// dry, the other processors' magazines are raided before giving up, so that
+/// frames are never stranded in a cache while an allocation fails.
+///
+/// Frames in a magazine are still allocated as far as the global pool is
+/// concerned. Call PmmFrameCache_drainAll() before asking the global pool
+/// anything that depends on exactly which frames are free.
+///
+// ===========================================================================
+
+#ifndef _KERNEL_MM_PMMFRAMECACHE_H_
+#define _KERNEL_MM_PMMFRAMECACHE_H_
+
+
+#include <stddef.h>
+#include "Kernel/MM/IPmmAllocator.h"
+#include "Kernel/MM/MM.h"
+#include "Kernel/HAL/Lock.h"
+#include "Kernel/HAL/Processor.h"
+
+
+// Public constants
+
+/// \brief	Defines constants for the implementation of PmmFrameCache.
+enum PmmFrameCache_consts
+{
+	FRAME_CACHE_CAPACITY = 64,		///< Maximum number of frames in each processor's magazine.
+	FRAME_CACHE_BATCH_SIZE = 16,	///< Number of frames moved at once to or from the pool.
+
+	/// \brief	When a free leaves more than this many frames in a magazine, a batch is spilled
+	///			back to the global pool.
+	FRAME_CACHE_HIGH_WATER = FRAME_CACHE_CAPACITY - FRAME_CACHE_BATCH_SIZE
+};
+
+
+
+/// \brief	Defines the fields of a single processor's magazine.
+typedef struct PmmProcessorFrameCache
+{
+#ifdef _KERNEL_MM_PMMFRAMECACHE_C_
+
+	/// \brief	Stack of free frames.
+	phys_addr_t m_frames[FRAME_CACHE_CAPACITY];
+
+	/// \brief	The number of frames currently on the stack.
+	size_t m_numFrames;
+
+	/// \brief	Synchronizes access to the magazine.
+	///
+	/// The lock is only contended when another processor is raiding this magazine, so acquiring
+	/// it does not cause cache-line bouncing in the common case. It also protects the magazine
+	/// from interrupt handlers on the owning processor.
+	Lock m_lock;
+
+#else
+
+	#ifndef DOXYGEN_SHOULD_SKIP_THIS
+	phys_addr_t	m_reserved0[FRAME_CACHE_CAPACITY];
+	size_t		m_reserved1;
+	Lock		m_reserved2;
+	#endif
+
+#endif
+} PmmProcessorFrameCache;
+
+
+
+/// \brief	Defines the fields of PmmFrameCache.
+typedef struct PmmFrameCache
+{
+#ifdef _KERNEL_MM_PMMFRAMECACHE_C_
+
+	/// \brief	The global pool of frames from which the magazines are refilled.
+	IPmmAllocator m_globalPool;
+
+	/// \brief	The number of cache colours, as returned by MM_getNumCacheColours().
+	size_t m_numColours;
+
+	/// \brief	One magazine per processor, indexed by processor ID.
+	PmmProcessorFrameCache m_caches[PROCESSOR_MAX_COUNT];
+
+#else
+
+	#ifndef DOXYGEN_SHOULD_SKIP_THIS
+	IPmmAllocator			m_reserved0;
+	size_t					m_reserved1;
+	PmmProcessorFrameCache	m_reserved2[PROCESSOR_MAX_COUNT];
+	#endif
+
+#endif
+} PmmFrameCache;
+
+
+
+/// \brief	Initializes the given PmmFrameCache.
+///
+/// \param cache		the PmmFrameCache to initialize.
+/// \param globalPool	the allocator that the cache will sit in front of. It must be thread-safe.
+///
+/// Unlike most classes, PmmFrameCache is initialized in place rather than returned by value,
+/// since it is fairly large.
+///
+/// In checked builds, a bugcheck will occur if \a cache is NULL.
+///
+/// The initial state of the cache is that every magazine is empty.
+void PmmFrameCache_init( PmmFrameCache* cache, IPmmAllocator globalPool );
+
+
+/// \brief	Implementation of IPmmAllocator_allocate().
+///
+/// \param this			the cache from which to allocate.
+/// \param colourHint	the colour hint; NULL means no preference.
+///
+/// If \a colourHint is not NULL, the current processor's magazine is searched for a frame of the
+/// right colour first. If there isn't one, the frame is claimed from the global pool, which can
+/// find the closest colour. Any frame in a magazine is used if the pool is empty.
+///
+/// This method is thread-safe. In the common case, it only touches the current processor's
+/// magazine.
+///
+/// \retval phys_addr_t	the physical address of the frame just allocated; Guaranteed to be
+///						page-aligned.
+/// \retval PHYS_NULL	there are no more free frames, either in the global pool or in any
+///						magazine.
+phys_addr_t PmmFrameCache_allocate( volatile PmmFrameCache* this, void* colourHint );
+
+
+/// \brief	Implementation of IPmmAllocator_free().
+///
+/// \param this			the cache to which to free.
+/// \param frameAddr	the physical address of the frame to free.
+///
+/// In checked builds, a bugcheck will occur if \a frameAddr is PHYS_NULL or not page-aligned.
+/// Other checks are deferred until the frame reaches the global pool.
+///
+/// This method is thread-safe. In the common case, it only touches the current processor's
+/// magazine.
+void PmmFrameCache_free( volatile PmmFrameCache* this, phys_addr_t frameAddr );
+
+
+/// \brief	Implementation of IPmmAllocator_allocateMany().
+///
+/// \param this			the cache from which to allocate.
+/// \param frameAddrs	receives the physical addresses of the frames allocated.
+/// \param numFrames	the number of frames to allocate.
+/// \param colourHint	the colour hint; NULL means no preference.
+///
+/// The current processor's magazine is emptied first, and the rest of the frames are claimed
+/// from the global pool in bulk. If \a colourHint is not NULL, frames are only taken from the
+/// magazine for as long as it has the colour wanted for the next page, and the rest come from the
+/// global pool with the matching hint.
+///
+/// This method is thread-safe.
+///
+/// \return the number of frames actually allocated.
+size_t PmmFrameCache_allocateMany(
+	volatile PmmFrameCache*	this,
+	phys_addr_t*			frameAddrs,
+	size_t					numFrames,
+	void*					colourHint
+);
+
+
+/// \brief	Implementation of IPmmAllocator_freeMany().
+///
+/// \param this			the cache to which to free.
+/// \param frameAddrs	the physical addresses of the frames to free.
+/// \param numFrames	the number of frames to free.
+///
+/// The current processor's magazine is filled up to its high-water mark, and the rest of the
+/// frames are returned to the global pool in bulk.
+///
+/// This method is thread-safe.
+void PmmFrameCache_freeMany(
+	volatile PmmFrameCache*	this,
+	const phys_addr_t*		frameAddrs,
+	size_t					numFrames
+);
+
+
+/// \brief	Returns every frame in every magazine to the global pool.
+///
+/// \param this	the PmmFrameCache.
+///
+/// This is useful when the caller needs an accurate picture of the global pool, for example
+/// before looking for a run of contiguous frames.
+///
+/// This method is thread-safe.
+void PmmFrameCache_drainAll( volatile PmmFrameCache* this );
+
+
+/// \brief	Gets a reference to the IPmmAllocator implementation of the given PmmFrameCache.
+///
+/// \param cache the PmmFrameCache instance.
+///
+/// \return the IPmmAllocator interface that \a cache implements.
+IPmmAllocator PmmFrameCache_getAsPmmAllocator( volatile PmmFrameCache* cache );
+
+
+#endif
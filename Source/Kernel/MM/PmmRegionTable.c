@@ -0,0 +1,437 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/Kernel/MM/PmmRegionTable.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/Apr/23
+//
+// ===========================================================================
+///
+///	\file
+///
+/// \brief	Contains the implementation of the PmmRegionTable class and its
+///			IPmmRegionList enumerator.
+///
+// ===========================================================================
+
+
+#include "Kernel/KCommon/KDebug.h"
+#include "Kernel/KCommon/KMem.h"
+
+#define _KERNEL_MM_PMMREGIONTABLE_C_
+#include "Kernel/MM/PmmRegionTable.h"
+
+
+// Private functions
+
+/// \brief	Inserts a new entry at the given index, shifting the entries above it up by one.
+///
+/// \param table	the PmmRegionTable.
+/// \param index	where to insert the entry.
+/// \param base		the address of the first byte of the new entry.
+/// \param last		the address of the last byte of the new entry.
+/// \param type		the type of the new entry.
+///
+/// \retval true	the entry was inserted.
+/// \retval false	the table is full.
+static bool PmmRegionTable_insertAt(
+	PmmRegionTable*	table,
+	size_t			index,
+	phys_addr_t		base,
+	phys_addr_t		last,
+	uint8_t			type
+)
+{
+	KDebug_assert( index <= table->m_numEntries );
+	KDebug_assert( base <= last );
+
+	if (table->m_numEntries == MAX_REGION_TABLE_ENTRIES)
+	{
+		return false;
+	}
+
+	KMem_move(
+		&(table->m_entries[index + 1]),
+		&(table->m_entries[index]),
+		(table->m_numEntries - index) * sizeof( PmmRegionTableEntry )
+	);
+	table->m_numEntries++;
+
+	PmmRegionTableEntry* entry = &(table->m_entries[index]);
+	entry->m_base	= base;
+	entry->m_last	= last;
+	entry->m_type	= type;
+	return true;
+}
+
+
+/// \brief	Fills a gap between entries with a new entry.
+///
+/// \param table	the PmmRegionTable.
+/// \param index	the index of the entry just above the gap.
+/// \param base		the address of the first byte of the gap.
+/// \param last		the address of the last byte of the gap.
+/// \param type		the type of the new entry.
+///
+/// If the gap can simply be merged into the entry just below it, no new entry is created. This
+/// keeps the table from filling up with fragments that would only be coalesced later.
+///
+/// \retval true	the gap was filled.
+/// \retval false	the table is full.
+static bool PmmRegionTable_fillGap(
+	PmmRegionTable*	table,
+	size_t			index,
+	phys_addr_t		base,
+	phys_addr_t		last,
+	uint8_t			type
+)
+{
+	if (index > 0)
+	{
+		PmmRegionTableEntry* prev = &(table->m_entries[index - 1]);
+		if ((prev->m_type == type) && (prev->m_last + 1 == base))
+		{
+			prev->m_last = last;
+			return true;
+		}
+	}
+	return PmmRegionTable_insertAt( table, index, base, last, type );
+}
+
+
+/// \brief	Merges adjacent entries of the same type.
+///
+/// \param table	the PmmRegionTable.
+static void PmmRegionTable_coalesce( PmmRegionTable* table )
+{
+	if (table->m_numEntries == 0)
+	{
+		return;
+	}
+
+	size_t numKept = 1;
+	for (size_t i = 1; i < table->m_numEntries; i++)
+	{
+		PmmRegionTableEntry* prev	= &(table->m_entries[numKept - 1]);
+		PmmRegionTableEntry* crnt	= &(table->m_entries[i]);
+
+		if ((prev->m_type == crnt->m_type) && (prev->m_last + 1 == crnt->m_base))
+		{
+			prev->m_last = crnt->m_last;
+		}
+		else
+		{
+			table->m_entries[numKept++] = *crnt;
+		}
+	}
+	table->m_numEntries = numKept;
+}
+
+
+/// \brief	Adds every region in the given list to the table.
+///
+/// \param table	the PmmRegionTable.
+/// \param list		the regions to add.
+/// \param type		the type of the regions in \a list.
+///
+/// \retval true	all the regions were added.
+/// \retval false	the table filled up.
+static bool PmmRegionTable_addList( PmmRegionTable* table, IPmmRegionList list, PmmRegionType type )
+{
+	bool succeeded = true;
+
+	list.iptr->reset( list.obj );
+	while (list.iptr->moveNext( list.obj ))
+	{
+		PmmRegion crnt = list.iptr->getCurrent( list.obj );
+		succeeded = PmmRegionTable_add( table, crnt, type ) && succeeded;
+	}
+	return succeeded;
+}
+
+
+/// \brief	Resets the iterator to the position before the first element (if any).
+///
+/// \param list the PmmRegionTableList.
+static void PmmRegionTableList_reset( PmmRegionTableList* list )
+{
+	KDebug_assertArg( list != NULL );
+	list->m_next	= 0;
+	list->m_current	= REGION_TABLE_NOT_FOUND;
+}
+
+
+/// \brief	Attempts to advance the iterator forward to the next entry of a selected type.
+///
+/// \param list the PmmRegionTableList.
+///
+/// \retval true	the iterator advanced to the next valid position.
+/// \retval false	the iterator advanced beyond the last valid position, the iterator was already
+///					beyond the last valid position, or the list is empty.
+static bool PmmRegionTableList_moveNext( PmmRegionTableList* list )
+{
+	KDebug_assertArg( list != NULL );
+
+	const PmmRegionTable* table = list->m_table;
+
+	while (list->m_next < table->m_numEntries)
+	{
+		size_t index = list->m_next++;
+		if ((table->m_entries[index].m_type & list->m_typeMask) != 0)
+		{
+			list->m_current = index;
+			return true;
+		}
+	}
+
+	list->m_next	= MAX_REGION_TABLE_ENTRIES;
+	list->m_current	= REGION_TABLE_NOT_FOUND;
+	return false;
+}
+
+
+/// \brief	Returns the PmmRegion at the current position in the list.
+///
+/// \param list the PmmRegionTableList.
+///
+/// If the iterator is not currently on a valid position, this method will cause a bugcheck in
+/// checked builds and will probably cause a system failure in free builds.
+///
+/// \return the PmmRegion at the current position in the list.
+static PmmRegion PmmRegionTableList_getCurrent( const PmmRegionTableList* list )
+{
+	KDebug_assertArg( list != NULL );
+	KDebug_assert( list->m_current < list->m_table->m_numEntries );
+
+	PmmRegion region;
+	PmmRegionTable_getEntry( list->m_table, list->m_current, &region );
+	return region;
+}
+
+
+
+/// \brief	Interface dispatch table for PmmRegionTableList's implementation of IPmmRegionList.
+static IPmmRegionList_itable s_itable =
+{
+	(IPmmRegionList_resetFunc) PmmRegionTableList_reset,
+	(IPmmRegionList_moveNextFunc) PmmRegionTableList_moveNext,
+	(IPmmRegionList_getCurrentFunc) PmmRegionTableList_getCurrent
+};
+
+
+
+// Public functions
+
+bool PmmRegionTable_init(
+	PmmRegionTable*	table,
+	IPmmRegionList	ramList,
+	IPmmRegionList	reservedList,
+	IPmmRegionList	moduleList
+)
+{
+	KDebug_assertArg( table != NULL );
+
+	table->m_numEntries = 0;
+
+	// The order doesn't matter for correctness, since add() resolves overlaps by precedence.
+	// Adding the highest-precedence regions first just means that the RAM regions get split
+	// around them as they go in, instead of being split up after the fact.
+	bool succeeded = PmmRegionTable_addList( table, moduleList, PMMREGION_MODULE );
+	succeeded = PmmRegionTable_addList( table, reservedList, PMMREGION_RESERVED ) && succeeded;
+	succeeded = PmmRegionTable_addList( table, ramList, PMMREGION_RAM ) && succeeded;
+	return succeeded;
+}
+
+
+bool PmmRegionTable_add( PmmRegionTable* table, PmmRegion region, PmmRegionType type )
+{
+	KDebug_assertArg( table != NULL );
+	KDebug_assertArg(
+		(type == PMMREGION_RAM) || (type == PMMREGION_RESERVED) || (type == PMMREGION_MODULE)
+	);
+
+	phys_addr_t cursor	= PmmRegion_base( &region );
+	phys_addr_t last	= PmmRegion_last( &region );
+
+	size_t i = PmmRegionTable_find( table, cursor );
+	if (i == REGION_TABLE_NOT_FOUND)
+	{
+		i = table->m_numEntries;
+	}
+
+	// Walk the new region from bottom to top. Every entry visited either wins or loses the part
+	// of the new region that it overlaps; the gaps between entries always go to the new region.
+	bool succeeded = true;
+	bool done = false;
+	while (!done && succeeded)
+	{
+		if ((i == table->m_numEntries) || (table->m_entries[i].m_base > last))
+		{
+			// Nothing else overlaps, so the rest of the new region fills the gap.
+			succeeded = PmmRegionTable_fillGap( table, i, cursor, last, type );
+			done = true;
+			continue;
+		}
+
+		PmmRegionTableEntry* entry = &(table->m_entries[i]);
+
+		if (entry->m_base > cursor)
+		{
+			// Fill the gap below the next entry. It may have moved, so find it again afterwards.
+			phys_addr_t nextBase = entry->m_base;
+			succeeded = PmmRegionTable_fillGap( table, i, cursor, nextBase - 1, type );
+			cursor = nextBase;
+			i = PmmRegionTable_find( table, cursor );
+			continue;
+		}
+
+		KDebug_assert( (entry->m_base <= cursor) && (cursor <= entry->m_last) );
+
+		if (entry->m_type >= type)
+		{
+			// The existing entry wins.
+			if (entry->m_last >= last)
+			{
+				done = true;
+			}
+			else
+			{
+				cursor = entry->m_last + 1;
+				i++;
+			}
+		}
+		else if (entry->m_base < cursor)
+		{
+			// The new region wins, but only from the cursor up. Split off the bottom of the existing
+			// entry so that the rest of it can be handled on the next pass.
+			phys_addr_t entryLast = entry->m_last;
+			succeeded = PmmRegionTable_insertAt( table, i + 1, cursor, entryLast, entry->m_type );
+			if (succeeded)
+			{
+				table->m_entries[i].m_last = cursor - 1;
+				i++;
+			}
+		}
+		else if (entry->m_last <= last)
+		{
+			// The new region covers the whole existing entry.
+			entry->m_type = type;
+			if (entry->m_last == last)
+			{
+				done = true;
+			}
+			else
+			{
+				cursor = entry->m_last + 1;
+				i++;
+			}
+		}
+		else
+		{
+			// The new region covers the bottom of the existing entry. Split off the top.
+			succeeded = PmmRegionTable_insertAt(
+				table,
+				i + 1,
+				last + 1,
+				entry->m_last,
+				entry->m_type
+			);
+			if (succeeded)
+			{
+				table->m_entries[i].m_last = last;
+				table->m_entries[i].m_type = type;
+			}
+			done = true;
+		}
+	}
+
+	PmmRegionTable_coalesce( table );
+	return succeeded;
+}
+
+
+size_t PmmRegionTable_getNumEntries( const PmmRegionTable* table )
+{
+	KDebug_assertArg( table != NULL );
+	return table->m_numEntries;
+}
+
+
+PmmRegionType PmmRegionTable_getEntry(
+	const PmmRegionTable*	table,
+	size_t					index,
+	PmmRegion*				region
+)
+{
+	KDebug_assertArg( table != NULL );
+	KDebug_assertArg( index < table->m_numEntries );
+
+	const PmmRegionTableEntry* entry = &(table->m_entries[index]);
+	if (region != NULL)
+	{
+		*region = PmmRegion_create( entry->m_base, entry->m_last - entry->m_base + 1 );
+	}
+	return (PmmRegionType) entry->m_type;
+}
+
+
+size_t PmmRegionTable_find( const PmmRegionTable* table, phys_addr_t addr )
+{
+	KDebug_assertArg( table != NULL );
+
+	// Find the first entry whose last byte is at or above addr.
+	size_t low	= 0;
+	size_t high	= table->m_numEntries;
+	while (low < high)
+	{
+		size_t mid = low + ((high - low) / 2);
+		if (table->m_entries[mid].m_last < addr)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+	return (low < table->m_numEntries) ? low : REGION_TABLE_NOT_FOUND;
+}
+
+
+PmmRegionType PmmRegionTable_lookup( const PmmRegionTable* table, phys_addr_t addr )
+{
+	size_t index = PmmRegionTable_find( table, addr );
+	if ((index == REGION_TABLE_NOT_FOUND) || (table->m_entries[index].m_base > addr))
+	{
+		return PMMREGION_NONE;
+	}
+	return (PmmRegionType) table->m_entries[index].m_type;
+}
+
+
+PmmRegionTableList PmmRegionTableList_create( const PmmRegionTable* table, uint8_t typeMask )
+{
+	KDebug_assertArg( table != NULL );
+
+	PmmRegionTableList list;
+	list.m_table	= table;
+	list.m_typeMask	= typeMask;
+	list.m_next		= MAX_REGION_TABLE_ENTRIES;
+	list.m_current	= REGION_TABLE_NOT_FOUND;
+	return list;
+}
+
+
+IPmmRegionList PmmRegionTableList_getAsPmmRegionList( PmmRegionTableList* list )
+{
+	IPmmRegionList ilist;
+	ilist.obj	= list;			// Point to the given object.
+	ilist.iptr	= &s_itable;	// Point at the right interface dispatch table.
+	return ilist;
+}
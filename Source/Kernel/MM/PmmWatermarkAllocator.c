@@ -30,6 +30,42 @@
 
 // Private functions
 
+/// \brief	Converts the given page-aligned region into a run of frames, leaving out the very first
+///			frame of the physical address space.
+///
+/// \param region			a page-aligned region, as produced by PmmRegion_makePageAligned().
+/// \param firstFrameAddr	receives the physical address of the first frame in the run.
+/// \param numFrames		receives the number of frames in the run.
+///
+/// The frame at PHYS_NULL is never handed out, so it is always left out of the run.
+///
+/// \retval true	the run has at least one frame in it.
+/// \retval false	the region only covers the frame at PHYS_NULL.
+static bool PmmWatermarkAllocator_getFrameRange(
+	const PmmRegion*	region,
+	phys_addr_t*		firstFrameAddr,
+	size_t*				numFrames
+)
+{
+	size_t firstFrame	= MM_getFrameNumber( PmmRegion_base( region ) );
+	size_t lastFrame	= MM_getFrameNumber( PmmRegion_last( region ) );
+
+	// Special case for the very first frame. Trying to allocate or free it might cause a bugcheck.
+	if (firstFrame == 0)
+	{
+		if (lastFrame == 0)
+		{
+			return false;
+		}
+		firstFrame = 1;
+	}
+
+	*firstFrameAddr	= MM_getFrameAddress( firstFrame );
+	*numFrames		= lastFrame - firstFrame + 1;
+	return true;
+}
+
+
 /// \brief	Finds any frames in the current region that overlap with the given region and allocates
 ///			them.
 ///
@@ -50,29 +86,19 @@ static void PmmWatermarkAllocator_allocateRegion( PmmWatermarkAllocator* this, P
 	// fails, that means the two regions do not overlap, so there is nothing to allocate.
 	if (PmmRegion_clip( &region, this->m_currentRegion ))
 	{
-		// There is something to allocate. Create an initial frame-sized region and keep advancing
-		// it until we are outside of the region to allocate.
-		PmmRegion frameRegion = PmmRegion_create( PmmRegion_base( &region ), PAGE_SIZE );
-		
-		do
+		// There is something to allocate. Do it a whole bitmap block at a time. We don't really
+		// care if some of the frames have already been allocated, as long as they've been
+		// allocated once.
+		phys_addr_t firstFrameAddr;
+		size_t numFrames;
+		if (PmmWatermarkAllocator_getFrameRange( &region, &firstFrameAddr, &numFrames ))
 		{
-			phys_addr_t frameAddr = PmmRegion_base( &frameRegion );
-			
-			// Special case for the very first frame. Trying to allocate it might cause a bugcheck.
-			if (frameAddr != PHYS_NULL)
-			{
-				// Ignore the return value. We don't really care if it's already been allocated,
-				// as long as it's been allocated once.
-				PmmBitmapAllocator_allocateFrame( &(this->m_regionBitmapAllocator), frameAddr );
-			}
-			
-			// Go to the next frame. If there's no more room, we're done.
-			if (!PmmRegion_advance( &frameRegion ))
-			{
-				break;
-			}
-			
-		} while (!PmmRegion_below( &region, PmmRegion_base( &frameRegion ) ));
+			PmmBitmapAllocator_reserveFrames(
+				&(this->m_regionBitmapAllocator),
+				firstFrameAddr,
+				numFrames
+			);
+		}
 	}
 }
 
@@ -105,27 +131,17 @@ static bool PmmWatermarkAllocator_freeRegion( PmmWatermarkAllocator* this, PmmRe
 	// fails, that means the two regions do not overlap, so there is nothing to free.
 	if (PmmRegion_clip( &region, this->m_currentRegion ))
 	{
-		// There is something to free. Create an initial frame-sized region and keep advancing
-		// it until we are outside of the region to free.
-		PmmRegion frameRegion = PmmRegion_create( PmmRegion_base( &region ), PAGE_SIZE );
-		
-		do
+		// There is something to free. Do it a whole bitmap block at a time.
+		phys_addr_t firstFrameAddr;
+		size_t numFrames;
+		if (PmmWatermarkAllocator_getFrameRange( &region, &firstFrameAddr, &numFrames ))
 		{
-			phys_addr_t frameAddr = PmmRegion_base( &frameRegion );
-			
-			// Special case for the very first frame. Trying to free it might cause a bugcheck.
-			if (frameAddr != PHYS_NULL)
-			{
-				PmmBitmapAllocator_free( &(this->m_regionBitmapAllocator), frameAddr );
-			}
-			
-			// Go to the next frame. If there's no more room, we're done.
-			if (!PmmRegion_advance( &frameRegion ))
-			{
-				break;
-			}
-			
-		} while (!PmmRegion_below( &region, PmmRegion_base( &frameRegion ) ));
+			PmmBitmapAllocator_freeFrames(
+				&(this->m_regionBitmapAllocator),
+				firstFrameAddr,
+				numFrames
+			);
+		}
 
 		return true;
 	}
@@ -216,7 +232,9 @@ static bool PmmWatermarkAllocator_initCurrentRegion( PmmWatermarkAllocator* this
 static IPmmAllocator_itable s_itable =
 {
 	(IPmmAllocator_allocateFunc) PmmWatermarkAllocator_allocate,
-	(IPmmAllocator_freeFunc) PmmWatermarkAllocator_free
+	(IPmmAllocator_freeFunc) PmmWatermarkAllocator_free,
+	(IPmmAllocator_allocateManyFunc) PmmWatermarkAllocator_allocateMany,
+	(IPmmAllocator_freeManyFunc) PmmWatermarkAllocator_freeMany
 };
 
 
@@ -230,6 +248,9 @@ PmmWatermarkAllocator PmmWatermarkAllocator_create(
 )
 {
 	KDebug_assertArg( regionBitmapSpace != NULL );
+	KDebug_assert(
+		PmmBitmapAllocator_calculateSpaceInBlocks( NUM_BLOCKS ) == REGION_SPACE_IN_BLOCKS
+	);
 
 	PmmWatermarkAllocator allocator;
 	allocator.m_lock				= Lock_create();
@@ -252,9 +273,6 @@ phys_addr_t PmmWatermarkAllocator_allocate(
 )
 {
 	KDebug_assertArg( this != NULL );
-	
-	// For now, the implementation ignores the colour hint.
-	(void) colourHint;
 
 	// Even though the bitmap is lock-free, we still need to lock before using it because we might
 	// need to trash it, and we wouldn't want any other threads to be using it at the time...
@@ -262,7 +280,7 @@ phys_addr_t PmmWatermarkAllocator_allocate(
 	PmmWatermarkAllocator* lockedThis = (PmmWatermarkAllocator*) this;
 
 	phys_addr_t frameAddr =
-		PmmBitmapAllocator_allocate( &(lockedThis->m_regionBitmapAllocator), NULL );
+		PmmBitmapAllocator_allocate( &(lockedThis->m_regionBitmapAllocator), colourHint );
 		
 	while (frameAddr == PHYS_NULL)
 	{
@@ -281,7 +299,7 @@ phys_addr_t PmmWatermarkAllocator_allocate(
 		{
 			// Try again now that we have a new window to allocate from.
 			frameAddr =
-				PmmBitmapAllocator_allocate( &(lockedThis->m_regionBitmapAllocator), NULL );
+				PmmBitmapAllocator_allocate( &(lockedThis->m_regionBitmapAllocator), colourHint );
 		}
 		else
 		{
@@ -305,6 +323,68 @@ void PmmWatermarkAllocator_free( volatile PmmWatermarkAllocator* this, phys_addr
 }
 
 
+size_t PmmWatermarkAllocator_allocateMany(
+	volatile PmmWatermarkAllocator*	this,
+	phys_addr_t*					frameAddrs,
+	size_t							numFrames,
+	void*							colourHint
+)
+{
+	KDebug_assertArg( this != NULL );
+	KDebug_assertArg( (frameAddrs != NULL) || (numFrames == 0) );
+
+	Lock_acquire( &(this->m_lock) );
+	PmmWatermarkAllocator* lockedThis = (PmmWatermarkAllocator*) this;
+
+	size_t numAllocated = 0;
+	while (true)
+	{
+		// Keep the colour hint in step with the frame being allocated.
+		void* hint = (colourHint != NULL)
+			? ((uint8_t*) colourHint) + (numAllocated * PAGE_SIZE)
+			: NULL;
+
+		numAllocated += PmmBitmapAllocator_allocateMany(
+			&(lockedThis->m_regionBitmapAllocator),
+			frameAddrs + numAllocated,
+			numFrames - numAllocated,
+			hint
+		);
+
+		if (numAllocated == numFrames)
+		{
+			break;
+		}
+
+		// The current "window" is empty. Advance to the next one, unless there is no more RAM
+		// left to allocate. See PmmWatermarkAllocator_allocate() for details.
+		if (!PmmRegion_advance( &(lockedThis->m_currentRegion) ) ||
+			!PmmWatermarkAllocator_initCurrentRegion( lockedThis ))
+		{
+			break;
+		}
+	}
+
+	Lock_release( &(this->m_lock) );
+	return numAllocated;
+}
+
+
+void PmmWatermarkAllocator_freeMany(
+	volatile PmmWatermarkAllocator*	this,
+	const phys_addr_t*				frameAddrs,
+	size_t							numFrames
+)
+{
+	// This implementation does not support freeing. Ignore all the parameters.
+	(void) this;
+	(void) frameAddrs;
+	(void) numFrames;
+
+	KDebug_assert( false );
+}
+
+
 IPmmAllocator PmmWatermarkAllocator_getAsPmmAllocator( volatile PmmWatermarkAllocator* allocator )
 {
 	IPmmAllocator iAllocator;
@@ -45,6 +45,7 @@
 
 
 #include <stddef.h>
+#include <stdbool.h>
 #include "Kernel/MM/IPmmAllocator.h"
 #include "Kernel/MM/IPmmRegionList.h"
 #include "Kernel/MM/PmmRegion.h"
@@ -62,7 +63,16 @@ enum PmmWatermarkAllocator_consts
 	// be evenly divided into equal-sized "windows"!
 	
 	NUM_BLOCKS = 128,	///< Number of blocks per region (e.g. -- 16 MB on 32-bit architectures).
-	REGION_SIZE_IN_BYTES = NUM_BLOCKS * BITS_PER_BLOCK * PAGE_SIZE	///< Size of "window" in bytes.
+	REGION_SIZE_IN_BYTES = NUM_BLOCKS * BITS_PER_BLOCK * PAGE_SIZE,	///< Size of "window" in bytes.
+
+	/// \brief	Number of blocks of space needed for the region bitmap, including its summary
+	///			levels.
+	///
+	/// This is the same as PmmBitmapAllocator_calculateSpaceInBlocks( NUM_BLOCKS ), as long as
+	/// NUM_BLOCKS is more than BITS_PER_BLOCK and no more than BITS_PER_BLOCK squared (i.e. -- there
+	/// are two summary levels).
+	REGION_SPACE_IN_BLOCKS =
+		NUM_BLOCKS + ((NUM_BLOCKS + BITS_PER_BLOCK - 1) / BITS_PER_BLOCK) + 1
 };
 
 
@@ -114,7 +124,7 @@ typedef struct PmmWatermarkAllocator
 /// \param regionBitmapSpace	pointer to the array that will hold the bitmap.
 ///
 /// The caller is responsible for allocating the \a regionBitmapSpace array. It must have exactly
-/// NUM_BLOCKS elements.
+/// REGION_SPACE_IN_BLOCKS elements.
 ///
 /// \return a new PmmWatermarkAllocator instance.
 PmmWatermarkAllocator PmmWatermarkAllocator_create(
@@ -127,11 +137,13 @@ PmmWatermarkAllocator PmmWatermarkAllocator_create(
 /// \brief	Implementation of IPmmAllocator_allocate().
 ///
 /// \param this			the allocator from which to allocate.
-/// \param colourHint	the colour hint; Currently ignored by this implementation.
+/// \param colourHint	the colour hint; NULL means no preference.
 ///
-/// This method is thread-safe.
+/// The colour hint is passed on to the bitmap allocator for the current "window". The watermark
+/// allocator never moves to the next window just to find a better colour, so a matching colour
+/// is only found if one is still free in the current window.
 ///
-/// ***FIXME: Pay attention to the colour hint!
+/// This method is thread-safe.
 ///
 /// \retval phys_addr_t	the physical address of the frame just allocated; Guaranteed to be
 ///						page-aligned.
@@ -154,6 +166,44 @@ phys_addr_t PmmWatermarkAllocator_allocate(
 void PmmWatermarkAllocator_free( volatile PmmWatermarkAllocator* this, phys_addr_t frame );
 
 
+/// \brief	Implementation of IPmmAllocator_allocateMany().
+///
+/// \param this			the allocator from which to allocate.
+/// \param frameAddrs	receives the physical addresses of the frames allocated.
+/// \param numFrames	the number of frames to allocate.
+/// \param colourHint	the colour hint for the first frame; NULL means no preference.
+///
+/// Frames are claimed from the current "window" in batches using
+/// PmmBitmapAllocator_allocateMany(), moving on to the next window as needed.
+///
+/// This method is thread-safe.
+///
+/// \return the number of frames actually allocated.
+size_t PmmWatermarkAllocator_allocateMany(
+	volatile PmmWatermarkAllocator*	this,
+	phys_addr_t*					frameAddrs,
+	size_t							numFrames,
+	void*							colourHint
+);
+
+
+/// \brief	Implementation of IPmmAllocator_freeMany().
+///
+/// \param this			the allocator to which to free.
+/// \param frameAddrs	the physical addresses of the frames to free.
+/// \param numFrames	the number of frames to free.
+///
+/// The watermark allocator does not support the freeing of frames. Therefore, in checked builds
+/// this method will cause a bugcheck. In free builds, this method does nothing.
+///
+/// This method is thread-safe.
+void PmmWatermarkAllocator_freeMany(
+	volatile PmmWatermarkAllocator*	this,
+	const phys_addr_t*				frameAddrs,
+	size_t							numFrames
+);
+
+
 /// \brief	Gets a reference to the IPmmAllocator implementation of the given
 ///			PmmWatermarkAllocator.
 ///
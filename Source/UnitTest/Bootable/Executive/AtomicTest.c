@@ -64,6 +64,36 @@ void DoAtomicTest( const char* welcomeMessage, BootLoaderInfo* bootInfo )
 		update
 	);
 
+	// The explicit versions should behave the same way, whatever the order.
+	bool explicitOk = Atomic_compareAndSwapExplicit( &target, 555, 666, ATOMIC_RELAXED );
+	explicitOk = explicitOk && !Atomic_compareAndSwapExplicit( &target, 555, 777, ATOMIC_ACQUIRE );
+	explicitOk = explicitOk && (Atomic_swapExplicit( &target, 888, ATOMIC_RELEASE ) == 666);
+	Atomic_writeExplicit( &target, 999, ATOMIC_SEQ_CST );
+	Atomic_fence( ATOMIC_SEQ_CST );
+	explicitOk = explicitOk && (Atomic_readExplicit( &target, ATOMIC_RELAXED ) == 999);
+	KOut_writeLine(
+		"\nExplicit memory order test %s",
+		explicitOk ? "succeeded." : "failed!"
+	);
+
+	// Fetch-and-op returns the old value. The bit operations return the old bit.
+	bool fetchOk = (Atomic_fetchAdd( &target, 1 ) == 999);
+	fetchOk = fetchOk && (Atomic_fetchOr( &target, 0x1000 ) == 1000);
+	fetchOk = fetchOk && (Atomic_fetchAnd( &target, 0x1000 ) == 0x13E8);
+	fetchOk = fetchOk && !Atomic_bitTestAndSet( &target, 0 );
+	fetchOk = fetchOk && Atomic_bitTestAndSet( &target, 0 );
+	fetchOk = fetchOk && Atomic_bitTestAndReset( &target, 12 );
+	fetchOk = fetchOk && !Atomic_bitTestAndReset( &target, 12 );
+	fetchOk = fetchOk && (Atomic_read( &target ) == 1);
+	KOut_writeLine( "Fetch-and-op test %s", fetchOk ? "succeeded." : "failed!" );
+
+	// Make sure the high half takes part in the comparison and the update.
+	static volatile uint64_t target64 = 0x100000002ULL;
+	bool cas64Ok = !Atomic_compareAndSwap64( &target64, 0x2ULL, 0x300000004ULL );
+	cas64Ok = cas64Ok && Atomic_compareAndSwap64( &target64, 0x100000002ULL, 0x300000004ULL );
+	cas64Ok = cas64Ok && (target64 == 0x300000004ULL);
+	KOut_writeLine( "64-bit compare-and-swap test %s", cas64Ok ? "succeeded." : "failed!" );
+
 	KOut_writeLine( "\nAtomic test complete." );
 }
 
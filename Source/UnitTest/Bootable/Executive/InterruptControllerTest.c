@@ -0,0 +1,63 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include "Kernel/KRunTime/DisplayTextStream.h"
+#include "Kernel/KRunTime/KOut.h"
+#include "Kernel/KRunTime/KShutdown.h"
+#include "Kernel/HAL/InterruptController.h"
+#include "Kernel/HAL/Processor.h"
+#include "HAL/CpuFeatures.h"
+#include "HAL/Tsc.h"
+#include "ExceptionDispatcher.h"
+#include "InterruptDispatcher.h"
+#include "BootLoaderInfo.h"
+#include "TestHelpers.h"
+
+
+enum
+{
+	NUM_EOIS		= 1000,	// End-of-interrupt notifications to time.
+	KEYBOARD_IRQ	= 1		// An IRQ that every PC has, and that nothing else here uses.
+};
+
+
+void DoInterruptControllerTest( const char* welcomeMessage, BootLoaderInfo* bootInfo )
+{
+	(void) bootInfo;
+	DisplayTextStream_init();
+	KShutdown_init();
+	ExceptionDispatcher_initForCurrentProcessor();
+	InterruptDispatcher_initForCurrentProcessor();
+
+	volatile KShutdown* kshutdown = KShutdown_getInstance();
+	KShutdown_setRebootOnFailEnabled( kshutdown, false );
+
+	PrintCompyLogo();
+	KOut_writeLine( welcomeMessage );
+
+	// Interrupts are still disabled, so it's safe to cast away volatile.
+	InterruptController* pic = (InterruptController*) InterruptController_getForCurrentProcessor();
+
+	// An EOI with nothing in service is harmless on both the 8259A and the local APIC. This just
+	// shows how much cheaper one is when it's a memory write instead of port I/O.
+	if (CpuFeatures_has( CPUFEATURE_TSC ))
+	{
+		uint64_t start = Tsc_read();
+		for (int i = 0; i < NUM_EOIS; i++)
+		{
+			InterruptController_endOfInterrupt( pic, KEYBOARD_IRQ );
+		}
+		uint32_t ticks = (uint32_t) (Tsc_read() - start);
+		KOut_writeLine( "\n%d EOIs took %d TSC ticks (%s).", NUM_EOIS, ticks,
+			CpuFeatures_has( CPUFEATURE_APIC ) ? "APIC present" : "no APIC" );
+	}
+
+	// Every controller can send an IRQ to the processor that set it up, and none can send one to
+	// a processor that doesn't exist.
+	int self = Processor_getID( Processor_getCurrent() );
+	bool affinityOk = InterruptController_setAffinity( pic, KEYBOARD_IRQ, self );
+	affinityOk = affinityOk
+		&& !InterruptController_setAffinity( pic, KEYBOARD_IRQ, PROCESSOR_MAX_COUNT );
+	KOut_writeLine( "Affinity test %s", affinityOk ? "succeeded." : "failed!" );
+
+	KOut_writeLine( "\nInterrupt controller test complete." );
+}
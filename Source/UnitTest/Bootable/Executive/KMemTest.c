@@ -0,0 +1,321 @@
+#include "Kernel/KRunTime/DisplayTextStream.h"
+#include "Kernel/KRunTime/KOut.h"
+#include "Kernel/KCommon/KMem.h"
+#include "Kernel/MM/MM.h"
+#include "HAL/CpuFeatures.h"
+#include "KCommon/KMemX86.h"
+#include "TestHelpers.h"
+#include "BootLoaderInfo.h"
+
+
+// This test runs every implementation of KMem_copy(), KMem_move(), KMem_set(), KMem_clearPage(),
+// and KMem_copyPage() that the processor supports, and compares what they do against plain byte
+// loops. Each operation gets a guard zone on either side, so writing too much is caught as well
+// as writing the wrong thing.
+
+
+/// \brief	Bytes on either side of each operation that must not change.
+#define GUARD_BYTES		64
+
+/// \brief	The largest operation. SSE2 copies and fills work in 4 KB chunks, so this crosses two
+///			chunk boundaries whatever the alignment.
+#define MAX_TEST_BYTES	(2 * PAGE_SIZE + 300)
+
+/// \brief	Size of each test buffer. There is room for a guard zone on either side and for moving
+///			an operation up to a page away from where it started.
+#define BUFFER_SIZE		(GUARD_BYTES + MAX_TEST_BYTES + PAGE_SIZE + GUARD_BYTES)
+
+
+// Operation sizes. These cover the byte-only, dword, and SSE2 thresholds, one byte either side of
+// them, and one and two whole SSE2 chunks, with and without a ragged tail.
+static const size_t s_sizes[] =
+{
+	0, 1, 3, 4, 15, 16, 17, 63, 64, 65, 255, 256, 257, 1000, PAGE_SIZE - 1, PAGE_SIZE,
+	PAGE_SIZE + 1, PAGE_SIZE + 100, 2 * PAGE_SIZE, MAX_TEST_BYTES
+};
+
+// Misalignments of the source and destination. GCC puts arrays as big as the buffers below on a
+// 32-byte boundary, so these are relative to a 16-byte boundary too.
+static const size_t s_offsets[] = { 0, 1, 3, 4, 7, 15 };
+
+// How far KMem_move() moves things. Short distances make the regions overlap almost completely.
+static const size_t s_distances[] = { 1, 3, 4, 15, 16, 17, 64, 100, PAGE_SIZE };
+
+// The unit-test kernel has no VMM, so the buffers come from the kernel's bss. The page tests carve
+// page-aligned pages out of them.
+static uint8_t s_source[BUFFER_SIZE];
+static uint8_t s_dest[BUFFER_SIZE];
+static uint8_t s_expected[BUFFER_SIZE];
+
+/// \brief	The feature sets to run the test with, from slowest to fastest.
+static const struct
+{
+	const char*	m_name;		///< What the implementations are called.
+	uint32_t	m_features;	///< The features that select them.
+} s_featureSets[] =
+{
+	{ "dword", 0 },
+	{ "SSE2", CPUFEATURE_SSE2 },
+	{ "ERMSB", CPUFEATURE_SSE2 | CPUFEATURE_ERMSB }
+};
+
+
+// Fills a buffer with bytes that don't repeat every 256 (or every 4096) bytes, so that data
+// copied to the wrong place, or from the wrong place, shows up. The pointers are volatile here
+// and below so that the compiler doesn't turn the loops into calls to a C runtime we don't have.
+static void fillPattern( volatile uint8_t* buffer, size_t numBytes, uint32_t seed )
+{
+	for (size_t i = 0; i < numBytes; i++)
+	{
+		seed = (seed * 1103515245) + 12345;
+		buffer[i] = (uint8_t) (seed >> 16);
+	}
+}
+
+
+static void copyBytes( volatile uint8_t* dest, const volatile uint8_t* source, size_t numBytes )
+{
+	for (size_t i = 0; i < numBytes; i++)
+	{
+		dest[i] = source[i];
+	}
+}
+
+
+// Returns the index of the first byte that differs, or numBytes if there isn't one.
+static size_t findMismatch(
+	const volatile uint8_t*	actual,
+	const volatile uint8_t*	expected,
+	size_t					numBytes
+)
+{
+	size_t i = 0;
+	while ((i < numBytes) && (actual[i] == expected[i]))
+	{
+		i++;
+	}
+	return i;
+}
+
+
+// Returns the first page boundary in the given buffer. BUFFER_SIZE leaves at least two whole pages
+// after it, and part of a third.
+static uint8_t* getPages( uint8_t* buffer )
+{
+	return (uint8_t*) (((uintptr_t) buffer + PAGE_SIZE - 1) & ~((uintptr_t) PAGE_SIZE - 1));
+}
+
+
+static bool reportMismatch(
+	const char*	operation,
+	size_t		numBytes,
+	size_t		destOffset,
+	size_t		sourceOffset,
+	size_t		mismatch
+)
+{
+	if (mismatch < BUFFER_SIZE)
+	{
+		KOut_writeLine(
+			"\t%s failed: %d bytes, dest +%d, source +%d. Byte %d is wrong.",
+			operation,
+			numBytes,
+			destOffset,
+			sourceOffset,
+			mismatch
+		);
+		return false;
+	}
+	return true;
+}
+
+
+static bool testCopy( void )
+{
+	fillPattern( s_source, BUFFER_SIZE, 1 );
+
+	for (size_t i = 0; i < sizeof( s_sizes ) / sizeof( s_sizes[0] ); i++)
+	{
+		for (size_t d = 0; d < sizeof( s_offsets ) / sizeof( s_offsets[0] ); d++)
+		{
+			for (size_t s = 0; s < sizeof( s_offsets ) / sizeof( s_offsets[0] ); s++)
+			{
+				size_t numBytes = s_sizes[i];
+				size_t destStart = GUARD_BYTES + s_offsets[d];
+				size_t sourceStart = GUARD_BYTES + s_offsets[s];
+
+				fillPattern( s_dest, BUFFER_SIZE, 2 );
+				copyBytes( s_expected, s_dest, BUFFER_SIZE );
+				copyBytes( s_expected + destStart, s_source + sourceStart, numBytes );
+
+				KMem_copy( s_dest + destStart, s_source + sourceStart, numBytes );
+
+				size_t mismatch = findMismatch( s_dest, s_expected, BUFFER_SIZE );
+				if (!reportMismatch( "copy", numBytes, s_offsets[d], s_offsets[s], mismatch ))
+				{
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+
+static bool testSet( void )
+{
+	for (size_t i = 0; i < sizeof( s_sizes ) / sizeof( s_sizes[0] ); i++)
+	{
+		for (size_t d = 0; d < sizeof( s_offsets ) / sizeof( s_offsets[0] ); d++)
+		{
+			size_t numBytes = s_sizes[i];
+			size_t destStart = GUARD_BYTES + s_offsets[d];
+
+			// 0xA5 has its top bit set, so a fill that sign-extends the value gets caught too.
+			fillPattern( s_dest, BUFFER_SIZE, 3 );
+			copyBytes( s_expected, s_dest, BUFFER_SIZE );
+			for (size_t j = 0; j < numBytes; j++)
+			{
+				s_expected[destStart + j] = 0xA5;
+			}
+
+			KMem_set( s_dest + destStart, (char) 0xA5, numBytes );
+
+			size_t mismatch = findMismatch( s_dest, s_expected, BUFFER_SIZE );
+			if (!reportMismatch( "set", numBytes, s_offsets[d], 0, mismatch ))
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+
+// Moves part of s_dest within itself, up (backwards = true) or down, and checks the result.
+static bool testMoveOnce( size_t numBytes, size_t lowStart, size_t distance, bool backwards )
+{
+	size_t destStart	= backwards ? (lowStart + distance) : lowStart;
+	size_t sourceStart	= backwards ? lowStart : (lowStart + distance);
+
+	// Work out the answer in s_expected, going through s_source so that overlap can't matter.
+	fillPattern( s_dest, BUFFER_SIZE, 4 );
+	copyBytes( s_expected, s_dest, BUFFER_SIZE );
+	copyBytes( s_source, s_dest + sourceStart, numBytes );
+	copyBytes( s_expected + destStart, s_source, numBytes );
+
+	KMem_move( s_dest + destStart, s_dest + sourceStart, numBytes );
+
+	size_t mismatch = findMismatch( s_dest, s_expected, BUFFER_SIZE );
+	return reportMismatch(
+		backwards ? "move up" : "move down",
+		numBytes,
+		destStart - GUARD_BYTES,
+		sourceStart - GUARD_BYTES,
+		mismatch
+	);
+}
+
+
+static bool testMove( void )
+{
+	for (size_t i = 0; i < sizeof( s_sizes ) / sizeof( s_sizes[0] ); i++)
+	{
+		for (size_t k = 0; k < sizeof( s_distances ) / sizeof( s_distances[0] ); k++)
+		{
+			for (size_t o = 0; o < sizeof( s_offsets ) / sizeof( s_offsets[0] ); o++)
+			{
+				size_t lowStart = GUARD_BYTES + s_offsets[o];
+				if (
+					!testMoveOnce( s_sizes[i], lowStart, s_distances[k], true ) ||
+					!testMoveOnce( s_sizes[i], lowStart, s_distances[k], false )
+				)
+				{
+					return false;
+				}
+			}
+		}
+	}
+
+	// Moving something onto itself has to leave it alone.
+	return testMoveOnce( MAX_TEST_BYTES, GUARD_BYTES + 1, 0, true );
+}
+
+
+static bool testClearPage( void )
+{
+	// Clear the second page, and make sure the pages on either side of it are left alone.
+	uint8_t* pages = getPages( s_dest );
+
+	fillPattern( s_dest, BUFFER_SIZE, 5 );
+	copyBytes( s_expected, s_dest, BUFFER_SIZE );
+	size_t pageStart = (size_t) (pages - s_dest) + PAGE_SIZE;
+	for (size_t j = 0; j < PAGE_SIZE; j++)
+	{
+		s_expected[pageStart + j] = 0;
+	}
+
+	KMem_clearPage( s_dest + pageStart );
+
+	size_t mismatch = findMismatch( s_dest, s_expected, BUFFER_SIZE );
+	return reportMismatch( "clearPage", PAGE_SIZE, pageStart, 0, mismatch );
+}
+
+
+static bool testCopyPage( void )
+{
+	// Copy into the second page, as testClearPage() does.
+	uint8_t* destPages = getPages( s_dest );
+	uint8_t* sourcePages = getPages( s_source );
+
+	fillPattern( s_source, BUFFER_SIZE, 6 );
+	fillPattern( s_dest, BUFFER_SIZE, 7 );
+	copyBytes( s_expected, s_dest, BUFFER_SIZE );
+	size_t destStart = (size_t) (destPages - s_dest) + PAGE_SIZE;
+	copyBytes( s_expected + destStart, sourcePages, PAGE_SIZE );
+
+	KMem_copyPage( s_dest + destStart, sourcePages );
+
+	size_t mismatch = findMismatch( s_dest, s_expected, BUFFER_SIZE );
+	return reportMismatch( "copyPage", PAGE_SIZE, destStart, 0, mismatch );
+}
+
+
+void DoKMemTest( const char* welcomeMessage, BootLoaderInfo* bootInfo )
+{
+	(void) bootInfo;
+	DisplayTextStream_init();
+
+	PrintCompyLogo();
+	KOut_writeLine( welcomeMessage );
+
+	uint32_t supported = CpuFeatures_getAll();
+	bool allPassed = true;
+
+	for (size_t i = 0; i < sizeof( s_featureSets ) / sizeof( s_featureSets[0] ); i++)
+	{
+		uint32_t features = s_featureSets[i].m_features;
+		if ((features & supported) != features)
+		{
+			KOut_writeLine( "\n%s: not supported by this processor, skipped.", s_featureSets[i].m_name );
+			continue;
+		}
+
+		KOut_writeLine( "\n%s:", s_featureSets[i].m_name );
+		KMem_x86_initForFeatures( features );
+
+		bool passed = testCopy();
+		passed = testSet() && passed;
+		passed = testMove() && passed;
+		passed = testClearPage() && passed;
+		passed = testCopyPage() && passed;
+		KOut_writeLine( "\t%s", passed ? "All passed." : "FAILED!" );
+
+		allPassed = allPassed && passed;
+	}
+
+	// Go back to what the processor is best at.
+	KMem_init();
+
+	KOut_writeLine( "\nKMem tests %s", allPassed ? "succeeded." : "failed!" );
+}
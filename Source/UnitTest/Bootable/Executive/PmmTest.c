@@ -2,6 +2,7 @@
 #include "Kernel/KRunTime/KOut.h"
 #include "Kernel/KRunTime/KShutdown.h"
 #include "Kernel/MM/PhysicalMemoryManager.h"
+#include "Kernel/MM/PmmBuddyAllocator.h"
 #include "ExceptionDispatcher.h"
 #include "InterruptDispatcher.h"
 #include "BootLoaderInfo.h"
@@ -11,6 +12,17 @@
 static const int WAIT_TIME = 2;
 
 
+/// \brief	The largest number of frames that DoPfdbTest() can handle (128 MB worth).
+#define MAX_TEST_FRAMES	(128 * 1024 * 1024 / PAGE_SIZE)
+
+// The unit-test kernel has no VMM, so the PFDB's working space comes from the kernel's bss
+// instead.
+static size_t s_pfdbSpace[MAX_TEST_FRAMES * 2];
+
+// Frames allocated by DoPfdbTest(), so they can be freed again.
+static phys_addr_t s_allocatedFrames[MAX_TEST_FRAMES];
+
+
 void DoPmmTest( const char* welcomeMessage, BootLoaderInfo* bootInfo )
 {
 	DisplayTextStream_init();
@@ -52,6 +64,25 @@ void DoPmmTest( const char* welcomeMessage, BootLoaderInfo* bootInfo )
 		"\nSpace required for Physical Memory Manager: %d frames ***FIXME",
 		spaceRequiredForPmm
 	);
+
+	// Show the region table that the PMM built from the memory maps. The entries should be sorted
+	// and should never overlap.
+	volatile PhysicalMemoryManager* pmm = PhysicalMemoryManager_getInstance();
+	const PmmRegionTable* table = PhysicalMemoryManager_getRegionTable( pmm );
+
+	KOut_writeLine( "\nRegion table:" );
+	for (size_t i = 0; i < PmmRegionTable_getNumEntries( table ); i++)
+	{
+		PmmRegion region;
+		PmmRegionType type = PmmRegionTable_getEntry( table, i, &region );
+		KOut_writeLine(
+			"\t%x - %x: %s",
+			PmmRegion_base( &region ),
+			PmmRegion_last( &region ),
+			(type == PMMREGION_RAM) ? "RAM" : ((type == PMMREGION_RESERVED) ? "Reserved" : "Module")
+		);
+	}
+	busyWait( WAIT_TIME );
 	
 	// This is a test of the initial watermark allocator. We will allocate all the frames we can,
 	// displaying them one "page" at a time. As a final flourish, we will try to free one of them,
@@ -59,7 +90,6 @@ void DoPmmTest( const char* welcomeMessage, BootLoaderInfo* bootInfo )
 	KOut_writeLine( "\nStarting alloc() test." );
 	busyWait( WAIT_TIME );
 	
-	volatile PhysicalMemoryManager* pmm = PhysicalMemoryManager_getInstance();
 	IPmmAllocator allocator = PhysicalMemoryManager_getAllocator( pmm );
 
 	phys_addr_t frameAddr = allocator.iptr->allocate( allocator.obj, NULL );
@@ -84,3 +114,280 @@ void DoPmmTest( const char* welcomeMessage, BootLoaderInfo* bootInfo )
 	KOut_writeLine( "\nPMM tests complete (if you got here, this must be a free build)." );
 }
 
+
+
+void DoPfdbTest( const char* welcomeMessage, BootLoaderInfo* bootInfo )
+{
+	DisplayTextStream_init();
+	KShutdown_init();
+	ExceptionDispatcher_initForCurrentProcessor();
+	InterruptDispatcher_initForCurrentProcessor();
+
+	volatile KShutdown* kshutdown = KShutdown_getInstance();
+	KShutdown_setRebootOnFailEnabled( kshutdown, false );
+
+	// Make sure the bootloader info was mapped properly.
+	if (bootInfo == NULL)
+	{
+		volatile KShutdown* kshutdown = KShutdown_getInstance();
+		KShutdown_fail(
+			kshutdown,
+			"SYSTEM FAILURE\n%s\n%s\n\nReason: %s\n\n",
+			"An unrecoverable error has occurred and the system must be shut down.",
+			"We apologize for the inconvenience.",
+			"Failed to read the boot loader information."
+		);
+	}
+
+	PrintCompyLogo();
+
+	KOut_writeLine( welcomeMessage );
+
+	// Initialize the Physical Memory Manager, all the way this time.
+	IPmmRegionList ramList		= BootLoaderInfo_getRamMemMap( bootInfo );
+	IPmmRegionList reservedList	= BootLoaderInfo_getReservedMemMap( bootInfo );
+	IPmmRegionList moduleList	= BootLoaderInfo_getModuleMemMap( bootInfo );
+	
+	size_t spaceRequiredForPmm =
+		PhysicalMemoryManager_initStageOne( ramList, reservedList, moduleList );
+		
+	KOut_writeLine(
+		"\nSpace required for Physical Memory Manager: %d bytes (have %d)",
+		spaceRequiredForPmm,
+		sizeof( s_pfdbSpace )
+	);
+
+	if (spaceRequiredForPmm > sizeof( s_pfdbSpace ))
+	{
+		KOut_writeLine( "Too much RAM for this test. Try again with 128 MB or less." );
+		return;
+	}
+
+	PhysicalMemoryManager_initStageTwo( s_pfdbSpace, sizeof( s_pfdbSpace ) );
+
+	volatile PhysicalMemoryManager* pmm = PhysicalMemoryManager_getInstance();
+	volatile PageFrameDatabase* pfdb = PhysicalMemoryManager_getPageFrameDatabase( pmm );
+	IPmmAllocator allocator = PhysicalMemoryManager_getAllocator( pmm );
+
+	size_t numFreeFrames = PageFrameDatabase_getNumFreeFrames( pfdb );
+	KOut_writeLine(
+		"\tFrames: %d\tFree: %d",
+		PageFrameDatabase_getNumFrames( pfdb ),
+		numFreeFrames
+	);
+
+	// Drain the PFDB, remembering every frame it hands out so that we can give them all back.
+	KOut_writeLine( "\nStarting alloc() test." );
+	busyWait( WAIT_TIME );
+
+	size_t numAllocated = 0;
+	phys_addr_t frameAddr = allocator.iptr->allocate( allocator.obj, NULL );
+
+	while (frameAddr != PHYS_NULL)
+	{
+		if (PageFrameDatabase_getFrameState( pfdb, frameAddr ) != PFSTATE_KERNEL)
+		{
+			KOut_writeLine( "\tFrame %x is not in the kernel state!", frameAddr );
+		}
+		if (numAllocated < MAX_TEST_FRAMES)
+		{
+			s_allocatedFrames[numAllocated] = frameAddr;
+		}
+		numAllocated++;
+		frameAddr = allocator.iptr->allocate( allocator.obj, NULL );
+	}
+	KOut_writeLine(
+		"\tAllocated %d frames. %s",
+		numAllocated,
+		(numAllocated == numFreeFrames) ? "OK" : "Mismatch!"
+	);
+
+	// Give every frame back and make sure they all made it.
+	KOut_writeLine( "\nStarting free() test." );
+	busyWait( WAIT_TIME );
+
+	for (size_t i = 0; (i < numAllocated) && (i < MAX_TEST_FRAMES); i++)
+	{
+		allocator.iptr->free( allocator.obj, s_allocatedFrames[i] );
+	}
+
+	// Some of the frames are still sitting in this processor's frame cache.
+	PhysicalMemoryManager_drainFrameCaches( pmm );
+
+	KOut_writeLine(
+		"\tFree after free(): %d. %s",
+		PageFrameDatabase_getNumFreeFrames( pfdb ),
+		(PageFrameDatabase_getNumFreeFrames( pfdb ) == numFreeFrames) ? "OK" : "Leak!"
+	);
+
+	// Do it all again in batches, the way page-table construction would.
+	KOut_writeLine( "\nStarting allocateMany()/freeMany() test." );
+	busyWait( WAIT_TIME );
+
+	size_t batchSize = 32;
+	numAllocated = 0;
+	while (numAllocated + batchSize <= MAX_TEST_FRAMES)
+	{
+		size_t numInBatch = allocator.iptr->allocateMany(
+			allocator.obj,
+			&(s_allocatedFrames[numAllocated]),
+			batchSize,
+			NULL
+		);
+		numAllocated += numInBatch;
+		if (numInBatch < batchSize)
+		{
+			break;
+		}
+	}
+	KOut_writeLine(
+		"\tAllocated %d frames. %s",
+		numAllocated,
+		(numAllocated == numFreeFrames) ? "OK" : "Mismatch!"
+	);
+
+	allocator.iptr->freeMany( allocator.obj, s_allocatedFrames, numAllocated );
+	PhysicalMemoryManager_drainFrameCaches( pmm );
+
+	KOut_writeLine(
+		"\tFree after freeMany(): %d. %s",
+		PageFrameDatabase_getNumFreeFrames( pfdb ),
+		(PageFrameDatabase_getNumFreeFrames( pfdb ) == numFreeFrames) ? "OK" : "Leak!"
+	);
+
+	// Scrub a few frames the way the idle loop would, then make sure allocateZeroed() hands
+	// those out first.
+	KOut_writeLine( "\nStarting scrubFreeFrames()/allocateZeroed() test." );
+	busyWait( WAIT_TIME );
+
+	size_t numScrubbed = PhysicalMemoryManager_scrubFreeFrames( pmm, batchSize );
+	KOut_writeLine(
+		"\tScrubbed %d frames. Zeroed: %d. %s",
+		numScrubbed,
+		PageFrameDatabase_getNumZeroedFrames( pfdb ),
+		((numScrubbed == batchSize) &&
+		 (PageFrameDatabase_getNumZeroedFrames( pfdb ) == batchSize) &&
+		 (PageFrameDatabase_getNumFreeFrames( pfdb ) == numFreeFrames)) ? "OK" : "Mismatch!"
+	);
+
+	for (size_t i = 0; i < batchSize; i++)
+	{
+		s_allocatedFrames[i] = PhysicalMemoryManager_allocateZeroed( pmm, NULL );
+	}
+	KOut_writeLine(
+		"\tZeroed after allocateZeroed(): %d. %s",
+		PageFrameDatabase_getNumZeroedFrames( pfdb ),
+		(PageFrameDatabase_getNumZeroedFrames( pfdb ) == 0) ? "OK" : "Mismatch!"
+	);
+
+	allocator.iptr->freeMany( allocator.obj, s_allocatedFrames, batchSize );
+	PhysicalMemoryManager_drainFrameCaches( pmm );
+
+	KOut_writeLine(
+		"\tFree after freeMany(): %d. %s",
+		PageFrameDatabase_getNumFreeFrames( pfdb ),
+		(PageFrameDatabase_getNumFreeFrames( pfdb ) == numFreeFrames) ? "OK" : "Leak!"
+	);
+
+	KOut_writeLine( "\nPFDB tests complete." );
+}
+
+
+
+void DoBuddyTest( const char* welcomeMessage, BootLoaderInfo* bootInfo )
+{
+	DisplayTextStream_init();
+	KShutdown_init();
+	ExceptionDispatcher_initForCurrentProcessor();
+	InterruptDispatcher_initForCurrentProcessor();
+
+	volatile KShutdown* kshutdown = KShutdown_getInstance();
+	KShutdown_setRebootOnFailEnabled( kshutdown, false );
+
+	(void) bootInfo;	// The buddy allocator is tested on a made-up region.
+
+	PrintCompyLogo();
+
+	KOut_writeLine( welcomeMessage );
+
+	// The buddy allocator never touches the frames it manages, so we can point it at any range
+	// of physical addresses we like. Pick one that doesn't start or end on a large-block
+	// boundary to make things interesting.
+	const phys_addr_t baseAddr = 0x01005000;
+	const size_t numFrames = 16 * 1024 + 300;
+
+	KOut_writeLine(
+		"\nBuddy allocator needs %d bytes for %d frames (have %d).",
+		PmmBuddyAllocator_calculateSizeInBytes( numFrames ),
+		numFrames,
+		sizeof( s_pfdbSpace )
+	);
+
+	PmmBuddyAllocator buddy =
+		PmmBuddyAllocator_create( s_pfdbSpace, sizeof( s_pfdbSpace ), baseAddr, numFrames );
+
+	for (size_t i = 0; i < numFrames; i++)
+	{
+		PmmBuddyAllocator_free( &buddy, baseAddr + MM_getFrameAddress( i ) );
+	}
+	KOut_writeLine( "\tFree after init: %d", PmmBuddyAllocator_getNumFreeFrames( &buddy ) );
+
+	// Allocate a mix of block sizes until we run out, checking alignment as we go.
+	KOut_writeLine( "\nStarting allocateOrder() test." );
+	busyWait( WAIT_TIME );
+
+	size_t numBlocks = 0;
+	size_t numMisaligned = 0;
+	for (uint8_t order = MAX_BUDDY_ORDER; ; order = (order == 0) ? MAX_BUDDY_ORDER : order - 1)
+	{
+		phys_addr_t blockAddr = PmmBuddyAllocator_allocateOrder( &buddy, order );
+		if (blockAddr == PHYS_NULL)
+		{
+			if (order == 0)
+			{
+				break;		// Not even a single frame left.
+			}
+			continue;
+		}
+
+		if ((MM_getFrameNumber( blockAddr ) & ((((size_t) 1) << order) - 1)) != 0)
+		{
+			numMisaligned++;
+		}
+
+		// Remember the order in the low bits of the address so we can free the block later.
+		s_allocatedFrames[numBlocks++] = blockAddr | order;
+	}
+	KOut_writeLine(
+		"\tAllocated %d blocks, %d misaligned. Free: %d",
+		numBlocks,
+		numMisaligned,
+		PmmBuddyAllocator_getNumFreeFrames( &buddy )
+	);
+
+	// Free everything and make sure the buddies all merge back together.
+	KOut_writeLine( "\nStarting freeOrder() test." );
+	busyWait( WAIT_TIME );
+
+	for (size_t i = 0; i < numBlocks; i++)
+	{
+		phys_addr_t blockAddr = MM_alignToFrame( s_allocatedFrames[i] );
+		uint8_t order = (uint8_t) (s_allocatedFrames[i] & FRAME_OFFSET_MASK);
+		PmmBuddyAllocator_freeOrder( &buddy, blockAddr, order );
+	}
+
+	const size_t largeBlockFrames = ((size_t) 1) << MAX_BUDDY_ORDER;
+	size_t numLargeBlocks = 0;
+	while (PmmBuddyAllocator_allocateOrder( &buddy, MAX_BUDDY_ORDER ) != PHYS_NULL)
+	{
+		numLargeBlocks++;
+	}
+	KOut_writeLine(
+		"\tLargest blocks available after free: %d (expected %d)",
+		numLargeBlocks,
+		(numFrames - (largeBlockFrames - MM_getFrameNumber( baseAddr ) % largeBlockFrames))
+			/ largeBlockFrames
+	);
+
+	KOut_writeLine( "\nBuddy allocator tests complete." );
+}
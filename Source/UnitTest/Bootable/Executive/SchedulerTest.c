@@ -0,0 +1,154 @@
+#include <limits.h>
+#include "Kernel/KRunTime/DisplayTextStream.h"
+#include "Kernel/KRunTime/KOut.h"
+#include "Kernel/KRunTime/KShutdown.h"
+#include "Kernel/HAL/Atomic.h"
+#include "Kernel/HAL/Processor.h"
+#include "ExceptionDispatcher.h"
+#include "InterruptDispatcher.h"
+#include "Scheduler.h"
+#include "Thread.h"
+#include "BootLoaderInfo.h"
+#include "TestHelpers.h"
+
+
+enum
+{
+	NUM_WORKERS			= 3,					// Normal-priority threads that share the processor.
+	NUM_THREADS			= NUM_WORKERS + 1,		// The workers, plus one high-priority thread.
+	HIGH_THREAD_ID		= NUM_WORKERS,			// ID of the high-priority thread.
+	TEST_STACK_SIZE		= 4096,					// Bytes of stack for each test thread.
+	NUM_FILLERS			= WORK_DEQUE_CAPACITY,	// Low-priority threads that fill a run queue.
+	FILLER_STACK_SIZE	= 2048,					// Bytes of stack for each filler thread.
+	NUM_WORK_LOOPS		= INT_MAX / 30			// Long enough to take many time slices.
+};
+
+
+// The unit-test kernel has no VMM, so the threads' stacks come from the kernel's bss instead.
+static uint32_t s_stacks[NUM_THREADS][TEST_STACK_SIZE / sizeof( uint32_t )];
+
+static Thread s_threads[NUM_THREADS];
+static Thread s_bootThread;
+
+// The fillers do nothing, so they can get by with less stack. The last one never fits.
+static uint32_t s_fillerStacks[NUM_FILLERS + 1][FILLER_STACK_SIZE / sizeof( uint32_t )];
+static Thread s_fillers[NUM_FILLERS + 1];
+static volatile uintptr_t s_numFillersRun = 0;
+
+// The ID of the last thread to go around its loop, and the number of times that changed.
+static volatile int s_lastRunner = -1;
+static volatile int s_numSwitches = 0;
+
+// The order in which the threads finished.
+static volatile int s_finishOrder[NUM_THREADS];
+static volatile uintptr_t s_numFinished = 0;
+
+
+static void SchedulerTest_work( void* arg )
+{
+	int id = (int) arg;
+
+	for (int i = 0; i < NUM_WORK_LOOPS; i++)
+	{
+		// Only the timer interrupt can make another thread run in between two iterations.
+		if (s_lastRunner != id)
+		{
+			s_lastRunner = id;
+			s_numSwitches++;
+		}
+	}
+
+	// Returning must end the thread cleanly.
+	s_finishOrder[Atomic_fetchAdd( &s_numFinished, 1 )] = id;
+}
+
+
+static void SchedulerTest_fill( void* arg )
+{
+	(void) arg;
+	Atomic_fetchAdd( &s_numFillersRun, 1 );
+}
+
+
+void DoSchedulerTest( const char* welcomeMessage, BootLoaderInfo* bootInfo )
+{
+	(void) bootInfo;
+	DisplayTextStream_init();
+	KShutdown_init();
+	ExceptionDispatcher_initForCurrentProcessor();
+	InterruptDispatcher_initForCurrentProcessor();
+
+	volatile KShutdown* kshutdown = KShutdown_getInstance();
+	KShutdown_setRebootOnFailEnabled( kshutdown, false );
+
+	PrintCompyLogo();
+	KOut_writeLine( welcomeMessage );
+
+	// This function becomes the idle thread, so it only runs once the others are all done.
+	Scheduler_initForCurrentProcessor( &s_bootThread );
+
+	for (int i = 0; i < NUM_THREADS; i++)
+	{
+		Thread_init(
+			&(s_threads[i]),
+			s_stacks[i],
+			sizeof( s_stacks[i] ),
+			SchedulerTest_work,
+			(void*) i,
+			(i == HIGH_THREAD_ID) ? THREAD_PRIORITY_HIGHEST : THREAD_PRIORITY_NORMAL
+		);
+		Scheduler_addThread( &(s_threads[i]) );
+	}
+
+	// Fill the run queue for the lowest priority. The one thread too many must be turned away
+	// without disturbing the others.
+	bool capacityOk = true;
+	for (int i = 0; i <= NUM_FILLERS; i++)
+	{
+		Thread_init(
+			&(s_fillers[i]),
+			s_fillerStacks[i],
+			sizeof( s_fillerStacks[i] ),
+			SchedulerTest_fill,
+			NULL,
+			THREAD_PRIORITY_IDLE + 1
+		);
+		bool isAdded = Scheduler_addThread( &(s_fillers[i]) );
+		capacityOk = capacityOk && (isAdded == (i < NUM_FILLERS));
+	}
+
+	KOut_writeLine( "\nRunning %d threads...", NUM_THREADS );
+	Processor_enableInterrupts();
+
+	for (int i = 0; i < NUM_THREADS; i++)
+	{
+		while (!Thread_hasExited( &(s_threads[i]) ))
+		{
+			Processor_waitForInterrupt();
+		}
+	}
+
+	for (int i = 0; i < NUM_FILLERS; i++)
+	{
+		while (!Thread_hasExited( &(s_fillers[i]) ))
+		{
+			Processor_waitForInterrupt();
+		}
+	}
+
+	KOut_writeLine( "All threads exited after %d switches.", s_numSwitches );
+
+	// The high-priority thread runs first and alone. The workers take turns after that, so each of
+	// them must have been switched to more than once.
+	bool priorityOk = (s_numFinished == NUM_THREADS) && (s_finishOrder[0] == HIGH_THREAD_ID);
+	KOut_writeLine( "Priority test %s", priorityOk ? "succeeded." : "failed!" );
+
+	bool timeSliceOk = (s_numSwitches > NUM_THREADS);
+	KOut_writeLine( "Time slice test %s", timeSliceOk ? "succeeded." : "failed!" );
+
+	capacityOk = capacityOk && (s_numFillersRun == NUM_FILLERS);
+	KOut_writeLine( "Capacity test %s", capacityOk ? "succeeded." : "failed!" );
+
+	KOut_writeLine( "\nScheduler test complete." );
+}
+
@@ -6,7 +6,13 @@ void DoDisplayTest( const char* welcomeMessage, BootLoaderInfo* bootInfo );
 void DoCrashTest( const char* welcomeMessage, BootLoaderInfo* bootInfo );
 void DoAtomicTest( const char* welcomeMessage, BootLoaderInfo* bootInfo );
 void DoBootLoaderInfoTest( const char* welcomeMessage, BootLoaderInfo* bootInfo );
+void DoKMemTest( const char* welcomeMessage, BootLoaderInfo* bootInfo );
 void DoPmmTest( const char* welcomeMessage, BootLoaderInfo* bootInfo );
+void DoPfdbTest( const char* welcomeMessage, BootLoaderInfo* bootInfo );
+void DoBuddyTest( const char* welcomeMessage, BootLoaderInfo* bootInfo );
+void DoSchedulerTest( const char* welcomeMessage, BootLoaderInfo* bootInfo );
+void DoTimerTest( const char* welcomeMessage, BootLoaderInfo* bootInfo );
+void DoInterruptControllerTest( const char* welcomeMessage, BootLoaderInfo* bootInfo );
 
 
 void kmain( BootLoaderInfo* bootInfo )
@@ -24,7 +30,13 @@ void kmain( BootLoaderInfo* bootInfo )
 //	DoCrashTest( welcomeMessage, bootInfo );
 //	DoAtomicTest( welcomeMessage, bootInfo );
 //	DoBootLoaderInfoTest( welcomeMessage, bootInfo );
+//	DoKMemTest( welcomeMessage, bootInfo );
 	DoPmmTest( welcomeMessage, bootInfo );
+//	DoPfdbTest( welcomeMessage, bootInfo );
+//	DoBuddyTest( welcomeMessage, bootInfo );
+//	DoSchedulerTest( welcomeMessage, bootInfo );
+//	DoTimerTest( welcomeMessage, bootInfo );
+//	DoInterruptControllerTest( welcomeMessage, bootInfo );
 
 	while (true)
 	{
@@ -0,0 +1,122 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include "Kernel/KRunTime/DisplayTextStream.h"
+#include "Kernel/KRunTime/KOut.h"
+#include "Kernel/KRunTime/KShutdown.h"
+#include "Kernel/HAL/Processor.h"
+#include "ExceptionDispatcher.h"
+#include "InterruptDispatcher.h"
+#include "Timer.h"
+#include "BootLoaderInfo.h"
+#include "TestHelpers.h"
+
+
+enum
+{
+	NUM_TIMERS			= 5,		// Timers armed by the test.
+	CANCELLED_TIMER		= 3,		// Index of the timer that is cancelled before it expires.
+	MILLISECOND			= 1000,		// Microseconds in a millisecond.
+	OLD_TICKS_PER_SECOND	= 100	// Rate of the periodic tick that the one-shot timer replaced.
+};
+
+
+// Deliberately out of order, so that the wheel has to sort them.
+static const uint64_t s_delays[NUM_TIMERS] =
+{
+	300 * MILLISECOND,
+	100 * MILLISECOND,
+	500 * MILLISECOND,
+	400 * MILLISECOND,
+	200 * MILLISECOND
+};
+
+static Timer s_timers[NUM_TIMERS];
+static uint64_t s_deadlines[NUM_TIMERS];
+static volatile uint64_t s_expiredAt[NUM_TIMERS];
+
+// The order in which the timers expired.
+static volatile int s_expiryOrder[NUM_TIMERS];
+static volatile int s_numExpired = 0;
+
+
+static void TimerTest_expired( Timer* timer, void* context )
+{
+	(void) timer;
+	int id = (int) context;
+
+	s_expiredAt[id] = Timer_getTime();
+	s_expiryOrder[s_numExpired] = id;
+	s_numExpired++;
+}
+
+
+void DoTimerTest( const char* welcomeMessage, BootLoaderInfo* bootInfo )
+{
+	(void) bootInfo;
+	DisplayTextStream_init();
+	KShutdown_init();
+	ExceptionDispatcher_initForCurrentProcessor();
+	InterruptDispatcher_initForCurrentProcessor();
+
+	volatile KShutdown* kshutdown = KShutdown_getInstance();
+	KShutdown_setRebootOnFailEnabled( kshutdown, false );
+
+	PrintCompyLogo();
+	KOut_writeLine( welcomeMessage );
+
+	uint64_t start = Timer_getTime();
+	for (int i = 0; i < NUM_TIMERS; i++)
+	{
+		s_deadlines[i] = start + s_delays[i];
+		Timer_init( &(s_timers[i]), TimerTest_expired, (void*) i );
+		Timer_arm( &(s_timers[i]), s_deadlines[i] );
+	}
+
+	bool cancelOk = Timer_cancel( &(s_timers[CANCELLED_TIMER]) );
+	cancelOk = cancelOk && !Timer_cancel( &(s_timers[CANCELLED_TIMER]) );
+
+	KOut_writeLine( "\nWaiting for %d timers...", NUM_TIMERS - 1 );
+	Processor_enableInterrupts();
+
+	// Every pass through the loop is one interrupt.
+	int numWakeups = 0;
+	while (s_numExpired < NUM_TIMERS - 1)
+	{
+		Processor_waitForInterrupt();
+		numWakeups++;
+	}
+
+	// Wait past the cancelled timer's deadline to make sure it doesn't go off anyway.
+	while (Timer_getTime() < s_deadlines[CANCELLED_TIMER] + (100 * MILLISECOND))
+	{
+		Processor_waitForInterrupt();
+	}
+	Processor_disableInterrupts();
+
+	uint64_t lastExpiry = s_expiredAt[s_expiryOrder[NUM_TIMERS - 2]];
+	uint32_t elapsedMs = (uint32_t) (lastExpiry - start) / MILLISECOND;
+	KOut_writeLine( "Timers expired over %d ms, with %d interrupts.", elapsedMs, numWakeups );
+
+	bool orderOk = (s_numExpired == NUM_TIMERS - 1);
+	for (int i = 1; orderOk && (i < s_numExpired); i++)
+	{
+		orderOk = (s_delays[s_expiryOrder[i - 1]] < s_delays[s_expiryOrder[i]]);
+	}
+	KOut_writeLine( "Order test %s", orderOk ? "succeeded." : "failed!" );
+
+	bool lateOk = true;
+	for (int i = 0; i < s_numExpired; i++)
+	{
+		int id = s_expiryOrder[i];
+		lateOk = lateOk && (s_expiredAt[id] >= s_deadlines[id]);
+	}
+	KOut_writeLine( "Deadline test %s", lateOk ? "succeeded." : "failed!" );
+	KOut_writeLine( "Cancel test %s", cancelOk ? "succeeded." : "failed!" );
+
+	// A periodic tick would have interrupted the processor the whole time. The wheel takes a few
+	// extra interrupts to move timers down from its coarser levels, but far fewer than that.
+	bool ticklessOk = (numWakeups < (int) ((elapsedMs * OLD_TICKS_PER_SECOND) / 1000));
+	KOut_writeLine( "Tickless test %s", ticklessOk ? "succeeded." : "failed!" );
+
+	KOut_writeLine( "\nTimer test complete." );
+}
@@ -0,0 +1,416 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/UnitTest/Hosted/LockStress.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/08
+//
+// ===========================================================================
+///
+///	\file
+///
+/// \brief	Hammers Lock, QueueLock, RWLock, and SeqLock from many threads at
+///			once, checking for lost updates and torn reads, and measuring how
+///			the acquire rate scales.
+///
+/// For Lock and QueueLock, each thread repeatedly acquires the lock, does a
+/// non-atomic increment of a shared counter, and releases the lock. If the
+/// lock ever lets two threads in at once, increments get lost and the final
+/// count comes up short.
+///
+/// RWLock and SeqLock are tested with a read-mostly mix: one acquire in
+/// every READS_PER_WRITE + 1 is a write, which increments the counter and a
+/// mirror of it, and the rest are reads, which check that the two are equal.
+/// A read that sees them differ means a reader got in during a write.
+///
+/// In builds with LOCK_STATS defined, each run also adds up the statistics of
+/// every LockSite before and after, and checks that the acquire count went up
+/// by exactly the number of exclusive acquires (every acquire for Lock and
+/// QueueLock, and only the writes for RWLock and SeqLock), and that some
+/// waiting and holding time was recorded once there is more than one thread.
+///
+/// Usage: hostedtest locks [maxThreads] [iterations]
+///
+/// \a maxThreads defaults to 16, and each thread does \a iterations
+/// acquire/release pairs, which defaults to 100000.
+///
+// ===========================================================================
+
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "Kernel/HAL/Atomic.h"
+#include "Kernel/HAL/Lock.h"
+#include "Kernel/HAL/LockStats.h"
+#include "Kernel/HAL/QueueLock.h"
+#include "Kernel/HAL/RWLock.h"
+#include "Kernel/HAL/SeqLock.h"
+
+
+// Private constants
+
+/// \brief	Defines private constants for the lock stress test.
+enum LockStress_consts
+{
+	MAX_LOCK_THREADS	= 64,		///< Most threads the lock stress test will start.
+	READS_PER_WRITE		= 15		///< Reads between writes for RWLock and SeqLock.
+};
+
+
+/// \brief	Identifies the kind of lock being hammered.
+typedef enum
+{
+	LOCKKIND_LOCK,			///< Lock.
+	LOCKKIND_QUEUELOCK,		///< QueueLock.
+	LOCKKIND_RWLOCK,		///< RWLock, with mostly reads.
+	LOCKKIND_SEQLOCK,		///< SeqLock, with mostly reads.
+	LOCKKIND_COUNT			///< Number of kinds of lock.
+
+} LockKind;
+
+
+/// \brief	Names of each kind of lock, indexed by LockKind.
+static const char* const s_lockKindNames[LOCKKIND_COUNT] =
+{
+	"Lock",
+	"QueueLock",
+	"RWLock",
+	"SeqLock"
+};
+
+
+
+// Private types
+
+/// \brief	The locks under test, and the counters they protect.
+typedef struct LockStressShared
+{
+	Lock				m_lock;				///< The Lock under test.
+	QueueLock			m_queueLock;		///< The QueueLock under test.
+	RWLock				m_rwLock;			///< The RWLock under test.
+	SeqLock				m_seqLock;			///< The SeqLock under test.
+	volatile uint64_t	m_counter;			///< Incremented while holding the lock under test.
+	volatile uint64_t	m_mirror;			///< Kept equal to m_counter by the other writers.
+	volatile uintptr_t	m_tornReads;		///< Number of reads that saw m_counter != m_mirror.
+	LockKind			m_kind;				///< Which lock this run hammers.
+	size_t				m_iterations;		///< Acquire/release pairs per thread.
+	pthread_barrier_t	m_start;			///< Makes the workers start together.
+} LockStressShared;
+
+
+/// \brief	The statistics of every LockSite, added together.
+typedef struct LockStressTotals
+{
+	uint64_t m_acquires;	///< Sum of every site's acquire count.
+	uint64_t m_spinTime;	///< Sum of every site's total wait.
+	uint64_t m_holdTime;	///< Sum of every site's total hold time.
+} LockStressTotals;
+
+
+
+// Private functions
+
+/// \brief	Returns the number of nanoseconds on the monotonic clock.
+static uint64_t LockStress_now( void )
+{
+	struct timespec now;
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	return ((uint64_t) now.tv_sec * 1000000000ULL) + (uint64_t) now.tv_nsec;
+}
+
+
+/// \brief	Adds up the statistics of every LockSite registered so far.
+///
+/// Only the main thread calls this, between runs, so nothing is updating the sites.
+static LockStressTotals LockStress_sumSites( void )
+{
+	LockStressTotals totals = { 0, 0, 0 };
+	for (LockSite* site = LockStats_getFirstSite();
+		 site != NULL;
+		 site = LockStats_getNextSite( site ))
+	{
+		totals.m_acquires	+= site->m_acquireCount;
+		totals.m_spinTime	+= site->m_totalSpinCycles;
+		totals.m_holdTime	+= site->m_totalHoldCycles;
+	}
+	return totals;
+}
+
+
+/// \brief	Checks that a run of the given lock moved the lock statistics as it should have.
+///
+/// \param shared		the locks and counters of the run.
+/// \param numThreads	the number of threads in the run.
+/// \param exclusive	the number of exclusive acquires that the run made.
+/// \param before		the totals from before the run.
+///
+/// \return \c true if the statistics are consistent with the run, or if this build has no lock
+///			statistics; \c false otherwise.
+static bool LockStress_checkSites(
+	const LockStressShared*	shared,
+	size_t					numThreads,
+	uint64_t				exclusive,
+	LockStressTotals		before
+)
+{
+#ifdef LOCK_STATS
+	LockStressTotals after = LockStress_sumSites();
+
+	uint64_t acquires	= after.m_acquires - before.m_acquires;
+	uint64_t spinTime	= after.m_spinTime - before.m_spinTime;
+	uint64_t holdTime	= after.m_holdTime - before.m_holdTime;
+
+	// With one thread there's no contention, and on a coarse clock the times can round to zero.
+	bool timesOk = (numThreads < 2) || ((spinTime > 0) && (holdTime > 0));
+
+	if ((acquires != exclusive) || !timesOk)
+	{
+		printf( "  FAILED: %s sites recorded %llu of %llu acquires, %llu ns waiting, %llu ns held\n",
+			s_lockKindNames[shared->m_kind],
+			(unsigned long long) acquires,
+			(unsigned long long) exclusive,
+			(unsigned long long) spinTime,
+			(unsigned long long) holdTime );
+		return false;
+	}
+#else
+	(void) shared;
+	(void) numThreads;
+	(void) exclusive;
+	(void) before;
+#endif
+	return true;
+}
+
+
+/// \brief	Indicates whether the given iteration of a read-mostly run is a write.
+static bool LockStress_isWrite( size_t iteration )
+{
+	return (iteration % (READS_PER_WRITE + 1)) == 0;
+}
+
+
+/// \brief	Increments the counter and its mirror. The caller must exclude everyone else.
+static void LockStress_write( LockStressShared* shared )
+{
+	shared->m_counter = shared->m_counter + 1;
+	shared->m_mirror = shared->m_mirror + 1;
+}
+
+
+/// \brief	Body of each worker thread.
+///
+/// \param arg	the LockStressShared that all the threads share.
+///
+/// \return NULL.
+static void* LockStress_threadMain( void* arg )
+{
+	LockStressShared* shared = (LockStressShared*) arg;
+	pthread_barrier_wait( &(shared->m_start) );
+
+	for (size_t i = 0; i < shared->m_iterations; i++)
+	{
+		switch (shared->m_kind)
+		{
+		case LOCKKIND_LOCK:
+			Lock_acquire( &(shared->m_lock) );
+			shared->m_counter = shared->m_counter + 1;
+			Lock_release( &(shared->m_lock) );
+			break;
+
+		case LOCKKIND_QUEUELOCK:
+		{
+			QueueLockNode node;
+			QueueLock_acquire( &(shared->m_queueLock), &node );
+			shared->m_counter = shared->m_counter + 1;
+			QueueLock_release( &(shared->m_queueLock), &node );
+			break;
+		}
+
+		case LOCKKIND_RWLOCK:
+			if (LockStress_isWrite( i ))
+			{
+				RWLock_acquireWrite( &(shared->m_rwLock) );
+				LockStress_write( shared );
+				RWLock_releaseWrite( &(shared->m_rwLock) );
+			}
+			else
+			{
+				RWLockReader reader;
+				RWLock_acquireRead( &(shared->m_rwLock), &reader );
+				bool torn = (shared->m_counter != shared->m_mirror);
+				RWLock_releaseRead( &(shared->m_rwLock), &reader );
+
+				if (torn)
+				{
+					Atomic_fetchAdd( &(shared->m_tornReads), 1 );
+				}
+			}
+			break;
+
+		case LOCKKIND_SEQLOCK:
+			if (LockStress_isWrite( i ))
+			{
+				SeqLock_acquireWrite( &(shared->m_seqLock) );
+				LockStress_write( shared );
+				SeqLock_releaseWrite( &(shared->m_seqLock) );
+			}
+			else
+			{
+				uint64_t counter;
+				uint64_t mirror;
+				uintptr_t sequence;
+				do
+				{
+					sequence	= SeqLock_beginRead( &(shared->m_seqLock) );
+					counter		= shared->m_counter;
+					mirror		= shared->m_mirror;
+				} while (SeqLock_retryRead( &(shared->m_seqLock), sequence ));
+
+				if (counter != mirror)
+				{
+					Atomic_fetchAdd( &(shared->m_tornReads), 1 );
+				}
+			}
+			break;
+
+		default:
+			break;
+		}
+	}
+	return NULL;
+}
+
+
+/// \brief	Runs one lock with the given number of threads.
+///
+/// \param shared		the locks and counters to use.
+/// \param numThreads	the number of threads to start.
+///
+/// \return millions of acquire/release pairs per second, or a negative number if an update was
+///			lost or a read was torn.
+static double LockStress_run( LockStressShared* shared, size_t numThreads )
+{
+	static pthread_t s_threads[MAX_LOCK_THREADS];
+
+	shared->m_counter		= 0;
+	shared->m_mirror		= 0;
+	shared->m_tornReads		= 0;
+	pthread_barrier_init( &(shared->m_start), NULL, (unsigned) numThreads );
+
+	LockStressTotals before = LockStress_sumSites();
+	uint64_t start = LockStress_now();
+	for (size_t i = 0; i < numThreads; i++)
+	{
+		if (pthread_create( &(s_threads[i]), NULL, LockStress_threadMain, shared ) != 0)
+		{
+			fprintf( stderr, "pthread_create failed\n" );
+			exit( EXIT_FAILURE );
+		}
+	}
+	for (size_t i = 0; i < numThreads; i++)
+	{
+		pthread_join( s_threads[i], NULL );
+	}
+	uint64_t elapsed = LockStress_now() - start;
+	pthread_barrier_destroy( &(shared->m_start) );
+
+	uint64_t acquires = (uint64_t) numThreads * shared->m_iterations;
+	uint64_t expected = acquires;
+	if ((shared->m_kind == LOCKKIND_RWLOCK) || (shared->m_kind == LOCKKIND_SEQLOCK))
+	{
+		// Iterations 0, READS_PER_WRITE + 1, ... are writes.
+		size_t writesPerThread =
+			(shared->m_iterations + READS_PER_WRITE) / (READS_PER_WRITE + 1);
+
+		expected = (uint64_t) numThreads * writesPerThread;
+	}
+
+	if ((shared->m_counter != expected) || (shared->m_tornReads != 0))
+	{
+		printf( "  FAILED: %s counted %llu of %llu, with %lu torn reads\n",
+			s_lockKindNames[shared->m_kind],
+			(unsigned long long) shared->m_counter,
+			(unsigned long long) expected,
+			(unsigned long) shared->m_tornReads );
+		return -1.0;
+	}
+
+	// Every counted increment was made under an exclusive acquire, and no other acquire was.
+	if (!LockStress_checkSites( shared, numThreads, expected, before ))
+	{
+		return -1.0;
+	}
+	return (elapsed == 0) ? 0.0 : ((double) acquires * 1000.0) / (double) elapsed;
+}
+
+
+
+// Public functions
+
+/// \brief	Runs the multi-threaded stress test of Lock, QueueLock, RWLock, and SeqLock.
+///
+/// \param argc	the number of arguments after the name of the test.
+/// \param argv	the arguments after the name of the test.
+///
+/// \return \c true if no lock lost an update or let a reader see a partial write.
+bool DoLockStress( int argc, char* argv[] )
+{
+	size_t maxThreads = (argc > 0) ? (size_t) strtoul( argv[0], NULL, 0 ) : 16;
+	size_t iterations = (argc > 1) ? (size_t) strtoul( argv[1], NULL, 0 ) : 100000;
+
+	if ((maxThreads == 0) || (maxThreads > MAX_LOCK_THREADS))
+	{
+		maxThreads = MAX_LOCK_THREADS;
+	}
+
+	static LockStressShared s_shared;
+	s_shared.m_lock			= Lock_create();
+	s_shared.m_queueLock	= QueueLock_create();
+	s_shared.m_rwLock		= RWLock_create();
+	s_shared.m_seqLock		= SeqLock_create();
+	s_shared.m_iterations	= iterations;
+
+	printf( "Lock stress test (%lu acquires per thread, ", (unsigned long) iterations );
+	printf( "1 in %d a write for RWLock and SeqLock), in Mops/s:\n", READS_PER_WRITE + 1 );
+	printf( "  %7s", "threads" );
+	for (int kind = 0; kind < LOCKKIND_COUNT; kind++)
+	{
+		printf( " %10s", s_lockKindNames[kind] );
+	}
+	printf( "\n" );
+
+	bool passed = true;
+	size_t numThreads = 1;
+	for (;;)
+	{
+		printf( "  %7lu", (unsigned long) numThreads );
+		for (int kind = 0; kind < LOCKKIND_COUNT; kind++)
+		{
+			s_shared.m_kind = (LockKind) kind;
+			double mops = LockStress_run( &s_shared, numThreads );
+
+			passed = passed && (mops >= 0.0);
+			printf( " %10.2f", mops );
+			fflush( stdout );
+		}
+		printf( "\n" );
+
+		if (numThreads == maxThreads)
+		{
+			break;
+		}
+		numThreads = ((numThreads * 2) > maxThreads) ? maxThreads : (numThreads * 2);
+	}
+	return passed;
+}
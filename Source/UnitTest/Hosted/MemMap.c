@@ -0,0 +1,106 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/UnitTest/Hosted/MemMap.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/21
+//
+// ===========================================================================
+///
+///	\file
+///
+/// \brief	Implements the synthetic physical memory maps for the hosted tests.
+///
+// ===========================================================================
+
+
+#include <string.h>
+#include "Kernel/KCommon/KDebug.h"
+#include "MemMap.h"
+
+
+
+// Private functions
+
+/// \brief	Implementation of IPmmRegionList_reset() for ArrayRegionList.
+static void ArrayRegionList_reset( ArrayRegionList* list )
+{
+	list->m_next = 0;
+}
+
+
+/// \brief	Implementation of IPmmRegionList_moveNext() for ArrayRegionList.
+static bool ArrayRegionList_moveNext( ArrayRegionList* list )
+{
+	if (list->m_next < list->m_numRegions)
+	{
+		list->m_next++;
+		return true;
+	}
+	return false;
+}
+
+
+/// \brief	Implementation of IPmmRegionList_getCurrent() for ArrayRegionList.
+static PmmRegion ArrayRegionList_getCurrent( const ArrayRegionList* list )
+{
+	return list->m_regions[list->m_next - 1];
+}
+
+
+/// \brief	Interface dispatch table for ArrayRegionList's implementation of IPmmRegionList.
+static IPmmRegionList_itable s_arrayListItable =
+{
+	(IPmmRegionList_resetFunc) ArrayRegionList_reset,
+	(IPmmRegionList_moveNextFunc) ArrayRegionList_moveNext,
+	(IPmmRegionList_getCurrentFunc) ArrayRegionList_getCurrent
+};
+
+
+
+// Public functions
+
+void ArrayRegionList_add( ArrayRegionList* list, phys_addr_t base, phys_addr_t last )
+{
+	KDebug_assert( list->m_numRegions < MAX_MAP_REGIONS );
+	list->m_regions[list->m_numRegions++] = PmmRegion_create( base, (last - base) + 1 );
+}
+
+
+IPmmRegionList ArrayRegionList_getAsPmmRegionList( ArrayRegionList* list )
+{
+	IPmmRegionList ilist;
+	ilist.obj	= list;
+	ilist.iptr	= &s_arrayListItable;
+	return ilist;
+}
+
+
+void MemMap_create( MemMap* map, const char* name, uint64_t sizeInBytes )
+{
+	memset( map, 0, sizeof( MemMap ) );
+	map->m_name			= name;
+	map->m_sizeInBytes	= sizeInBytes;
+
+	phys_addr_t last = (phys_addr_t) (sizeInBytes - 1);
+
+	ArrayRegionList_add( &(map->m_ramList), 0x00000000, 0x0009FBFF );
+	ArrayRegionList_add( &(map->m_reservedList), 0x0009FC00, 0x000FFFFF );
+	ArrayRegionList_add( &(map->m_moduleList), 0x00100000, 0x001FFFFF );
+
+	if (sizeInBytes >= (((uint64_t) 4) << 30))
+	{
+		ArrayRegionList_add( &(map->m_ramList), 0x00100000, 0xBFFFFFFF );
+		ArrayRegionList_add( &(map->m_reservedList), 0xC0000000, last );
+	}
+	else
+	{
+		ArrayRegionList_add( &(map->m_ramList), 0x00100000, last );
+	}
+}
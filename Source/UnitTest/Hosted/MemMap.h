@@ -0,0 +1,90 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/UnitTest/Hosted/MemMap.h
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/21
+//
+// ===========================================================================
+///
+///	\file
+///
+/// \brief	Synthetic physical memory maps for the hosted tests.
+///
+/// The hosted tests have no bootloader, so they describe physical memory
+/// with fixed lists of regions instead. Every map looks like a PC: RAM below
+/// 640 KB, the BIOS area up to 1 MB, a 1 MB kernel image, and RAM everywhere
+/// else.
+///
+// ===========================================================================
+
+#ifndef _UNITTEST_HOSTED_MEMMAP_H_
+#define _UNITTEST_HOSTED_MEMMAP_H_
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Kernel/MM/IPmmRegionList.h"
+#include "Kernel/MM/PmmRegion.h"
+
+
+/// \brief	Defines constants for the synthetic memory maps.
+enum MemMap_consts
+{
+	MAX_MAP_REGIONS = 4		///< Most regions in one list of a synthetic memory map.
+};
+
+
+/// \brief	A fixed list of regions that implements IPmmRegionList.
+typedef struct ArrayRegionList
+{
+	PmmRegion	m_regions[MAX_MAP_REGIONS];	///< The regions in the list.
+	size_t		m_numRegions;				///< The number of regions in the list.
+	size_t		m_next;						///< Index of the region after the current one.
+} ArrayRegionList;
+
+
+/// \brief	Describes one of the synthetic memory maps.
+typedef struct MemMap
+{
+	const char*		m_name;				///< Name to show in the results.
+	uint64_t		m_sizeInBytes;		///< Size of the physical address space covered.
+	ArrayRegionList	m_ramList;			///< RAM regions.
+	ArrayRegionList	m_reservedList;		///< Reserved regions.
+	ArrayRegionList	m_moduleList;		///< Kernel & module regions.
+} MemMap;
+
+
+/// \brief	Appends a region to the given list.
+///
+/// \param list	the list to append to.
+/// \param base	the first address of the region.
+/// \param last	the last address of the region.
+void ArrayRegionList_add( ArrayRegionList* list, phys_addr_t base, phys_addr_t last );
+
+
+/// \brief	Gets the IPmmRegionList implementation of the given ArrayRegionList.
+///
+/// \param list	the list.
+///
+/// \return an IPmmRegionList that enumerates \a list.
+IPmmRegionList ArrayRegionList_getAsPmmRegionList( ArrayRegionList* list );
+
+
+/// \brief	Builds a PC-style memory map covering the given number of bytes.
+///
+/// \param map			receives the memory map.
+/// \param name			name to show in the results.
+/// \param sizeInBytes	size of the physical address space to cover. At least 4 MB.
+///
+/// Maps of 4 GB also get a 1 GB PCI hole at the top.
+void MemMap_create( MemMap* map, const char* name, uint64_t sizeInBytes );
+
+
+#endif
@@ -0,0 +1,544 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/UnitTest/Hosted/PmmBench.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/Apr/30
+//
+// ===========================================================================
+///
+///	\file
+///
+/// \brief	Benchmarks and sanity-checks the physical memory allocators in an
+///			ordinary Linux process.
+///
+/// Each allocator is set up over a synthetic PC-style memory map, then put
+/// through three tests:
+///
+///	- Throughput: allocate a batch of frames, free them again, repeat.
+///	- Fill & drain: allocate every frame, timing each call to find the
+///	  worst-case latency, then free them all in random order.
+///	- Fragmentation: churn at about half occupancy with random allocations and
+///	  frees, then measure the longest run of free frames that is left.
+///
+/// Every frame handed out is checked against a shadow map. Handing out a
+/// frame twice, handing out a frame that isn't free RAM, or failing to hand
+/// out every free frame ("lost frames") makes the program exit with a non-zero
+/// status, so it can be used as a regression test as well as a benchmark.
+///
+/// Usage: hostedtest bench [maxMegabytes]
+///
+/// Memory maps larger than \a maxMegabytes are skipped. The default is to run
+/// every map, up to 4 GB.
+///
+// ===========================================================================
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "Kernel/MM/IPmmAllocator.h"
+#include "Kernel/MM/IPmmRegionList.h"
+#include "Kernel/MM/MM.h"
+#include "Kernel/MM/PageFrameDatabase.h"
+#include "Kernel/MM/PmmBuddyAllocator.h"
+#include "Kernel/MM/PmmRegion.h"
+#include "Kernel/MM/PmmRegionTable.h"
+#include "PmmBitmapAllocator.h"
+#include "PmmFrameCache.h"
+#include "PmmWatermarkAllocator.h"
+#include "MemMap.h"
+
+
+// Private constants
+
+/// \brief	Defines private constants for the benchmark.
+enum PmmBench_consts
+{
+	THROUGHPUT_BATCH	= 64,		///< Frames allocated per round of the throughput test.
+	THROUGHPUT_ROUNDS	= 20000,	///< Rounds of the throughput test.
+	CHURN_STEPS_PER_FRAME = 4		///< Steps of the fragmentation test per free frame.
+};
+
+
+/// \brief	Marks a frame in the shadow map as free RAM that nobody holds.
+static const uint8_t SHADOW_FREE = 1;
+
+/// \brief	Marks a frame in the shadow map as held by the benchmark.
+static const uint8_t SHADOW_HELD = 2;
+
+
+
+// Private types
+
+/// \brief	Everything a test needs to know about the frames it is allocating.
+typedef struct BenchContext
+{
+	size_t		m_numFrames;		///< Frames in the physical address space covered by the map.
+	size_t		m_numFreeFrames;	///< Frames of free RAM at the start of each test.
+	uint8_t*	m_shadow;			///< One SHADOW_xxx value per frame, or zero if not free RAM.
+	phys_addr_t* m_held;			///< Frames currently held by the test.
+	size_t		m_numHeld;			///< Number of entries in m_held.
+	uint64_t	m_rng;				///< State of the random number generator.
+	bool		m_failed;			///< \c true once any consistency check has failed.
+} BenchContext;
+
+
+
+// Private functions
+
+/// \brief	Returns the number of nanoseconds on the monotonic clock.
+static uint64_t PmmBench_now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (((uint64_t) ts.tv_sec) * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+}
+
+
+/// \brief	Returns a pseudo-random number (xorshift64*).
+static uint64_t PmmBench_random( BenchContext* ctx )
+{
+	ctx->m_rng ^= ctx->m_rng >> 12;
+	ctx->m_rng ^= ctx->m_rng << 25;
+	ctx->m_rng ^= ctx->m_rng >> 27;
+	return ctx->m_rng * 2685821657736338717ULL;
+}
+
+
+/// \brief	Reports a consistency failure.
+static void PmmBench_fail( BenchContext* ctx, const char* what, phys_addr_t frameAddr )
+{
+	if (!ctx->m_failed)
+	{
+		printf( "  FAILED: %s (frame 0x%08lx)\n", what, (unsigned long) frameAddr );
+	}
+	ctx->m_failed = true;
+}
+
+
+/// \brief	Records that the test now holds the given frame, checking that it was free.
+static void PmmBench_take( BenchContext* ctx, phys_addr_t frameAddr )
+{
+	size_t frameNumber = MM_getFrameNumber( frameAddr );
+	if (!MM_isFrameAligned( frameAddr ) || (frameNumber >= ctx->m_numFrames) ||
+		(ctx->m_shadow[frameNumber] == 0))
+	{
+		PmmBench_fail( ctx, "handed out a frame that isn't free RAM", frameAddr );
+		return;
+	}
+	if (ctx->m_shadow[frameNumber] == SHADOW_HELD)
+	{
+		PmmBench_fail( ctx, "handed out the same frame twice", frameAddr );
+		return;
+	}
+	ctx->m_shadow[frameNumber] = SHADOW_HELD;
+	ctx->m_held[ctx->m_numHeld++] = frameAddr;
+}
+
+
+/// \brief	Removes the held frame at the given index and returns it.
+static phys_addr_t PmmBench_release( BenchContext* ctx, size_t index )
+{
+	phys_addr_t frameAddr = ctx->m_held[index];
+	ctx->m_held[index] = ctx->m_held[--ctx->m_numHeld];
+	ctx->m_shadow[MM_getFrameNumber( frameAddr )] = SHADOW_FREE;
+	return frameAddr;
+}
+
+
+/// \brief	Measures allocate/free throughput with small batches.
+///
+/// \return the number of million operations (allocations plus frees) per second.
+static double PmmBench_testThroughput( IPmmAllocator allocator )
+{
+	phys_addr_t batch[THROUGHPUT_BATCH];
+	uint64_t numOps = 0;
+
+	uint64_t start = PmmBench_now();
+	for (size_t round = 0; round < THROUGHPUT_ROUNDS; round++)
+	{
+		size_t numAllocated = 0;
+		while (numAllocated < THROUGHPUT_BATCH)
+		{
+			phys_addr_t frameAddr = allocator.iptr->allocate( allocator.obj, NULL );
+			if (frameAddr == PHYS_NULL)
+			{
+				break;
+			}
+			batch[numAllocated++] = frameAddr;
+		}
+
+		// Free in the reverse order, like a stack of temporary buffers would.
+		for (size_t i = numAllocated; i > 0; i--)
+		{
+			allocator.iptr->free( allocator.obj, batch[i - 1] );
+		}
+		numOps += 2 * numAllocated;
+	}
+	uint64_t elapsed = PmmBench_now() - start;
+
+	return (elapsed == 0) ? 0.0 : ((double) numOps * 1000.0) / (double) elapsed;
+}
+
+
+/// \brief	Allocates every frame, timing each allocation.
+///
+/// \param ctx			the benchmark context. Must not be holding any frames.
+/// \param allocator	the allocator to test.
+/// \param meanNs		receives the mean allocation time in nanoseconds.
+/// \param maxNs		receives the worst allocation time in nanoseconds.
+static void PmmBench_testFill(
+	BenchContext*	ctx,
+	IPmmAllocator	allocator,
+	double*			meanNs,
+	uint64_t*		maxNs
+)
+{
+	uint64_t total = 0;
+	uint64_t worst = 0;
+
+	for (;;)
+	{
+		uint64_t start = PmmBench_now();
+		phys_addr_t frameAddr = allocator.iptr->allocate( allocator.obj, NULL );
+		uint64_t elapsed = PmmBench_now() - start;
+
+		if (frameAddr == PHYS_NULL)
+		{
+			break;
+		}
+
+		total += elapsed;
+		if (elapsed > worst)
+		{
+			worst = elapsed;
+		}
+		PmmBench_take( ctx, frameAddr );
+	}
+
+	if (ctx->m_numHeld != ctx->m_numFreeFrames)
+	{
+		PmmBench_fail( ctx, "lost frames; not every free frame was handed out", PHYS_NULL );
+		printf( "          got %lu of %lu\n",
+			(unsigned long) ctx->m_numHeld, (unsigned long) ctx->m_numFreeFrames );
+	}
+
+	*meanNs	= (ctx->m_numHeld == 0) ? 0.0 : (double) total / (double) ctx->m_numHeld;
+	*maxNs	= worst;
+}
+
+
+/// \brief	Frees every frame the test holds, in random order.
+///
+/// \return the mean time per free in nanoseconds.
+static double PmmBench_testDrain( BenchContext* ctx, IPmmAllocator allocator )
+{
+	size_t numFreed = ctx->m_numHeld;
+
+	uint64_t start = PmmBench_now();
+	while (ctx->m_numHeld > 0)
+	{
+		size_t index = (size_t) (PmmBench_random( ctx ) % ctx->m_numHeld);
+		allocator.iptr->free( allocator.obj, PmmBench_release( ctx, index ) );
+	}
+	uint64_t elapsed = PmmBench_now() - start;
+
+	return (numFreed == 0) ? 0.0 : (double) elapsed / (double) numFreed;
+}
+
+
+/// \brief	Churns the allocator at about half occupancy, then measures fragmentation.
+///
+/// \param ctx			the benchmark context. Must not be holding any frames.
+/// \param allocator	the allocator to test.
+/// \param longestRun	receives the length of the longest run of free frames left at the end.
+///
+/// \return the fragmentation index: one minus the longest free run divided by the number of free
+///			frames. Zero means all the free memory is in one piece.
+static double PmmBench_testFragmentation(
+	BenchContext*	ctx,
+	IPmmAllocator	allocator,
+	size_t*			longestRun
+)
+{
+	size_t target = ctx->m_numFreeFrames / 2;
+	size_t numSteps = ctx->m_numFreeFrames * CHURN_STEPS_PER_FRAME;
+
+	for (size_t step = 0; step < numSteps; step++)
+	{
+		// The odds of allocating are even at the target occupancy, and shrink as the number of
+		// frames held grows, so the occupancy drifts around the target.
+		bool shouldAllocate = (ctx->m_numHeld == 0) ||
+			((PmmBench_random( ctx ) % (2 * target + 1)) >= ctx->m_numHeld);
+
+		if (shouldAllocate)
+		{
+			phys_addr_t frameAddr = allocator.iptr->allocate( allocator.obj, NULL );
+			if (frameAddr != PHYS_NULL)
+			{
+				PmmBench_take( ctx, frameAddr );
+			}
+		}
+		else
+		{
+			size_t index = (size_t) (PmmBench_random( ctx ) % ctx->m_numHeld);
+			allocator.iptr->free( allocator.obj, PmmBench_release( ctx, index ) );
+		}
+	}
+
+	// Find the longest run of free RAM that nobody holds.
+	size_t numFree = 0;
+	size_t run = 0;
+	size_t longest = 0;
+	for (size_t i = 0; i < ctx->m_numFrames; i++)
+	{
+		if (ctx->m_shadow[i] == SHADOW_FREE)
+		{
+			numFree++;
+			run++;
+			if (run > longest)
+			{
+				longest = run;
+			}
+		}
+		else
+		{
+			run = 0;
+		}
+	}
+
+	*longestRun = longest;
+	return (numFree == 0) ? 0.0 : 1.0 - ((double) longest / (double) numFree);
+}
+
+
+/// \brief	Runs all the tests against one allocator and prints a line of results.
+///
+/// \param ctx			the benchmark context. Must not be holding any frames.
+/// \param name			the name of the allocator.
+/// \param allocator	the allocator to test. Every free frame of RAM must be free in it.
+/// \param canFree		\c false if the allocator doesn't support freeing (i.e. -- the watermark
+///						allocator). Only the fill test is run in that case.
+static void PmmBench_runAll(
+	BenchContext*	ctx,
+	const char*		name,
+	IPmmAllocator	allocator,
+	bool			canFree
+)
+{
+	double mops = 0.0;
+	double fillMeanNs = 0.0;
+	uint64_t fillMaxNs = 0;
+	double drainMeanNs = 0.0;
+	double fragmentation = 0.0;
+	size_t longestRun = 0;
+
+	if (canFree)
+	{
+		mops = PmmBench_testThroughput( allocator );
+	}
+
+	PmmBench_testFill( ctx, allocator, &fillMeanNs, &fillMaxNs );
+
+	if (canFree)
+	{
+		drainMeanNs = PmmBench_testDrain( ctx, allocator );
+		fragmentation = PmmBench_testFragmentation( ctx, allocator, &longestRun );
+
+		// Give everything back so that the next test starts clean.
+		while (ctx->m_numHeld > 0)
+		{
+			allocator.iptr->free( allocator.obj, PmmBench_release( ctx, ctx->m_numHeld - 1 ) );
+		}
+		printf( "  %-12s %9.2f %10.1f %10lu %10.1f %10lu %8.3f\n",
+			name, mops, fillMeanNs, (unsigned long) fillMaxNs, drainMeanNs,
+			(unsigned long) longestRun, fragmentation );
+	}
+	else
+	{
+		printf( "  %-12s %9s %10.1f %10lu %10s %10s %8s\n",
+			name, "-", fillMeanNs, (unsigned long) fillMaxNs, "-", "-", "-" );
+		ctx->m_numHeld = 0;
+	}
+}
+
+
+/// \brief	Runs every allocator over the given memory map.
+///
+/// \return \c true if all the consistency checks passed.
+static bool PmmBench_runMap( MemMap* map )
+{
+	static PmmRegionTable s_table;
+
+	printf( "\n%s RAM map:\n", map->m_name );
+
+	PmmRegionTable_init(
+		&s_table,
+		ArrayRegionList_getAsPmmRegionList( &(map->m_ramList) ),
+		ArrayRegionList_getAsPmmRegionList( &(map->m_reservedList) ),
+		ArrayRegionList_getAsPmmRegionList( &(map->m_moduleList) )
+	);
+
+	BenchContext ctx;
+	memset( &ctx, 0, sizeof( ctx ) );
+	ctx.m_numFrames	= (size_t) (map->m_sizeInBytes / PAGE_SIZE);
+	ctx.m_shadow	= calloc( ctx.m_numFrames, sizeof( uint8_t ) );
+	ctx.m_held		= calloc( ctx.m_numFrames, sizeof( phys_addr_t ) );
+	ctx.m_rng		= 0x9E3779B97F4A7C15ULL;
+
+	// Work out which frames are free RAM. Only whole frames count, and frame zero is PHYS_NULL.
+	for (size_t i = 0; i < PmmRegionTable_getNumEntries( &s_table ); i++)
+	{
+		PmmRegion region;
+		if (PmmRegionTable_getEntry( &s_table, i, &region ) != PMMREGION_RAM)
+		{
+			continue;
+		}
+
+		uint64_t first = ((uint64_t) PmmRegion_base( &region ) + PAGE_SIZE - 1) / PAGE_SIZE;
+		uint64_t end = ((uint64_t) PmmRegion_last( &region ) + 1) / PAGE_SIZE;
+		for (uint64_t frame = (first == 0) ? 1 : first; frame < end; frame++)
+		{
+			ctx.m_shadow[frame] = SHADOW_FREE;
+			ctx.m_numFreeFrames++;
+		}
+	}
+
+	printf( "  %lu frames of free RAM\n", (unsigned long) ctx.m_numFreeFrames );
+	printf( "  %-12s %9s %10s %10s %10s %10s %8s\n",
+		"allocator", "Mops/s", "fill ns", "fill max", "drain ns", "free run", "frag" );
+
+	// Bitmap allocator, alone and behind the per-processor frame cache.
+	size_t numBlocks = (ctx.m_numFrames + BITS_PER_BLOCK - 1) / BITS_PER_BLOCK;
+	size_t* bitmapSpace =
+		calloc( PmmBitmapAllocator_calculateSpaceInBlocks( numBlocks ), sizeof( size_t ) );
+	PmmBitmapAllocator bitmap = PmmBitmapAllocator_create( bitmapSpace, numBlocks, 0 );
+
+	for (size_t frame = 1; frame < ctx.m_numFrames; frame++)
+	{
+		if (ctx.m_shadow[frame] == SHADOW_FREE)
+		{
+			PmmBitmapAllocator_freeFrames( &bitmap, MM_getFrameAddress( frame ), 1 );
+		}
+	}
+	PmmBench_runAll( &ctx, "bitmap", PmmBitmapAllocator_getAsPmmAllocator( &bitmap ), true );
+
+	PmmFrameCache* cache = malloc( sizeof( PmmFrameCache ) );
+	PmmFrameCache_init( cache, PmmBitmapAllocator_getAsPmmAllocator( &bitmap ) );
+	PmmBench_runAll( &ctx, "frame cache", PmmFrameCache_getAsPmmAllocator( cache ), true );
+	PmmFrameCache_drainAll( cache );
+	free( cache );
+	free( bitmapSpace );
+
+	// Page frame database.
+	size_t pfdbSize = PageFrameDatabase_calculateSizeInBytes( ctx.m_numFrames );
+	void* pfdbSpace = calloc( 1, pfdbSize );
+	PageFrameDatabase pfdb = PageFrameDatabase_create( pfdbSpace, pfdbSize, ctx.m_numFrames );
+
+	for (size_t i = 0; i < PmmRegionTable_getNumEntries( &s_table ); i++)
+	{
+		PmmRegion region;
+		if (PmmRegionTable_getEntry( &s_table, i, &region ) == PMMREGION_RAM)
+		{
+			PageFrameDatabase_setRegionState( &pfdb, region, PFSTATE_FREE );
+		}
+	}
+	PageFrameDatabase_buildFreeList( &pfdb );
+	PmmBench_runAll( &ctx, "pfdb", PageFrameDatabase_getAsPmmAllocator( &pfdb ), true );
+
+	// The PFDB behind the frame cache is what the kernel uses once the PMM is fully initialized.
+	cache = malloc( sizeof( PmmFrameCache ) );
+	PmmFrameCache_init( cache, PageFrameDatabase_getAsPmmAllocator( &pfdb ) );
+	PmmBench_runAll( &ctx, "pfdb cache", PmmFrameCache_getAsPmmAllocator( cache ), true );
+	PmmFrameCache_drainAll( cache );
+	free( cache );
+	free( pfdbSpace );
+
+	// Buddy allocator.
+	size_t buddySize = PmmBuddyAllocator_calculateSizeInBytes( ctx.m_numFrames );
+	void* buddySpace = calloc( 1, buddySize );
+	PmmBuddyAllocator buddy = PmmBuddyAllocator_create( buddySpace, buddySize, 0, ctx.m_numFrames );
+
+	for (size_t frame = 1; frame < ctx.m_numFrames; frame++)
+	{
+		if (ctx.m_shadow[frame] == SHADOW_FREE)
+		{
+			PmmBuddyAllocator_free( &buddy, MM_getFrameAddress( frame ) );
+		}
+	}
+	PmmBench_runAll( &ctx, "buddy", PmmBuddyAllocator_getAsPmmAllocator( &buddy ), true );
+	free( buddySpace );
+
+	// Watermark allocator. It can't free, so it only gets the fill test.
+	static size_t s_watermarkSpace[REGION_SPACE_IN_BLOCKS];
+	PmmRegionTableList ramList = PmmRegionTableList_create( &s_table, PMMREGION_RAM );
+	PmmRegionTableList usedList = PmmRegionTableList_create( &s_table, PMMREGION_USED );
+	PmmWatermarkAllocator watermark =
+		PmmWatermarkAllocator_create(
+			PmmRegionTableList_getAsPmmRegionList( &ramList ),
+			PmmRegionTableList_getAsPmmRegionList( &usedList ),
+			s_watermarkSpace
+		);
+	PmmBench_runAll(
+		&ctx,
+		"watermark",
+		PmmWatermarkAllocator_getAsPmmAllocator( &watermark ),
+		false
+	);
+
+	bool passed = !ctx.m_failed;
+	free( ctx.m_held );
+	free( ctx.m_shadow );
+	return passed;
+}
+
+
+
+// Public functions
+
+/// \brief	Runs the PMM benchmark.
+///
+/// \param argc	the number of arguments after the name of the test.
+/// \param argv	the arguments after the name of the test.
+///
+/// \return \c true if all the consistency checks passed.
+bool DoPmmBench( int argc, char* argv[] )
+{
+	uint64_t maxMegabytes = (argc > 0) ? strtoull( argv[0], NULL, 0 ) : 4096;
+
+	static const struct
+	{
+		const char*	name;
+		uint64_t	megabytes;
+	} s_maps[] =
+	{
+		{ "16 MB",	16 },
+		{ "64 MB",	64 },
+		{ "256 MB",	256 },
+		{ "1 GB",	1024 },
+		{ "4 GB",	4096 }
+	};
+
+	bool passed = true;
+	for (size_t i = 0; i < sizeof( s_maps ) / sizeof( s_maps[0] ); i++)
+	{
+		if (s_maps[i].megabytes > maxMegabytes)
+		{
+			continue;
+		}
+
+		MemMap map;
+		MemMap_create( &map, s_maps[i].name, s_maps[i].megabytes << 20 );
+		passed = PmmBench_runMap( &map ) && passed;
+	}
+
+	return passed;
+}
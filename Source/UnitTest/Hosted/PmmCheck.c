@@ -0,0 +1,1032 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/UnitTest/Hosted/PmmCheck.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/21
+//
+// ===========================================================================
+///
+///	\file
+///
+/// \brief	Checks the behaviour of the PhysicalMemoryManager and the
+///			allocators behind it, one feature at a time.
+///
+/// Unlike the benchmark and the stress tests, these checks are about
+/// getting exact answers rather than measuring anything. Each one sets up
+/// what it needs from scratch, and prints a line saying whether it passed.
+///
+///	- Stage two: frames handed out by the initial allocator before
+///	  initStageTwo() must stay allocated in the PageFrameDatabase, and every
+///	  other frame of RAM must end up free.
+///	- Frame cache: once stage two is done, the kernel allocator is a
+///	  PmmFrameCache in front of the PFDB. The cache must refill a magazine
+///	  from the PFDB a batch at a time, spill a batch back when a magazine
+///	  passes its high-water mark, raid other processors' magazines when the
+///	  PFDB runs dry, and give everything back when drained.
+///	- Colours: with more than one cache colour, a hinted allocate() or
+///	  allocateMany() must return frames of the hinted colours from the PFDB,
+///	  the bitmap, the watermark and the frame cache. The frame cache must find
+///	  a frame of the right colour in its magazine without going to the PFDB.
+///	- Ranges: PhysicalMemoryManager_allocateRange() must return aligned runs
+///	  of free frames below maxAddr, fail without side effects when nothing
+///	  fits, and drain the frame caches before giving up. Two threads racing
+///	  PmmBitmapAllocator_allocateRange() for overlapping runs must never both
+///	  get the same frame, and losing claims must be rolled back.
+///
+/// Usage: hostedtest pmm
+///
+// ===========================================================================
+
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Kernel/MM/IPmmAllocator.h"
+#include "Kernel/MM/MM.h"
+#include "Kernel/MM/PageFrameDatabase.h"
+#include "Kernel/MM/PhysicalMemoryManager.h"
+#include "Kernel/MM/PmmRegionTable.h"
+#include "Kernel/HAL/Atomic.h"
+#include "Kernel/HAL/Processor.h"
+#include "MM/MMHosted.h"
+#include "PmmBitmapAllocator.h"
+#include "PmmFrameCache.h"
+#include "MemMap.h"
+
+
+// Private constants
+
+/// \brief	Defines private constants for the PMM checks.
+enum PmmCheck_consts
+{
+	MAP_MEGABYTES		= 16,	///< Size of the memory map that the checks use.
+	NUM_EARLY_FRAMES	= 37,	///< Frames taken from the initial allocator before stage two.
+	DRAIN_BATCH_SIZE	= 50,	///< Frames per allocateMany() call when draining an allocator.
+	NUM_TEST_COLOURS	= 8,	///< Cache colours to pretend to have for the colour checks.
+	COLOUR_RUN_LENGTH	= 20,	///< Frames per hinted allocateMany() call in the colour checks.
+	LIMITED_RUN_LENGTH	= 16,	///< Frames per run in the maxAddr check.
+	RACE_FREE_FRAMES	= 12,	///< Free frames in the bitmap that the race check fights over.
+	RACE_FREE_BELOW		= 4,	///< How many of those are in the first block of the bitmap.
+	RACE_STRADDLE_RUN	= 6,	///< Frames per run for the race thread that straddles the blocks.
+	RACE_ALIGNED_RUN	= 4,	///< Frames per run for the race thread that starts at the second block.
+	RACE_ITERATIONS		= 2000000	///< Runs each thread tries to claim in the race check.
+};
+
+
+
+// Private types
+
+/// \brief	Which frames of a memory map are free RAM, and which ones a check is holding.
+typedef struct FrameShadow
+{
+	uint8_t*	m_isHeld;		///< For each frame, 1 if the check holds it, 2 if it isn't RAM.
+	size_t		m_numFrames;	///< Frames in the physical address space of the map.
+	size_t		m_numRamFrames;	///< Whole frames of RAM, not counting frame zero.
+} FrameShadow;
+
+
+/// \brief	A fully initialized PhysicalMemoryManager, and what it took to set it up.
+typedef struct PmmFixture
+{
+	MemMap							m_map;			///< The memory map the PMM was built from.
+	void*							m_pfdbSpace;	///< Working space of the PFDB.
+	volatile PhysicalMemoryManager*	m_pmm;			///< The PMM.
+	volatile PageFrameDatabase*		m_pfdb;			///< The PMM's PFDB.
+} PmmFixture;
+
+
+/// \brief	State shared by the threads of the range race check.
+typedef struct RangeRace
+{
+	volatile PmmBitmapAllocator*	m_bitmap;		///< The bitmap being fought over.
+	pthread_barrier_t				m_start;		///< Makes the threads start together.
+	volatile uintptr_t*				m_owners;		///< For each frame, 1 while a thread holds it.
+	volatile uintptr_t				m_numClaims;	///< Runs claimed so far, by either thread.
+	volatile uintptr_t				m_failed;		///< Non-zero once a frame was claimed twice.
+} RangeRace;
+
+
+/// \brief	What one thread of the range race check asks for.
+typedef struct RangeRacer
+{
+	RangeRace*	m_race;			///< The shared state.
+	size_t		m_numFrames;	///< Frames per run.
+	phys_size_t	m_alignment;	///< Alignment of each run.
+} RangeRacer;
+
+
+/// \brief	What a thread that fills its own magazine needs to know, and what it found out.
+typedef struct MagazineFiller
+{
+	volatile PmmFrameCache*	m_cache;		///< The cache whose magazine to fill.
+	int						m_processorId;	///< Receives the ID of the thread's processor.
+} MagazineFiller;
+
+
+/// \brief	Marks a frame in the shadow as held by the check.
+static const uint8_t SHADOW_HELD = 1;
+
+/// \brief	Marks a frame in the shadow as not being RAM.
+static const uint8_t SHADOW_NOT_RAM = 2;
+
+
+
+// Private functions
+
+/// \brief	Reports the result of one check.
+///
+/// \param name		the name of the check.
+/// \param passed	whether it passed.
+/// \param detail	what went wrong, or NULL if it passed.
+///
+/// \return \a passed.
+static bool PmmCheck_report( const char* name, bool passed, const char* detail )
+{
+	printf( "  %-28s %s", name, passed ? "OK" : "FAILED" );
+	if (!passed && (detail != NULL))
+	{
+		printf( " (%s)", detail );
+	}
+	printf( "\n" );
+	return passed;
+}
+
+
+/// \brief	Works out which frames of the given region table are whole frames of RAM.
+///
+/// \param shadow	receives the result. Free it with PmmCheck_destroyShadow().
+/// \param table	the region table.
+/// \param map		the memory map that \a table was built from.
+static void PmmCheck_createShadow(
+	FrameShadow*			shadow,
+	const PmmRegionTable*	table,
+	const MemMap*			map
+)
+{
+	shadow->m_numFrames		= (size_t) (map->m_sizeInBytes / PAGE_SIZE);
+	shadow->m_numRamFrames	= 0;
+	shadow->m_isHeld		= malloc( shadow->m_numFrames );
+	memset( shadow->m_isHeld, SHADOW_NOT_RAM, shadow->m_numFrames );
+
+	for (size_t i = 0; i < PmmRegionTable_getNumEntries( table ); i++)
+	{
+		PmmRegion region;
+		if (PmmRegionTable_getEntry( table, i, &region ) != PMMREGION_RAM)
+		{
+			continue;
+		}
+
+		// Only whole frames count, and frame zero is PHYS_NULL.
+		uint64_t first = ((uint64_t) PmmRegion_base( &region ) + PAGE_SIZE - 1) / PAGE_SIZE;
+		uint64_t end = ((uint64_t) PmmRegion_last( &region ) + 1) / PAGE_SIZE;
+		for (uint64_t frame = (first == 0) ? 1 : first; frame < end; frame++)
+		{
+			shadow->m_isHeld[frame] = 0;
+			shadow->m_numRamFrames++;
+		}
+	}
+}
+
+
+/// \brief	Frees the memory used by the given shadow.
+static void PmmCheck_destroyShadow( FrameShadow* shadow )
+{
+	free( shadow->m_isHeld );
+	shadow->m_isHeld = NULL;
+}
+
+
+/// \brief	Records that the check now holds the given frame.
+///
+/// \param shadow		the shadow of the memory map.
+/// \param frameAddr	the frame that an allocator just handed out.
+///
+/// \return \c true if the frame was free RAM; \c false if it wasn't RAM, or was already held.
+static bool PmmCheck_take( FrameShadow* shadow, phys_addr_t frameAddr )
+{
+	size_t frameNumber = MM_getFrameNumber( frameAddr );
+	if (!MM_isFrameAligned( frameAddr ) || (frameNumber >= shadow->m_numFrames) ||
+		(shadow->m_isHeld[frameNumber] != 0))
+	{
+		return false;
+	}
+	shadow->m_isHeld[frameNumber] = SHADOW_HELD;
+	return true;
+}
+
+
+/// \brief	Initializes the PhysicalMemoryManager over the given memory map, as far as stage one.
+///
+/// \param map	the memory map.
+///
+/// \return the number of bytes of working space that stage two needs.
+static size_t PmmCheck_initStageOne( MemMap* map )
+{
+	return PhysicalMemoryManager_initStageOne(
+		ArrayRegionList_getAsPmmRegionList( &(map->m_ramList) ),
+		ArrayRegionList_getAsPmmRegionList( &(map->m_reservedList) ),
+		ArrayRegionList_getAsPmmRegionList( &(map->m_moduleList) )
+	);
+}
+
+
+/// \brief	Initializes the PhysicalMemoryManager all the way over a fresh memory map.
+///
+/// \param fixture	receives the PMM. Free it with PmmCheck_destroyFixture().
+static void PmmCheck_createFixture( PmmFixture* fixture )
+{
+	MemMap_create( &(fixture->m_map), "16 MB", ((uint64_t) MAP_MEGABYTES) << 20 );
+	size_t pfdbSize = PmmCheck_initStageOne( &(fixture->m_map) );
+
+	fixture->m_pfdbSpace = calloc( 1, pfdbSize );
+	PhysicalMemoryManager_initStageTwo( fixture->m_pfdbSpace, pfdbSize );
+
+	fixture->m_pmm	= PhysicalMemoryManager_getInstance();
+	fixture->m_pfdb	= PhysicalMemoryManager_getPageFrameDatabase( fixture->m_pmm );
+}
+
+
+/// \brief	Frees the memory used by the given fixture.
+static void PmmCheck_destroyFixture( PmmFixture* fixture )
+{
+	free( fixture->m_pfdbSpace );
+	fixture->m_pfdbSpace = NULL;
+}
+
+
+/// \brief	Thread that leaves exactly one batch of frames in its own processor's magazine.
+///
+/// \param arg	the MagazineFiller.
+///
+/// \return NULL.
+static void* PmmCheck_fillMagazine( void* arg )
+{
+	MagazineFiller* filler = arg;
+	filler->m_processorId = Processor_getID( Processor_getCurrent() );
+
+	// Allocating from an empty magazine refills it with a batch, and freeing the frame tops it
+	// back up again.
+	IPmmAllocator allocator = PmmFrameCache_getAsPmmAllocator( filler->m_cache );
+	phys_addr_t frameAddr = allocator.iptr->allocate( allocator.obj, NULL );
+	if (frameAddr != PHYS_NULL)
+	{
+		allocator.iptr->free( allocator.obj, frameAddr );
+	}
+	return NULL;
+}
+
+
+/// \brief	Leaves one batch of frames in the magazine of a processor other than the current one.
+///
+/// \param cache	the PmmFrameCache.
+///
+/// \return \c true if the frames ended up in some other processor's magazine.
+static bool PmmCheck_fillOtherMagazine( volatile PmmFrameCache* cache )
+{
+	MagazineFiller filler;
+	filler.m_cache			= cache;
+	filler.m_processorId	= -1;
+
+	pthread_t thread;
+	if (pthread_create( &thread, NULL, PmmCheck_fillMagazine, &filler ) != 0)
+	{
+		return false;
+	}
+	pthread_join( thread, NULL );
+
+	return (filler.m_processorId >= 0) &&
+		(filler.m_processorId != Processor_getID( Processor_getCurrent() ));
+}
+
+
+/// \brief	Checks that initStageTwo() hands the initial allocator's free frames to the PFDB.
+///
+/// \return \c true if the check passed.
+static bool PmmCheck_stageTwo( void )
+{
+	const char* name = "stage two hand-off";
+
+	MemMap map;
+	MemMap_create( &map, "16 MB", ((uint64_t) MAP_MEGABYTES) << 20 );
+	size_t pfdbSize = PmmCheck_initStageOne( &map );
+
+	volatile PhysicalMemoryManager* pmm = PhysicalMemoryManager_getInstance();
+	FrameShadow shadow;
+	PmmCheck_createShadow( &shadow, PhysicalMemoryManager_getRegionTable( pmm ), &map );
+
+	// Take some frames while still in "initialization mode". These must never come back.
+	IPmmAllocator initial = PhysicalMemoryManager_getAllocator( pmm );
+	phys_addr_t early[NUM_EARLY_FRAMES];
+	bool passed = true;
+	for (size_t i = 0; i < NUM_EARLY_FRAMES; i++)
+	{
+		early[i] = initial.iptr->allocate( initial.obj, NULL );
+		passed = passed && PmmCheck_take( &shadow, early[i] );
+	}
+
+	void* pfdbSpace = calloc( 1, pfdbSize );
+	PhysicalMemoryManager_initStageTwo( pfdbSpace, pfdbSize );
+
+	volatile PageFrameDatabase* pfdb = PhysicalMemoryManager_getPageFrameDatabase( pmm );
+	size_t expectedFree = shadow.m_numRamFrames - NUM_EARLY_FRAMES;
+	passed = passed && (PageFrameDatabase_getNumFreeFrames( pfdb ) == expectedFree);
+
+	for (size_t i = 0; i < NUM_EARLY_FRAMES; i++)
+	{
+		passed = passed && (PageFrameDatabase_getFrameState( pfdb, early[i] ) == PFSTATE_KERNEL);
+	}
+
+	// Everything else that is RAM must come out of the PFDB exactly once.
+	IPmmAllocator allocator = PhysicalMemoryManager_getAllocator( pmm );
+	size_t numDrained = 0;
+	size_t numInBatch;
+	do
+	{
+		phys_addr_t batch[DRAIN_BATCH_SIZE];
+		numInBatch = allocator.iptr->allocateMany( allocator.obj, batch, DRAIN_BATCH_SIZE, NULL );
+		for (size_t i = 0; i < numInBatch; i++)
+		{
+			passed = passed && PmmCheck_take( &shadow, batch[i] );
+		}
+		numDrained += numInBatch;
+	} while (numInBatch == DRAIN_BATCH_SIZE);
+
+	passed = passed && (numDrained == expectedFree);
+
+	PmmCheck_destroyShadow( &shadow );
+	free( pfdbSpace );
+	return PmmCheck_report( name, passed, "PFDB doesn't match what the initial allocator had left" );
+}
+
+
+/// \brief	Checks that the PMM's kernel allocator is a frame cache in front of the PFDB.
+///
+/// \return \c true if the check passed.
+static bool PmmCheck_frameCacheInstalled( void )
+{
+	PmmFixture fixture;
+	PmmCheck_createFixture( &fixture );
+
+	size_t numFree = PageFrameDatabase_getNumFreeFrames( fixture.m_pfdb );
+
+	// The first allocation refills this processor's magazine, so the PFDB loses a whole batch.
+	IPmmAllocator allocator = PhysicalMemoryManager_getAllocator( fixture.m_pmm );
+	phys_addr_t frameAddr = allocator.iptr->allocate( allocator.obj, NULL );
+	bool passed = (frameAddr != PHYS_NULL) &&
+		(PageFrameDatabase_getNumFreeFrames( fixture.m_pfdb ) == numFree - FRAME_CACHE_BATCH_SIZE);
+
+	// Freeing it leaves it in the magazine until the caches are drained.
+	allocator.iptr->free( allocator.obj, frameAddr );
+	passed = passed &&
+		(PageFrameDatabase_getNumFreeFrames( fixture.m_pfdb ) == numFree - FRAME_CACHE_BATCH_SIZE);
+
+	PhysicalMemoryManager_drainFrameCaches( fixture.m_pmm );
+	passed = passed && (PageFrameDatabase_getNumFreeFrames( fixture.m_pfdb ) == numFree);
+
+	PmmCheck_destroyFixture( &fixture );
+	return PmmCheck_report( "frame cache installed", passed, "PMM allocator bypasses the cache" );
+}
+
+
+/// \brief	Checks that an empty magazine is refilled from the PFDB one batch at a time.
+///
+/// \return \c true if the check passed.
+static bool PmmCheck_frameCacheRefill( void )
+{
+	PmmFixture fixture;
+	PmmCheck_createFixture( &fixture );
+
+	PmmFrameCache* cache = malloc( sizeof( PmmFrameCache ) );
+	PmmFrameCache_init( cache, PageFrameDatabase_getAsPmmAllocator( fixture.m_pfdb ) );
+	IPmmAllocator allocator = PmmFrameCache_getAsPmmAllocator( cache );
+
+	size_t numFree = PageFrameDatabase_getNumFreeFrames( fixture.m_pfdb );
+	phys_addr_t held[2 * FRAME_CACHE_BATCH_SIZE];
+	bool passed = true;
+
+	// The PFDB should only be touched on the first allocation of each batch.
+	for (size_t i = 0; i < 2 * FRAME_CACHE_BATCH_SIZE; i++)
+	{
+		held[i] = allocator.iptr->allocate( allocator.obj, NULL );
+
+		size_t numRefills = (i / FRAME_CACHE_BATCH_SIZE) + 1;
+		passed = passed && (held[i] != PHYS_NULL) &&
+			(PageFrameDatabase_getNumFreeFrames( fixture.m_pfdb ) ==
+				numFree - (numRefills * FRAME_CACHE_BATCH_SIZE));
+	}
+
+	allocator.iptr->freeMany( allocator.obj, held, 2 * FRAME_CACHE_BATCH_SIZE );
+	PmmFrameCache_drainAll( cache );
+	passed = passed && (PageFrameDatabase_getNumFreeFrames( fixture.m_pfdb ) == numFree);
+
+	free( cache );
+	PmmCheck_destroyFixture( &fixture );
+	return PmmCheck_report( "frame cache refill", passed, "wrong number of frames taken from PFDB" );
+}
+
+
+/// \brief	Checks that a magazine spills a batch back to the PFDB when it passes its high-water
+///			mark.
+///
+/// \return \c true if the check passed.
+static bool PmmCheck_frameCacheSpill( void )
+{
+	PmmFixture fixture;
+	PmmCheck_createFixture( &fixture );
+
+	PmmFrameCache* cache = malloc( sizeof( PmmFrameCache ) );
+	PmmFrameCache_init( cache, PageFrameDatabase_getAsPmmAllocator( fixture.m_pfdb ) );
+	IPmmAllocator allocator = PmmFrameCache_getAsPmmAllocator( cache );
+
+	// With every magazine empty, allocateMany() takes everything straight from the PFDB.
+	enum { NUM_HELD = FRAME_CACHE_HIGH_WATER + 1 };
+	size_t numFree = PageFrameDatabase_getNumFreeFrames( fixture.m_pfdb );
+	phys_addr_t held[NUM_HELD];
+	size_t numHeld = allocator.iptr->allocateMany( allocator.obj, held, NUM_HELD, NULL );
+	bool passed = (numHeld == NUM_HELD) &&
+		(PageFrameDatabase_getNumFreeFrames( fixture.m_pfdb ) == numFree - NUM_HELD);
+
+	// Frees stay in the magazine up to the high-water mark. The one after that spills a batch.
+	for (size_t i = 0; i < NUM_HELD; i++)
+	{
+		allocator.iptr->free( allocator.obj, held[i] );
+
+		size_t expected = (i < FRAME_CACHE_HIGH_WATER)
+			? numFree - NUM_HELD
+			: numFree - NUM_HELD + FRAME_CACHE_BATCH_SIZE;
+		passed = passed && (PageFrameDatabase_getNumFreeFrames( fixture.m_pfdb ) == expected);
+	}
+
+	PmmFrameCache_drainAll( cache );
+	passed = passed && (PageFrameDatabase_getNumFreeFrames( fixture.m_pfdb ) == numFree);
+
+	free( cache );
+	PmmCheck_destroyFixture( &fixture );
+	return PmmCheck_report( "frame cache spill", passed, "wrong number of frames given to PFDB" );
+}
+
+
+/// \brief	Checks that another processor's magazine is raided once the PFDB runs dry.
+///
+/// \return \c true if the check passed.
+static bool PmmCheck_frameCacheRaid( void )
+{
+	PmmFixture fixture;
+	PmmCheck_createFixture( &fixture );
+
+	FrameShadow shadow;
+	PmmCheck_createShadow(
+		&shadow,
+		PhysicalMemoryManager_getRegionTable( fixture.m_pmm ),
+		&(fixture.m_map)
+	);
+
+	PmmFrameCache* cache = malloc( sizeof( PmmFrameCache ) );
+	PmmFrameCache_init( cache, PageFrameDatabase_getAsPmmAllocator( fixture.m_pfdb ) );
+	IPmmAllocator allocator = PmmFrameCache_getAsPmmAllocator( cache );
+
+	size_t numFree = PageFrameDatabase_getNumFreeFrames( fixture.m_pfdb );
+	bool passed = PmmCheck_fillOtherMagazine( cache );
+	passed = passed &&
+		(PageFrameDatabase_getNumFreeFrames( fixture.m_pfdb ) == numFree - FRAME_CACHE_BATCH_SIZE);
+
+	// This processor can only get every free frame by raiding the other one's magazine at the end.
+	size_t numDrained = 0;
+	phys_addr_t frameAddr = allocator.iptr->allocate( allocator.obj, NULL );
+	while (frameAddr != PHYS_NULL)
+	{
+		passed = passed && PmmCheck_take( &shadow, frameAddr );
+		numDrained++;
+		frameAddr = allocator.iptr->allocate( allocator.obj, NULL );
+	}
+	passed = passed && (numDrained == numFree) &&
+		(PageFrameDatabase_getNumFreeFrames( fixture.m_pfdb ) == 0);
+
+	free( cache );
+	PmmCheck_destroyShadow( &shadow );
+	PmmCheck_destroyFixture( &fixture );
+	return PmmCheck_report( "frame cache raid", passed, "frames stranded in a magazine" );
+}
+
+
+/// \brief	Checks that drainAll() empties every processor's magazine, not just the current one.
+///
+/// \return \c true if the check passed.
+static bool PmmCheck_frameCacheDrainAll( void )
+{
+	PmmFixture fixture;
+	PmmCheck_createFixture( &fixture );
+
+	PmmFrameCache* cache = malloc( sizeof( PmmFrameCache ) );
+	PmmFrameCache_init( cache, PageFrameDatabase_getAsPmmAllocator( fixture.m_pfdb ) );
+	IPmmAllocator allocator = PmmFrameCache_getAsPmmAllocator( cache );
+
+	size_t numFree = PageFrameDatabase_getNumFreeFrames( fixture.m_pfdb );
+
+	// Leave a batch in this processor's magazine, and another in some other processor's.
+	allocator.iptr->free( allocator.obj, allocator.iptr->allocate( allocator.obj, NULL ) );
+	bool passed = PmmCheck_fillOtherMagazine( cache );
+	passed = passed &&
+		(PageFrameDatabase_getNumFreeFrames( fixture.m_pfdb ) ==
+			numFree - (2 * FRAME_CACHE_BATCH_SIZE));
+
+	PmmFrameCache_drainAll( cache );
+	passed = passed && (PageFrameDatabase_getNumFreeFrames( fixture.m_pfdb ) == numFree);
+
+	free( cache );
+	PmmCheck_destroyFixture( &fixture );
+	return PmmCheck_report( "frame cache drainAll", passed, "frames left in a magazine" );
+}
+
+
+/// \brief	Gets an address in a virtual page of the given colour, for use as a colour hint.
+///
+/// \param colour	the colour.
+///
+/// \return a colour hint; Never NULL, even for colour zero.
+static void* PmmCheck_getColourHint( size_t colour )
+{
+	return (void*) (uintptr_t) ((NUM_TEST_COLOURS + colour) * PAGE_SIZE);
+}
+
+
+/// \brief	Checks whether the given frame has the given colour.
+static bool PmmCheck_hasColour( phys_addr_t frameAddr, size_t colour )
+{
+	return (frameAddr != PHYS_NULL) &&
+		(MM_getFrameColour( MM_getFrameNumber( frameAddr ), NUM_TEST_COLOURS ) == colour);
+}
+
+
+/// \brief	Checks that the given allocator honours colour hints while it has plenty of frames.
+///
+/// \param allocator	the allocator. MM_getNumCacheColours() must have been NUM_TEST_COLOURS
+///						when it was created.
+///
+/// The frames are not freed, so that this works for the watermark allocator too.
+///
+/// \return \c true if every frame had the hinted colour.
+static bool PmmCheck_allocateColours( IPmmAllocator allocator )
+{
+	bool passed = true;
+
+	// Go through the colours backwards, so that an allocator that ignores the hint and hands out
+	// frames in address order can't pass by accident.
+	for (size_t i = NUM_TEST_COLOURS; i > 0; i--)
+	{
+		phys_addr_t frameAddr =
+			allocator.iptr->allocate( allocator.obj, PmmCheck_getColourHint( i - 1 ) );
+		passed = passed && PmmCheck_hasColour( frameAddr, i - 1 );
+	}
+
+	// Frame i of a run should match page i of the hint.
+	size_t firstColour = 3;
+	phys_addr_t run[COLOUR_RUN_LENGTH];
+	size_t numInRun = allocator.iptr->allocateMany(
+		allocator.obj,
+		run,
+		COLOUR_RUN_LENGTH,
+		PmmCheck_getColourHint( firstColour )
+	);
+	passed = passed && (numInRun == COLOUR_RUN_LENGTH);
+
+	for (size_t i = 0; i < numInRun; i++)
+	{
+		passed = passed && PmmCheck_hasColour( run[i], (firstColour + i) % NUM_TEST_COLOURS );
+	}
+	return passed;
+}
+
+
+/// \brief	Checks that each allocator returns frames of the hinted colour.
+///
+/// \return \c true if the check passed.
+static bool PmmCheck_colours( void )
+{
+	MM_hosted_setNumCacheColours( NUM_TEST_COLOURS );
+
+	// Watermark: the PMM's allocator before stage two.
+	PmmFixture fixture;
+	MemMap_create( &(fixture.m_map), "16 MB", ((uint64_t) MAP_MEGABYTES) << 20 );
+	size_t pfdbSize = PmmCheck_initStageOne( &(fixture.m_map) );
+
+	volatile PhysicalMemoryManager* pmm = PhysicalMemoryManager_getInstance();
+	bool watermarkPassed = PmmCheck_allocateColours( PhysicalMemoryManager_getAllocator( pmm ) );
+
+	// PFDB.
+	fixture.m_pfdbSpace = calloc( 1, pfdbSize );
+	PhysicalMemoryManager_initStageTwo( fixture.m_pfdbSpace, pfdbSize );
+	fixture.m_pmm	= pmm;
+	fixture.m_pfdb	= PhysicalMemoryManager_getPageFrameDatabase( pmm );
+	bool pfdbPassed =
+		PmmCheck_allocateColours( PageFrameDatabase_getAsPmmAllocator( fixture.m_pfdb ) );
+
+	// Frame cache, from the PFDB and from its magazine. The cache has to go to the PFDB the first
+	// time, since its magazines start out empty.
+	PmmFrameCache* cache = malloc( sizeof( PmmFrameCache ) );
+	PmmFrameCache_init( cache, PageFrameDatabase_getAsPmmAllocator( fixture.m_pfdb ) );
+	IPmmAllocator allocator = PmmFrameCache_getAsPmmAllocator( cache );
+	bool cachePassed = PmmCheck_allocateColours( allocator );
+
+	phys_addr_t frameAddr = allocator.iptr->allocate( allocator.obj, NULL );
+	size_t colour = MM_getFrameColour( MM_getFrameNumber( frameAddr ), NUM_TEST_COLOURS );
+	allocator.iptr->free( allocator.obj, frameAddr );
+
+	size_t numFree = PageFrameDatabase_getNumFreeFrames( fixture.m_pfdb );
+	phys_addr_t sameFrameAddr = allocator.iptr->allocate( allocator.obj, PmmCheck_getColourHint( colour ) );
+	cachePassed = cachePassed && (sameFrameAddr == frameAddr) &&
+		(PageFrameDatabase_getNumFreeFrames( fixture.m_pfdb ) == numFree);
+
+	free( cache );
+	PmmCheck_destroyFixture( &fixture );
+
+	// Bitmap, over the same memory map.
+	MemMap map;
+	MemMap_create( &map, "16 MB", ((uint64_t) MAP_MEGABYTES) << 20 );
+	PmmCheck_initStageOne( &map );
+
+	FrameShadow shadow;
+	PmmCheck_createShadow( &shadow, PhysicalMemoryManager_getRegionTable( pmm ), &map );
+
+	size_t numBlocks = (shadow.m_numFrames + BITS_PER_BLOCK - 1) / BITS_PER_BLOCK;
+	size_t* bitmapSpace =
+		calloc( PmmBitmapAllocator_calculateSpaceInBlocks( numBlocks ), sizeof( size_t ) );
+	PmmBitmapAllocator bitmap = PmmBitmapAllocator_create( bitmapSpace, numBlocks, 0 );
+
+	for (size_t frame = 1; frame < shadow.m_numFrames; frame++)
+	{
+		if (shadow.m_isHeld[frame] == 0)
+		{
+			PmmBitmapAllocator_freeFrames( &bitmap, MM_getFrameAddress( frame ), 1 );
+		}
+	}
+	bool bitmapPassed =
+		PmmCheck_allocateColours( PmmBitmapAllocator_getAsPmmAllocator( &bitmap ) );
+
+	free( bitmapSpace );
+	PmmCheck_destroyShadow( &shadow );
+
+	MM_hosted_setNumCacheColours( 1 );
+
+	bool passed = true;
+	passed = PmmCheck_report( "colours: watermark", watermarkPassed, "wrong colour" ) && passed;
+	passed = PmmCheck_report( "colours: pfdb", pfdbPassed, "wrong colour" ) && passed;
+	passed = PmmCheck_report( "colours: bitmap", bitmapPassed, "wrong colour" ) && passed;
+	passed = PmmCheck_report( "colours: frame cache", cachePassed, "wrong colour" ) && passed;
+	return passed;
+}
+
+
+/// \brief	Checks that every frame of the given run was free RAM, and is now allocated.
+///
+/// \param shadow			the shadow of the memory map. The frames are marked as held.
+/// \param pfdb				the PFDB that handed out the run.
+/// \param firstFrameAddr	the first frame of the run.
+/// \param numFrames		the number of frames in the run.
+///
+/// \return \c true if the run is good.
+static bool PmmCheck_takeRun(
+	FrameShadow*				shadow,
+	volatile PageFrameDatabase*	pfdb,
+	phys_addr_t					firstFrameAddr,
+	size_t						numFrames
+)
+{
+	bool passed = (firstFrameAddr != PHYS_NULL);
+	for (size_t i = 0; passed && (i < numFrames); i++)
+	{
+		phys_addr_t frameAddr = firstFrameAddr + (phys_addr_t) (i * PAGE_SIZE);
+		passed = PmmCheck_take( shadow, frameAddr ) &&
+			(PageFrameDatabase_getFrameState( pfdb, frameAddr ) == PFSTATE_KERNEL);
+	}
+	return passed;
+}
+
+
+/// \brief	Checks that allocateRange() honours the alignment, and that freeRange() undoes it.
+///
+/// \return \c true if the check passed.
+static bool PmmCheck_rangeAlignment( void )
+{
+	static const struct
+	{
+		size_t		numFrames;
+		phys_size_t	alignment;
+	} s_requests[] =
+	{
+		{ 3,	0 },
+		{ 5,	2 * PAGE_SIZE },
+		{ 16,	64 * 1024 },
+		{ 100,	1024 * 1024 }	// The first 1 MB boundary is in the module region.
+	};
+	enum { NUM_REQUESTS = sizeof( s_requests ) / sizeof( s_requests[0] ) };
+
+	PmmFixture fixture;
+	PmmCheck_createFixture( &fixture );
+
+	FrameShadow shadow;
+	PmmCheck_createShadow(
+		&shadow,
+		PhysicalMemoryManager_getRegionTable( fixture.m_pmm ),
+		&(fixture.m_map)
+	);
+
+	size_t numFree = PageFrameDatabase_getNumFreeFrames( fixture.m_pfdb );
+	size_t numAllocated = 0;
+	phys_addr_t runs[NUM_REQUESTS];
+	bool passed = true;
+
+	for (size_t i = 0; i < NUM_REQUESTS; i++)
+	{
+		size_t numFrames = s_requests[i].numFrames;
+		phys_size_t alignment = s_requests[i].alignment;
+
+		runs[i] = PhysicalMemoryManager_allocateRange( fixture.m_pmm, numFrames, alignment, MAX_PHYS_ADDR );
+		passed = passed && PmmCheck_takeRun( &shadow, fixture.m_pfdb, runs[i], numFrames );
+		passed = passed && ((alignment == 0) || ((runs[i] & (alignment - 1)) == 0));
+		numAllocated += numFrames;
+	}
+	passed = passed && (PageFrameDatabase_getNumFreeFrames( fixture.m_pfdb ) == numFree - numAllocated);
+
+	for (size_t i = 0; i < NUM_REQUESTS; i++)
+	{
+		PhysicalMemoryManager_freeRange( fixture.m_pmm, runs[i], s_requests[i].numFrames );
+	}
+	passed = passed && (PageFrameDatabase_getNumFreeFrames( fixture.m_pfdb ) == numFree);
+
+	PmmCheck_destroyShadow( &shadow );
+	PmmCheck_destroyFixture( &fixture );
+	return PmmCheck_report( "range alignment", passed, "misaligned or overlapping run" );
+}
+
+
+/// \brief	Checks that allocateRange() never hands out a frame above maxAddr.
+///
+/// \return \c true if the check passed.
+static bool PmmCheck_rangeMaxAddr( void )
+{
+	PmmFixture fixture;
+	PmmCheck_createFixture( &fixture );
+
+	FrameShadow shadow;
+	PmmCheck_createShadow(
+		&shadow,
+		PhysicalMemoryManager_getRegionTable( fixture.m_pmm ),
+		&(fixture.m_map)
+	);
+
+	// Make the limit straddle a frame, which then doesn't count.
+	phys_addr_t maxAddr = 0x002FFFFE;
+	size_t endFrameNumber = MM_getFrameNumber( maxAddr );
+
+	// Work out how many runs should fit below the limit, using the shadow.
+	size_t numExpected = 0;
+	size_t runLength = 0;
+	for (size_t frame = 1; frame <= endFrameNumber; frame++)
+	{
+		runLength = ((frame < endFrameNumber) && (shadow.m_isHeld[frame] == 0)) ? runLength + 1 : 0;
+		if (runLength == LIMITED_RUN_LENGTH)
+		{
+			numExpected++;
+			runLength = 0;
+		}
+	}
+
+	// Take runs until there are no more below the limit.
+	size_t numRuns = 0;
+	bool passed = true;
+	phys_addr_t firstFrameAddr =
+		PhysicalMemoryManager_allocateRange( fixture.m_pmm, LIMITED_RUN_LENGTH, 0, maxAddr );
+
+	while (firstFrameAddr != PHYS_NULL)
+	{
+		phys_addr_t lastAddr = firstFrameAddr + (LIMITED_RUN_LENGTH * PAGE_SIZE) - 1;
+		passed = passed && (lastAddr <= maxAddr) &&
+			PmmCheck_takeRun( &shadow, fixture.m_pfdb, firstFrameAddr, LIMITED_RUN_LENGTH );
+		numRuns++;
+		firstFrameAddr =
+			PhysicalMemoryManager_allocateRange( fixture.m_pmm, LIMITED_RUN_LENGTH, 0, maxAddr );
+	}
+	passed = passed && (numRuns == numExpected) && (numExpected > 0);
+
+	// There is still plenty of room once the run may cross the limit.
+	firstFrameAddr =
+		PhysicalMemoryManager_allocateRange( fixture.m_pmm, LIMITED_RUN_LENGTH, 0, MAX_PHYS_ADDR );
+	passed = passed && (firstFrameAddr != PHYS_NULL) &&
+		(firstFrameAddr + (LIMITED_RUN_LENGTH * PAGE_SIZE) - 1 > maxAddr) &&
+		PmmCheck_takeRun( &shadow, fixture.m_pfdb, firstFrameAddr, LIMITED_RUN_LENGTH );
+
+	PmmCheck_destroyShadow( &shadow );
+	PmmCheck_destroyFixture( &fixture );
+	return PmmCheck_report( "range maxAddr", passed, "run above maxAddr, or runs missed" );
+}
+
+
+/// \brief	Checks that allocateRange() fails cleanly when no run fits.
+///
+/// \return \c true if the check passed.
+static bool PmmCheck_rangeNoFit( void )
+{
+	PmmFixture fixture;
+	PmmCheck_createFixture( &fixture );
+
+	size_t numFree = PageFrameDatabase_getNumFreeFrames( fixture.m_pfdb );
+	volatile PhysicalMemoryManager* pmm = fixture.m_pmm;
+
+	// There are holes in RAM, so all of it can't be contiguous. Only frame zero lies below the
+	// second limit, and only frame zero is aligned on 16 MB.
+	bool passed =
+		(PhysicalMemoryManager_allocateRange( pmm, numFree, 0, MAX_PHYS_ADDR ) == PHYS_NULL) &&
+		(PhysicalMemoryManager_allocateRange( pmm, 1, 0, PAGE_SIZE - 1 ) == PHYS_NULL) &&
+		(PhysicalMemoryManager_allocateRange( pmm, 1, MAP_MEGABYTES << 20, MAX_PHYS_ADDR ) == PHYS_NULL);
+
+	// Nothing may have been taken, and the free lists must still be intact.
+	passed = passed && (PageFrameDatabase_getNumFreeFrames( fixture.m_pfdb ) == numFree);
+
+	IPmmAllocator allocator = PageFrameDatabase_getAsPmmAllocator( fixture.m_pfdb );
+	size_t numDrained = 0;
+	phys_addr_t frameAddr = allocator.iptr->allocate( allocator.obj, NULL );
+	while (frameAddr != PHYS_NULL)
+	{
+		numDrained++;
+		frameAddr = allocator.iptr->allocate( allocator.obj, NULL );
+	}
+	passed = passed && (numDrained == numFree);
+
+	PmmCheck_destroyFixture( &fixture );
+	return PmmCheck_report( "range no fit", passed, "failed request changed the PFDB" );
+}
+
+
+/// \brief	Checks that allocateRange() drains the frame caches before giving up.
+///
+/// \return \c true if the check passed.
+static bool PmmCheck_rangeDrainsCaches( void )
+{
+	PmmFixture fixture;
+	PmmCheck_createFixture( &fixture );
+
+	// The first allocation leaves the lowest batch of frames in this processor's magazine.
+	IPmmAllocator allocator = PhysicalMemoryManager_getAllocator( fixture.m_pmm );
+	allocator.iptr->free( allocator.obj, allocator.iptr->allocate( allocator.obj, NULL ) );
+
+	// All of the RAM below 640 KB can only be had once the magazine has been drained.
+	phys_addr_t maxAddr = 0x0009EFFF;
+	size_t numFrames = MM_getFrameNumber( maxAddr );
+	phys_addr_t firstFrameAddr =
+		PhysicalMemoryManager_allocateRange( fixture.m_pmm, numFrames, 0, maxAddr );
+
+	bool passed = (firstFrameAddr == PAGE_SIZE);
+
+	PmmCheck_destroyFixture( &fixture );
+	return PmmCheck_report( "range drains caches", passed, "frames stranded in a magazine" );
+}
+
+
+/// \brief	Thread that keeps claiming and freeing runs that overlap the other thread's runs.
+///
+/// \param arg	the RangeRacer.
+///
+/// \return NULL.
+static void* PmmCheck_raceForRanges( void* arg )
+{
+	RangeRacer* racer = arg;
+	RangeRace* race = racer->m_race;
+	size_t numFrames = racer->m_numFrames;
+	pthread_barrier_wait( &(race->m_start) );
+
+	for (size_t i = 0; (i < RACE_ITERATIONS) && (Atomic_read( &(race->m_failed) ) == 0); i++)
+	{
+		phys_addr_t firstFrameAddr = PmmBitmapAllocator_allocateRange(
+			race->m_bitmap,
+			numFrames,
+			racer->m_alignment,
+			MAX_PHYS_ADDR
+		);
+		if (firstFrameAddr == PHYS_NULL)
+		{
+			continue;
+		}
+
+		// Nobody else may be holding any frame of the run.
+		size_t firstFrame = MM_getFrameNumber( firstFrameAddr );
+		for (size_t frame = firstFrame; frame < firstFrame + numFrames; frame++)
+		{
+			if (Atomic_swap( &(race->m_owners[frame]), 1 ) != 0)
+			{
+				Atomic_write( &(race->m_failed), 1 );
+			}
+		}
+		for (size_t frame = firstFrame; frame < firstFrame + numFrames; frame++)
+		{
+			Atomic_write( &(race->m_owners[frame]), 0 );
+		}
+
+		PmmBitmapAllocator_freeFrames( race->m_bitmap, firstFrameAddr, numFrames );
+		Atomic_fetchAdd( &(race->m_numClaims), 1 );
+	}
+	return NULL;
+}
+
+
+/// \brief	Checks that two threads racing for overlapping runs in the bitmap never share a frame,
+///			and that the losers leave nothing behind.
+///
+/// The free frames straddle the boundary between the two blocks of the bitmap. One thread asks for
+/// runs that straddle it too, and the other for runs that start right at the second block. The
+/// first thread can therefore claim its part of the first block, and then find that the other
+/// thread got to the second block first, which forces it to give back what it claimed. That only
+/// happens when a thread is interrupted at the right moment, so there are a lot of iterations.
+///
+/// \return \c true if the check passed.
+static bool PmmCheck_rangeRace( void )
+{
+	enum { NUM_THREADS = 2, NUM_BLOCKS = 2 };
+
+	size_t* bitmapSpace =
+		calloc( PmmBitmapAllocator_calculateSpaceInBlocks( NUM_BLOCKS ), sizeof( size_t ) );
+	PmmBitmapAllocator bitmap = PmmBitmapAllocator_create( bitmapSpace, NUM_BLOCKS, 0 );
+
+	phys_addr_t firstFreeAddr = MM_getFrameAddress( BITS_PER_BLOCK - RACE_FREE_BELOW );
+	PmmBitmapAllocator_freeFrames( &bitmap, firstFreeAddr, RACE_FREE_FRAMES );
+
+	RangeRace race;
+	race.m_bitmap		= &bitmap;
+	race.m_owners		= calloc( NUM_BLOCKS * BITS_PER_BLOCK, sizeof( uintptr_t ) );
+	race.m_numClaims	= 0;
+	race.m_failed		= 0;
+	pthread_barrier_init( &(race.m_start), NULL, NUM_THREADS );
+
+	RangeRacer racers[NUM_THREADS] =
+	{
+		{ &race, RACE_STRADDLE_RUN, 0 },
+		{ &race, RACE_ALIGNED_RUN, BITS_PER_BLOCK * PAGE_SIZE }
+	};
+
+	pthread_t threads[NUM_THREADS];
+	bool passed = true;
+	for (size_t i = 0; i < NUM_THREADS; i++)
+	{
+		passed =
+			(pthread_create( &(threads[i]), NULL, PmmCheck_raceForRanges, &(racers[i]) ) == 0) &&
+			passed;
+	}
+	for (size_t i = 0; i < NUM_THREADS; i++)
+	{
+		pthread_join( threads[i], NULL );
+	}
+	pthread_barrier_destroy( &(race.m_start) );
+
+	// Every frame has to be free again, or a losing claim wasn't rolled back.
+	passed = passed && (race.m_failed == 0) && (race.m_numClaims > 0) &&
+		(PmmBitmapAllocator_countFreeFrames( &bitmap ) == RACE_FREE_FRAMES);
+	for (size_t i = 0; passed && (i < RACE_FREE_FRAMES); i++)
+	{
+		passed = PmmBitmapAllocator_isFrameFree( &bitmap, firstFreeAddr + (phys_addr_t) (i * PAGE_SIZE) );
+	}
+
+	free( (void*) race.m_owners );
+	free( bitmapSpace );
+	return PmmCheck_report( "range race", passed, "frame claimed twice, or claim not undone" );
+}
+
+
+// Public functions
+
+/// \brief	Runs the PMM checks.
+///
+/// \param argc	the number of arguments after the name of the test.
+/// \param argv	the arguments after the name of the test.
+///
+/// \return \c true if every check passed.
+bool DoPmmCheck( int argc, char* argv[] )
+{
+	(void) argc;
+	(void) argv;
+
+	printf( "PMM checks:\n" );
+
+	bool passed = true;
+	passed = PmmCheck_stageTwo() && passed;
+	passed = PmmCheck_frameCacheInstalled() && passed;
+	passed = PmmCheck_frameCacheRefill() && passed;
+	passed = PmmCheck_frameCacheSpill() && passed;
+	passed = PmmCheck_frameCacheRaid() && passed;
+	passed = PmmCheck_frameCacheDrainAll() && passed;
+	passed = PmmCheck_colours() && passed;
+	passed = PmmCheck_rangeAlignment() && passed;
+	passed = PmmCheck_rangeMaxAddr() && passed;
+	passed = PmmCheck_rangeNoFit() && passed;
+	passed = PmmCheck_rangeDrainsCaches() && passed;
+	passed = PmmCheck_rangeRace() && passed;
+	return passed;
+}
@@ -0,0 +1,559 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/UnitTest/Hosted/PmmStress.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/02
+//
+// ===========================================================================
+///
+///	\file
+///
+/// \brief	Hammers PmmBitmapAllocator from many threads at once, checking for
+///			double allocation and lost frames, and measuring how throughput
+///			scales with the number of threads.
+///
+/// Each thread of the host process stands in for a processor. For each
+/// thread count from 1 up to the maximum (doubling each time), three
+/// workloads are run against the same allocator:
+///
+///	- Churn: a pool that never runs dry. Each thread holds up to a few dozen
+///	  frames, and randomly allocates with PmmBitmapAllocator_allocate() or
+///	  PmmBitmapAllocator_allocateFrame(), or frees with
+///	  PmmBitmapAllocator_free(). This measures contention on the shared
+///	  m_lastAllocatedIndex and on the bitmap blocks near it.
+///	- Scarce: the same, but with a pool small enough that the threads between
+///	  them want more frames than there are. Allocations fail regularly, and
+///	  every thread is fighting over the same few blocks, so this is the worst
+///	  case for the CAS retry loops.
+///	- Fill: every thread allocates as fast as it can until the allocator runs
+///	  dry. Between them, they must get every free frame exactly once.
+///
+/// Every frame handed out is claimed in a shared ownership table with a CAS,
+/// so a frame handed to two threads at once is caught immediately. After each
+/// run, every frame is given back and the allocator is checked to make sure
+/// that every frame is free again, and that all of them can be allocated
+/// ("lost frames" would show up as a shortfall).
+///
+/// Usage: hostedtest stress [maxThreads] [milliseconds]
+///
+/// \a maxThreads defaults to 64, and each churn run lasts \a milliseconds,
+/// which defaults to 200.
+///
+// ===========================================================================
+
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "Kernel/HAL/Atomic.h"
+#include "Kernel/MM/MM.h"
+#include "PmmBitmapAllocator.h"
+
+
+// Private constants
+
+/// \brief	Defines private constants for the stress test.
+enum PmmStress_consts
+{
+	MAX_STRESS_THREADS	= 64,		///< Most threads the stress test will start.
+	MAX_HELD_FRAMES		= 64,		///< Most frames each thread holds during the churn tests.
+	CHURN_POOL_FRAMES	= 16384,	///< Frames in the pool for the churn and fill tests (64 MB).
+	SCARCE_POOL_FRAMES	= 1024		///< Frames in the pool for the scarce test (4 MB).
+};
+
+
+
+// Private types
+
+/// \brief	The allocator under test, and everything needed to check up on it.
+typedef struct StressPool
+{
+	PmmBitmapAllocator	m_bitmap;			///< The allocator under test.
+	size_t*				m_bitmapSpace;		///< Working space of m_bitmap.
+	size_t				m_numFrames;		///< Frames tracked by m_bitmap, including frame zero.
+
+	/// \brief	For each frame, zero if it is free, otherwise one more than the ID of the thread
+	///			that holds it.
+	volatile uintptr_t*	m_owners;
+
+	/// \brief	Set by the main thread to tell the workers to stop.
+	volatile uintptr_t	m_stop;
+
+	/// \brief	Makes the workers and the main thread start together.
+	pthread_barrier_t	m_start;
+
+	/// \brief	Set to a non-zero value by the first thread to find a problem.
+	volatile uintptr_t	m_failed;
+} StressPool;
+
+
+/// \brief	Identifies a workload.
+typedef enum
+{
+	WORKLOAD_CHURN,		///< Random allocations and frees; Runs until told to stop.
+	WORKLOAD_FILL		///< Allocate until the allocator runs dry.
+} StressWorkload;
+
+
+/// \brief	The state and results of one worker thread.
+typedef struct StressThread
+{
+	pthread_t		m_thread;			///< The thread itself.
+	StressPool*		m_pool;				///< The pool that the thread is hammering.
+	StressWorkload	m_workload;			///< What the thread does to the pool.
+	uintptr_t		m_id;				///< Small integer that identifies the thread.
+	uint64_t		m_seed;				///< Seed of the thread's random number generator.
+
+	phys_addr_t		m_held[MAX_HELD_FRAMES];	///< Frames held when the thread finished.
+	size_t			m_numHeld;					///< Number of entries in m_held.
+
+	uint64_t		m_numOps;			///< Number of allocations and frees done.
+	uint64_t		m_numAllocs;		///< Number of calls to allocate and allocateFrame.
+	uint64_t		m_numFailedAllocs;	///< Number of those calls that returned PHYS_NULL.
+	uint64_t		m_startNs;			///< When the thread started work.
+	uint64_t		m_endNs;			///< When the thread finished work.
+} StressThread;
+
+
+/// \brief	The results of a run, added up across all the threads.
+typedef struct StressResult
+{
+	double		m_mops;				///< Millions of operations per second.
+	double		m_failedPercent;	///< Percentage of allocations that returned PHYS_NULL.
+} StressResult;
+
+
+
+// Private functions
+
+/// \brief	Returns the number of nanoseconds on the monotonic clock.
+static uint64_t PmmStress_now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (((uint64_t) ts.tv_sec) * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+}
+
+
+/// \brief	Returns a pseudo-random number (xorshift64*).
+static uint64_t PmmStress_random( uint64_t* state )
+{
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return *state * 2685821657736338717ULL;
+}
+
+
+/// \brief	Reports a problem found by one of the threads.
+///
+/// Only the first problem is printed, since one bug usually causes a flood of them.
+static void PmmStress_fail( StressPool* pool, const char* what, phys_addr_t frameAddr )
+{
+	if (Atomic_compareAndSwap( &(pool->m_failed), 0, 1 ))
+	{
+		printf( "  FAILED: %s (frame 0x%08lx)\n", what, (unsigned long) frameAddr );
+	}
+}
+
+
+/// \brief	Records that the given thread now holds the given frame.
+///
+/// \retval true	the frame was free, and now belongs to \a id.
+/// \retval false	the frame is bad, or some other thread already holds it.
+static bool PmmStress_claim( StressPool* pool, uintptr_t id, phys_addr_t frameAddr )
+{
+	size_t frameNumber = MM_getFrameNumber( frameAddr );
+	if (!MM_isFrameAligned( frameAddr ) || (frameNumber == 0) ||
+		(frameNumber >= pool->m_numFrames))
+	{
+		PmmStress_fail( pool, "handed out a frame outside the pool", frameAddr );
+		return false;
+	}
+	if (!Atomic_compareAndSwap( &(pool->m_owners[frameNumber]), 0, id + 1 ))
+	{
+		PmmStress_fail( pool, "handed out a frame that another thread holds", frameAddr );
+		return false;
+	}
+	return true;
+}
+
+
+/// \brief	Records that the given thread no longer holds the given frame.
+///
+/// This must be called before the frame is actually freed, since another thread may allocate it
+/// again as soon as it is.
+static void PmmStress_disown( StressPool* pool, uintptr_t id, phys_addr_t frameAddr )
+{
+	size_t frameNumber = MM_getFrameNumber( frameAddr );
+	if (!Atomic_compareAndSwap( &(pool->m_owners[frameNumber]), id + 1, 0 ))
+	{
+		PmmStress_fail( pool, "a frame changed hands while a thread held it", frameAddr );
+	}
+}
+
+
+/// \brief	Randomly allocates and frees frames until told to stop.
+static void PmmStress_churn( StressThread* thread )
+{
+	StressPool* pool = thread->m_pool;
+	volatile PmmBitmapAllocator* bitmap = &(pool->m_bitmap);
+	uint64_t rng = thread->m_seed;
+
+	// Keep the hot counters in locals so that the threads don't share cache lines.
+	phys_addr_t held[MAX_HELD_FRAMES];
+	size_t numHeld = 0;
+	uint64_t numOps = 0;
+	uint64_t numAllocs = 0;
+	uint64_t numFailedAllocs = 0;
+
+	while (Atomic_read( &(pool->m_stop) ) == 0)
+	{
+		uint64_t r = PmmStress_random( &rng );
+
+		if ((numHeld == MAX_HELD_FRAMES) || ((numHeld > 0) && ((r & 1) == 0)))
+		{
+			size_t index = (size_t) ((r >> 8) % numHeld);
+			phys_addr_t frameAddr = held[index];
+			held[index] = held[--numHeld];
+
+			PmmStress_disown( pool, thread->m_id, frameAddr );
+			PmmBitmapAllocator_free( bitmap, frameAddr );
+		}
+		else
+		{
+			// Mostly plain allocations, with the occasional request for a particular frame thrown
+			// in to race against them.
+			phys_addr_t frameAddr;
+			if (((r >> 1) & 7) == 0)
+			{
+				size_t frameNumber = 1 + (size_t) ((r >> 8) % (pool->m_numFrames - 1));
+				frameAddr = PmmBitmapAllocator_allocateFrame(
+					bitmap,
+					MM_getFrameAddress( frameNumber )
+				);
+			}
+			else
+			{
+				frameAddr = PmmBitmapAllocator_allocate( bitmap, NULL );
+			}
+
+			numAllocs++;
+			if (frameAddr == PHYS_NULL)
+			{
+				numFailedAllocs++;
+			}
+			else if (PmmStress_claim( pool, thread->m_id, frameAddr ))
+			{
+				held[numHeld++] = frameAddr;
+			}
+		}
+		numOps++;
+	}
+
+	memcpy( thread->m_held, held, numHeld * sizeof( phys_addr_t ) );
+	thread->m_numHeld			= numHeld;
+	thread->m_numOps			= numOps;
+	thread->m_numAllocs			= numAllocs;
+	thread->m_numFailedAllocs	= numFailedAllocs;
+}
+
+
+/// \brief	Allocates frames until the allocator runs dry.
+///
+/// The frames are left allocated. Their owners are recorded in the pool's ownership table.
+static void PmmStress_fill( StressThread* thread )
+{
+	StressPool* pool = thread->m_pool;
+	volatile PmmBitmapAllocator* bitmap = &(pool->m_bitmap);
+	uint64_t numAllocs = 0;
+
+	for (;;)
+	{
+		phys_addr_t frameAddr = PmmBitmapAllocator_allocate( bitmap, NULL );
+		if (frameAddr == PHYS_NULL)
+		{
+			break;
+		}
+		PmmStress_claim( pool, thread->m_id, frameAddr );
+		numAllocs++;
+	}
+
+	thread->m_numHeld			= 0;
+	thread->m_numOps			= numAllocs;
+	thread->m_numAllocs			= numAllocs;
+	thread->m_numFailedAllocs	= 0;
+}
+
+
+/// \brief	Entry point of each worker thread.
+static void* PmmStress_threadMain( void* arg )
+{
+	StressThread* thread = (StressThread*) arg;
+
+	pthread_barrier_wait( &(thread->m_pool->m_start) );
+
+	// Each thread times itself, since on a busy host the main thread may not get to run again
+	// until some of the workers are done.
+	thread->m_startNs = PmmStress_now();
+	if (thread->m_workload == WORKLOAD_CHURN)
+	{
+		PmmStress_churn( thread );
+	}
+	else
+	{
+		PmmStress_fill( thread );
+	}
+	thread->m_endNs = PmmStress_now();
+	return NULL;
+}
+
+
+/// \brief	Creates a pool with every frame but frame zero free.
+static void PmmStress_createPool( StressPool* pool, size_t numFrames )
+{
+	size_t numBlocks = PmmBitmapAllocator_framesToBlocks( numFrames );
+	pool->m_numFrames	= numFrames;
+	pool->m_bitmapSpace	=
+		calloc( PmmBitmapAllocator_calculateSpaceInBlocks( numBlocks ), sizeof( size_t ) );
+	pool->m_owners		= calloc( numFrames, sizeof( uintptr_t ) );
+	pool->m_stop		= 0;
+	pool->m_failed		= 0;
+
+	pool->m_bitmap = PmmBitmapAllocator_create( pool->m_bitmapSpace, numBlocks, 0 );
+	PmmBitmapAllocator_freeFrames( &(pool->m_bitmap), PAGE_SIZE, numFrames - 1 );
+}
+
+
+/// \brief	Frees the resources used by the given pool.
+static void PmmStress_destroyPool( StressPool* pool )
+{
+	free( (void*) pool->m_owners );
+	free( pool->m_bitmapSpace );
+}
+
+
+/// \brief	Checks that every frame in the pool is free, and that all of them can be allocated.
+///
+/// The pool must be quiescent, and nobody may hold any frames. Every frame is free again when
+/// this returns.
+static void PmmStress_checkPool( StressPool* pool )
+{
+	volatile PmmBitmapAllocator* bitmap = &(pool->m_bitmap);
+
+	for (size_t i = 1; i < pool->m_numFrames; i++)
+	{
+		phys_addr_t frameAddr = MM_getFrameAddress( i );
+		if (!PmmBitmapAllocator_isFrameFree( bitmap, frameAddr ))
+		{
+			PmmStress_fail( pool, "lost frame; allocated, but nobody holds it", frameAddr );
+			PmmBitmapAllocator_freeFrames( bitmap, frameAddr, 1 );
+		}
+	}
+
+	size_t numFree = PmmBitmapAllocator_countFreeFrames( bitmap );
+	if (numFree != pool->m_numFrames - 1)
+	{
+		PmmStress_fail( pool, "free frame count is wrong", PHYS_NULL );
+		printf( "          counted %lu of %lu\n",
+			(unsigned long) numFree, (unsigned long) (pool->m_numFrames - 1) );
+	}
+
+	// The summary bitmaps have to agree with the bitmap, or some of the free frames will be
+	// unreachable.
+	size_t numAllocated = 0;
+	while (PmmBitmapAllocator_allocate( bitmap, NULL ) != PHYS_NULL)
+	{
+		numAllocated++;
+	}
+	if (numAllocated != pool->m_numFrames - 1)
+	{
+		PmmStress_fail( pool, "lost frames; some free frames could not be allocated", PHYS_NULL );
+		printf( "          got %lu of %lu\n",
+			(unsigned long) numAllocated, (unsigned long) (pool->m_numFrames - 1) );
+	}
+	PmmBitmapAllocator_freeFrames( bitmap, PAGE_SIZE, pool->m_numFrames - 1 );
+}
+
+
+/// \brief	Runs one workload with the given number of threads.
+///
+/// \param pool			the pool to hammer. Every frame in it must be free.
+/// \param workload		what the threads should do.
+/// \param numThreads	the number of threads to start.
+/// \param runNs		how long a WORKLOAD_CHURN run should last, in nanoseconds.
+///
+/// \return the combined results of all the threads.
+static StressResult PmmStress_run(
+	StressPool*		pool,
+	StressWorkload	workload,
+	size_t			numThreads,
+	uint64_t		runNs
+)
+{
+	static StressThread s_threads[MAX_STRESS_THREADS];
+
+	Atomic_write( &(pool->m_stop), 0 );
+	pthread_barrier_init( &(pool->m_start), NULL, (unsigned) numThreads + 1 );
+
+	for (size_t i = 0; i < numThreads; i++)
+	{
+		StressThread* thread = &(s_threads[i]);
+		memset( thread, 0, sizeof( StressThread ) );
+		thread->m_pool		= pool;
+		thread->m_workload	= workload;
+		thread->m_id		= i;
+		thread->m_seed		= 0x9E3779B97F4A7C15ULL * (i + 1);
+
+		if (pthread_create( &(thread->m_thread), NULL, PmmStress_threadMain, thread ) != 0)
+		{
+			fprintf( stderr, "pthread_create failed\n" );
+			exit( EXIT_FAILURE );
+		}
+	}
+
+	pthread_barrier_wait( &(pool->m_start) );
+
+	if (workload == WORKLOAD_CHURN)
+	{
+		struct timespec delay;
+		delay.tv_sec	= (time_t) (runNs / 1000000000ULL);
+		delay.tv_nsec	= (long) (runNs % 1000000000ULL);
+		nanosleep( &delay, NULL );
+		Atomic_write( &(pool->m_stop), 1 );
+	}
+
+	for (size_t i = 0; i < numThreads; i++)
+	{
+		pthread_join( s_threads[i].m_thread, NULL );
+	}
+	pthread_barrier_destroy( &(pool->m_start) );
+
+	// Add up the results, and give back everything the threads are still holding. The run lasted
+	// from when the first thread started until the last one finished.
+	uint64_t start = UINT64_MAX;
+	uint64_t end = 0;
+	uint64_t numOps = 0;
+	uint64_t numAllocs = 0;
+	uint64_t numFailedAllocs = 0;
+
+	for (size_t i = 0; i < numThreads; i++)
+	{
+		StressThread* thread = &(s_threads[i]);
+		start			= (thread->m_startNs < start) ? thread->m_startNs : start;
+		end				= (thread->m_endNs > end) ? thread->m_endNs : end;
+		numOps			+= thread->m_numOps;
+		numAllocs		+= thread->m_numAllocs;
+		numFailedAllocs	+= thread->m_numFailedAllocs;
+
+		for (size_t j = 0; j < thread->m_numHeld; j++)
+		{
+			PmmStress_disown( pool, thread->m_id, thread->m_held[j] );
+			PmmBitmapAllocator_free( &(pool->m_bitmap), thread->m_held[j] );
+		}
+	}
+
+	if (workload == WORKLOAD_FILL)
+	{
+		if (numAllocs != pool->m_numFrames - 1)
+		{
+			PmmStress_fail( pool, "lost frames; the threads didn't get every frame", PHYS_NULL );
+			printf( "          got %lu of %lu\n",
+				(unsigned long) numAllocs, (unsigned long) (pool->m_numFrames - 1) );
+		}
+
+		memset( (void*) pool->m_owners, 0, pool->m_numFrames * sizeof( uintptr_t ) );
+		PmmBitmapAllocator_freeFrames( &(pool->m_bitmap), PAGE_SIZE, pool->m_numFrames - 1 );
+	}
+
+	PmmStress_checkPool( pool );
+
+	uint64_t elapsed = end - start;
+	StressResult result;
+	result.m_mops			= (elapsed == 0) ? 0.0 : ((double) numOps * 1000.0) / (double) elapsed;
+	result.m_failedPercent	=
+		(numAllocs == 0) ? 0.0 : (100.0 * (double) numFailedAllocs) / (double) numAllocs;
+	return result;
+}
+
+
+
+// Public functions
+
+/// \brief	Runs the multi-threaded stress test of PmmBitmapAllocator.
+///
+/// \param argc	the number of arguments after the name of the test.
+/// \param argv	the arguments after the name of the test.
+///
+/// \return \c true if all the consistency checks passed.
+bool DoPmmStress( int argc, char* argv[] )
+{
+	size_t maxThreads = (argc > 0) ? (size_t) strtoul( argv[0], NULL, 0 ) : MAX_STRESS_THREADS;
+	uint64_t runMs = (argc > 1) ? strtoull( argv[1], NULL, 0 ) : 200;
+
+	if ((maxThreads == 0) || (maxThreads > MAX_STRESS_THREADS))
+	{
+		maxThreads = MAX_STRESS_THREADS;
+	}
+
+	static StressPool s_churnPool;
+	static StressPool s_scarcePool;
+	PmmStress_createPool( &s_churnPool, CHURN_POOL_FRAMES );
+	PmmStress_createPool( &s_scarcePool, SCARCE_POOL_FRAMES );
+
+	printf( "PmmBitmapAllocator stress test (%lu ms per churn run):\n", (unsigned long) runMs );
+	printf( "  %7s %13s %8s %13s %8s %8s %13s\n",
+		"threads", "churn Mops/s", "scaling", "scarce Mops/s", "failed%", "scaling",
+		"fill Mops/s" );
+
+	double churnBase = 0.0;
+	double scarceBase = 0.0;
+
+	size_t numThreads = 1;
+	for (;;)
+	{
+		StressResult churn =
+			PmmStress_run( &s_churnPool, WORKLOAD_CHURN, numThreads, runMs * 1000000ULL );
+		StressResult scarce =
+			PmmStress_run( &s_scarcePool, WORKLOAD_CHURN, numThreads, runMs * 1000000ULL );
+		StressResult fill = PmmStress_run( &s_churnPool, WORKLOAD_FILL, numThreads, 0 );
+
+		if (numThreads == 1)
+		{
+			churnBase	= churn.m_mops;
+			scarceBase	= scarce.m_mops;
+		}
+
+		printf( "  %7lu %13.2f %7.2fx %13.2f %7.1f%% %7.2fx %13.2f\n",
+			(unsigned long) numThreads,
+			churn.m_mops,
+			(churnBase == 0.0) ? 0.0 : churn.m_mops / churnBase,
+			scarce.m_mops,
+			scarce.m_failedPercent,
+			(scarceBase == 0.0) ? 0.0 : scarce.m_mops / scarceBase,
+			fill.m_mops );
+		fflush( stdout );
+
+		// Double the number of threads each time, but make sure that the largest thread count
+		// gets a run even if it isn't a power of two.
+		if (numThreads == maxThreads)
+		{
+			break;
+		}
+		numThreads = ((numThreads * 2) > maxThreads) ? maxThreads : (numThreads * 2);
+	}
+
+	bool passed = (s_churnPool.m_failed == 0) && (s_scarcePool.m_failed == 0);
+	PmmStress_destroyPool( &s_scarcePool );
+	PmmStress_destroyPool( &s_churnPool );
+	return passed;
+}
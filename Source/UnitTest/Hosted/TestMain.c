@@ -0,0 +1,74 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/UnitTest/Hosted/TestMain.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/02
+//
+// ===========================================================================
+///
+///	\file
+///
+/// \brief	Entry point of the hosted unit tests.
+///
+/// Usage: hostedtest <test> [arguments...]
+///
+/// The first argument names the test to run. The rest are passed on to the
+/// test. The exit status is non-zero if the test found a problem.
+///
+// ===========================================================================
+
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool DoLockStress( int argc, char* argv[] );
+bool DoPmmBench( int argc, char* argv[] );
+bool DoPmmCheck( int argc, char* argv[] );
+bool DoPmmStress( int argc, char* argv[] );
+bool DoWorkDequeStress( int argc, char* argv[] );
+
+
+/// \brief	Maps the name of each test to the function that runs it.
+static const struct
+{
+	const char*	name;
+	bool		(*run)( int argc, char* argv[] );
+	const char*	usage;
+} s_tests[] =
+{
+	{ "bench",	DoPmmBench,		"bench [maxMegabytes]" },
+	{ "stress",	DoPmmStress,	"stress [maxThreads] [milliseconds]" },
+	{ "pmm",		DoPmmCheck,		"pmm" },
+	{ "locks",	DoLockStress,	"locks [maxThreads] [iterations]" },
+	{ "deque",	DoWorkDequeStress,	"deque [maxThieves] [iterations]" }
+};
+
+
+int main( int argc, char* argv[] )
+{
+	for (size_t i = 0; (argc > 1) && (i < sizeof( s_tests ) / sizeof( s_tests[0] )); i++)
+	{
+		if (strcmp( argv[1], s_tests[i].name ) == 0)
+		{
+			bool passed = s_tests[i].run( argc - 2, argv + 2 );
+			printf( "\n%s\n", passed ? "All checks passed." : "SOME CHECKS FAILED." );
+			return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	fprintf( stderr, "Usage:\n" );
+	for (size_t i = 0; i < sizeof( s_tests ) / sizeof( s_tests[0] ); i++)
+	{
+		fprintf( stderr, "  %s %s\n", argv[0], s_tests[i].usage );
+	}
+	return EXIT_FAILURE;
+}
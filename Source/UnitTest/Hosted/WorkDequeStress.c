@@ -0,0 +1,261 @@
+// ===========================================================================
+//
+//             Copyright (C) 2004-2006 Bruce Johnston
+//
+// ===========================================================================
+//
+//   //osdev/precursor/Source/UnitTest/Hosted/WorkDequeStress.c
+//
+// ===========================================================================
+//
+//	Originating Author:	BruceJ
+//	Originating Date:	2006/May/14
+//
+// ===========================================================================
+///
+///	\file
+///
+/// \brief	Hammers a WorkDeque with one owner and many thieves, checking that
+///			every item is taken exactly once.
+///
+/// The owner pushes a numbered item for each iteration, and pops one back
+/// after every POPS_EVERY pushes, or whenever the deque is full. Once it has
+/// pushed everything, it pops whatever is left. Meanwhile, the thieves steal
+/// as fast as they can. Everyone counts each item they get, so an item that
+/// is lost or taken twice shows up as a count other than one.
+///
+/// Usage: hostedtest deque [maxThieves] [iterations]
+///
+/// \a maxThieves defaults to 8, and the owner pushes \a iterations items,
+/// which defaults to 1000000.
+///
+// ===========================================================================
+
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "Kernel/HAL/Atomic.h"
+#include "Kernel/HAL/WorkDeque.h"
+
+
+// Private constants
+
+/// \brief	Defines private constants for the WorkDeque stress test.
+enum WorkDequeStress_consts
+{
+	MAX_DEQUE_THIEVES	= 63,	///< Most thieves the WorkDeque stress test will start.
+	POPS_EVERY			= 4		///< Pushes between pops by the owner.
+};
+
+
+
+// Private types
+
+/// \brief	The WorkDeque under test, and the counts of how often each item was taken.
+typedef struct WorkDequeStressShared
+{
+	WorkDeque			m_deque;		///< The WorkDeque under test.
+	volatile uintptr_t*	m_taken;		///< Times each item was taken, indexed by item - 1.
+	volatile uintptr_t	m_numStolen;	///< Items taken by the thieves.
+	volatile uintptr_t	m_done;			///< Set once the owner has emptied the deque for good.
+	size_t				m_iterations;	///< Items the owner pushes.
+	pthread_barrier_t	m_start;		///< Makes everyone start together.
+} WorkDequeStressShared;
+
+
+
+// Private functions
+
+/// \brief	Counts an item that was taken from the deque.
+static void WorkDequeStress_take( WorkDequeStressShared* shared, void* item )
+{
+	Atomic_fetchAdd( &(shared->m_taken[(uintptr_t) item - 1]), 1 );
+}
+
+
+/// \brief	Body of the owner thread.
+///
+/// \param arg	the WorkDequeStressShared that all the threads share.
+///
+/// \return NULL.
+static void* WorkDequeStress_ownerMain( void* arg )
+{
+	WorkDequeStressShared* shared = (WorkDequeStressShared*) arg;
+	pthread_barrier_wait( &(shared->m_start) );
+
+	for (size_t i = 0; i < shared->m_iterations; i++)
+	{
+		// Items are numbered from 1, since a WorkDeque can't hold NULL.
+		void* item = (void*) (uintptr_t) (i + 1);
+		while (!WorkDeque_push( &(shared->m_deque), item ))
+		{
+			void* popped = WorkDeque_pop( &(shared->m_deque) );
+			if (popped != NULL)
+			{
+				WorkDequeStress_take( shared, popped );
+			}
+		}
+
+		if ((i % POPS_EVERY) == 0)
+		{
+			void* popped = WorkDeque_pop( &(shared->m_deque) );
+			if (popped != NULL)
+			{
+				WorkDequeStress_take( shared, popped );
+			}
+		}
+	}
+
+	void* popped;
+	while ((popped = WorkDeque_pop( &(shared->m_deque) )) != NULL)
+	{
+		WorkDequeStress_take( shared, popped );
+	}
+	Atomic_writeExplicit( &(shared->m_done), 1, ATOMIC_RELEASE );
+	return NULL;
+}
+
+
+/// \brief	Body of each thief thread.
+///
+/// \param arg	the WorkDequeStressShared that all the threads share.
+///
+/// \return NULL.
+static void* WorkDequeStress_thiefMain( void* arg )
+{
+	WorkDequeStressShared* shared = (WorkDequeStressShared*) arg;
+	pthread_barrier_wait( &(shared->m_start) );
+
+	// Nothing is pushed once the owner is done, so an empty deque after that means we're finished.
+	while (true)
+	{
+		bool done = (Atomic_readExplicit( &(shared->m_done), ATOMIC_ACQUIRE ) != 0);
+		void* item = WorkDeque_steal( &(shared->m_deque) );
+		if (item != NULL)
+		{
+			WorkDequeStress_take( shared, item );
+			Atomic_fetchAdd( &(shared->m_numStolen), 1 );
+		}
+		else if (done)
+		{
+			break;
+		}
+	}
+	return NULL;
+}
+
+
+/// \brief	Runs the owner with the given number of thieves.
+///
+/// \param shared		the WorkDeque and counts to use.
+/// \param numThieves	the number of thieves to start.
+///
+/// \return \c true if every item was taken exactly once.
+static bool WorkDequeStress_run( WorkDequeStressShared* shared, size_t numThieves )
+{
+	static pthread_t s_threads[MAX_DEQUE_THIEVES + 1];
+
+	WorkDeque_init( &(shared->m_deque) );
+	for (size_t i = 0; i < shared->m_iterations; i++)
+	{
+		shared->m_taken[i] = 0;
+	}
+	shared->m_numStolen	= 0;
+	shared->m_done		= 0;
+	pthread_barrier_init( &(shared->m_start), NULL, (unsigned) (numThieves + 1) );
+
+	for (size_t i = 0; i <= numThieves; i++)
+	{
+		void* (*threadMain)( void* ) =
+			(i == 0) ? WorkDequeStress_ownerMain : WorkDequeStress_thiefMain;
+
+		if (pthread_create( &(s_threads[i]), NULL, threadMain, shared ) != 0)
+		{
+			fprintf( stderr, "pthread_create failed\n" );
+			exit( EXIT_FAILURE );
+		}
+	}
+	for (size_t i = 0; i <= numThieves; i++)
+	{
+		pthread_join( s_threads[i], NULL );
+	}
+	pthread_barrier_destroy( &(shared->m_start) );
+
+	size_t numLost = 0;
+	size_t numDuplicated = 0;
+	for (size_t i = 0; i < shared->m_iterations; i++)
+	{
+		if (shared->m_taken[i] == 0)
+		{
+			numLost++;
+		}
+		else if (shared->m_taken[i] > 1)
+		{
+			numDuplicated++;
+		}
+	}
+
+	printf( "  %7lu %10lu", (unsigned long) numThieves, (unsigned long) shared->m_numStolen );
+	if ((numLost != 0) || (numDuplicated != 0))
+	{
+		printf( "  FAILED: %lu lost, %lu taken more than once",
+			(unsigned long) numLost,
+			(unsigned long) numDuplicated );
+	}
+	printf( "\n" );
+	return (numLost == 0) && (numDuplicated == 0);
+}
+
+
+
+// Public functions
+
+/// \brief	Runs the multi-threaded stress test of WorkDeque.
+///
+/// \param argc	the number of arguments after the name of the test.
+/// \param argv	the arguments after the name of the test.
+///
+/// \return \c true if no item was ever lost or taken twice.
+bool DoWorkDequeStress( int argc, char* argv[] )
+{
+	size_t maxThieves = (argc > 0) ? (size_t) strtoul( argv[0], NULL, 0 ) : 8;
+	size_t iterations = (argc > 1) ? (size_t) strtoul( argv[1], NULL, 0 ) : 1000000;
+
+	if ((maxThieves == 0) || (maxThieves > MAX_DEQUE_THIEVES))
+	{
+		maxThieves = MAX_DEQUE_THIEVES;
+	}
+
+	static WorkDequeStressShared s_shared;
+	s_shared.m_iterations	= iterations;
+	s_shared.m_taken		= calloc( iterations, sizeof( uintptr_t ) );
+	if (s_shared.m_taken == NULL)
+	{
+		fprintf( stderr, "Out of memory\n" );
+		exit( EXIT_FAILURE );
+	}
+
+	printf( "WorkDeque stress test (%lu items, ", (unsigned long) iterations );
+	printf( "capacity %d, owner pops 1 in %d):\n", WORK_DEQUE_CAPACITY, POPS_EVERY );
+	printf( "  %7s %10s\n", "thieves", "stolen" );
+
+	bool passed = true;
+	size_t numThieves = 1;
+	for (;;)
+	{
+		passed = WorkDequeStress_run( &s_shared, numThieves ) && passed;
+		fflush( stdout );
+
+		if (numThieves == maxThieves)
+		{
+			break;
+		}
+		numThieves = ((numThieves * 2) > maxThieves) ? maxThieves : (numThieves * 2);
+	}
+
+	free( (void*) s_shared.m_taken );
+	return passed;
+}